@@ -0,0 +1,88 @@
+/*********************************************************************************
+Simulated chamber, for trying out the humidity control without a chamber.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "ChamberPlant.h"
+
+#if defined(HUMIDOSH_SIMULATION) || defined(HUMIDOSH_HOST)
+
+ChamberPlant::ChamberPlant() : pumpDrive_(0), valveDryOpen_(false), valveWetOpen_(false), lastUpdateTime_(0), started_(false)
+{
+  RH_ = RH_AMBIENT;
+}
+
+void ChamberPlant::setPumpDrive(uint16_t duty)
+{
+  pumpDrive_ = duty;
+}
+
+void ChamberPlant::setValveDry(bool open)
+{
+  valveDryOpen_ = open;
+}
+
+void ChamberPlant::setValveWet(bool open)
+{
+  valveWetOpen_ = open;
+}
+
+// Advance the model to now and return the RH (%).
+float ChamberPlant::update(unsigned long now)
+{
+  if (!started_)
+  {
+    started_ = true;
+    lastUpdateTime_ = now;
+    return RH_;
+  }
+
+  // RH of the air coming in. With both valves open the two lines mix; with both closed nothing flows.
+  float flowRate = 0;
+  float RHIn = 0;
+
+  if (valveWetOpen_ || valveDryOpen_)
+  {
+    flowRate = FLOW_RATE_MAX * pumpDrive_ / PUMPDRIVE_TOP;
+    RHIn = valveWetOpen_ && valveDryOpen_ ? (RH_WET + RH_DRY) / 2 : (valveWetOpen_ ? RH_WET : RH_DRY);
+  }
+
+  // Euler integration, in steps short enough to stay stable.
+  unsigned long elapsed = now - lastUpdateTime_;
+  lastUpdateTime_ = now;
+
+  while (elapsed > 0)
+  {
+    uint16_t step = elapsed > STEP_MAX ? STEP_MAX : elapsed;
+    float dt = step / 1000.0;
+    RH_ += dt * (flowRate * (RHIn - RH_) + LEAK_RATE * (RH_AMBIENT - RH_));
+    elapsed -= step;
+  }
+
+  return RH_;
+}
+
+float ChamberPlant::getRH()
+{
+  return RH_;
+}
+
+float ChamberPlant::getTemperature()
+{
+  return TEMPERATURE;
+}
+
+#endif // HUMIDOSH_SIMULATION || HUMIDOSH_HOST
@@ -0,0 +1,82 @@
+/*********************************************************************************
+Simulated chamber, for trying out the humidity control without a chamber.
+
+Uncomment HUMIDOSH_SIMULATION below to replace the RH sensor with this model. The
+pump and valves are still driven as usual, and the model follows them: the pump
+pushes air from the wet (or dry) line into the chamber, and the chamber also leaks
+slowly towards the ambient RH. Everything else (screen, keypad, fan controller
+and the computer link) is the real hardware, so the sketch is meant to run on the
+controller board with only the chamber missing.
+
+The model runs in real time, since the control is timed with millis(). Use the
+step response metrics (see StepResponse.h) and the task statistics to compare
+tunings and measure the loop cost.
+
+The host build (see host/HostSim.h) runs the same model behind a model of the
+SHT3x, on a virtual clock, so that thousands of steps take minutes instead of days.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _CHAMBERPLANT_h
+#define _CHAMBERPLANT_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#include "PumpDrive.h"
+
+//#define HUMIDOSH_SIMULATION 1
+
+#if defined(HUMIDOSH_SIMULATION) || defined(HUMIDOSH_HOST)
+
+class ChamberPlant
+{
+public:
+  static const uint16_t MEASUREMENT_PERIOD = 100; // Period (ms) of the simulated RH readings, same as the SHT3x at 10 measurements per second
+
+  ChamberPlant();
+  void setPumpDrive(uint16_t duty);  // 0 to PUMPDRIVE_TOP
+  void setValveDry(bool open);
+  void setValveWet(bool open);
+  float update(unsigned long now);
+  float getRH();
+  float getTemperature();
+
+private:
+  // Parameters of the model. Adjust these to match the chamber being simulated.
+  static constexpr float RH_AMBIENT        = 50;     // %RH of the room
+  static constexpr float RH_WET            = 95;     // %RH of the air coming out of the water bubbler
+  static constexpr float RH_DRY            = 5;      // %RH of the air coming out of the desiccant
+  static constexpr float TEMPERATURE       = 25;     // degC, constant
+  static constexpr float FLOW_RATE_MAX     = 0.02;   // Fraction of the chamber air replaced per second at full pump drive
+  static constexpr float LEAK_RATE         = 0.0003; // Fraction of the chamber air exchanged with the room per second
+  static const uint16_t STEP_MAX       = 100;    // Longest integration step (ms)
+
+  float RH_;
+  uint16_t pumpDrive_;
+  bool valveDryOpen_;
+  bool valveWetOpen_;
+  unsigned long lastUpdateTime_;
+  bool started_;
+};
+
+#endif // HUMIDOSH_SIMULATION || HUMIDOSH_HOST
+
+#endif
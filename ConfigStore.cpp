@@ -0,0 +1,301 @@
+/*********************************************************************************
+Settings kept in EEPROM.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "ConfigStore.h"
+#include "SHT3x.h"
+
+// Where the SHT3x kept its two-point RH calibration before ConfigStore: for each point, a CRC, the ref. RH at +2 and the
+// raw RH at +6. Only read by importOldCalibration(); it ends well before the last slot.
+static const uint8_t OLD_ADDR_CALIBRATION     = 10;
+static const uint8_t OLD_LENGTH_CAL_POINT     = 10;
+static const float OLD_CAL_POINT_DEFAULT[2]   = { 1, 100 };  // Both raw and ref. RH (%) of a point that wasn't saved
+
+ConfigStore::ConfigStore() : slot_(0), sequence_(0), changed_(false), changeTime_(0), writeIndex_(WRITE_INDEX_IDLE), writeCRC_(0xFF)
+{
+  memset(&data_, 0, sizeof(data_));
+  data_.logDecimation = CONFIGSTORE_NONE;
+}
+
+// Load the newest record. Call this before anything asks for a setting.
+void ConfigStore::begin()
+{
+  uint8_t newest = SLOT_NONE;
+
+  for (uint8_t slot = 0; slot < SLOT_COUNT; slot++)
+  {
+    uint16_t address = getSlotAddress(slot);
+
+    if (EEPROM.read(address) != VERSION)
+    {
+      continue;
+    }
+
+    uint8_t crc = 0xFF;
+
+    for (uint8_t i = 1; i < OFFSET_CRC; i++)
+    {
+      uint8_t value = EEPROM.read(address + i);
+      crc = SHT3x::calcCRC(&value, 1, crc);
+    }
+
+    if (crc != EEPROM.read(address + OFFSET_CRC))
+    {
+      continue;
+    }
+
+    // The sequence number wraps around, but the records are never more than SLOT_COUNT apart.
+    uint8_t sequence = EEPROM.read(address + 1);
+
+    if (newest == SLOT_NONE || (int8_t) (sequence - sequence_) > 0)
+    {
+      newest = slot;
+      sequence_ = sequence;
+    }
+  }
+
+  writeIndex_ = WRITE_INDEX_IDLE;
+
+  if (newest != SLOT_NONE)
+  {
+    slot_ = newest;
+    EEPROM.get(getSlotAddress(slot_) + OFFSET_DATA, data_);
+    changed_ = false;
+  }
+  else
+  { // No record yet. Have the old calibration written as the first one straight away, to the last slot so that the
+    // calibration stays where it was until the record is done. service() moves on to the next slot before writing.
+    importOldCalibration();
+    slot_ = SLOT_COUNT - 2;  // The one before the last
+    sequence_ = 0;
+    changed_ = true;
+    changeTime_ = millis() - COMMIT_DELAY;
+  }
+}
+
+const ConfigStore_CalTable *ConfigStore::getCalibration(uint8_t sensor)
+{
+  return &data_.calibration[sensor];
+}
+
+void ConfigStore::setCalibration(uint8_t sensor, const ConfigStore_CalTable &table)
+{
+  change(&data_.calibration[sensor], &table, sizeof(table));
+}
+
+bool ConfigStore::getPIDGains(uint8_t chamber, float *kp, float *ki, float *kd)
+{
+  const ConfigStore_PIDGains *gains = &data_.pidGains[chamber];
+
+  if (!gains->saved)
+  {
+    return false;
+  }
+
+  *kp = gains->kp;
+  *ki = gains->ki;
+  *kd = gains->kd;
+  return true;
+}
+
+void ConfigStore::setPIDGains(uint8_t chamber, float kp, float ki, float kd)
+{
+  ConfigStore_PIDGains gains = { true, kp, ki, kd };
+  change(&data_.pidGains[chamber], &gains, sizeof(gains));
+}
+
+bool ConfigStore::getRunState(uint8_t chamber, ChamberRunState *state)
+{
+  *state = data_.runState[chamber];
+  return state->saved;
+}
+
+void ConfigStore::setRunState(uint8_t chamber, const ChamberRunState &state)
+{
+  ChamberRunState savedState = state;
+  savedState.saved = true;
+  change(&data_.runState[chamber], &savedState, sizeof(savedState));
+}
+
+uint32_t ConfigStore::getBaudRate()
+{
+  return data_.baudRate;
+}
+
+void ConfigStore::setBaudRate(uint32_t baudRate)
+{
+  change(&data_.baudRate, &baudRate, sizeof(baudRate));
+}
+
+uint16_t ConfigStore::getSendPeriod()
+{
+  return data_.sendPeriod;
+}
+
+void ConfigStore::setSendPeriod(uint16_t periodMs)
+{
+  change(&data_.sendPeriod, &periodMs, sizeof(periodMs));
+}
+
+uint16_t ConfigStore::getLogDecimation()
+{
+  return data_.logDecimation;
+}
+
+void ConfigStore::setLogDecimation(uint16_t decimation)
+{
+  change(&data_.logDecimation, &decimation, sizeof(decimation));
+}
+
+const SetpointProgram_Table *ConfigStore::getProgram()
+{
+  return &data_.program;
+}
+
+void ConfigStore::setProgram(const SetpointProgram_Table &program)
+{
+  change(&data_.program, &program, sizeof(program));
+}
+
+uint8_t ConfigStore::getUnitAddress()
+{
+  return data_.unitAddress;
+}
+
+void ConfigStore::setUnitAddress(uint8_t address)
+{
+  change(&data_.unitAddress, &address, sizeof(address));
+}
+
+bool ConfigStore::service()
+{
+  if (!eeprom_is_ready())
+  {
+    return !isIdle();
+  }
+
+  if (writeIndex_ == WRITE_INDEX_IDLE)
+  {
+    if (!changed_ || millis() - changeTime_ < COMMIT_DELAY)
+    {
+      return changed_;
+    }
+
+    // Start a record in the next slot. Until it is done, the one before stays the newest.
+    slot_ = (slot_ + 1) % SLOT_COUNT;
+    sequence_++;
+    changed_ = false;
+    EEPROM.update(getSlotAddress(slot_), 0xFF);
+    writeIndex_ = 1;
+    writeCRC_ = 0xFF;
+    return true;
+  }
+
+  uint16_t address = getSlotAddress(slot_);
+
+  if (writeIndex_ < OFFSET_CRC)
+  {
+    uint8_t value = writeIndex_ < OFFSET_DATA ? sequence_ : ((const uint8_t *) &data_)[writeIndex_ - OFFSET_DATA];
+    writeCRC_ = SHT3x::calcCRC(&value, 1, writeCRC_);
+    EEPROM.update(address + writeIndex_, value);
+    writeIndex_++;
+  }
+  else if (writeIndex_ == OFFSET_CRC)
+  {
+    EEPROM.update(address + OFFSET_CRC, writeCRC_);
+    writeIndex_++;
+  }
+  else
+  { // Record done
+    EEPROM.update(address, VERSION);
+    writeIndex_ = WRITE_INDEX_IDLE;
+  }
+
+  return !isIdle();
+}
+
+bool ConfigStore::isIdle()
+{
+  return !changed_ && writeIndex_ == WRITE_INDEX_IDLE;
+}
+
+// Copy a setting into data_, if it is different.
+void ConfigStore::change(void *field, const void *value, uint8_t length)
+{
+  if (memcmp(field, value, length) == 0)
+  {
+    return;
+  }
+
+  memcpy(field, value, length);
+  changed_ = true;
+  changeTime_ = millis();
+
+  if (writeIndex_ != WRITE_INDEX_IDLE)
+  { // The slot being written no longer matches data_. Step back to the newest record, so that the write starts over
+    // in this same slot; the one after it may be the newest record, which has to stay until another one is done.
+    writeIndex_ = WRITE_INDEX_IDLE;
+    slot_ = (slot_ + SLOT_COUNT - 1) % SLOT_COUNT;
+    sequence_--;
+  }
+}
+
+uint16_t ConfigStore::getSlotAddress(uint8_t slot)
+{
+  return ADDR_START + (uint16_t) slot * SLOT_LENGTH;
+}
+
+// Take the two-point RH calibration from where the SHT3x kept it before ConfigStore, as the calibration table of the sensor
+// with the ADDR pin low (the only one then). A point that fails its CRC is left at its default if the other one is good,
+// which gives the same correction as before; the rest of the settings start unsaved.
+void ConfigStore::importOldCalibration()
+{
+  memset(&data_, 0, sizeof(data_));
+  data_.logDecimation = CONFIGSTORE_NONE;
+
+  float RHRef[2], RHRaw[2];
+  bool saved[2];
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    uint8_t address = OLD_ADDR_CALIBRATION + i * OLD_LENGTH_CAL_POINT;
+    EEPROM.get(address + 2, RHRef[i]);
+    EEPROM.get(address + 6, RHRaw[i]);
+
+    uint8_t crc = SHT3x::calcCRC((const uint8_t *) &RHRef[i], sizeof(float));
+    saved[i] = EEPROM.read(address) == SHT3x::calcCRC((const uint8_t *) &RHRaw[i], sizeof(float), crc);
+  }
+
+  if (!saved[0] && !saved[1])
+  {
+    return;
+  }
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    if (saved[i])
+    {
+      SHT3x::addCalibrationPoint(&data_.calibration[0], RHRef[i], RHRaw[i]);
+    }
+    else
+    {
+      SHT3x::addCalibrationPoint(&data_.calibration[0], OLD_CAL_POINT_DEFAULT[i], OLD_CAL_POINT_DEFAULT[i]);
+    }
+  }
+}
+
+ConfigStore Config = ConfigStore();
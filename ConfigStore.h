@@ -0,0 +1,168 @@
+/*********************************************************************************
+Settings kept in EEPROM: RH calibration tables, PID gains, run state of the chambers,
+baud rate, send period, log decimation, the setpoint program and the unit
+address on a multi-drop bus.
+
+All the settings are one record (ConfigStore_Data). begin() reads the newest
+record into RAM with one block read, and the get/set functions only work on
+the RAM copy. A change is written back by service() in the background, one
+byte at a time, once there were no more changes for COMMIT_DELAY; so a burst
+of changes is one write, and no EEPROM write holds up the control.
+
+The first half of the EEPROM (the second is the telemetry log) has SLOT_COUNT
+slots, and each write goes to the next one, which spreads the wear. A slot holds:
+  0      Version (VERSION; anything else is an empty slot)
+  1      Sequence number, one more than that of the previous record
+  2-     ConfigStore_Data
+  last   CRC of the sequence number and the data (SHT3x::calcCRC)
+The version byte is cleared first and written last, so a write cut short by a
+reset leaves an empty slot and the previous record is used.
+
+If there is no record, the RH calibration is taken from where the SHT3x kept it
+before ConfigStore (the other settings start unsaved), and written as the first record.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _CONFIGSTORE_h
+#define _CONFIGSTORE_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#include <EEPROM.h>
+#include "SetpointProgram.h"
+
+static const uint8_t CONFIGSTORE_CAL_POINT_MAX   = 8;
+static const uint8_t CONFIGSTORE_CAL_SLOPE_SHIFT = 12;  // The slopes are gains in Q3.12
+
+// The record is laid out without padding, as on the AVR, so that it fits the slot on the host build too (see host/HostSim.h).
+#ifndef __AVR__
+#pragma pack(push, 1)
+#endif // __AVR__
+
+// Piecewise-linear RH calibration of one SHT3x (see SHT3x::calibrateSignal()). All in units of the RH signal
+// (RH (%) = 100 * signal / 65535), so that the correction is integer only. The points are in order of raw signal, and
+// slope[i] is the gain of the segment from point i to i + 1, worked out when a point is saved; the end segments carry on
+// past the end points. With one point, the correction is an offset; with none, the RH is left as it is.
+struct ConfigStore_CalTable
+{
+  uint8_t pointCount;
+  uint16_t raw[CONFIGSTORE_CAL_POINT_MAX];    // Raw signal
+  uint16_t ref[CONFIGSTORE_CAL_POINT_MAX];    // Reference RH, as a signal
+  int16_t slope[CONFIGSTORE_CAL_POINT_MAX - 1];
+};
+
+// Autotuned gains of the humidity PID of one chamber
+struct ConfigStore_PIDGains
+{
+  bool saved;
+  float kp, ki, kd;
+};
+
+// What is kept of each chamber for a warm boot (see WARM_BOOT in HumidOSH.h)
+struct ChamberRunState
+{
+  bool saved;
+  uint8_t flags;                // HumidOSH::RUNSTATE_*
+  float humidityTarget;         // %RH
+  uint16_t fanSpeedTarget;      // RPM
+  float humidityOutputSum;      // Integral term of the humidity PID
+  float humidityControlOutput;
+};
+
+static const uint8_t CONFIGSTORE_SENSOR_COUNT  = 2; // SHT3x addresses
+static const uint8_t CONFIGSTORE_CHAMBER_COUNT = 2; // Most chambers (see HUMIDOSH_CHANNEL_COUNT)
+
+struct ConfigStore_Data
+{
+  ConfigStore_PIDGains pidGains[CONFIGSTORE_CHAMBER_COUNT];
+  ChamberRunState runState[CONFIGSTORE_CHAMBER_COUNT];
+  uint32_t baudRate;        // 0 if none was negotiated
+  uint16_t sendPeriod;      // ms; 0 if none was set
+  uint16_t logDecimation;   // s; CONFIGSTORE_NONE if none was set
+  SetpointProgram_Table program;
+  uint8_t unitAddress;      // 0 for point-to-point (see SerialCommunication::setUnitAddress())
+  ConfigStore_CalTable calibration[CONFIGSTORE_SENSOR_COUNT];  // Index 0 is the sensor with the ADDR pin low
+};
+
+#ifndef __AVR__
+#pragma pack(pop)
+#endif // __AVR__
+
+class ConfigStore
+{
+public:
+  static const uint16_t CONFIGSTORE_NONE = 0xFFFF;
+
+  ConfigStore();
+  void begin();
+
+  const ConfigStore_CalTable *getCalibration(uint8_t sensor);  // Stays valid, and follows setCalibration()
+  void setCalibration(uint8_t sensor, const ConfigStore_CalTable &table);
+
+  // Returns false (and leaves the outputs alone) if nothing was saved.
+  bool getPIDGains(uint8_t chamber, float *kp, float *ki, float *kd);
+  void setPIDGains(uint8_t chamber, float kp, float ki, float kd);
+  bool getRunState(uint8_t chamber, ChamberRunState *state);
+  void setRunState(uint8_t chamber, const ChamberRunState &state);
+
+  uint32_t getBaudRate();
+  void setBaudRate(uint32_t baudRate);
+  uint16_t getSendPeriod();
+  void setSendPeriod(uint16_t periodMs);
+  uint16_t getLogDecimation();
+  void setLogDecimation(uint16_t decimation);
+  const SetpointProgram_Table *getProgram();
+  void setProgram(const SetpointProgram_Table &program);
+  uint8_t getUnitAddress();
+  void setUnitAddress(uint8_t address);
+
+  // Writes at most one byte to the EEPROM. Returns true while there is a change that isn't written yet. Call every few ms until then.
+  bool service();
+  bool isIdle();
+
+private:
+  static const uint8_t VERSION        = 1;
+  static const uint16_t ADDR_START    = 0;
+  static const uint16_t SLOT_LENGTH   = 256;  // Fits ConfigStore_Data and the 3 bytes around it
+  static const uint8_t SLOT_COUNT     = 2;    // Up to the telemetry log (TelemetryLog::LOG_ADDR_START)
+  static const uint8_t SLOT_NONE      = 0xFF;
+  static const uint8_t OFFSET_DATA    = 2;
+  static const uint16_t OFFSET_CRC    = OFFSET_DATA + sizeof(ConfigStore_Data);  // Not a uint8_t, which would wrap past the check below
+  static const uint8_t WRITE_INDEX_IDLE = 0xFF;
+  static const uint16_t COMMIT_DELAY  = 2000; // Time (ms) without changes before they are written
+  static_assert(OFFSET_CRC < SLOT_LENGTH && OFFSET_CRC < WRITE_INDEX_IDLE, "ConfigStore_Data doesn't fit a slot");
+
+  ConfigStore_Data data_;
+  uint8_t slot_;            // Slot of the newest record, or of the one being written
+  uint8_t sequence_;        // Sequence number of the newest record
+  bool changed_;            // data_ differs from the newest record
+  unsigned long changeTime_;
+  uint8_t writeIndex_;      // Next byte of the slot to write; WRITE_INDEX_IDLE when not writing
+  uint8_t writeCRC_;
+
+  void change(void *field, const void *value, uint8_t length);
+  uint16_t getSlotAddress(uint8_t slot);
+  void importOldCalibration();
+};
+
+extern ConfigStore Config;
+
+#endif
@@ -22,6 +22,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "EMC2301.h"
 
+// Needs a definition since its address is the buffer of the background tacho read
+const uint8_t EMC2301::EMC2301_REG_TACHREADMSB;
+
 EMC2301::EMC2301(I2C * i2cWire) : i2cWire_(i2cWire)
 {
   // Base config for a fan with 2 poles and 500 min RPM.
@@ -30,7 +33,12 @@ EMC2301::EMC2301(I2C * i2cWire) : i2cWire_(i2cWire)
   fanEdgesCount_          = 5;
   fanPoleCount_           = 2;
   fanSpeed_               = 0;
+  tachoCount_             = 0;
+  fanStatus_              = 0;
   targetTachCount_        = TACHO_OFF;
+  shadowValid_            = false;
+  configDeferred_         = false;
+  shadowDirty_            = 0;
   recalculateTachoRPMConstant();
 }
 
@@ -38,6 +46,53 @@ EMC2301::~EMC2301()
 {
 }
 
+// Start a batch of config changes. Until applyConfig() is called, the set/toggle functions for the registers
+// EMC2301_REG_FANCONFIG1 to EMC2301_REG_FANVALTACHCOUNT only change the shadow copy, and applyConfig() then writes
+// all the changed registers in as few transactions as possible.
+EMC2301_STATUS EMC2301::beginConfig()
+{
+  // Start from what the device actually has, in case an earlier batch failed halfway.
+  if (readShadow() != EMC2301_STATUS_OK)
+  {
+    return EMC2301_STATUS_FAIL;
+  }
+
+  configDeferred_ = true;
+  return EMC2301_STATUS_OK;
+}
+
+// Write the registers changed since beginConfig(). Each run of adjacent changed registers is one block write.
+EMC2301_STATUS EMC2301::applyConfig()
+{
+  uint8_t i = 0;
+  configDeferred_ = false;
+
+  while (i < SHADOW_LENGTH)
+  {
+    if (!(shadowDirty_ & (1 << i)))
+    {
+      i++;
+      continue;
+    }
+
+    uint8_t runStart = i;
+    while (i < SHADOW_LENGTH && (shadowDirty_ & (1 << i)))
+    {
+      i++;
+    }
+
+    if (i2cWire_->write(I2C_ADDRESS, (uint8_t) (EMC2301_REG_FANCONFIG1 + runStart), &shadow_[runStart], i - runStart) != I2C_STATUS_OK)
+    { // Don't know what the device has now; it will be read again.
+      shadowValid_ = false;
+      shadowDirty_ = 0;
+      return EMC2301_STATUS_FAIL;
+    }
+  }
+
+  shadowDirty_ = 0;
+  return EMC2301_STATUS_OK;
+}
+
 // Set the base frequency of the PWM output, which could be divided further by setPWMFrequencyDivider().
 // The function is written such that any frequency below the next higher base frequency
 // will automatically be converted to the previous frequency.
@@ -90,11 +145,11 @@ EMC2301_STATUS EMC2301::toggleControlAlgorithm(bool enable)
 {
   if (enable)
   {
-    return writeRegisterBits(EMC2301_REG_FANCONFIG1, ~EMC2301_REG_FANCONFIG1_RPMCONTROL, EMC2301_REG_FANCONFIG1_RPMCONTROL);
+    return writeRegisterBits(EMC2301_REG_FANCONFIG1, (uint8_t) ~EMC2301_REG_FANCONFIG1_RPMCONTROL, EMC2301_REG_FANCONFIG1_RPMCONTROL);
   }
   else
   {
-    return writeRegisterBits(EMC2301_REG_FANCONFIG1, ~EMC2301_REG_FANCONFIG1_RPMCONTROL, 0);
+    return writeRegisterBits(EMC2301_REG_FANCONFIG1, (uint8_t) ~EMC2301_REG_FANCONFIG1_RPMCONTROL, 0);
   }
 }
 
@@ -385,14 +440,7 @@ EMC2301_STATUS EMC2301::setControlMaxStep(uint8_t stepSize)
     stepSize = EMC2301_REG_FANMAXSTEP_MAX;
   }
 
-  if (i2cWire_->write(I2C_ADDRESS, EMC2301_REG_FANMAXSTEP, stepSize) == I2C_STATUS_OK)
-  {
-    return EMC2301_STATUS_OK;
-  }
-  else
-  {
-    return EMC2301_STATUS_FAIL;
-  }
+  return writeShadowRegister(EMC2301_REG_FANMAXSTEP, stepSize);
 }
 
 // Sets the minimum allowable drive for the RPM-based Fan Speed Control algorithm.
@@ -406,14 +454,7 @@ EMC2301_STATUS EMC2301::setControlMaxStep(uint8_t stepSize)
 // Having a minimum drive prevents this from happening.
 EMC2301_STATUS EMC2301::setFanMinDrive(uint8_t minDriveByte)
 {
-  if (i2cWire_->write(I2C_ADDRESS, EMC2301_REG_FANMINDRIVE, minDriveByte) == I2C_STATUS_OK)
-  {
-    return EMC2301_STATUS_OK;
-  }
-  else
-  {
-    return EMC2301_STATUS_FAIL;
-  }
+  return writeShadowRegister(EMC2301_REG_FANMINDRIVE, minDriveByte);
 }
 
 // Sets the minimum RPM which is checked at the end of the spin up routine to decide if the fan is actually
@@ -454,14 +495,7 @@ EMC2301_STATUS EMC2301::setFanSpeedSpinupMin(uint16_t minRPM)
   // See pg 35 of datasheet, the register values are multiplied by 32. So divide by 32 before storing them.
   uint8_t maxTachCount_ = tachoRPMConstant_ / minRPM / 32;
 
-  if (i2cWire_->write(I2C_ADDRESS, EMC2301_REG_FANVALTACHCOUNT, maxTachCount_) == I2C_STATUS_OK)
-  {
-    return EMC2301_STATUS_OK;
-  }
-  else
-  {
-    return EMC2301_STATUS_FAIL;
-  }
+  return writeShadowRegister(EMC2301_REG_FANVALTACHCOUNT, maxTachCount_);
 }
 
 // Based on the given target RPM, calculate the appropriate target tachometer reading and
@@ -506,24 +540,55 @@ EMC2301_STATUS EMC2301::toggleFan(bool enable)
 */
 EMC2301_STATUS EMC2301::fetchFanSpeed()
 {
-  if (i2cWire_->read(I2C_ADDRESS, EMC2301_REG_TACHREADMSB, (uint8_t) 1) == I2C_STATUS_OK)
+  INSTRUMENT_SCOPE(INSTR_SECTION_EMC2301_FETCH);
+
+  // One block read of the MSB and then the LSB.
+  if (i2cWire_->read(I2C_ADDRESS, EMC2301_REG_TACHREADMSB, (uint8_t) 2, tachBuffer_) == I2C_STATUS_OK)
   {
-    uint16_t tachoCount = ((uint16_t) i2cWire_->getByte()) << 8;
+    calcFanSpeed((((uint16_t) tachBuffer_[0]) << 8) | tachBuffer_[1]);
+    return EMC2301_STATUS_OK;
+  }
+  else
+  {
+    return EMC2301_STATUS_FAIL;
+  }
+}
 
-    if (i2cWire_->read(I2C_ADDRESS, EMC2301_REG_TACHREADLSB, (uint8_t)1) == I2C_STATUS_OK)
-    {
-      tachoCount |= i2cWire_->getByte();
-      tachoCount = tachoCount >> 3;
+// Same as fetchFanSpeed(), but the read is queued on the I2C bus and done in the background, so this returns right away.
+// Call checkFanSpeed() to find out how it went.
+EMC2301_STATUS EMC2301::requestFanSpeed()
+{
+  tachTransaction_.address   = I2C_ADDRESS;
+  tachTransaction_.txBuffer  = &EMC2301_REG_TACHREADMSB;
+  tachTransaction_.txLength  = 1;
+  tachTransaction_.rxBuffer  = tachBuffer_;
+  tachTransaction_.rxLength  = 2;
+  tachTransaction_.callback  = NULL;
+  tachTransaction_.context   = NULL;
 
-      // To avoid doubles, the fan pole multiplier was multiplied by 2 to make it an integer.
-      // Here, we divide it (and the -1 in the bracket) by 2 to bring it back to its proper value.
-      fanSpeed_ = tachoRPMConstant_ / tachoCount;
-      return EMC2301_STATUS_OK;
-    }
-    else
-    {
-      return EMC2301_STATUS_FAIL;
-    }
+  if (i2cWire_->submit(&tachTransaction_) == I2C_STATUS_PENDING)
+  {
+    return EMC2301_STATUS_PENDING;
+  }
+  else
+  { // Could not queue the read.
+    return EMC2301_STATUS_FAIL;
+  }
+}
+
+// Returns EMC2301_STATUS_PENDING while the read queued by requestFanSpeed() is still in progress.
+// Once it is done, the fan speed is updated and this returns the same statuses as fetchFanSpeed().
+EMC2301_STATUS EMC2301::checkFanSpeed()
+{
+  if (!tachTransaction_.complete)
+  {
+    return EMC2301_STATUS_PENDING;
+  }
+
+  if (tachTransaction_.status == I2C_STATUS_OK)
+  {
+    calcFanSpeed((((uint16_t) tachBuffer_[0]) << 8) | tachBuffer_[1]);
+    return EMC2301_STATUS_OK;
   }
   else
   {
@@ -536,55 +601,130 @@ uint16_t EMC2301::getFanSpeed()
   return fanSpeed_;
 }
 
+// Tacho count of the last fan speed reading.
+uint16_t EMC2301::getTachoCount()
+{
+  return tachoCount_;
+}
+
+// Let a fan fault (see FAN_STATUS_*) pull the ALERT pin low, until the fault is gone and fetchFanStatus() reads it.
+EMC2301_STATUS EMC2301::toggleAlert(bool enable)
+{
+  if (i2cWire_->write(I2C_ADDRESS, EMC2301_REG_FANINTERRUPT, enable ? EMC2301_REG_FANINTERRUPT_ENABLE : (uint8_t) 0) == I2C_STATUS_OK)
+  {
+    return EMC2301_STATUS_OK;
+  }
+  else
+  {
+    return EMC2301_STATUS_FAIL;
+  }
+}
+
+// Read the fault bits of the fan, and store them. Get them by calling getFanStatus().
+EMC2301_STATUS EMC2301::fetchFanStatus()
+{
+  uint8_t status;
+
+  if (i2cWire_->read(I2C_ADDRESS, EMC2301_REG_FANSTATUS, (uint8_t) 1, &status) == I2C_STATUS_OK)
+  {
+    fanStatus_ = status;
+    return EMC2301_STATUS_OK;
+  }
+  else
+  {
+    return EMC2301_STATUS_FAIL;
+  }
+}
+
+uint8_t EMC2301::getFanStatus()
+{
+  return fanStatus_;
+}
+
+// Converts the raw 2-byte tacho reading into fan speed (RPM)
+void EMC2301::calcFanSpeed(uint16_t tachoCount)
+{
+  tachoCount = tachoCount >> 3;
+  tachoCount_ = tachoCount;
+
+  // To avoid doubles, the fan pole multiplier was multiplied by 2 to make it an integer.
+  // Here, we divide it (and the -1 in the bracket) by 2 to bring it back to its proper value.
+  fanSpeed_ = tachoRPMConstant_ / tachoCount;
+}
+
 // Recalculates and store the proportionality constant relating tacho counts to fan speed (RPM)
 void EMC2301::recalculateTachoRPMConstant()
 {
   tachoRPMConstant_ = (fanEdgesCount_ - 1) * TACHO_FREQUENCY * 60 * tachMinRPMMultiplier_ / fanPoleCount_;
 }
 
-// Writes specific bits in the given register, such that the other bits in the register
-// are unaffected. This is done by reading the register first, masking the appropriate
-// bits, and then writing this modified byte into the register.
-EMC2301_STATUS EMC2301::writeRegisterBits(uint8_t registerAddress, uint8_t clearingMask, uint8_t byteToWrite)
+// Read the registers kept in shadow_ in one block read.
+EMC2301_STATUS EMC2301::readShadow()
 {
-  if (i2cWire_->read(I2C_ADDRESS, registerAddress, (uint8_t) 1) == I2C_STATUS_OK)
+  if (i2cWire_->read(I2C_ADDRESS, EMC2301_REG_FANCONFIG1, SHADOW_LENGTH, shadow_) == I2C_STATUS_OK)
   {
-    uint8_t registerContents = i2cWire_->getByte();
-    registerContents &= clearingMask; // Reset the bits at the location of interest
-    registerContents |= byteToWrite;  // Write bits to the location of interest
+    shadowValid_ = true;
+    shadowDirty_ = 0;
+    return EMC2301_STATUS_OK;
+  }
+  else
+  {
+    shadowValid_ = false;
+    return EMC2301_STATUS_FAIL;
+  }
+}
 
-    if (i2cWire_->write(I2C_ADDRESS, registerAddress, registerContents) == I2C_STATUS_OK)
-    {
-      return EMC2301_STATUS_OK;
-    }
-    else
-    {
-      return EMC2301_STATUS_FAIL;
-    }
+// Write a register kept in shadow_, or only note the change if a batch was started with beginConfig().
+EMC2301_STATUS EMC2301::writeShadowRegister(uint8_t registerAddress, uint8_t value)
+{
+  uint8_t index = registerAddress - EMC2301_REG_FANCONFIG1;
+  shadow_[index] = value;
+
+  if (configDeferred_)
+  {
+    shadowDirty_ |= 1 << index;
+    return EMC2301_STATUS_OK;
+  }
+
+  if (i2cWire_->write(I2C_ADDRESS, registerAddress, value) == I2C_STATUS_OK)
+  {
+    return EMC2301_STATUS_OK;
   }
   else
+  { // Don't know what the device has now; it will be read again.
+    shadowValid_ = false;
+    return EMC2301_STATUS_FAIL;
+  }
+}
+
+// Writes specific bits in the given register, such that the other bits in the register
+// are unaffected. The other bits come from the shadow copy, so only the write goes on the bus
+// (plus one block read the first time, or after a failed write).
+EMC2301_STATUS EMC2301::writeRegisterBits(uint8_t registerAddress, uint8_t clearingMask, uint8_t byteToWrite)
+{
+  if (!shadowValid_ && readShadow() != EMC2301_STATUS_OK)
   {
     return EMC2301_STATUS_FAIL;
   }
+
+  uint8_t registerContents = shadow_[registerAddress - EMC2301_REG_FANCONFIG1];
+  registerContents &= clearingMask; // Reset the bits at the location of interest
+  registerContents |= byteToWrite;  // Write bits to the location of interest
+
+  return writeShadowRegister(registerAddress, registerContents);
 }
 
 EMC2301_STATUS EMC2301::writeTachoTarget(uint16_t tachoTarget)
 {
-  uint8_t tachCountLSB = (tachoTarget << 3) & 0xF8;
-  uint8_t tachCountMSB = (tachoTarget >> 5) & 0xFF;
+  uint8_t tachCount[2];
+  tachCount[0] = (tachoTarget << 3) & 0xF8; // LSB
+  tachCount[1] = (tachoTarget >> 5) & 0xFF; // MSB
 
-  // The low byte must be written before the high byte, because
-  // the target is officially changed once the high byte is written (pg 36 of datasheet).
-  if (i2cWire_->write(I2C_ADDRESS, EMC2301_REG_TACHTARGETLSB, tachCountLSB) == I2C_STATUS_OK)
+  // The low byte must be written before the high byte, because the target is officially changed
+  // once the high byte is written (pg 36 of datasheet). The block write goes LSB then MSB.
+  if (i2cWire_->write(I2C_ADDRESS, EMC2301_REG_TACHTARGETLSB, tachCount, 2) == I2C_STATUS_OK)
   {
-    if (i2cWire_->write(I2C_ADDRESS, EMC2301_REG_TACHTARGETMSB, tachCountMSB) == I2C_STATUS_OK)
-    {
-      return EMC2301_STATUS_OK;
-    }
-    else
-    {
-      return EMC2301_STATUS_FAIL;
-    }
+    return EMC2301_STATUS_OK;
   }
   else
   {
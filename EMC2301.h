@@ -37,7 +37,8 @@ typedef enum
 {
   EMC2301_STATUS_OK         = 0,  // No problemo.
   EMC2301_STATUS_FAIL       = 1,  // Something went wrong.
-  EMC2301_STATUS_INVALIDARG = 2   // The argument given to a function is invalid.
+  EMC2301_STATUS_INVALIDARG = 2,  // The argument given to a function is invalid.
+  EMC2301_STATUS_PENDING    = 3   // The background read requested by requestFanSpeed() is still in progress.
 } EMC2301_STATUS;
 
 
@@ -45,9 +46,20 @@ typedef enum
 class EMC2301
 {
 public:
+  // Pg 12 of datasheet : The SMBus / I2C address is set at 0101_111(r / w)b(aka 47 or 0x2F)
+  static const uint8_t I2C_ADDRESS = 0x2F;
+
+  // Bits of getFanStatus(), from the Fan Status register. They are latched, and cleared by reading them if the fault is gone.
+  static const uint8_t FAN_STATUS_STALL     = 0x01; // Tach count past the limit set by setFanSpeedMin(), i.e. the fan stopped
+  static const uint8_t FAN_STATUS_SPINUP    = 0x02; // The fan did not reach the spin-up speed within the spin-up time
+  static const uint8_t FAN_STATUS_DRIVEFAIL = 0x04; // Full drive, and still below the target speed
+  static const uint8_t FAN_STATUS_WATCHDOG  = 0x80; // Nothing was written for 4 s after power-up, so the fan went to full drive
+
   EMC2301(I2C * i2cWire);
   ~EMC2301();
 
+  EMC2301_STATUS beginConfig();
+  EMC2301_STATUS applyConfig();
   EMC2301_STATUS setPWMFrequencyBase(double frequencyKHz);
   EMC2301_STATUS setPWMFrequencyDivider(uint8_t divisor);
   EMC2301_STATUS toggleControlAlgorithm(bool enable);
@@ -67,34 +79,39 @@ public:
   EMC2301_STATUS setFanSpeedTarget(uint16_t targetRPM);
   EMC2301_STATUS toggleFan(bool enable);
   EMC2301_STATUS fetchFanSpeed();
+  EMC2301_STATUS requestFanSpeed();
+  EMC2301_STATUS checkFanSpeed();
   uint16_t getFanSpeed();
+  uint16_t getTachoCount();
+  EMC2301_STATUS toggleAlert(bool enable);
+  EMC2301_STATUS fetchFanStatus();
+  uint8_t getFanStatus();
 
 private:
-  // Pg 12 of datasheet : The SMBus / I2C address is set at 0101_111(r / w)b(aka 47 or 0x2F)
-  const uint8_t I2C_ADDRESS = 0x2F;
-
   // Assume that we use internal clock for tachometer
-  const double TACHO_FREQUENCY = 32768;
+  static const unsigned long TACHO_FREQUENCY = 32768; // Integer so that recalculateTachoRPMConstant() doesn't need float math
 
   // 2-byte to be written to tacho target register to turn off fan
-  const uint16_t TACHO_OFF = 0x1FFF << 3; // 1111 1111 1111 1000
+  static const uint16_t TACHO_OFF = 0x1FFF << 3; // 1111 1111 1111 1000
 
   /******************************
    *     List of registers      *
    ******************************/
-  const uint8_t EMC2301_REG_PWMBASEFREQ          = 0x2D;
-  const uint8_t EMC2301_REG_FANSETTING           = 0x30;
-  const uint8_t EMC2301_REG_PWMDIVIDE            = 0x31;
-  const uint8_t EMC2301_REG_FANCONFIG1           = 0x32;
-  const uint8_t EMC2301_REG_FANCONFIG2           = 0x33;
-  const uint8_t EMC2301_REG_FANSPINUP            = 0x36;
-  const uint8_t EMC2301_REG_FANMAXSTEP           = 0x37;
-  const uint8_t EMC2301_REG_FANMINDRIVE          = 0x38;
-  const uint8_t EMC2301_REG_FANVALTACHCOUNT      = 0x39;
-  const uint8_t EMC2301_REG_TACHTARGETLSB        = 0x3C;
-  const uint8_t EMC2301_REG_TACHTARGETMSB        = 0x3D;
-  const uint8_t EMC2301_REG_TACHREADMSB          = 0x3E;
-  const uint8_t EMC2301_REG_TACHREADLSB          = 0x3F;
+  static const uint8_t EMC2301_REG_FANSTATUS            = 0x24;
+  static const uint8_t EMC2301_REG_FANINTERRUPT         = 0x29;
+  static const uint8_t EMC2301_REG_PWMBASEFREQ          = 0x2D;
+  static const uint8_t EMC2301_REG_FANSETTING           = 0x30;
+  static const uint8_t EMC2301_REG_PWMDIVIDE            = 0x31;
+  static const uint8_t EMC2301_REG_FANCONFIG1           = 0x32;
+  static const uint8_t EMC2301_REG_FANCONFIG2           = 0x33;
+  static const uint8_t EMC2301_REG_FANSPINUP            = 0x36;
+  static const uint8_t EMC2301_REG_FANMAXSTEP           = 0x37;
+  static const uint8_t EMC2301_REG_FANMINDRIVE          = 0x38;
+  static const uint8_t EMC2301_REG_FANVALTACHCOUNT      = 0x39;
+  static const uint8_t EMC2301_REG_TACHTARGETLSB        = 0x3C;
+  static const uint8_t EMC2301_REG_TACHTARGETMSB        = 0x3D;
+  static const uint8_t EMC2301_REG_TACHREADMSB          = 0x3E;
+  static const uint8_t EMC2301_REG_TACHREADLSB          = 0x3F;
 
   /* Registers that can have values written directly into them (i.e. the entire register is meant for a single number):
       EMC2301_REG_FANSETTING
@@ -103,69 +120,75 @@ private:
       EMC2301_REG_FANMINDRIVE
       EMC2301_REG_FANVALTACHCOUNT (The final value from this register is 32 x (value in register))
       EMC2301_REG_TACHTARGETLSB and EMC2301_REG_TACHTARGETMSB (MUST write both LSB and MSB, with LSB written before MSB)
+
+     The register address auto-increments during block reads/writes, so adjacent registers are sent in one transaction:
+     the tach target (LSB then MSB) and the tach reading (MSB then LSB) are each a single 2-byte transfer.
   */
 
+  // EMC2301_REG_FANINTERRUPT
+  static const uint8_t EMC2301_REG_FANINTERRUPT_ENABLE = 0x01;
+
   // EMC2301_REG_PWMBASEFREQ
-  const uint8_t EMC2301_REG_PWMBASEFREQ_26KHZ  = 0x00;
-  const uint8_t EMC2301_REG_PWMBASEFREQ_19KHZ  = 0x01;
-  const uint8_t EMC2301_REG_PWMBASEFREQ_4KHZ   = 0x02;
-  const uint8_t EMC2301_REG_PWMBASEFREQ_2KHZ   = 0x03;
+  static const uint8_t EMC2301_REG_PWMBASEFREQ_26KHZ  = 0x00;
+  static const uint8_t EMC2301_REG_PWMBASEFREQ_19KHZ  = 0x01;
+  static const uint8_t EMC2301_REG_PWMBASEFREQ_4KHZ   = 0x02;
+  static const uint8_t EMC2301_REG_PWMBASEFREQ_2KHZ   = 0x03;
 
   // EMC2301_REG_FANCONFIG1
-  const uint8_t EMC2301_REG_FANCONFIG1_RPMCONTROL    = 0x80;
-  const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_CLEAR    = ~0x60;
-  const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_500    = 0x00;
-  const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_1000   = 0x20;
-  const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_2000   = 0x40;
-  const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_4000   = 0x60;
-  const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_CLEAR  = ~0x18;
-  const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_1    = 0x00;
-  const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_2    = 0x08;
-  const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_3    = 0x10;
-  const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_4    = 0x18;
-  const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_CLEAR    = ~0x07;
-  const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_100    = 0x00;
-  const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_200    = 0x01;
-  const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_300    = 0x02;
-  const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_400    = 0x03;
-  const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_500    = 0x04;
-  const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_800    = 0x05;
-  const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_1200   = 0x06;
-  const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_1600   = 0x07;
+  static const uint8_t EMC2301_REG_FANCONFIG1_RPMCONTROL    = 0x80;
+  static const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_CLEAR    = ~0x60;
+  static const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_500    = 0x00;
+  static const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_1000   = 0x20;
+  static const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_2000   = 0x40;
+  static const uint8_t EMC2301_REG_FANCONFIG1_MINRPM_4000   = 0x60;
+  static const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_CLEAR  = ~0x18;
+  static const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_1    = 0x00;
+  static const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_2    = 0x08;
+  static const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_3    = 0x10;
+  static const uint8_t EMC2301_REG_FANCONFIG1_FANPOLES_4    = 0x18;
+  static const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_CLEAR    = ~0x07;
+  static const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_100    = 0x00;
+  static const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_200    = 0x01;
+  static const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_300    = 0x02;
+  static const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_400    = 0x03;
+  static const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_500    = 0x04;
+  static const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_800    = 0x05;
+  static const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_1200   = 0x06;
+  static const uint8_t EMC2301_REG_FANCONFIG1_UPDATE_1600   = 0x07;
 
   // EMC2301_REG_FANCONFIG2
-  const uint8_t EMC2301_REG_FANCONFIG2_RAMPCONTROL   = 0x40;
-  const uint8_t EMC2301_REG_FANCONFIG2_GLITCHFILTER  = 0x20;
-  const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_CLEAR    = ~0x18;
-  const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_NONE   = 0x00;
-  const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_BASIC  = 0x08;
-  const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_STEP   = 0x10;
-  const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_BOTH   = 0x18;
-  const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_CLEAR  = ~0x06;
-  const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_0    = 0x00;
-  const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_50   = 0x02;
-  const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_100  = 0x04;
-  const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_200  = 0x06;
+  static const uint8_t EMC2301_REG_FANCONFIG2_RAMPCONTROL   = 0x40;
+  static const uint8_t EMC2301_REG_FANCONFIG2_GLITCHFILTER  = 0x20;
+  static const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_CLEAR    = ~0x18;
+  static const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_NONE   = 0x00;
+  static const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_BASIC  = 0x08;
+  static const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_STEP   = 0x10;
+  static const uint8_t EMC2301_REG_FANCONFIG2_DEROPT_BOTH   = 0x18;
+  static const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_CLEAR  = ~0x06;
+  static const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_0    = 0x00;
+  static const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_50   = 0x02;
+  static const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_100  = 0x04;
+  static const uint8_t EMC2301_REG_FANCONFIG2_ERRRANGE_200  = 0x06;
 
   // EMC2301_REG_FANSPINUP
-  const uint8_t EMC2301_REG_FANSPINUP_NOKICK           = 0x20;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_CLEAR      = ~0x1C;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_30       = 0x00;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_35       = 0x04;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_40       = 0x08;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_45       = 0x0C;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_50       = 0x10;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_55       = 0x14;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_60       = 0x18;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_65       = 0x1C;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_CLEAR   = ~0x03;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_250   = 0x00;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_500   = 0x01;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_1000  = 0x02;
-  const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_2000  = 0x03;
+  static const uint8_t EMC2301_REG_FANSPINUP_NOKICK           = 0x20;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_CLEAR      = ~0x1C;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_30       = 0x00;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_35       = 0x04;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_40       = 0x08;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_45       = 0x0C;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_50       = 0x10;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_55       = 0x14;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_60       = 0x18;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINLVL_65       = 0x1C;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_CLEAR   = ~0x03;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_250   = 0x00;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_500   = 0x01;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_1000  = 0x02;
+  static const uint8_t EMC2301_REG_FANSPINUP_SPINUPTIME_2000  = 0x03;
 
   // EMC2301_REG_FANMAXSTEP
-  const uint8_t EMC2301_REG_FANMAXSTEP_MAX = 0b00111111;
+  static const uint8_t EMC2301_REG_FANMAXSTEP_MAX = 0b00111111;
 
   I2C *i2cWire_;
   uint8_t tachMinRPMMultiplier_;
@@ -174,8 +197,25 @@ private:
   unsigned long tachoRPMConstant_;
   uint16_t targetTachCount_;
   uint16_t fanSpeed_;
+  uint16_t tachoCount_;       // Tacho count behind fanSpeed_, already shifted into the 13-bit count
+  uint8_t fanStatus_;         // FAN_STATUS_* bits of the last fetchFanStatus()
+
+  // Used by requestFanSpeed() to read the tacho count (MSB, then LSB) in the background.
+  I2C_Transaction tachTransaction_;
+  uint8_t tachBuffer_[2];
+
+  // Write-through copy of the config registers EMC2301_REG_FANCONFIG1 to EMC2301_REG_FANVALTACHCOUNT (0x32 to 0x39),
+  // so that changing some bits of a register doesn't need a read first. It is read from the device the first time it's needed.
+  static const uint8_t SHADOW_LENGTH = 8;
+  uint8_t shadow_[SHADOW_LENGTH];
+  bool shadowValid_;        // shadow_ matches the device
+  bool configDeferred_;     // Between beginConfig() and applyConfig(): only shadow_ is changed
+  uint8_t shadowDirty_;     // Bit n set: shadow_[n] changed while deferred and not yet written
 
   void recalculateTachoRPMConstant();
+  void calcFanSpeed(uint16_t tachoCount);
+  EMC2301_STATUS readShadow();
+  EMC2301_STATUS writeShadowRegister(uint8_t registerAddress, uint8_t value);
   EMC2301_STATUS writeRegisterBits(uint8_t registerAddress, uint8_t clearingMask, uint8_t byteToWrite);
   EMC2301_STATUS writeTachoTarget(uint16_t tachoTarget);
 };
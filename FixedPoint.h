@@ -0,0 +1,124 @@
+/*********************************************************************************
+Fixed-point number type for the control and conversion math.
+
+The ATmega328 has no FPU, so every float/double operation is done in software.
+The signed fixed-point type here keeps the value as an integer scaled by
+2^FRAC_BITS; additions and comparisons become plain integer operations, while
+multiplications and divisions use a 64-bit intermediate.
+
+The code that uses it is written against real_t, which is either double or
+FixedPoint<16> (Q15.16, range of about +/-32767 with a resolution of
+1.5e-5) depending on USE_FIXED_POINT below. Values that are only used for
+displaying, the user input and the EEPROM data stay in float/double.
+
+Rounding error of the Q15.16 path, against the exact math (see
+host/FixedPointTest.cpp):
+- RH and temperature conversion: rounded down by at most 1.003 LSB (1.5e-5
+  %RH or degC). The float path is off by more than that, from its rounded
+  multipliers: up to 1.5e-4 %RH and 0.002 degC at the top of the range.
+- Calibration: done on the signal with the integer table of
+  ConfigStore_CalTable in both paths, so it adds nothing between them.
+  Compared to the exact straight lines through the points, the points are
+  rounded to 1 signal LSB (0.0015 %RH) and the slopes to 2^-12, so a reading
+  d LSB into a segment of slope s is off by at most 1.5 + s / 2 + d / 4096 LSB:
+  under 0.03 %RH across the full range for slopes up to 1.2.
+- PID: each Compute() rounds by a few LSB, mostly in the integral term, where
+  it adds up: after 3000 Compute() with the same inputs, the output is within
+  0.04 of the float path, about a twentieth of one duty cycle step. In the
+  loop, this is corrected like any other disturbance. Tuning parameters are
+  converted with a resolution of 1.5e-5; see PID_modified.cpp for how the
+  integral gain is scaled to keep it precise.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _FIXEDPOINT_h
+#define _FIXEDPOINT_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// Uncommenting USE_FIXED_POINT switches the sensor conversion, calibration and PID math from double to Q15.16 fixed-point.
+//#define USE_FIXED_POINT 1
+
+template <uint8_t FRAC_BITS>
+class FixedPoint
+{
+public:
+  static const int32_t ONE = (int32_t) 1 << FRAC_BITS;
+
+  // Conversions are implicit so that the code using real_t reads the same for double and fixed-point.
+  // Converting from a constant is done at compile time.
+  constexpr FixedPoint() : raw_(0) {}
+  constexpr FixedPoint(int value) : raw_((int32_t) value * ONE) {}
+  constexpr FixedPoint(unsigned int value) : raw_((int32_t) value * ONE) {}
+  constexpr FixedPoint(long value) : raw_((int32_t) value * ONE) {}
+  constexpr FixedPoint(unsigned long value) : raw_((int32_t) value * ONE) {}
+  constexpr FixedPoint(double value) : raw_((int32_t) (value * ONE + (value >= 0 ? 0.5 : -0.5))) {}
+
+  // Build from the scaled integer directly, e.g. from sensor signals that were converted with integer math.
+  static FixedPoint fromRaw(int32_t raw) { FixedPoint result; result.raw_ = raw; return result; }
+  int32_t getRaw() const { return raw_; }
+
+  double toDouble() const { return (double) raw_ / ONE; }
+
+  // Truncates towards zero like a cast from double does.
+  long toLong() const { return raw_ >= 0 ? (long) (raw_ >> FRAC_BITS) : -(long) ((-raw_) >> FRAC_BITS); }
+
+  FixedPoint operator-() const { return fromRaw(-raw_); }
+  FixedPoint & operator+=(const FixedPoint & other) { raw_ += other.raw_; return *this; }
+  FixedPoint & operator-=(const FixedPoint & other) { raw_ -= other.raw_; return *this; }
+  FixedPoint & operator*=(const FixedPoint & other) { raw_ = (int32_t) (((int64_t) raw_ * other.raw_) >> FRAC_BITS); return *this; }
+  FixedPoint & operator/=(const FixedPoint & other) { raw_ = (int32_t) (((int64_t) raw_ << FRAC_BITS) / other.raw_); return *this; }
+
+  friend FixedPoint operator+(FixedPoint a, const FixedPoint & b) { return a += b; }
+  friend FixedPoint operator-(FixedPoint a, const FixedPoint & b) { return a -= b; }
+  friend FixedPoint operator*(FixedPoint a, const FixedPoint & b) { return a *= b; }
+  friend FixedPoint operator/(FixedPoint a, const FixedPoint & b) { return a /= b; }
+  friend bool operator==(const FixedPoint & a, const FixedPoint & b) { return a.raw_ == b.raw_; }
+  friend bool operator!=(const FixedPoint & a, const FixedPoint & b) { return a.raw_ != b.raw_; }
+  friend bool operator< (const FixedPoint & a, const FixedPoint & b) { return a.raw_ <  b.raw_; }
+  friend bool operator> (const FixedPoint & a, const FixedPoint & b) { return a.raw_ >  b.raw_; }
+  friend bool operator<=(const FixedPoint & a, const FixedPoint & b) { return a.raw_ <= b.raw_; }
+  friend bool operator>=(const FixedPoint & a, const FixedPoint & b) { return a.raw_ >= b.raw_; }
+
+private:
+  int32_t raw_;
+};
+
+#ifdef USE_FIXED_POINT
+typedef FixedPoint<16> real_t;
+#else
+typedef double real_t;
+#endif // USE_FIXED_POINT
+
+// Build a real_t from the ratio of two integers without going through float/double.
+#ifdef USE_FIXED_POINT
+inline real_t realFromRatio(long numerator, long denominator) { return real_t::fromRaw((int32_t) (((int64_t) numerator << 16) / denominator)); }
+#else
+inline real_t realFromRatio(long numerator, long denominator) { return (double) numerator / denominator; }
+#endif // USE_FIXED_POINT
+
+// Going back to double/long (e.g. for printing or analogWrite()), regardless of what real_t is.
+inline double realToDouble(double value) { return value; }
+inline long realToLong(double value) { return (long) value; }
+template <uint8_t FRAC_BITS> inline double realToDouble(const FixedPoint<FRAC_BITS> & value) { return value.toDouble(); }
+template <uint8_t FRAC_BITS> inline long realToLong(const FixedPoint<FRAC_BITS> & value) { return value.toLong(); }
+
+#endif
@@ -45,283 +45,1450 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "HumidOSH.h"
 
+#ifdef __AVR__
+// Cause of the last reset (MCUSR), saved before anything else runs.
+static uint8_t resetFlags __attribute__((section(".noinit")));
+
+// Runs before the C++ startup code (.init3). Optiboot clears MCUSR and hands its value over in r2. The watchdog stays on
+// after it resets the chip, so it is turned off here before it can strike again during the startup.
+static void saveResetFlags() __attribute__((naked, used, section(".init3")));
+static void saveResetFlags()
+{
+  asm volatile ("mov %0, r2" : "=r" (resetFlags));  // No local variables in a naked function
+
+  if (MCUSR)
+  {
+    resetFlags = MCUSR;
+  }
+
+  MCUSR = 0;
+  wdt_disable();
+}
+#else
+static uint8_t resetFlags = 0;  // Host build (see host/HostSim.h): always a power-on
+#endif // __AVR__
+
+const char HumidOSH::CONTROLINDICATOR_RUN_LEFT[5]   PROGMEM = { CHAR_RUN, CHAR_RUN, CHAR_EMPTY, CHAR_EMPTY, CHAR_NULL };
+const char HumidOSH::CONTROLINDICATOR_RUN_RIGHT[5]  PROGMEM = { CHAR_EMPTY, CHAR_EMPTY, CHAR_RUN, CHAR_RUN, CHAR_NULL };
+const char HumidOSH::CONTROLINDICATOR_IDLE[5]       PROGMEM = { 'I', 'D', 'L', 'E', CHAR_NULL };
+const char HumidOSH::PRINT_ERROR[6]                 PROGMEM = { 'E', 'R', 'R', 'O', 'R', CHAR_NULL };
+const char HumidOSH::PRINT_NOREADING[4]             PROGMEM = { 'N', '/', 'A', CHAR_NULL };
+const char HumidOSH::ERROR_FLASHER_LEFT[6]  PROGMEM = { CHAR_FLASHER_LEFT, CHAR_FLASHER_LEFT, CHAR_FLASHER_LEFT, CHAR_FLASHER_LEFT, CHAR_FLASHER_LEFT, CHAR_NULL };
+const char HumidOSH::ERROR_FLASHER_RIGHT[6] PROGMEM = { CHAR_FLASHER_RIGHT, CHAR_FLASHER_RIGHT, CHAR_FLASHER_RIGHT, CHAR_FLASHER_RIGHT, CHAR_FLASHER_RIGHT, CHAR_NULL };
+const char HumidOSH::ERROR_FLASHER_CLEAR[6] PROGMEM = { CHAR_EMPTY, CHAR_EMPTY, CHAR_EMPTY, CHAR_EMPTY, CHAR_EMPTY, CHAR_NULL };
+
+// Static text of the screen pages
+static const char LABEL_STARS[]           PROGMEM = "********************";
+static const char LABEL_DASHES[]          PROGMEM = "--------------------";
+static const char LABEL_OLD_TARGET[]      PROGMEM = "Old target:";
+static const char LABEL_NEW_TARGET[]      PROGMEM = "New target:";
+static const char LABEL_READINGS[]        PROGMEM = "Readings";
+#if HUMIDOSH_CHANNEL_COUNT > 1
+static const char LABEL_CHANNEL[]         PROGMEM = "#";
+#endif
+#ifdef DISPLAY_TEMPERATURE
+static const char LABEL_TEMPERATURE[]     PROGMEM = "T:        C";
+#endif // DISPLAY_TEMPERATURE
+static const char LABEL_HUMIDITY[]        PROGMEM = "RH:        %";
+static const char LABEL_FANSPEED[]        PROGMEM = "Fan:        RPM";
+static const char LABEL_HUMIDITYADJ[]     PROGMEM = "Relative humidity(%)";
+static const char LABEL_FANSPEEDADJ[]     PROGMEM = "Fan speed (RPM)";
+static const char LABEL_CAL[]             PROGMEM = "---RH calibration---";
+static const char LABEL_CAL_POINT_ADD[]   PROGMEM = "Press 1 to add point";
+static const char LABEL_CAL_POINT_COUNT[] PROGMEM = "Points saved:";
+static const char LABEL_CAL_RESETALL[]    PROGMEM = "Press 3 to reset all";
+static const char LABEL_CAL_POINT[]       PROGMEM = "------Point  -------";
+static const char LABEL_CAL_STORED[]      PROGMEM = "raw:      ref.:";
+static const char LABEL_CAL_NEW_RAW[]     PROGMEM = "New raw RH:";
+static const char LABEL_CAL_NEW_REF[]     PROGMEM = "New ref. RH:";
+static const char LABEL_CAL_RESET[]       PROGMEM = "Reset calibration?";
+static const char LABEL_CAL_RESET_WARN1[] PROGMEM = "This will delete all";
+static const char LABEL_CAL_RESET_WARN2[] PROGMEM = "calibration data!!";
+static const char LABEL_CAL_RESET_PRESS[] PROGMEM = "--Press 5 to reset--";
+static const char LABEL_AUTOTUNE[]        PROGMEM = "---PID autotune-----";
+static const char LABEL_AUTOTUNE_TARGET[] PROGMEM = "Target:         %";
+static const char LABEL_HOLD[]            PROGMEM = "Hold button for";
+static const char LABEL_HOLD_SECONDS[]    PROGMEM = "second(s)";
+static const char LABEL_MINVAL[]          PROGMEM = "Minimum value is";
+static const char LABEL_MAXVAL[]          PROGMEM = "Maximum value is";
+
+const HumidOSH::ScreenLabel HumidOSH::SCREEN_LABELS[] PROGMEM =
+{
+  { SCREEN_PAGE_READINGS,     6,  0,                        LABEL_READINGS },
+#if HUMIDOSH_CHANNEL_COUNT > 1
+  { SCREEN_PAGE_READINGS,     17, 0,                        LABEL_CHANNEL },
+#endif
+#ifdef DISPLAY_TEMPERATURE
+  { SCREEN_PAGE_READINGS,     7,  ROW_READING_TEMPERATURE,  LABEL_TEMPERATURE },
+#else
+  { SCREEN_PAGE_READINGS,     0,  1,                        LABEL_DASHES },
+#endif // DISPLAY_TEMPERATURE
+  { SCREEN_PAGE_READINGS,     6,  ROW_READING_HUMIDITY,     LABEL_HUMIDITY },
+  { SCREEN_PAGE_READINGS,     5,  ROW_READING_FANSPEED,     LABEL_FANSPEED },
+
+  { SCREEN_PAGE_HUMIDITYADJ,  0,  0,  LABEL_HUMIDITYADJ },
+  { SCREEN_PAGE_HUMIDITYADJ,  0,  1,  LABEL_DASHES },
+  { SCREEN_PAGE_HUMIDITYADJ,  0,  2,  LABEL_OLD_TARGET },
+  { SCREEN_PAGE_HUMIDITYADJ,  0,  3,  LABEL_NEW_TARGET },
+
+  { SCREEN_PAGE_FANSPEEDADJ,  2,  0,  LABEL_FANSPEEDADJ },
+  { SCREEN_PAGE_FANSPEEDADJ,  0,  1,  LABEL_DASHES },
+  { SCREEN_PAGE_FANSPEEDADJ,  0,  2,  LABEL_OLD_TARGET },
+  { SCREEN_PAGE_FANSPEEDADJ,  0,  3,  LABEL_NEW_TARGET },
+
+  { SCREEN_PAGE_CAL,          0,  0,  LABEL_CAL },
+  { SCREEN_PAGE_CAL,          0,  1,  LABEL_CAL_POINT_ADD },
+  { SCREEN_PAGE_CAL,          0,  2,  LABEL_CAL_POINT_COUNT },
+  { SCREEN_PAGE_CAL,          0,  3,  LABEL_CAL_RESETALL },
+
+  { SCREEN_PAGE_CAL_POINT,    0,  0,  LABEL_CAL_POINT },
+  { SCREEN_PAGE_CAL_POINT,    0,  1,  LABEL_CAL_STORED },
+  { SCREEN_PAGE_CAL_POINT,    3,  2,  LABEL_CAL_NEW_RAW },
+  { SCREEN_PAGE_CAL_POINT,    2,  3,  LABEL_CAL_NEW_REF },
+
+  { SCREEN_PAGE_CAL_RESET,    1,  0,  LABEL_CAL_RESET },
+  { SCREEN_PAGE_CAL_RESET,    0,  1,  LABEL_CAL_RESET_WARN1 },
+  { SCREEN_PAGE_CAL_RESET,    1,  2,  LABEL_CAL_RESET_WARN2 },
+  { SCREEN_PAGE_CAL_RESET,    0,  3,  LABEL_CAL_RESET_PRESS },
+
+  { SCREEN_PAGE_AUTOTUNE,     0,  0,  LABEL_AUTOTUNE },
+  { SCREEN_PAGE_AUTOTUNE,     0,  1,  LABEL_AUTOTUNE_TARGET },
+
+  { SCREEN_PAGE_HOLD,         0,  0,  LABEL_STARS },
+  { SCREEN_PAGE_HOLD,         2,  1,  LABEL_HOLD },
+  { SCREEN_PAGE_HOLD,         6,  2,  LABEL_HOLD_SECONDS },
+  { SCREEN_PAGE_HOLD,         0,  3,  LABEL_STARS },
+
+  { SCREEN_PAGE_MINVAL,       0,  0,  LABEL_STARS },
+  { SCREEN_PAGE_MINVAL,       2,  1,  LABEL_MINVAL },
+  { SCREEN_PAGE_MINVAL,       0,  3,  LABEL_STARS },
+
+  { SCREEN_PAGE_MAXVAL,       0,  0,  LABEL_STARS },
+  { SCREEN_PAGE_MAXVAL,       2,  1,  LABEL_MAXVAL },
+  { SCREEN_PAGE_MAXVAL,       0,  3,  LABEL_STARS }
+};
+
+const uint8_t HumidOSH::SCREEN_LABEL_COUNT = sizeof(SCREEN_LABELS) / sizeof(SCREEN_LABELS[0]);
+
 HumidOSH::HumidOSH( SerialCommunication* communicator, I2C* i2cWire, Keypad* keypad, // class ref
-                    uint8_t pinPump, uint8_t pinValveDry, uint8_t pinValveWet, uint8_t pinFanPWMDrain, uint8_t pinLEDRH, uint8_t pinLEDFan, // pins
+                    const ChamberConfig chamberConfigs[HUMIDOSH_CHANNEL_COUNT], // pins etc. of each chamber
                     double humidityMin, double humidityMax, uint8_t pumpDutyCycleMin, uint8_t pumpDutyCycleMax, double fanSpeedMin, double fanSpeedMax, double fanSpeedAbsMin, double fanMinDrive,  // Limits for the controls
                     double humidityKp, double humidityKi, double humidityKd,  // PID params
+                    const HumidityGainSchedule &humidityGainSchedule,        // Gains of HUMIDITY_CONTROL_SCHEDULED
                     uint16_t keyHoldDuration
                   )
   :
   communicator_(communicator),
   i2cWire_(i2cWire),
   keypad_(keypad),
-  pinPump_(pinPump),
-  pinValveDry_(pinValveDry),
-  pinValveWet_(pinValveWet),
-  pinFanPWMDrain_(pinFanPWMDrain),
-  pinLEDRH_(pinLEDRH),
-  pinLEDFan_(pinLEDFan),
   humidityMin_(humidityMin),
   humidityMax_(humidityMax),
   pumpDutyCycleMin_(pumpDutyCycleMin),
   pumpDutyCycleMax_(pumpDutyCycleMax),
+  humidityGainSchedule_(humidityGainSchedule),
   fanSpeedMin_(fanSpeedMin),
   fanSpeedMax_(fanSpeedMax),
   fanSpeedAbsMin_(fanSpeedAbsMin),
   fanMinDrive_(fanMinDrive),
-  keyHoldDuration_(keyHoldDuration),
-  humiditySensor_(i2cWire_),
-  fan_(i2cWire_),
-  humidityPID_(&humidity_, &humidityControlOutput_, &humidityTarget_, humidityKp, humidityKi, humidityKd, millis(), P_ON_M, DIRECT)
-{
-  // Set up pins
-  digitalWrite(pinPump_, LOW);
-  digitalWrite(pinValveDry_, LOW);
-  digitalWrite(pinValveWet_, LOW);
-  digitalWrite(pinFanPWMDrain_, HIGH);
-  digitalWrite(pinLEDRH_, LOW);
-  digitalWrite(pinLEDFan_, LOW);
-
-  // Enable them
-  pinMode(pinPump_, OUTPUT);
-  pinMode(pinValveDry_, OUTPUT);
-  pinMode(pinValveWet_, OUTPUT);
-  pinMode(pinFanPWMDrain_, OUTPUT);
-  pinMode(pinLEDRH_, OUTPUT);
-  pinMode(pinLEDFan_, OUTPUT);
-
-  // Set default state for some flags
-  humidityOK_                     = false;
-  humidityControlActive_          = false;
-  newHumidityReadingPrint_        = false;
-  newHumidityReadingControl_      = false;
-  humidityErrorHandlingActive_    = false;
-  humidityTriggered_              = false;
-  humidityTriggeredOK_            = false;
+  keyHoldDuration_(keyHoldDuration)
+{
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  {
+    ChamberChannel *channel = &channels_[i];
+    channel->config = chamberConfigs[i];
+    channel->humiditySensor.changeAddress(channel->config.sensorADDRPinHigh);
+    channel->humidityRetry = RetryPolicy(&I2c, channel->config.sensorADDRPinHigh ? SHT3x::BASE_ADDRESS + 1 : SHT3x::BASE_ADDRESS);
+    channel->humidityPID = PID(&channel->humidity, &channel->humidityControlOutput, &channel->humidityTarget, humidityKp, humidityKi, humidityKd, millis(), P_ON_M, DIRECT);
+    channel->pidKp = humidityKp;
+    channel->pidKi = humidityKi;
+    channel->pidKd = humidityKd;
+
+    // Set up pins
+    digitalWrite(channel->config.pinPump, LOW);
+    digitalWrite(channel->config.pinValveDry, LOW);
+    digitalWrite(channel->config.pinValveWet, LOW);
+    digitalWrite(channel->config.pinFanPWMDrain, HIGH);
+    digitalWrite(channel->config.pinLEDRH, LOW);
+    digitalWrite(channel->config.pinLEDFan, LOW);
+
+    // Enable them
+    pinMode(channel->config.pinPump, OUTPUT);
+    pinMode(channel->config.pinValveDry, OUTPUT);
+    pinMode(channel->config.pinValveWet, OUTPUT);
+    pinMode(channel->config.pinFanPWMDrain, OUTPUT);
+    pinMode(channel->config.pinLEDRH, OUTPUT);
+    pinMode(channel->config.pinLEDFan, OUTPUT);
+    channel->pump.begin(channel->config.pinPump);
+
+    // Set default state for some flags
+    channel->humidityOK                   = false;
+    channel->humidityControlActive        = false;
+    channel->newHumidityReadingPrint      = false;
+    channel->newHumidityReadingControl    = false;
+    channel->humidityErrorHandlingActive  = false;
+    channel->humidityPeriodicStarted      = false;
+    channel->humidityControlMode          = HUMIDITY_CONTROL_PID;
+    channel->humidifying                  = true;
+    channel->fanSpeedOK                   = false;
+    channel->fanStatus                    = 0;
+    channel->fanSpeedControlActive        = false;
+    channel->newFanSpeedReadingPrint      = false;
+    channel->humidityRequested            = false;
+    channel->fanSpeedRequested            = false;
+#ifdef ADAPTIVE_DAQ
+    channel->DAQFast                      = true;   // Until the chamber settles after the start
+    channel->humiditySlopeValid           = false;
+    channel->humiditySlopeHigh            = false;
+#endif // ADAPTIVE_DAQ
+  }
+
   holdHumidityButton_             = false;
   humidityControlRecentlyStopped_ = false;
-  fanSpeedOK_                     = false;
-  fanSpeedControlActive_          = false;
-  newFanSpeedReadingPrint_        = false;
   holdFanSpeedButton_             = false;
   fanSpeedControlRecentlyStopped_ = false;
+
+  displayedChannel_ = 0;
+  remoteChannel_    = 0;
+  humidityChannel_  = 0;
+  fanSpeedChannel_  = 0;
+  fanBusChannel_    = FAN_BUS_CHANNEL_UNKNOWN;
+  autotuneChannel_  = AUTOTUNE_CHANNEL_NONE;
+  programChannel_   = PROGRAM_CHANNEL_NONE;
+  channel_ = &channels_[0];
+}
+
+HumidOSH::~HumidOSH()
+{
+}
+
+void HumidOSH::init()
+{
+  bool warmBoot = isWarmBoot();
+
+  // Set up I2C
+  I2c.setTimeOut(100);   // Timeout (ms) of a transaction with a device that has no profile below.
+  I2c.begin(false);     // True to use internal pull-up resistors; false for external pull-ups.
+  I2c.setSpeed(false);  // true for 400 kHz (fast-mode); false for 100 kHz (standard mode), for a device that has no profile below.
+
+  // Each device gets its own bus clock. The screen takes most of the bus time, so it and the sensors run in fast-mode,
+  // while the EMC2301 stays in standard mode for SMBus compatibility.
+  // Timeouts in ms. A device may hold the clock low for a measurement (SHT3x) or while it is busy; SMBus allows 35 ms.
+  //             Address                  Bus clock        Timeout  Clock stretch                Retries
+  I2c.setProfile(DISPLAY_ADDRESS1,         I2C_TWBR_400KHZ, 100,     10,                          I2C_LOSTARB_RETRIES);
+  I2c.setProfile(SHT3x::BASE_ADDRESS,      I2C_TWBR_400KHZ, 100,     SHT3x::DURATION_HIGREP + 5,  I2C_LOSTARB_RETRIES);
+  I2c.setProfile(SHT3x::BASE_ADDRESS + 1,  I2C_TWBR_400KHZ, 100,     SHT3x::DURATION_HIGREP + 5,  I2C_LOSTARB_RETRIES);
+  I2c.setProfile(HUMIDOSH_FAN_MUX_ADDRESS, I2C_TWBR_400KHZ, 100,     10,                          I2C_LOSTARB_RETRIES);
+  I2c.setProfile(EMC2301::I2C_ADDRESS,     I2C_TWBR_100KHZ, 100,     35,                          I2C_LOSTARB_RETRIES);
+
+  // Init the LCD screen
+  screen_.begin(*i2cWire_);
+
+  if (warmBoot)
+  { // The screen keeps its backlight and contrast settings, so just start drawing.
+    screen_.enableFramebuffer();
+  }
+  else
+  {
+    screen_.setBacklight(SCREEN_BACKGROUND_DEFAULT); //Set backlight to bright white
+    screen_.noDisplay();  // Hide the confirmation message from setting contrast
+    screen_.setContrast(0); //Set contrast. Lower to 0 for higher contrast.
+    screen_.clear(); // clear screen
+    screen_.display();  // Turn back on display
+    delay(2000);  // Give time for display to turn back on
+    screen_.enableFramebuffer(); // From here on, the screen is drawn through the framebuffer and flushed in run().
+    // Write splash screen.
+    screen_.setCursor(0, 0);
+    printToDisplay(F("********************"));
+    screen_.setCursor(0, 1);
+    printToDisplay(F("----> HumidOSH <----"));
+    screen_.setCursor(0, 2);
+    printToDisplay(F(" Soon Kiat Lau 2019 "));
+    screen_.setCursor(0, 3);
+    printToDisplay(F("********************"));
+    screen_.flushFrameAll();
+    delay(2000);
+  }
+
+  // The send period last set by the computer, if any
+  sendPeriod_ = Config.getSendPeriod();
+
+  if (sendPeriod_ < PERIOD_SEND_MIN || sendPeriod_ > PERIOD_SEND_MAX)
+  {
+    sendPeriod_ = PERIOD_DAQ;
+  }
+
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  {
+    selectChannel(i);
+
+    // Set up the fan. Only the registers that differ from what the EMC2301 has are written, so this is quick if it kept its settings.
+    retryFunc(&channel_->fanRetry, &HumidOSH::configureFan);
+
+    // Init PID settings
+    channel_->humidityPID.SetOutputLimits(-PUMPDRIVE_COMMAND_MAX, PUMPDRIVE_COMMAND_MAX);  // Range of the pump command
+    channel_->humidityPID.SetMode(AUTOMATIC);
+    loadHumidityPIDTunings(); // From an earlier autotune
+
+    // Set some default numbers
+    channel_->humidityTarget = humidityMin_ + (humidityMax_ - humidityMin_) / 2;
+    channel_->fanSpeedTarget = fanSpeedMax_;
+
+    channel_->humidityPeriodicStarted = retryFunc(&channel_->humidityRetry, &HumidOSH::startHumidityPeriodic);
+
+    // Default values until the measurements are made.
+    channel_->humidity = 0;
+    channel_->fanSpeed = 0;
+    channel_->temperature = 0;
+
+    ChamberRunState runState;
+
+    if (loadRunState(&runState))
+    {
+      restoreRunState(runState, !warmBoot);
+    }
+  }
+
+  if (!warmBoot)
+  {
+    delay(getHumidityPeriod() + PERIOD_DAQ_HUMIDITY_RETRY); // Ensure that when run() is called, the first RH measurement is ready to be fetched.
+  }
+
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  {
+    channels_[i].humidityTimerStart = millis();
+    channels_[i].humidityLastReadingTime = millis();
+    channels_[i].humidityPublishTime = millis() - PERIOD_HUMIDITY_CONTROL; // Publish the first reading straight away
+    channels_[i].humidityWait = warmBoot ? getHumidityPeriod() + PERIOD_DAQ_HUMIDITY_RETRY : 0; // Instead of the wait above
+    channels_[i].DAQTimerStart = millis();
+#ifdef ADAPTIVE_DAQ
+    channels_[i].DAQSteadyTime = millis();
+#endif // ADAPTIVE_DAQ
+  }
+
+  runStateSaveTime_ = millis();
+
+  selectChannel(displayedChannel_);
+  changeScreenPage(SCREEN_PAGE_READINGS);
+  backlightOn_ = true;
+  screenActiveTimerStart_ = millis();
+
+#ifdef KEYPAD_PINCHANGE
+  // Scan once at the start; the keypad task arms the rows once it finds no key down.
+  keypadWake_ = true;
+  keypadIdle_ = false;
+
+  for (uint8_t r = 0; r < keypad_->getRowCount(); r++)
+  {
+    PinChange::attach(keypad_->getRowPin(r), keypadPinChangeCallback, this);
+  }
+#endif // KEYPAD_PINCHANGE
+
+#ifdef FAN_ALERT
+  // Read the fan status once at the start, in case ALERT went low before the interrupt was on.
+  fanAlert_ = true;
+  pinMode(HUMIDOSH_FAN_ALERT_PIN, INPUT_PULLUP);
+  PinChange::attach(HUMIDOSH_FAN_ALERT_PIN, fanAlertPinChangeCallback, this);
+#endif // FAN_ALERT
+
+  // Carry on with the telemetry log after the records of the previous runs.
+  telemetryLog_.begin();
+  restartLog();
+  logDumping_ = false;
+
+  if (!addTasks())
+  { // SCHEDULER_TASK_MAX is too small for this build, and a task that wasn't added would never run. Stop here, with
+    // the pumps and valves off.
+    for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+    {
+      selectChannel(i);
+      toggleHumidityControl(false);
+    }
+
+    resetScreen();
+    printToDisplay(F("Too many tasks, see"));
+    screen_.setCursor(0, 1);
+    printToDisplay(F("SCHEDULER_TASK_MAX"));
+    screen_.flushFrameAll();
+
+    while (true)
+    {
+    }
+  }
+
+#ifdef WATCHDOG
+  wdt_enable(WATCHDOG_TIMEOUT);
+#endif // WATCHDOG
+}
+
+// The main function that should be called in loop().
+void HumidOSH::run()
+{
+  INSTRUMENT_LOOP();
+
+#ifdef WATCHDOG
+  wdt_reset();
+#endif // WATCHDOG
+
+  // Abort any background I2C transaction that got stuck.
+  i2cWire_->poll();
+
+#ifdef FAN_ALERT
+  if (fanAlert_)
+  { // The fan speed task reads the fan status.
+    scheduler_.trigger(fanSpeedTaskID_, 0);
+  }
+#endif // FAN_ALERT
+
+  // Everything else runs as tasks; see addTasks().
+  scheduler_.run();
+}
+
+// Set up the tasks that make up run(). The task IDs follow the order here, which is also the order in the task statistics.
+// Returns false if the task table is full.
+bool HumidOSH::addTasks()
+{
+  if (scheduler_.addPeriodic(keypadTaskCallback, this, PERIOD_TASK_KEYPAD, 0, &keypadTaskID_) != SCHEDULER_STATUS_OK
+      || scheduler_.addOneShot(humidityTaskCallback, this, &humidityTaskID_) != SCHEDULER_STATUS_OK
+      || scheduler_.addOneShot(controlTaskCallback, this, &controlTaskID_) != SCHEDULER_STATUS_OK
+      || scheduler_.addOneShot(fanSpeedTaskCallback, this, &fanSpeedTaskID_) != SCHEDULER_STATUS_OK
+      || scheduler_.addPeriodic(screenTaskCallback, this, PERIOD_TASK_SCREEN, 0, &screenTaskID_) != SCHEDULER_STATUS_OK
+      || scheduler_.addPeriodic(sendTaskCallback, this, sendPeriod_, sendPeriod_, &sendTaskID_) != SCHEDULER_STATUS_OK
+      || scheduler_.addPeriodic(logTaskCallback, this, PERIOD_TASK_LOG, PERIOD_TASK_LOG, &logTaskID_) != SCHEDULER_STATUS_OK
+      || scheduler_.addOneShot(logWriteTaskCallback, this, &logWriteTaskID_) != SCHEDULER_STATUS_OK)
+  {
+    return false;
+  }
+
+  // Data are only sent once the computer asks for them.
+  scheduler_.cancel(sendTaskID_);
+
+  // Force acquisition of measurements before the display is updated to the readings screen.
+  scheduler_.trigger(humidityTaskID_, 0);
+  scheduler_.trigger(fanSpeedTaskID_, 0);
+  return true;
+}
+
+// Scan the keypad; the key presses come back through handleKeyPress().
+void HumidOSH::runKeypadTask()
+{
+#ifdef KEYPAD_PINCHANGE
+  if (keypadIdle_ && !keypadWake_)
+  { // Nothing pressed since the rows were armed.
+    return;
+  }
+
+  keypadWake_ = false;
+#endif // KEYPAD_PINCHANGE
+
+  selectChannel(displayedChannel_);
+  keypad_->getKey();
+
+#ifdef KEYPAD_PINCHANGE
+  // Keep scanning while a key is down (for the debounce, hold and release); otherwise wait for the interrupt.
+  keypadIdle_ = keypad_->isIdle();
+
+  if (keypadIdle_ && keypad_->armRows())
+  { // A key went down just after the scan, so there won't be a change for the interrupt to catch.
+    keypadWake_ = true;
+  }
+#endif // KEYPAD_PINCHANGE
+}
+
+#ifdef KEYPAD_PINCHANGE
+void HumidOSH::keypadPinChangeCallback(void *context)
+{
+  ((HumidOSH *) context)->keypadWake_ = true;
+}
+#endif // KEYPAD_PINCHANGE
+
+#ifdef FAN_ALERT
+// ALERT is active low. The other pins on its port fire the interrupt too, hence the check.
+void HumidOSH::fanAlertPinChangeCallback(void *context)
+{
+  if (digitalRead(HUMIDOSH_FAN_ALERT_PIN) == LOW)
+  {
+    ((HumidOSH *) context)->fanAlert_ = true;
+  }
+}
+
+// Read the fan status of every chamber, since ALERT is shared. A chamber whose fault came or went gets its fan speed read right away.
+void HumidOSH::checkFanAlert()
+{
+  fanAlert_ = false;
+
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  {
+    selectChannel(i);
+    bool hadFault = hasFanFault();
+
+    if (attemptFunc(&channel_->fanRetry, &HumidOSH::getFanStatus) && hasFanFault() != hadFault)
+    {
+      if (hasFanFault())
+      { // Don't wait for the reading to show it.
+        channel_->fanSpeedOK = false;
+        channel_->newFanSpeedReadingPrint = false;
+      }
+
+      channel_->DAQTimerStart = millis() - getFanSpeedPeriod(channel_);
+    }
+  }
+
+  selectChannel(displayedChannel_);
+}
+#endif // FAN_ALERT
+
+// Grab RH measurements, one chamber at a time. The reads are queued on the I2C bus so that the loop isn't held up while waiting for them;
+// this task then comes back shortly to collect the reading.
+void HumidOSH::runHumidityTask()
+{
+  uint16_t waitRemaining;
+
+  if (!channels_[humidityChannel_].humidityRequested)
+  {
+    humidityChannel_ = getNextDueChannel(true, &waitRemaining);
+
+    if (waitRemaining > 0)
+    { // None of the chambers is due yet.
+      scheduler_.trigger(humidityTaskID_, waitRemaining);
+      return;
+    }
+
+    selectChannel(humidityChannel_);
+    requestHumidityReading();
+
+    if (channel_->humidityRequested)
+    {
+      scheduler_.trigger(humidityTaskID_, PERIOD_TASK_I2C_CHECK);
+    }
+    else
+    {
+      getNextDueChannel(true, &waitRemaining);
+      scheduler_.trigger(humidityTaskID_, waitRemaining);
+    }
+    return;
+  }
+
+  selectChannel(humidityChannel_);
+  collectHumidityReading();
+
+  if (channel_->humidityRequested)
+  { // Still waiting on the bus.
+    scheduler_.trigger(humidityTaskID_, PERIOD_TASK_I2C_CHECK);
+    return;
+  }
+
+  // Got a reading (or found that it was missing), so the control has something to do.
+  scheduler_.trigger(controlTaskID_, 0);
+
+  // The next fetch of each chamber is timed from when its last one was requested.
+  getNextDueChannel(true, &waitRemaining);
+  scheduler_.trigger(humidityTaskID_, waitRemaining);
+}
+
+// Same as runHumidityTask(), but for the fan speed.
+void HumidOSH::runFanSpeedTask()
+{
+  uint16_t waitRemaining;
+
+  if (!channels_[fanSpeedChannel_].fanSpeedRequested)
+  {
+#ifdef FAN_ALERT
+    // ALERT stays low for as long as a fault lasts, so check again on every run until it is gone.
+    if (fanAlert_ || digitalRead(HUMIDOSH_FAN_ALERT_PIN) == LOW)
+    {
+      checkFanAlert();
+    }
+#endif // FAN_ALERT
+
+    fanSpeedChannel_ = getNextDueChannel(false, &waitRemaining);
+
+    if (waitRemaining > 0)
+    {
+      scheduler_.trigger(fanSpeedTaskID_, waitRemaining);
+      return;
+    }
+
+    selectChannel(fanSpeedChannel_);
+    selectFanBus();
+    channel_->DAQTimerStart = millis();
+#ifndef FAN_ALERT
+    attemptFunc(&channel_->fanRetry, &HumidOSH::getFanStatus);
+#endif // !FAN_ALERT
+    requestFanSpeedReading();
+  }
+  else
+  {
+    selectChannel(fanSpeedChannel_);
+    collectFanSpeedReading();
+  }
+
+  if (channel_->fanSpeedRequested)
+  {
+    scheduler_.trigger(fanSpeedTaskID_, PERIOD_TASK_I2C_CHECK);
+  }
+  else
+  {
+    getNextDueChannel(false, &waitRemaining);
+    scheduler_.trigger(fanSpeedTaskID_, waitRemaining);
+  }
+}
+
+// Point channel_ at the given chamber.
+void HumidOSH::selectChannel(uint8_t channelIndex)
+{
+  channel_ = &channels_[channelIndex];
+}
+
+// Route the I2C multiplexer to the fan controller of channel_. Must be called before talking to channel_->fan.
+// The write is blocking, so any queued transaction to the previous fan controller finishes before the switch.
+void HumidOSH::selectFanBus()
+{
+#if HUMIDOSH_CHANNEL_COUNT > 1
+  if (fanBusChannel_ != channel_->config.fanMuxChannel)
+  {
+    if (i2cWire_->write((uint8_t) HUMIDOSH_FAN_MUX_ADDRESS, (uint8_t) (1 << channel_->config.fanMuxChannel)) == I2C_STATUS_OK)
+    {
+      fanBusChannel_ = channel_->config.fanMuxChannel;
+    }
+    else
+    { // Unknown state; try again next time.
+      fanBusChannel_ = FAN_BUS_CHANNEL_UNKNOWN;
+    }
+  }
+#endif
+}
+
+// Find the chamber whose RH (or fan speed) reading is due the soonest, and how long (ms) until then.
+uint8_t HumidOSH::getNextDueChannel(bool humidity, uint16_t * waitRemaining)
+{
+  unsigned long now = millis();
+  uint8_t dueChannel = 0;
+  *waitRemaining = 0xFFFF;
+
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  {
+    unsigned long elapsed = now - (humidity ? channels_[i].humidityTimerStart : channels_[i].DAQTimerStart);
+    uint16_t period = humidity ? channels_[i].humidityWait : getFanSpeedPeriod(&channels_[i]);
+    uint16_t wait = elapsed >= period ? 0 : period - elapsed;
+
+    if (wait < *waitRemaining)
+    {
+      dueChannel = i;
+      *waitRemaining = wait;
+    }
+  }
+
+  return dueChannel;
+}
+
+// Triggered by runHumidityTask() after every RH reading. Runs the control of every chamber that has a new reading (or an error).
+void HumidOSH::runControlTask()
+{
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  {
+    selectChannel(i);
+
+    // The program moves the target before the control works on it.
+    if (isProgramChannel() && channel_->humidityOK && channel_->newHumidityReadingControl)
+    {
+      runProgram();
+    }
+
+    // Perform controls on relative humidity, if necessary.
+    if (channel_->humidityControlActive)
+    {
+      if (channel_->humidityOK)
+      { // No errors
+        if (channel_->newHumidityReadingControl)
+        { // Got a new reading
+          channel_->newHumidityReadingControl = false;
+          channel_->stepResponse.update(millis(), realToDouble(channel_->humidity), realToDouble(channel_->humidityTarget));
+
+        
+          if (channel_->humidityErrorHandlingActive)
+          { // Just recovered from an error but don't start control just yet; instead restart the control PID
+            // and assign the current reading as the "last" value that will be used in the next control loop.
+            channel_->humidityErrorHandlingActive = false;
+          
+            /* REMOVED: RH error handling
+             Ideally, whenever the RH sensor has an error, the PID algorithm should reset so that the RH control doesn't
+             abruptly start from the previous state before error occured. However, the system currently has a bug where
+             scrolling thru LCD screen will cause an error, thus restarting control. Since the user should NOT expect
+             a control restart just by scrolling thru menu, this error handling is disabled for now. This means the system
+             will return to previous known state before error happened. Note that this can result in large PID integral term if
+             the time delay caused by the error is large enough.
+            channel_->humidityPID.Reset();
+            */
+            channel_->humidityPID.setLastInput(channel_->humidity);
+            channel_->humidityPID.setLastTime(millis());
+
+            // The pump was disabled for the error, and stays off until enabled again; the next control pass drives it.
+            setPumpCommand(0);
+            togglePump(true);
+          }
+          else
+          {
+            // Everything is fine and dandy; proceed to perform control on RH.
+            if (channel_->humidityFilter.getVariance() > HUMIDITY_VARIANCE_MAX)
+            { // The filter has only seen a few samples since a reset; keep the output as it is until it settles.
+            }
+            else if (isAutotuneChannel())
+            {
+              runAutotune();
+            }
+            else if (channel_->humidityControlMode == HUMIDITY_CONTROL_SCHEDULED)
+            {
+              computeScheduledHumidityOutput();
+              applyScheduledHumidityOutput();
+            }
+            else
+            {
+              channel_->humidityPID.Compute(millis());
+              applyHumidityOutput();
+            }
+          }
+        }
+      }
+      else if (!channel_->humidityErrorHandlingActive)
+      { // Encountered an error while trying to get a measurement, and haven't taken steps to handle it.
+        channel_->humidityErrorHandlingActive = true;
+
+        // Turn off all the actuators for humidity control until the problem is resolved.
+        togglePump(false);
+        toggleValveDry(false);
+        toggleValveWet(false);
+      }
+    }
+    else
+    {
+      channel_->stepResponse.stop();
+    }
+  }
+
+  selectChannel(displayedChannel_);
+}
+
+// Start the relay autotune of the humidity PID of the given chamber, around its current RH target.
+// The humidity control is turned on if it isn't already. Only one chamber can be tuned at a time.
+bool HumidOSH::beginAutotune(uint8_t channelIndex)
+{
+  if (autotuneChannel_ != AUTOTUNE_CHANNEL_NONE || channelIndex >= HUMIDOSH_CHANNEL_COUNT)
+  {
+    return false;
+  }
+
+  selectChannel(channelIndex);
+
+  if (!channel_->humidityOK || isProgramChannel())
+  { // A program would move the target under the experiment.
+    return false;
+  }
+
+  changeHumidityControlMode(HUMIDITY_CONTROL_PID);
+  autotuneChannel_ = channelIndex;
+  autotune_.start(millis(), realToDouble(channel_->humidity), realToDouble(channel_->humidityTarget), pumpDutyCycleMax_, AUTOTUNE_HYSTERESIS);
+
+  if (!channel_->humidityControlActive)
+  {
+    toggleHumidityControl(true);
+  }
+
+  return true;
+}
+
+// Stop the autotune of channel_ and go back to the PID with the gains it had before.
+void HumidOSH::cancelAutotune()
+{
+  if (isAutotuneChannel())
+  {
+    autotune_.stop();
+    autotuneChannel_ = AUTOTUNE_CHANNEL_NONE;
+    channel_->humidityPID.Reset();
+  }
+}
+
+// Whether channel_ is being autotuned.
+bool HumidOSH::isAutotuneChannel()
+{
+  return autotuneChannel_ != AUTOTUNE_CHANNEL_NONE && channel_ == &channels_[autotuneChannel_];
+}
+
+// One step of the autotune experiment on channel_, in place of the PID.
+void HumidOSH::runAutotune()
+{
+  double output;
+  AUTOTUNE_STATUS status = autotune_.update(millis(), realToDouble(channel_->humidity), &output);
+
+  if (status == AUTOTUNE_STATUS_RUNNING)
+  {
+    channel_->humidityControlOutput = output;
+    applyHumidityOutput();
+    return;
+  }
+
+  autotuneChannel_ = AUTOTUNE_CHANNEL_NONE;
+
+  if (status == AUTOTUNE_STATUS_DONE)
+  { // Carry on controlling with the new gains.
+    channel_->humidityPID.SetTunings(autotune_.getKp(), autotune_.getKi(), autotune_.getKd());
+    channel_->humidityPID.Reset();
+    saveHumidityPIDTunings();
+  }
+  else
+  { // Leave the chamber alone rather than risk running with gains that don't suit it.
+    toggleHumidityControl(false);
+  }
+
+  communicator_->sendAutotuneResult(channel_ - channels_, status == AUTOTUNE_STATUS_DONE, autotune_.getKp(), autotune_.getKi(), autotune_.getKd());
+}
+
+// Whether channel_ is running the setpoint program.
+bool HumidOSH::isProgramChannel()
+{
+  return programChannel_ != PROGRAM_CHANNEL_NONE && channel_ == &channels_[programChannel_];
+}
+
+// Stop the program of channel_. The targets stay where the program left them.
+void HumidOSH::cancelProgram()
+{
+  if (isProgramChannel())
+  {
+    program_.stop();
+    programChannel_ = PROGRAM_CHANNEL_NONE;
+  }
+}
+
+// One step of the setpoint program on channel_, with its latest filtered RH.
+void HumidOSH::runProgram()
+{
+  SETPOINTPROGRAM_STATUS status = program_.update(millis(), realToDouble(channel_->humidity));
+  setHumidityTarget(program_.getHumidityTarget());
+
+  if (status == SETPOINTPROGRAM_STATUS_NEXTSTEP)
+  {
+    applyProgramStep();
+  }
+  else if (status == SETPOINTPROGRAM_STATUS_DONE)
+  {
+    programChannel_ = PROGRAM_CHANNEL_NONE;
+  }
+}
+
+// Take the targets of the step that just started. From then on, the RH target follows the ramp in runProgram().
+void HumidOSH::applyProgramStep()
+{
+  const SetpointProgram_Step *step = program_.getStep();
+  setHumidityTarget(program_.getHumidityTarget());
+
+  if (step->fanSpeedTarget == 0)
+  {
+    return;
+  }
+
+  channel_->fanSpeedTarget = step->fanSpeedTarget;
+
+  if (channel_->fanSpeedControlActive)
+  {
+    retryFunc(&channel_->fanRetry, &HumidOSH::updateFanSpeedTarget, channel_->fanSpeedTarget);
+  }
+  else
+  {
+    retryFunc(&channel_->fanRetry, &HumidOSH::toggleFanSpeedControl, true);
+  }
+}
+
+// Step of the program for the binary data frame (see SERIAL_SEND_BINARY_PROGRAM_*).
+uint8_t HumidOSH::getProgramStep(uint8_t channelIndex)
+{
+  if (programChannel_ != channelIndex)
+  {
+    return SerialCommunication::SERIAL_SEND_BINARY_PROGRAM_NONE;
+  }
+
+  return program_.getStepIndex() | (program_.isHolding() ? SerialCommunication::SERIAL_SEND_BINARY_PROGRAM_HOLDING : 0);
+}
+
+// Switch channel_ between the humidity control modes. humidityPID is shared by both, so its gains and limits are swapped here.
+void HumidOSH::changeHumidityControlMode(HUMIDITY_CONTROL_MODE mode)
+{
+  if (mode == channel_->humidityControlMode)
+  {
+    return;
+  }
+
+  if (mode == HUMIDITY_CONTROL_SCHEDULED)
+  {
+    channel_->pidKp = channel_->humidityPID.GetKp();
+    channel_->pidKi = channel_->humidityPID.GetKi();
+    channel_->pidKd = channel_->humidityPID.GetKd();
+    channel_->humidityControlMode = mode;
+    setScheduledSide(channel_->humidityTarget >= channel_->humidity);
+  }
+  else
+  {
+    channel_->humidityControlMode = mode;
+    channel_->humidityPID.SetTunings(channel_->pidKp, channel_->pidKi, channel_->pidKd);
+    channel_->humidityPID.SetOutputLimits(-PUMPDRIVE_COMMAND_MAX, PUMPDRIVE_COMMAND_MAX);
+    channel_->humidityPID.Reset();
+  }
+}
+
+// Load the gains for humidifying or drying into humidityPID of channel_. The integral term is cleared since what was
+// built up on one side means nothing on the other.
+void HumidOSH::setScheduledSide(bool humidifying)
+{
+  const HumidityGainSchedule *schedule = &humidityGainSchedule_;
+
+  channel_->humidifying = humidifying;
+
+  if (humidifying)
+  {
+    channel_->humidityPID.SetTunings(schedule->humidifyKp, schedule->humidifyKi, schedule->humidifyKd);
+  }
+  else
+  {
+    channel_->humidityPID.SetTunings(schedule->dryKp, schedule->dryKi, schedule->dryKd);
+  }
+
+  channel_->humidityPID.Reset();
+}
+
+// HUMIDITY_CONTROL_SCHEDULED: work out humidityControlOutput of channel_ as feed-forward + PID correction.
+// The feed-forward is the output that roughly holds the target against the leak to the room, so the integral term only
+// has to make up the difference instead of building the whole output up from nothing after each setpoint change.
+// Anti-windup: the PID output is limited to what is left of the range of the current side after the feed-forward. So
+// the integral term stops growing while the pump is pinned at full duty, and it cannot wind towards the other side while
+// the RH is within VALVE_SWITCH_HYSTERESIS of the target (the pump is simply off there). The pump minimum duty is taken
+// out of the output in applyScheduledHumidityOutput(), so the integral term never has to cross that deadband either.
+void HumidOSH::computeScheduledHumidityOutput()
+{
+  double error = realToDouble(channel_->humidityTarget - channel_->humidity);
+
+  if (channel_->humidifying && error < -VALVE_SWITCH_HYSTERESIS)
+  {
+    setScheduledSide(false);
+  }
+  else if (!channel_->humidifying && error > VALVE_SWITCH_HYSTERESIS)
+  {
+    setScheduledSide(true);
+  }
+
+  double feedForward = humidityGainSchedule_.feedForwardGain * (realToDouble(channel_->humidityTarget) - humidityGainSchedule_.feedForwardRH);
+
+  if (channel_->humidifying)
+  {
+    feedForward = constrain(feedForward, 0, PUMPDRIVE_COMMAND_MAX);
+    channel_->humidityPID.SetOutputLimits(-feedForward, PUMPDRIVE_COMMAND_MAX - feedForward);
+  }
+  else
+  {
+    feedForward = constrain(feedForward, -PUMPDRIVE_COMMAND_MAX, 0);
+    channel_->humidityPID.SetOutputLimits(-PUMPDRIVE_COMMAND_MAX - feedForward, -feedForward);
+  }
+
+  channel_->humidityPID.Compute(millis());
+  channel_->humidityControlOutput += feedForward;
+}
+
+// HUMIDITY_CONTROL_SCHEDULED: drive the pump and valves of channel_ from humidityControlOutput. Any output above zero is
+// scaled into pumpDutyCycleMin_ - pumpDutyCycleMax_, so that the pump doesn't have a deadband as seen by the PID.
+void HumidOSH::applyScheduledHumidityOutput()
+{
+  real_t drive = channel_->humidifying ? channel_->humidityControlOutput : -channel_->humidityControlOutput;
+
+  if (drive < real_t(1))
+  { // Nothing to do on this side; the valves stay shut until the RH moves past the hysteresis.
+    setPumpCommand(0);
+    toggleValveDry(false);
+    toggleValveWet(false);
+    return;
+  }
+
+  toggleValveWet(channel_->humidifying);
+  toggleValveDry(!channel_->humidifying);
+
+  if (drive >= real_t(PUMPDRIVE_COMMAND_MAX))
+  { // Same as the PID mode at or above pumpDutyCycleMax_
+    setPumpCommand(PUMPDRIVE_COMMAND_MAX);
+  }
+  else
+  { // The fraction is kept, so the pump follows the output in steps of the duty cycle instead of whole commands.
+    setPumpCommand(real_t(pumpDutyCycleMin_) + drive * realFromRatio(pumpDutyCycleMax_ - pumpDutyCycleMin_, PUMPDRIVE_COMMAND_MAX));
+  }
+}
+
+// Drive the pump and valves of channel_ from humidityControlOutput: positive humidifies, negative dries.
+void HumidOSH::applyHumidityOutput()
+{
+  if (channel_->humidityControlOutput >= pumpDutyCycleMin_)
+  { // Humidifying
+    toggleValveWet(true);
+    toggleValveDry(false);
+
+    // If duty cycle is at least the upper limit, then run pump at max duty cycle
+    if (channel_->humidityControlOutput >= pumpDutyCycleMax_)
+    {
+      setPumpCommand(PUMPDRIVE_COMMAND_MAX);
+    }
+    else
+    {
+      setPumpCommand(channel_->humidityControlOutput);
+    }
+  }
+  else if (channel_->humidityControlOutput  < 0 && -channel_->humidityControlOutput >= pumpDutyCycleMin_)
+  { // Drying
+    toggleValveDry(true);
+    toggleValveWet(false);
+
+    // If duty cycle is at least the upper limit, then run pump at max duty cycle
+    if (-channel_->humidityControlOutput >= pumpDutyCycleMax_)
+    {
+      setPumpCommand(PUMPDRIVE_COMMAND_MAX);
+    }
+    else
+    {
+      setPumpCommand(-channel_->humidityControlOutput);
+    }
+  }
+  else
+  { // The pump duty cycle is within the minimum range; turn the pump and valves off.
+    setPumpCommand(0);
+    toggleValveDry(false);
+    toggleValveWet(false);
+  }
+}
+
+void HumidOSH::runScreenTask()
+{
+  /* TODO
+  // This code block darkens the screen when it is idle after a while.
+  // Commented out because some Sparkfun LCD screens use an older firmware
+  // that does not have setFastBacklight functionality, thus messing up
+  // the screen.
+  // Turn off the backlight if no buttons were pressed in a while
+  if (backlightOn_)
+  {
+    if (millis() - screenActiveTimerStart_ >= SCREEN_ACTIVE_DURATION)
+    {
+      backlightOn_ = false;
+      screen_.setFastBacklight(SCREEN_BACKGROUND_IDLE);
+      screen_.setBacklight(SCREEN_BACKGROUND_IDLE);
+      changeScreenPage(screenPage_);  // Refresh the screen
+    }
+  }
+  */
+
+  // Update the screen as necessary. Only the changed characters are sent to the screen, in the background.
+  selectChannel(displayedChannel_);
+  updateScreen();
+  screen_.flushFrame();
+}
+
+// Send data to computer. This runs on its own period so that the computer can ask for faster (or slower) streaming.
+void HumidOSH::runSendTask()
+{
+  if (logDumping_)
+  { // Don't break up the log; this data is skipped.
+    return;
+  }
+
+  sendCurrentData(sendDataBinary_);
+}
+
+// Runs every second: keep the saved run states up to date, and log a sample of every chamber once the decimation is up.
+void HumidOSH::runLogTask()
+{
+  bool saveOutput = millis() - runStateSaveTime_ >= PERIOD_RUNSTATE_SAVE;
+
+  if (saveOutput)
+  {
+    runStateSaveTime_ = millis();
+  }
+
+  saveRunStates(saveOutput);
+
+  if (!Config.isIdle())
+  {
+    scheduler_.trigger(logWriteTaskID_, 0);
+  }
+
+  uint16_t decimation = telemetryLog_.getDecimation();
+
+  if (decimation == 0 || ++logSecondsCount_ < decimation)
+  {
+    return;
+  }
+
+  logSecondsCount_ = 0;
+
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  {
+    ChamberChannel *channel = &channels_[i];
+    TelemetryLog_Encoder *encoder = &channel->logEncoder;
+    uint8_t status = getLogStatus(channel);
+    int16_t humidityTarget = realToLong(channel->humidityTarget * 10);
+    uint16_t fanSpeedTarget = channel->fanSpeedTarget;
+    TELEMETRYLOG_STATUS result = TELEMETRYLOG_STATUS_OK;
+
+    if (!encoder->started || encoder->humidityTarget != humidityTarget || encoder->fanSpeedTarget != fanSpeedTarget)
+    {
+      result = telemetryLog_.addTargets(encoder, i, humidityTarget, fanSpeedTarget, status);
+    }
+
+    if (result == TELEMETRYLOG_STATUS_OK)
+    {
+      TelemetryLog_Sample sample;
+      sample.humidity = realToLong(channel->humidity * 10);
+      sample.temperature = realToLong(channel->temperature * 10);
+      sample.fanSpeed = channel->fanSpeed;
+      sample.status = status;
+      result = telemetryLog_.addSample(encoder, i, sample);
+    }
+
+    if (result != TELEMETRYLOG_STATUS_OK)
+    { // Lost a record, so start a new session with this chamber.
+      telemetryLog_.resetEncoder(encoder);
+    }
+  }
+
+  scheduler_.trigger(logWriteTaskID_, 0);
+}
+
+// Write the queued log records and the changed settings (see ConfigStore) to the EEPROM, or send the log to the computer,
+// without holding up the loop.
+void HumidOSH::runLogWriteTask()
+{
+  if (logDumping_)
+  {
+    uint8_t record[TelemetryLog::LOG_RECORD_LENGTH];
+
+    if (!logDumpHeaderSent_)
+    {
+      if (!communicator_->canSendBinary(4))
+      {
+        scheduler_.trigger(logWriteTaskID_, PERIOD_TASK_LOG_DUMP);
+        return;
+      }
+
+      communicator_->sendLogHeader(logDumpCount_, TelemetryLog::LOG_RECORD_LENGTH);
+      logDumpHeaderSent_ = true;
+    }
+
+    while (logDumpIndex_ < logDumpCount_ && communicator_->canSendBinary(TelemetryLog::LOG_RECORD_LENGTH))
+    {
+      telemetryLog_.readRecord(logDumpIndex_, record);
+      communicator_->sendLogRecord(record, TelemetryLog::LOG_RECORD_LENGTH);
+      logDumpIndex_++;
+    }
+
+    if (logDumpIndex_ < logDumpCount_ || !communicator_->canSendBinary(1))
+    {
+      scheduler_.trigger(logWriteTaskID_, PERIOD_TASK_LOG_DUMP);
+      return;
+    }
+
+    communicator_->sendLogEnd();
+    telemetryLog_.endRead();
+    logDumping_ = false;
+  }
+
+  // Both write a byte only when the EEPROM is ready, so one of them waits for the other.
+  bool writing = telemetryLog_.service();
+  writing |= Config.service();
+
+  if (writing)
+  {
+    scheduler_.trigger(logWriteTaskID_, PERIOD_TASK_LOG_WRITE);
+  }
+}
+
+void HumidOSH::keypadTaskCallback(void *context)
+{
+  ((HumidOSH *) context)->runKeypadTask();
+}
+
+void HumidOSH::humidityTaskCallback(void *context)
+{
+  ((HumidOSH *) context)->runHumidityTask();
+}
+
+void HumidOSH::controlTaskCallback(void *context)
+{
+  ((HumidOSH *) context)->runControlTask();
+}
+
+void HumidOSH::fanSpeedTaskCallback(void *context)
+{
+  ((HumidOSH *) context)->runFanSpeedTask();
+}
+
+void HumidOSH::screenTaskCallback(void *context)
+{
+  ((HumidOSH *) context)->runScreenTask();
+}
+
+void HumidOSH::sendTaskCallback(void *context)
+{
+  ((HumidOSH *) context)->runSendTask();
+}
+
+void HumidOSH::logTaskCallback(void *context)
+{
+  ((HumidOSH *) context)->runLogTask();
+}
+
+void HumidOSH::logWriteTaskCallback(void *context)
+{
+  ((HumidOSH *) context)->runLogWriteTask();
 }
 
-HumidOSH::~HumidOSH()
+// Queue a fetch of the latest measurement from the RH sensor on the I2C bus.
+void HumidOSH::requestHumidityReading()
 {
+  channel_->humidityTimerStart = millis();
+
+  if (!channel_->humidityPeriodicStarted)
+  { // The sensor is not measuring (e.g. it was power cycled); restart the periodic mode first.
+    // One try per pass, so that a missing sensor doesn't hold up the other tasks.
+    channel_->humidityPeriodicStarted = attemptFunc(&channel_->humidityRetry, &HumidOSH::startHumidityPeriodic);
+    channel_->humidityWait = channel_->humidityPeriodicStarted ? getHumidityPeriod() : max(PERIOD_DAQ_HUMIDITY_RETRY, channel_->humidityRetry.getWait(millis()));
+
+    if (channel_->humidityPeriodicStarted)
+    { // The missed readings are counted in periods of the new rate, so from here; the last reading may be a slow period ago.
+      channel_->humidityLastReadingTime = millis();
+    }
+
+    return;
+  }
+
+#ifdef HUMIDOSH_SIMULATION
+  // The reading is taken from the model when it is collected.
+  channel_->humidityRequested = true;
+  return;
+#endif // HUMIDOSH_SIMULATION
+
+  channel_->humidityRequested = channel_->humiditySensor.requestPeriodicMeasurement() == SHT3X_STATUS_PENDING;
+
+  if (!channel_->humidityRequested)
+  {
+    handleMissingHumidityReading();
+  }
 }
 
-void HumidOSH::init()
+// Pick up the RH reading queued by requestHumidityReading() once it is done.
+void HumidOSH::collectHumidityReading()
 {
-  // Set up I2C
-  I2c.setTimeOut(100);   // Timeout after 20 ms.
-  I2c.begin(false);     // True to use internal pull-up resistors; false for external pull-ups.
-  I2c.setSpeed(false);  // true for 400 kHz (fast-mode); false for 100 kHz (standard mode). Need standard mode to ensure SMBus compatibility on EMC2301.
+#ifdef HUMIDOSH_SIMULATION
+  SHT3X_STATUS humidityStatus = SHT3X_STATUS_OK;
+#else
+  SHT3X_STATUS humidityStatus = channel_->humiditySensor.checkMeasurement();
+#endif // HUMIDOSH_SIMULATION
+
+  if (humidityStatus == SHT3X_STATUS_PENDING)
+  { // Still waiting on the bus.
+    return;
+  }
 
-  // Init the LCD screen
-  screen_.begin(*i2cWire_);
-  screen_.setBacklight(SCREEN_BACKGROUND_DEFAULT); //Set backlight to bright white
-  screen_.noDisplay();  // Hide the confirmation message from setting contrast
-  screen_.setContrast(0); //Set contrast. Lower to 0 for higher contrast.
-  screen_.clear(); // clear screen
-  screen_.display();  // Turn back on display
-  delay(2000);  // Give time for display to turn back on
-  // Write splash screen.
-  screen_.setCursor(0, 0);
-  printToDisplay("********************");
-  screen_.setCursor(0, 1);
-  printToDisplay("----> HumidOSH <----");
-  screen_.setCursor(0, 2);
-  printToDisplay(" Soon Kiat Lau 2019 ");
-  screen_.setCursor(0, 3);
-  printToDisplay("********************");
-  delay(2000);
-
-  // Set up the fan
-  fan_.toggleControlAlgorithm(true);
-  fan_.setFanSpeedMin(fanSpeedAbsMin_);
-  fan_.setSpinUpDrive(30);
-  fan_.setFanSpeedSpinupMin(fanSpeedAbsMin_);
-  fan_.setFanMinDrive(fanMinDrive_);
-
-  // Init PID settings
-  humidityPID_.SetOutputLimits(-255, 255);  // Range matches the limits of analogWrite().
-  humidityPID_.SetMode(AUTOMATIC);
+  channel_->humidityRequested = false;
 
-  changeScreenPage(SCREEN_PAGE_READINGS);
-  backlightOn_ = true;
-  screenActiveTimerStart_ = millis();
+  if (humidityStatus == SHT3X_STATUS_OK)
+  {
+    channel_->humidityRetry.recordSuccess();
+    storeHumidity();
+    channel_->humidityOK                 = true;
+    channel_->humidityLastReadingTime    = millis();
+    channel_->humidityWait               = getHumidityPeriod();
+
+    if (millis() - channel_->humidityPublishTime >= getHumidityControlPeriod())
+    { // Time for the control and the screen to have the filtered RH
+      channel_->humidityPublishTime        = millis();
+      channel_->newHumidityReadingPrint    = true;
+      channel_->newHumidityReadingControl  = true;
+#ifdef ADAPTIVE_DAQ
+      updateDAQRate();
+#endif // ADAPTIVE_DAQ
+    }
+  }
+  else
+  {
+    if (humidityStatus != SHT3X_STATUS_NOTREADY)
+    { // No reply, or a corrupted one. Not having a new measurement yet is normal and doesn't count.
+      channel_->humidityRetry.recordFailure(millis());
+    }
+
+    handleMissingHumidityReading();
+  }
+}
 
-  // Set some default numbers
-  humidityTarget_ = humidityMin_ + (humidityMax_ - humidityMin_) / 2;
-  fanSpeedTarget_ = fanSpeedMax_;
+// No new RH reading this time. This is normal now and then, since the sensor runs on its own clock; just try again shortly.
+// If there hasn't been a reading for several periods, something is wrong: flag the error and restart the periodic mode.
+void HumidOSH::handleMissingHumidityReading()
+{
+  channel_->humidityWait = max(PERIOD_DAQ_HUMIDITY_RETRY, channel_->humidityRetry.getWait(millis()));
 
-  // Force acquisition of measurements before the display is updated to the readings screen.
-  DAQTimerStart_ = millis() - PERIOD_DAQ;
-  retryFunc(&HumidOSH::triggerHumidity) ? humidityTriggeredOK_ = true : humidityTriggeredOK_ = false;
-  humidityTriggered_ = true;
-  delay(PERIOD_DAQ_HUMIDITY_TRIGGER + 10); // Ensure that when run() is called, it will instantly fetch the sensor measurements.
+  if (millis() - channel_->humidityLastReadingTime >= (unsigned long) HUMIDITY_MISSED_MAX * getHumidityPeriod())
+  {
+    channel_->humidityOK                 = false;
+    channel_->newHumidityReadingPrint    = false;
+    channel_->newHumidityReadingControl  = false;
+    channel_->humidityPeriodicStarted    = false;
+    channel_->humidityLastReadingTime    = millis(); // Space out the restart attempts
+    channel_->humidityFilter.reset();                // The old samples don't tell anything about the readings after the restart
+#ifdef ADAPTIVE_DAQ
+    channel_->humiditySlopeValid         = false;
+#endif // ADAPTIVE_DAQ
+  }
+}
+
+// Queue the read of the fan tachometer on the I2C bus.
+void HumidOSH::requestFanSpeedReading()
+{
+  channel_->fanSpeedRequested = channel_->fan.requestFanSpeed() == EMC2301_STATUS_PENDING;
 
-  // Default values until the measurements are made.
-  humidity_ = 0;
-  fanSpeed_ = 0;
-  temperature_ = 0;
+  if (!channel_->fanSpeedRequested)
+  { // Could not queue it; go straight to collecting, which falls back to the blocking read.
+    collectFanSpeedReading();
+  }
 }
 
-// The main function that should be called in loop().
-void HumidOSH::run()
+// Pick up the fan speed queued by requestFanSpeedReading() once it is done.
+// If the background read failed (or couldn't be queued), fall back to the blocking read with retries.
+void HumidOSH::collectFanSpeedReading()
 {
-  // Grab/trigger measurements.
-  if (millis() - DAQTimerStart_ >= PERIOD_DAQ - PERIOD_DAQ_HUMIDITY_TRIGGER)
+  EMC2301_STATUS fanSpeedStatus = channel_->fanSpeedRequested ? channel_->fan.checkFanSpeed() : EMC2301_STATUS_FAIL;
+
+  if (fanSpeedStatus == EMC2301_STATUS_PENDING)
+  { // Still waiting on the bus.
+    return;
+  }
+
+  if (fanSpeedStatus == EMC2301_STATUS_OK)
   {
-    if (humidityTriggered_ && millis() - DAQTimerStart_ >= PERIOD_DAQ)
-    {// Time to grab measurements.
-      DAQTimerStart_ = millis();
+    channel_->fanSpeedRequested = false;
+    channel_->fanRetry.recordSuccess();
+    storeFanSpeed();
+    channel_->fanSpeedOK = !hasFanFault();
+    channel_->newFanSpeedReadingPrint = true;
+    return;
+  }
 
-      // Relative humidity
-      if (humidityTriggeredOK_ && retryFunc(&HumidOSH::getHumidity))
-      {
-        humidityOK_ = true;
-        newHumidityReadingPrint_ = true;
-        newHumidityReadingControl_ = true;
-      }
-      else
-      {
-        humidityOK_ = false;
-        newHumidityReadingPrint_ = false;
-        newHumidityReadingControl_ = false;
-      }
+  if (channel_->fanSpeedRequested)
+  { // The background read failed; the next one is the retry.
+    channel_->fanSpeedRequested = false;
+    channel_->fanRetry.recordFailure(millis());
+  }
+  else if (attemptFunc(&channel_->fanRetry, &HumidOSH::getFanSpeed))
+  { // Could not queue the background read, but the blocking one went through.
+    channel_->fanSpeedOK = !hasFanFault();
+    channel_->newFanSpeedReadingPrint = true;
+    return;
+  }
 
-      // Fan speed
-      if (retryFunc(&HumidOSH::getFanSpeed))
-      {
-        fanSpeedOK_ = true;
-        newFanSpeedReadingPrint_ = true;
-      }
-      else
-      {
-        fanSpeedOK_ = false;
-        newFanSpeedReadingPrint_ = false;
-      }
+  // Keep showing the last reading until the fan controller has failed a few times in a row.
+  channel_->fanSpeedOK = !channel_->fanRetry.isFailing() && !hasFanFault();
+  channel_->newFanSpeedReadingPrint = false;
+}
 
-      humidityTriggered_ = false;
+// Period (ms) between each new RH reading.
+uint16_t HumidOSH::getHumidityPeriod()
+{
+#ifdef HUMIDOSH_SIMULATION
+  return ChamberPlant::MEASUREMENT_PERIOD;
+#else
+  return channel_->humiditySensor.getMeasurementPeriod();
+#endif // HUMIDOSH_SIMULATION
+}
 
-      // Send data to computer, if necessary. Note that the sending frequency is the same as PERIOD_DAQ.
-      if (sendData_)
-      {
-        communicator_->sendData(humidityOK_, humidity_, temperature_, fanSpeedOK_, fanSpeed_, humidityControlActive_, humidityTarget_, fanSpeedControlActive_, fanSpeedTarget_);
-      }
-    }
-    else if (!humidityTriggered_)
-    {// Trigger the SHT3x sensor to perform a measurement.
-      retryFunc(&HumidOSH::triggerHumidity) ? humidityTriggeredOK_ = true : humidityTriggeredOK_ = false;
-      // Set triggered flag to true even if the above fails after retries, otherwise the program will be retrying again in the next loop.
-      humidityTriggered_ = true;
-    }
-  }
+// Period (ms) between each run of the humidity control of channel_.
+uint16_t HumidOSH::getHumidityControlPeriod()
+{
+#ifdef ADAPTIVE_DAQ
+  return channel_->DAQFast ? PERIOD_HUMIDITY_CONTROL_FAST : PERIOD_HUMIDITY_CONTROL_SLOW;
+#else
+  return PERIOD_HUMIDITY_CONTROL;
+#endif // ADAPTIVE_DAQ
+}
+
+// Fan speed readings have to keep up when data are sent more often than PERIOD_DAQ.
+// With FAN_ALERT, faults come from ALERT, so the readings are only telemetry and the data sent repeat the last one.
+uint16_t HumidOSH::getFanSpeedPeriod(const ChamberChannel *channel)
+{
+#ifdef FAN_ALERT
+  return PERIOD_DAQ_FAN_ALERT;
+#else
+#ifdef ADAPTIVE_DAQ
+  uint16_t period = channel->DAQFast ? PERIOD_DAQ_FAST : PERIOD_DAQ_SLOW;
+#else
+  uint16_t period = PERIOD_DAQ;
+#endif // ADAPTIVE_DAQ
+  return sendData_ && sendPeriod_ < period ? sendPeriod_ : period;
+#endif // FAN_ALERT
+}
 
-  // Perform controls on relative humidity, if necessary.
-  if (humidityControlActive_)
+#ifdef ADAPTIVE_DAQ
+// Called with every filtered RH handed to the control of channel_. The chamber is in a transient while its RH is away from
+// the target or moving, or while the autotune or the ramp of a program runs; it goes to the fast rate right away, and back
+// to the slow rate only after DAQ_STEADY_TIME without one. The PID takes the time between its runs as it comes.
+void HumidOSH::updateDAQRate()
+{
+  unsigned long now = millis();
+  float humidity = realToDouble(channel_->humidity);
+
+  if (!channel_->humiditySlopeValid)
+  {
+    channel_->humiditySlopeValid = true;
+    channel_->humiditySlopeStart = humidity;
+    channel_->humiditySlopeTime = now;
+  }
+  else if (now - channel_->humiditySlopeTime >= PERIOD_DAQ_SLOPE)
   {
-    if (humidityOK_)
-    { // No errors
-      if (newHumidityReadingControl_)
-      { // Got a new reading
-        newHumidityReadingControl_ = false;
+    channel_->humiditySlopeHigh = fabs(humidity - channel_->humiditySlopeStart) * 60000 / (now - channel_->humiditySlopeTime) > DAQ_FAST_SLOPE;
+    channel_->humiditySlopeStart = humidity;
+    channel_->humiditySlopeTime = now;
+  }
 
-        
-        if (humidityErrorHandlingActive_)
-        { // Just recovered from an error but don't start control just yet; instead restart the control PID
-          // and assign the current reading as the "last" value that will be used in the next control loop.
-          humidityErrorHandlingActive_ = false;
-          
-          /* REMOVED: RH error handling
-           Ideally, whenever the RH sensor has an error, the PID algorithm should reset so that the RH control doesn't
-           abruptly start from the previous state before error occured. However, the system currently has a bug where
-           scrolling thru LCD screen will cause an error, thus restarting control. Since the user should NOT expect
-           a control restart just by scrolling thru menu, this error handling is disabled for now. This means the system
-           will return to previous known state before error happened. Note that this can result in large PID integral term if
-           the time delay caused by the error is large enough.
-          humidityPID_.Reset();
-          */
-          humidityPID_.setLastInput(humidity_);
-          humidityPID_.setLastTime(millis());
-        }
-        else
-        {
-          // Everything is fine and dandy; proceed to perform control on RH.
-          humidityPID_.Compute(millis());
+  bool transient = channel_->humiditySlopeHigh || isAutotuneChannel() || (isProgramChannel() && !program_.isHolding());
 
-          if (humidityControlOutput_ >= pumpDutyCycleMin_)
-          { // Humidifying
-            toggleValveWet(true);
-            toggleValveDry(false);
+  if (channel_->humidityControlActive && fabs(humidity - realToDouble(channel_->humidityTarget)) > DAQ_FAST_ERROR)
+  {
+    transient = true;
+  }
 
-            // If duty cycle is at least the upper limit, then run pump at max duty cycle
-            if (humidityControlOutput_ >= pumpDutyCycleMax_)
-            {
-              setPumpDutyCycle(255);
-            }
-            else
-            {
-              setPumpDutyCycle(humidityControlOutput_);
-            }
-          }
-          else if (humidityControlOutput_  < 0 && -humidityControlOutput_ >= pumpDutyCycleMin_)
-          { // Drying
-            toggleValveDry(true);
-            toggleValveWet(false);
+  if (transient)
+  {
+    channel_->DAQSteadyTime = now;
+  }
 
-            // If duty cycle is at least the upper limit, then run pump at max duty cycle
-            if (-humidityControlOutput_ >= pumpDutyCycleMax_)
-            {
-              setPumpDutyCycle(255);
-            }
-            else
-            {
-              setPumpDutyCycle(-humidityControlOutput_);
-            }
-          }
-          else
-          { // The pump duty cycle is within the minimum range; turn the pump and valves off.
-            setPumpDutyCycle(0);
-            toggleValveDry(false);
-            toggleValveWet(false);
-          }
-        }
-      }
-    }
-    else if (!humidityErrorHandlingActive_)
-    { // Encountered an error while trying to get a measurement, and haven't taken steps to handle it.
-      humidityErrorHandlingActive_ = true;
+  bool fast = transient || now - channel_->DAQSteadyTime < DAQ_STEADY_TIME;
 
-      // Turn off all the actuators for humidity control until the problem is resolved.
-      togglePump(false);
-      toggleValveDry(false);
-      toggleValveWet(false);
-    }
+  if (fast != channel_->DAQFast)
+  { // requestHumidityReading() restarts the periodic mode of the sensor at the new rate.
+    channel_->DAQFast = fast;
+    channel_->humidityPeriodicStarted = false;
   }
+}
+#endif // ADAPTIVE_DAQ
 
-  /* TODO
-  // This code block darkens the screen when it is idle after a while.
-  // Commented out because some Sparkfun LCD screens use an older firmware
-  // that does not have setFastBacklight functionality, thus messing up
-  // the screen.
-  // Turn off the backlight if no buttons were pressed in a while
-  if (backlightOn_)
+// Send the latest readings and setpoints of every chamber to the computer.
+void HumidOSH::sendCurrentData(bool binary)
+{
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
   {
-    if (millis() - screenActiveTimerStart_ >= SCREEN_ACTIVE_DURATION)
+    ChamberChannel *channel = &channels_[i];
+
+    if (binary)
     {
-      backlightOn_ = false;
-      screen_.setFastBacklight(SCREEN_BACKGROUND_IDLE);
-      screen_.setBacklight(SCREEN_BACKGROUND_IDLE);
-      changeScreenPage(screenPage_);  // Refresh the screen
+      communicator_->sendDataBinary(i, channel->humidityOK, channel->humiditySensor.getRHSignal(), channel->humiditySensor.getTemperatureSignal(), realToLong(channel->humidity * 100),
+                                    channel->fanSpeedOK, channel->fan.getTachoCount(),
+                                    channel->humidityControlActive, realToLong(channel->humidityTarget * 100), channel->fanSpeedControlActive, channel->fanSpeedTarget,
+                                    getProgramStep(i));
+    }
+    else
+    {
+      communicator_->sendData(HUMIDOSH_CHANNEL_COUNT > 1 ? i : SerialCommunication::SERIAL_SEND_CHANNEL_NONE,
+                              channel->humidityOK, realToDouble(channel->humidity), realToDouble(channel->temperature), channel->fanSpeedOK, channel->fanSpeed, channel->humidityControlActive, realToDouble(channel->humidityTarget), channel->fanSpeedControlActive, channel->fanSpeedTarget);
     }
   }
-  */
-
-  // Update the screen as necessary.
-  updateScreen();
 }
 
 void HumidOSH::handleKeyPress(KeypadEvent key)
@@ -362,13 +1529,24 @@ void HumidOSH::handleKeyPress(KeypadEvent key)
     case 'h':
       // Starting/stopping humidity control.
       // Only turn on/off control when screen is displaying readings (i.e. not in settings mode)
-      handleButtonControl(true, humidityControlActive_, humidityControlRecentlyStopped_);
+      handleButtonControl(true, channel_->humidityControlActive, humidityControlRecentlyStopped_);
       break;
     case 'f':
       // Starting/stopping fan control.
       // Only turn on/off control when screen is displaying readings (i.e. not in settings mode)
-      handleButtonControl(false, fanSpeedControlActive_, fanSpeedControlRecentlyStopped_);
+      handleButtonControl(false, channel_->fanSpeedControlActive, fanSpeedControlRecentlyStopped_);
+      break;
+#if HUMIDOSH_CHANNEL_COUNT > 1
+    case 'x':
+      // Show the next chamber
+      if (keypad_->getState() == PRESSED)
+      {
+        displayedChannel_ = (displayedChannel_ + 1) % HUMIDOSH_CHANNEL_COUNT;
+        selectChannel(displayedChannel_);
+        changeScreenPage(SCREEN_PAGE_READINGS);
+      }
       break;
+#endif
     }
     break;
   case SCREEN_PAGE_HUMIDITYADJ:
@@ -379,8 +1557,11 @@ void HumidOSH::handleKeyPress(KeypadEvent key)
       case 's':
         if (inputCharCount_ > 0)
         { // Only analyze/save the data if there were entered characters, otherwise don't change the setpoint.
-          if (saveInput(true, humidityTarget_, humidityMin_, humidityMax_))
+          double newTarget = realToDouble(channel_->humidityTarget);
+
+          if (saveInput(true, newTarget, humidityMin_, humidityMax_))
           { // User input is valid.
+            channel_->humidityTarget = newTarget;
             // Begin adjusting target for fan speed.
             resetInputVars();
             changeScreenPage(SCREEN_PAGE_FANSPEEDADJ);
@@ -417,7 +1598,7 @@ void HumidOSH::handleKeyPress(KeypadEvent key)
       case 's':
         if (inputCharCount_ > 0)
         { // Only analyze/save the data if there were entered characters, otherwise don't change the setpoint.
-          if (saveInput(false, fanSpeedTarget_, fanSpeedMin_, fanSpeedMax_))
+          if (saveInput(false, channel_->fanSpeedTarget, fanSpeedMin_, fanSpeedMax_))
           { // User input is valid.
             // Begin adjusting target for fan speed.
             resetInputVars();
@@ -453,18 +1634,13 @@ void HumidOSH::handleKeyPress(KeypadEvent key)
       switch (key)
       {
       case 's':
-        // Back to readings screen.
+        // Proceed to autotune screen.
         resetInputVars();
-        changeScreenPage(SCREEN_PAGE_READINGS);
+        changeScreenPage(SCREEN_PAGE_AUTOTUNE);
         break;
       case '1':
-        // Move to screen to calibrate point 1.
-        calibratingPoint1 = true;
-        changeScreenPage(SCREEN_PAGE_CAL_POINT);
-        break;
-      case '2':
-        // Move to screen to calibrate point 2.
-        calibratingPoint1 = false;
+        // Move to screen to calibrate a point: the saved one close to the current raw RH, if any, otherwise a new one.
+        calibrationPoint_ = channel_->humiditySensor.findCalibrationPoint(realToDouble(channel_->humiditySensor.getRHRaw()));
         changeScreenPage(SCREEN_PAGE_CAL_POINT);
         break;
       case '3':
@@ -482,7 +1658,7 @@ void HumidOSH::handleKeyPress(KeypadEvent key)
       case 's':
         if (inputCharCount_ > 0)
         { // Only save calibration data if there were entered characters.
-          humiditySensor_.saveAndApplyCalibration(calibratingPoint1, inputValue_, humiditySensor_.getRHRaw());
+          channel_->humiditySensor.saveAndApplyCalibration(inputValue_, realToDouble(channel_->humiditySensor.getRHRaw()));
           resetInputVars();
           changeScreenPage(SCREEN_PAGE_CAL);
         }
@@ -509,11 +1685,35 @@ void HumidOSH::handleKeyPress(KeypadEvent key)
       }
     }
     break;
+  case SCREEN_PAGE_AUTOTUNE:
+    if (keypad_->getState() == PRESSED)
+    {
+      switch (key)
+      {
+      case 's':
+        // Back to readings screen.
+        changeScreenPage(SCREEN_PAGE_READINGS);
+        break;
+      case '5':
+        // Start or stop the autotune of the chamber on display.
+        if (isAutotuneChannel())
+        {
+          cancelAutotune();
+        }
+        else
+        {
+          beginAutotune(displayedChannel_);
+        }
+        changeScreenPage(SCREEN_PAGE_AUTOTUNE);
+        break;
+      }
+    }
+    break;
   case SCREEN_PAGE_CAL_RESET:
     // Only reset calibration data if user confirms by pressing key '5'.
     if (keypad_->getState() == PRESSED && key == '5')
     {
-      humiditySensor_.resetCalibration();
+      channel_->humiditySensor.resetCalibration();
       changeScreenPage(SCREEN_PAGE_CAL);
     }
     break;
@@ -523,109 +1723,360 @@ void HumidOSH::handleKeyPress(KeypadEvent key)
 // Send data and setpoints to computer every time data is acquired.
 void HumidOSH::startSendData()
 {
+  if (!sendData_)
+  {
+    scheduler_.trigger(sendTaskID_, sendPeriod_);
+  }
+
+  sendData_ = true;
+  sendDataBinary_ = false;
+}
+
+// Same as startSendData(), but the data are sent as binary frames.
+void HumidOSH::startSendDataBinary()
+{
+  if (!sendData_)
+  {
+    scheduler_.trigger(sendTaskID_, sendPeriod_);
+  }
+
   sendData_ = true;
+  sendDataBinary_ = true;
+}
+
+// Send the binary frame of every chamber once, for a computer that polls (e.g. many controllers on a multi-drop bus).
+// Fails while the log is being sent.
+bool HumidOSH::sendLatestData()
+{
+  if (logDumping_)
+  {
+    return false;
+  }
+
+  sendCurrentData(true);
+  return true;
 }
 
 // Stop sending data to computer.
 void HumidOSH::stopSendData()
 {
   sendData_ = false;
+  scheduler_.cancel(sendTaskID_);
+}
+
+// Change the period between each data sent to the computer. Returns false if the period is out of range.
+bool HumidOSH::setSendPeriod(uint16_t periodMs)
+{
+  if (periodMs < PERIOD_SEND_MIN || periodMs > PERIOD_SEND_MAX)
+  {
+    return false;
+  }
+
+  sendPeriod_ = periodMs;
+  scheduler_.setPeriod(sendTaskID_, sendPeriod_);
+  Config.setSendPeriod(sendPeriod_);
+  return true;
+}
+
+// Set the RH target and start/stop the humidity control from the computer. Returns false if the target is out of range.
+bool HumidOSH::setHumidityControl(double targetPercent, bool enable)
+{
+  selectChannel(remoteChannel_);
+
+  if (targetPercent < humidityMin_ || targetPercent > humidityMax_)
+  {
+    return false;
+  }
+
+  channel_->humidityTarget = targetPercent;
+
+  if (enable != channel_->humidityControlActive)
+  {
+    toggleHumidityControl(enable);
+  }
+
+  return true;
+}
+
+// Set the fan speed target and start/stop the fan speed control from the computer.
+// Returns false if the target is out of range or the fan controller didn't respond.
+bool HumidOSH::setFanSpeedControl(double targetRPM, bool enable)
+{
+  selectChannel(remoteChannel_);
+
+  if (targetRPM < fanSpeedMin_ || targetRPM > fanSpeedMax_)
+  {
+    return false;
+  }
+
+  channel_->fanSpeedTarget = targetRPM;
+
+  if (enable != channel_->fanSpeedControlActive)
+  {
+    return retryFunc(&channel_->fanRetry, &HumidOSH::toggleFanSpeedControl, enable);
+  }
+  else
+  {
+    return retryFunc(&channel_->fanRetry, &HumidOSH::updateFanSpeedTarget, channel_->fanSpeedTarget);
+  }
+}
+
+// Change the humidity PID parameters from the computer. Not saved: after a reset, the chamber goes back to the gains of
+// its last autotune (see loadHumidityPIDTunings()), or to the defaults if it was never autotuned.
+bool HumidOSH::setHumidityPIDTunings(double kp, double ki, double kd)
+{
+  if (kp < 0 || ki < 0 || kd < 0)
+  {
+    return false;
+  }
+
+  selectChannel(remoteChannel_);
+
+  if (channel_->humidityControlMode == HUMIDITY_CONTROL_SCHEDULED)
+  { // Used once the chamber is back to HUMIDITY_CONTROL_PID
+    channel_->pidKp = kp;
+    channel_->pidKi = ki;
+    channel_->pidKd = kd;
+  }
+  else
+  {
+    channel_->humidityPID.SetTunings(kp, ki, kd);
+  }
+
+  return true;
+}
+
+// Change the humidity control mode (see HUMIDITY_CONTROL_MODE) from the computer.
+bool HumidOSH::setHumidityControlMode(uint8_t mode)
+{
+  if (mode > HUMIDITY_CONTROL_SCHEDULED)
+  {
+    return false;
+  }
+
+  selectChannel(remoteChannel_);
+
+  if (isAutotuneChannel())
+  { // The autotune is for the gains of HUMIDITY_CONTROL_PID
+    return false;
+  }
+
+  changeHumidityControlMode((HUMIDITY_CONTROL_MODE) mode);
+  return true;
+}
+
+// Start (or cancel) the autotune of the humidity PID from the computer.
+bool HumidOSH::setHumidityAutotune(bool enable)
+{
+  if (enable)
+  {
+    return beginAutotune(remoteChannel_);
+  }
+
+  selectChannel(remoteChannel_);
+
+  if (!isAutotuneChannel())
+  {
+    return false;
+  }
+
+  cancelAutotune();
+  return true;
+}
+
+// Replace the setpoint program with the one uploaded by the computer: the step count, then each step as laid out in
+// SetpointProgram_Step. Returns false (and keeps the old program) if it is malformed, a target is out of range, or a
+// program is running. The new program is saved (see ConfigStore).
+bool HumidOSH::setProgram(const uint8_t *payload, uint8_t length)
+{
+  if (payload == NULL || length == 0 || payload[0] > SETPOINTPROGRAM_STEP_MAX || length != 1 + payload[0] * sizeof(SetpointProgram_Step))
+  {
+    return false;
+  }
+
+  if (programChannel_ != PROGRAM_CHANNEL_NONE)
+  { // The running program works from the table in ConfigStore.
+    return false;
+  }
+
+  // The AVR is little-endian and doesn't pad structs, so the steps are copied as they are.
+  SetpointProgram_Table table;
+  memset(&table, 0, sizeof(table));
+  table.stepCount = payload[0];
+  memcpy(table.steps, payload + 1, length - 1);
+
+  for (uint8_t i = 0; i < table.stepCount; i++)
+  {
+    const SetpointProgram_Step *step = &table.steps[i];
+
+    if (step->humidityTarget < humidityMin_ * 100 || step->humidityTarget > humidityMax_ * 100)
+    {
+      return false;
+    }
+
+    if (step->fanSpeedTarget != 0 && (step->fanSpeedTarget < fanSpeedMin_ || step->fanSpeedTarget > fanSpeedMax_))
+    {
+      return false;
+    }
+  }
+
+  Config.setProgram(table);
+  return true;
 }
 
-bool HumidOSH::retryFunc(bool(HumidOSH::* func)())
+// Start (or stop) the setpoint program on the chamber adjusted by the computer. It starts from the current RH target,
+// and turns the humidity control on if it isn't already. Only one chamber can run the program at a time.
+bool HumidOSH::setProgramRun(bool enable)
 {
-  uint8_t tries = 0;
+  selectChannel(remoteChannel_);
 
-  while (tries < RETRIES_MAX)
+  if (!enable)
   {
-    if ((this->*func)()) { return true; }
-    tries++;
+    if (!isProgramChannel())
+    {
+      return false;
+    }
+
+    cancelProgram();
+    return true;
   }
-  return false;
-}
 
-bool HumidOSH::retryFunc(bool (HumidOSH::*func)(bool), bool param)
-{
-  uint8_t tries = 0;
+  if (programChannel_ != PROGRAM_CHANNEL_NONE || isAutotuneChannel())
+  {
+    return false;
+  }
+
+  if (!program_.start(Config.getProgram(), millis(), realToDouble(channel_->humidityTarget)))
+  { // No program uploaded
+    return false;
+  }
 
-  while (tries < RETRIES_MAX)
+  programChannel_ = remoteChannel_;
+
+  if (!channel_->humidityControlActive)
   {
-    if ((this->*func)(param)) { return true; }
-    tries++;
+    toggleHumidityControl(true);
   }
-  return false;
+
+  applyProgramStep();
+  return true;
 }
 
-bool HumidOSH::retryFunc(bool(HumidOSH::* func)(char), char param)
+// Choose the chamber that the computer adjusts with the next commands. Returns false if there is no such chamber.
+bool HumidOSH::setRemoteChannel(uint8_t channelIndex)
 {
-  uint8_t tries = 0;
-
-  while (tries < RETRIES_MAX)
+  if (channelIndex >= HUMIDOSH_CHANNEL_COUNT)
   {
-    if ((this->*func)(param)) { return true; }
-    tries++;
+    return false;
   }
-  return false;
+
+  remoteChannel_ = channelIndex;
+  return true;
 }
 
-bool HumidOSH::retryFunc(bool(HumidOSH::* func)(char[]), char param[])
+// Send the step response metrics of every chamber to the computer.
+void HumidOSH::sendStepResponse()
 {
-  uint8_t tries = 0;
+  unsigned long now = millis();
 
-  while (tries < RETRIES_MAX)
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
   {
-    if ((this->*func)(param)) { return true; }
-    tries++;
+    StepResponse *stepResponse = &channels_[i].stepResponse;
+    communicator_->sendStepResponse(i, stepResponse->isActive(), stepResponse->isSettled(), stepResponse->getElapsedTime(now),
+                                    stepResponse->getSettlingTime(), stepResponse->getOvershoot());
   }
-  return false;
 }
 
-bool HumidOSH::retryFunc(bool (HumidOSH::*func)(uint8_t), uint8_t param)
+// Send the run time statistics of every task to the computer and start counting again.
+void HumidOSH::sendTaskStats()
 {
-  uint8_t tries = 0;
+  Scheduler_TaskStats stats;
 
-  while (tries < RETRIES_MAX)
+  for (uint8_t taskID = 0; taskID < scheduler_.getTaskCount(); taskID++)
   {
-    if ((this->*func)(param)) { return true; }
-    tries++;
+    scheduler_.getTaskStats(taskID, &stats);
+    communicator_->sendTaskStats(taskID, stats);
   }
-  return false;
+
+  scheduler_.resetTaskStats();
 }
 
-bool HumidOSH::retryFunc(bool (HumidOSH::*func)(uint16_t), uint16_t param)
+// Send the failure statistics of the devices of every chamber, then reset them.
+void HumidOSH::sendDeviceStats()
 {
-  uint8_t tries = 0;
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  {
+    communicator_->sendDeviceStats(i, SerialCommunication::SERIAL_SEND_DEVICE_RH_SENSOR, channels_[i].humidityRetry.getStats());
+    communicator_->sendDeviceStats(i, SerialCommunication::SERIAL_SEND_DEVICE_FAN, channels_[i].fanRetry.getStats());
+    channels_[i].humidityRetry.resetStats();
+    channels_[i].fanRetry.resetStats();
+  }
+}
 
-  while (tries < RETRIES_MAX)
+// Send the telemetry log to the computer. It goes out in the background, after the response to the command.
+bool HumidOSH::startLogDump()
+{
+  if (logDumping_)
   {
-    if ((this->*func)(param)) { return true; }
-    tries++;
+    return false;
   }
-  return false;
+
+  logDumpCount_ = telemetryLog_.beginRead();
+  logDumpIndex_ = 0;
+  logDumpHeaderSent_ = false;
+  logDumping_ = true;
+  scheduler_.trigger(logWriteTaskID_, PERIOD_TASK_LOG_DUMP);
+  return true;
 }
 
-bool HumidOSH::retryFunc(bool (HumidOSH::*func)(double), double param)
+// Seconds between each logged sample; 0 stops the log. Starts a new session.
+void HumidOSH::setLogDecimation(uint16_t decimation)
 {
-  uint8_t tries = 0;
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  { // The last samples of the old session
+    telemetryLog_.flush(&channels_[i].logEncoder, i);
+  }
 
-  while (tries < RETRIES_MAX)
+  telemetryLog_.setDecimation(decimation);
+  restartLog();
+  scheduler_.trigger(logWriteTaskID_, 0);
+}
+
+bool HumidOSH::clearLog()
+{
+  if (logDumping_)
   {
-    if ((this->*func)(param)) { return true; }
-    tries++;
+    return false;
   }
-  return false;
+
+  telemetryLog_.clear();
+  restartLog();
+  scheduler_.trigger(logWriteTaskID_, 0);
+  return true;
 }
 
-bool HumidOSH::retryFunc(bool(HumidOSH::* func)(double, uint8_t), double paramDouble, uint8_t paramByte)
+// Same status bits as the binary data frame
+uint8_t HumidOSH::getLogStatus(ChamberChannel *channel)
 {
-  uint8_t tries = 0;
+  uint8_t status = 0;
+
+  if (channel->humidityOK)             status |= SerialCommunication::SERIAL_SEND_BINARY_STATUS_HUMIDITYOK;
+  if (channel->fanSpeedOK)             status |= SerialCommunication::SERIAL_SEND_BINARY_STATUS_FANSPEEDOK;
+  if (channel->humidityControlActive)  status |= SerialCommunication::SERIAL_SEND_BINARY_STATUS_HUMIDITYCONTROLACTIVE;
+  if (channel->fanSpeedControlActive)  status |= SerialCommunication::SERIAL_SEND_BINARY_STATUS_FANSPEEDCONTROLACTIVE;
+
+  return status;
+}
 
-  while (tries < RETRIES_MAX)
+// Start a new session: the next sample of every chamber comes after a TARGETS record, one decimation from now.
+void HumidOSH::restartLog()
+{
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
   {
-    if ((this->*func)(paramDouble, paramByte)) { return true; }
-    tries++;
+    telemetryLog_.resetEncoder(&channels_[i].logEncoder);
   }
-  return false;
+
+  logSecondsCount_ = 0;
 }
 
 // Change the page that should be displayed on the screen.
@@ -640,6 +2091,8 @@ void HumidOSH::changeScreenPage(SCREEN_PAGE newScreenPage)
 // Update the currently displayed screen page as necessary.
 void HumidOSH::updateScreen()
 {
+  INSTRUMENT_SCOPE(INSTR_SECTION_UPDATESCREEN);
+
   switch (screenPage_)
   {
   case SCREEN_PAGE_READINGS:
@@ -647,20 +2100,11 @@ void HumidOSH::updateScreen()
     if (screenPageChanged_)
     {
       screenPageChanged_ = false;
-      resetScreen();
-      screen_.setCursor(6, 0);
-      screen_.print("Readings");
-    #ifdef DISPLAY_TEMPERATURE
-      screen_.setCursor(7, ROW_READING_TEMPERATURE);
-      screen_.print("T:        C");
-    #else
-      screen_.setCursor(0, 1);
-      screen_.print("--------------------");
-    #endif // DISPLAY_TEMPERATURE
-      screen_.setCursor(6, ROW_READING_HUMIDITY);
-      screen_.print("RH:        %");
-      screen_.setCursor(5, ROW_READING_FANSPEED);
-      screen_.print("Fan:        RPM");
+      drawScreenPage();
+    #if HUMIDOSH_CHANNEL_COUNT > 1
+      screen_.setCursor(18, 0);
+      screen_.print(displayedChannel_ + 1);
+    #endif
 
       /* Alternative display
       screen_.print("Relative humidity(%)");
@@ -668,36 +2112,12 @@ void HumidOSH::updateScreen()
       screen_.print("Fan speed (RPM)     ");
       screen_.print("Set:10000 Read:10000");*/
 
-      // Print out the sensor readings
-      if (humidityOK_)
-      {
-        printReadingRightAligned(humidity_, INPUT_HUMIDITY_DECIMALS, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_HUMIDITY);
-
-      #ifdef DISPLAY_TEMPERATURE
-        printReadingRightAligned(temperature_, TEMPERATURE_DECIMALS, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_TEMPERATURE);
-      #endif // DISPLAY_TEMPERATURE
-      }
-      else
-      {
-        printTextRightAligned(PRINT_ERROR, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_HUMIDITY);
-      }
-
-      // For fan speed, the tachometer only gives out correct readings when control is active.
-      if (fanSpeedControlActive_)
-      {
-        if (fanSpeedOK_)
-        {
-          printReadingRightAligned(fanSpeed_, INPUT_FANSPEED_DECIMALS, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_FANSPEED);
-        }
-        else
-        {
-          printTextRightAligned(PRINT_ERROR, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_FANSPEED);
-        }
-      }
-      else
-      {
-        printNoReading();
-      }
+      // Nothing is on the page yet, so every field is drawn
+      humidityFieldShown_ = SCREEN_FIELD_UNKNOWN;
+      fanSpeedFieldShown_ = SCREEN_FIELD_UNKNOWN;
+      humidityIndicatorShown_ = SCREEN_FIELD_UNKNOWN;
+      fanSpeedIndicatorShown_ = SCREEN_FIELD_UNKNOWN;
+      printReadingFields();
 
       // Indicate if control is running
       controlActiveIndicatorLeft_ = true;
@@ -706,50 +2126,16 @@ void HumidOSH::updateScreen()
     }
     else
     {
-      if (humidityOK_)
-      {
-        if (newHumidityReadingPrint_)
-        {
-          printReadingRightAligned(humidity_, INPUT_HUMIDITY_DECIMALS, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_HUMIDITY);
-          newHumidityReadingPrint_ = false;
-      
-      #ifdef DISPLAY_TEMPERATURE
-        printReadingRightAligned(temperature_, TEMPERATURE_DECIMALS, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_TEMPERATURE);
-      #endif // DISPLAY_TEMPERATURE
-        }
-      }
-      else
-      {
-        printTextRightAligned(PRINT_ERROR, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_HUMIDITY);
-      }
-
-      // For fan speed, the tachometer only gives out correct readings when control is active.
-      if (fanSpeedControlActive_)
-      {
-        if (fanSpeedOK_)
-        {
-          if (newFanSpeedReadingPrint_)
-          {
-            printReadingRightAligned(fanSpeed_, INPUT_FANSPEED_DECIMALS, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_FANSPEED);
-            newFanSpeedReadingPrint_ = false;
-          }
-        }
-        else
-        {
-          printTextRightAligned(PRINT_ERROR, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_FANSPEED);
-        }
-      }
-      else
-      {
-        printNoReading();
-      }
+      printReadingFields();
 
       if (millis() - controlIndicatorTimerStart_ >= PERIOD_SCREEN_CONTROLINDICATOR)
       {
         controlIndicatorTimerStart_ = millis();
         controlActiveIndicatorLeft_ ? controlActiveIndicatorLeft_ = false : controlActiveIndicatorLeft_ = true;
-        printControlIndicators(controlActiveIndicatorLeft_);
       }
+
+      // Only the rows whose indicator changed are redrawn
+      printControlIndicators(controlActiveIndicatorLeft_);
     }
     break;
   case SCREEN_PAGE_HUMIDITYADJ:
@@ -757,18 +2143,10 @@ void HumidOSH::updateScreen()
     if (screenPageChanged_)
     {
       screenPageChanged_ = false;
-      resetScreen();
-      screen_.setCursor(0, 0);
-      screen_.print("Relative humidity(%)");
-      screen_.setCursor(0, 1);
-      screen_.print("--------------------");
-      screen_.setCursor(0, 2);
-      screen_.print("Old target:");
-      screen_.setCursor(0, 3);
-      screen_.print("New target:");
+      drawScreenPage();
 
       // Display current setpoint.
-      printValueRightAligned(humidityTarget_, INPUT_HUMIDITY_DECIMALS, MAX_COLUMNS - 1, 2);
+      printValueRightAligned(realToDouble(channel_->humidityTarget), INPUT_HUMIDITY_DECIMALS, MAX_COLUMNS - 1, 2);
 
       // Prompt user for input.
       screen_.setCursor(MAX_COLUMNS - 1, 3);
@@ -780,18 +2158,10 @@ void HumidOSH::updateScreen()
     if (screenPageChanged_)
     {
       screenPageChanged_ = false;
-      resetScreen();
-      screen_.setCursor(2, 0);
-      screen_.print("Fan speed (RPM)");
-      screen_.setCursor(0, 1);
-      screen_.print("--------------------");
-      screen_.setCursor(0, 2);
-      screen_.print("Old target:");
-      screen_.setCursor(0, 3);
-      screen_.print("New target:");
+      drawScreenPage();
 
       // Display current setpoint.
-      printValueRightAligned(fanSpeedTarget_, INPUT_FANSPEED_DECIMALS, MAX_COLUMNS - 1, 2);
+      printValueRightAligned(channel_->fanSpeedTarget, INPUT_FANSPEED_DECIMALS, MAX_COLUMNS - 1, 2);
 
       // Prompt user for input.
       screen_.setCursor(MAX_COLUMNS - 1, 3);
@@ -799,19 +2169,15 @@ void HumidOSH::updateScreen()
     }
     break;
   case SCREEN_PAGE_CAL:
-    // Screen displaying options for relative humidity two-point calibration.
+    // Screen displaying options for relative humidity multi-point calibration.
     if (screenPageChanged_)
     {
       screenPageChanged_ = false;
-      resetScreen();
-      screen_.setCursor(0, 0);
-      screen_.print("---RH calibration---");
-      screen_.setCursor(0, 1);
-      screen_.print("Press 1 for point 1");
-      screen_.setCursor(0, 2);
-      screen_.print("Press 2 for point 2");
-      screen_.setCursor(0, 3);
-      screen_.print("Press 3 to reset all");
+      drawScreenPage();
+      screen_.setCursor(MAX_COLUMNS - 3, 2);
+      screen_.print(channel_->humiditySensor.getCalibrationPointCount());
+      screen_.print('/');
+      screen_.print(CONFIGSTORE_CAL_POINT_MAX);
     }
     break;
   case SCREEN_PAGE_CAL_POINT:
@@ -819,43 +2185,29 @@ void HumidOSH::updateScreen()
     if (screenPageChanged_)
     {
       screenPageChanged_ = false;
-      resetScreen();
-      screen_.setCursor(0, 0);
-      screen_.print("------Point  -------");
+      drawScreenPage();
       screen_.setCursor(12, 0);
-      if (calibratingPoint1)
-      {
-        screen_.print('1');
-      }
-      else
-      {
-        screen_.print('2');
-      }
-      screen_.setCursor(0, 1);
-      screen_.print("raw:      ref.:");
-      screen_.setCursor(3, 2);
-      screen_.print("New raw RH:");
-      screen_.setCursor(2, 3);
-      screen_.print("New ref. RH:");
+      screen_.print(calibrationPoint_ + 1);
 
       // Print out stored calibration data.
-      float storedRHRef;
-      float storedRHRaw;
-      if (humiditySensor_.getSavedCalibration(calibratingPoint1, &storedRHRef, &storedRHRaw))
+      if (calibrationPoint_ < channel_->humiditySensor.getCalibrationPointCount())
       {
+        float storedRHRef;
+        float storedRHRaw;
+        channel_->humiditySensor.getCalibrationPoint(calibrationPoint_, &storedRHRef, &storedRHRaw);
         printValueRightAligned(storedRHRaw, INPUT_HUMIDITY_DECIMALS, 8, 1);
         printValueRightAligned(storedRHRef, INPUT_HUMIDITY_DECIMALS, MAX_COLUMNS - 1, 1);
       }
       else
-      { // No saved calibration data or corrupt data.
+      { // A new point
         screen_.setCursor(5, 1);
-        screen_.print("N/A");
+        screen_.print(F("N/A"));
         screen_.setCursor(16, 1);
-        screen_.print("N/A");
+        screen_.print(F("N/A"));
       }
 
       // Print out current raw humidity reading.
-      printValueRightAligned(humiditySensor_.getRHRaw(), INPUT_HUMIDITY_DECIMALS, MAX_COLUMNS - 1, 2);
+      printValueRightAligned(realToDouble(channel_->humiditySensor.getRHRaw()), INPUT_HUMIDITY_DECIMALS, MAX_COLUMNS - 1, 2);
 
       // Prompt user for input.
       screen_.setCursor(MAX_COLUMNS - 1, 3);
@@ -863,13 +2215,13 @@ void HumidOSH::updateScreen()
     }
     else
     {
-      if (humidityOK_)
+      if (channel_->humidityOK)
       {
-        if (newHumidityReadingPrint_)
+        if (channel_->newHumidityReadingPrint)
         { // Since we are calibrating, print out the RAW reading.
           screen_.noBlink();
-          printReadingRightAligned(humiditySensor_.getRHRaw(), INPUT_HUMIDITY_DECIMALS, MAXCHAR_RHRAW, MAX_COLUMNS - 1, 2);
-          newHumidityReadingPrint_ = false;
+          printReadingRightAligned(realToDouble(channel_->humiditySensor.getRHRaw()), INPUT_HUMIDITY_DECIMALS, MAXCHAR_RHRAW, MAX_COLUMNS - 1, 2);
+          channel_->newHumidityReadingPrint = false;
 
           // Prompt user for input.
           screen_.setCursor(MAX_COLUMNS - 1, 3);
@@ -879,7 +2231,7 @@ void HumidOSH::updateScreen()
       else
       {
         screen_.noBlink();
-        printTextRightAligned(PRINT_ERROR, MAXCHAR_RHRAW, MAX_COLUMNS - 1, 2);
+        printTextRightAligned(FLASH_STRING(PRINT_ERROR), MAXCHAR_RHRAW, MAX_COLUMNS - 1, 2);
 
         // Prompt user for input.
         screen_.setCursor(MAX_COLUMNS - 1, 3);
@@ -892,15 +2244,7 @@ void HumidOSH::updateScreen()
     if (screenPageChanged_)
     {
       screenPageChanged_ = false;
-      resetScreen();
-      screen_.setCursor(1, 0);
-      screen_.print("Reset calibration?");
-      screen_.setCursor(0, 1);
-      screen_.print("This will delete all");
-      screen_.setCursor(1, 2);
-      screen_.print("calibration data!!");
-      screen_.setCursor(0, 3);
-      screen_.print("--Press 5 to reset--");
+      drawScreenPage();
 
       // Start the timer to return to calibration options screen.
       calResetSplashTimerStart_ = millis();
@@ -910,20 +2254,43 @@ void HumidOSH::updateScreen()
       changeScreenPage(SCREEN_PAGE_CAL);
     }
     break;
+  case SCREEN_PAGE_AUTOTUNE:
+    // Screen for starting the autotune of the humidity PID, around the RH target.
+    if (screenPageChanged_)
+    {
+      screenPageChanged_ = false;
+      drawScreenPage();
+      printValueRightAligned(realToDouble(channel_->humidityTarget), INPUT_HUMIDITY_DECIMALS, COL_READING_RIGHTMOST, 1);
+      autotuneCycleShown_ = 0xFF; // Force the status to be printed
+    }
+
+    if (isAutotuneChannel() ? autotune_.getCycleCount() != autotuneCycleShown_ : autotuneCycleShown_ != AUTOTUNE_CYCLE_IDLE)
+    {
+      screen_.setCursor(0, 2);
+      if (isAutotuneChannel())
+      {
+        autotuneCycleShown_ = autotune_.getCycleCount();
+        screen_.print(F("Running, cycle "));
+        screen_.print(autotuneCycleShown_);
+        screen_.print(F("    "));
+        screen_.setCursor(0, 3);
+        screen_.print(F("--Press 5 to stop---"));
+      }
+      else
+      {
+        autotuneCycleShown_ = AUTOTUNE_CYCLE_IDLE;
+        screen_.print(F("Takes a few hours   "));
+        screen_.setCursor(0, 3);
+        screen_.print(F("--Press 5 to start--"));
+      }
+    }
+    break;
   case SCREEN_PAGE_HOLD:
     // Screen prompting user to keep holding the control start/stop button to stop control.
     if (screenPageChanged_)
     {
       screenPageChanged_ = false;
-      resetScreen();
-      screen_.setCursor(0, 0);
-      screen_.print("********************");
-      screen_.setCursor(2, 1);
-      screen_.print("Hold button for");
-      screen_.setCursor(6, 2);
-      screen_.print("second(s)");
-      screen_.setCursor(0, 3);
-      screen_.print("********************");
+      drawScreenPage();
 
       // Print out seconds remaining, rounded towards the lesser integer
       printSecondsRemaining();
@@ -946,7 +2313,7 @@ void HumidOSH::updateScreen()
           else if (holdFanSpeedButton_)
           {
             fanSpeedControlRecentlyStopped_ = true;
-            retryFunc(&HumidOSH::toggleFanSpeedControl, false);
+            retryFunc(&channel_->fanRetry, &HumidOSH::toggleFanSpeedControl, false);
             changeScreenPage(SCREEN_PAGE_READINGS); // return screen to readings screen
           }
         }
@@ -970,25 +2337,13 @@ void HumidOSH::updateScreen()
     if (screenPageChanged_)
     {
       screenPageChanged_ = false;
-      resetScreen();
-      screen_.setCursor(0, 0);
-      screen_.print("********************");
-      screen_.setCursor(2, 1);
-
-      if (screenPage_ == SCREEN_PAGE_MINVAL)
-      {
-        screen_.print("Minimum value is");
-      }
-      else
-      {
-        screen_.print("Maximum value is");
-      }
+      drawScreenPage();
 
       // Print the flasher
       screen_.setCursor(0, 2);
-      screen_.print(ERROR_FLASHER_LEFT);
-      screen_.setCursor(MAX_COLUMNS - strlen(ERROR_FLASHER_RIGHT), 2);
-      screen_.print(ERROR_FLASHER_RIGHT);
+      screen_.print(FLASH_STRING(ERROR_FLASHER_LEFT));
+      screen_.setCursor(MAX_COLUMNS - strlen_P(ERROR_FLASHER_RIGHT), 2);
+      screen_.print(FLASH_STRING(ERROR_FLASHER_RIGHT));
 
       // Print the limit value, center-aligned
       if (errorInputHumidity_)
@@ -1013,9 +2368,6 @@ void HumidOSH::updateScreen()
           printValueLimit(fanSpeedMax_, INPUT_FANSPEED_DECIMALS);
         }
       }
-
-      screen_.setCursor(0, 3);
-      screen_.print("********************");
     }
     else if (millis() - errorInputTimerStart_ >= (errorInputTimerFlashCounter_ + 1) * PERIOD_ERROR_INPUT_FLASH)
     {
@@ -1029,9 +2381,9 @@ void HumidOSH::updateScreen()
 
           // Erase the flasher
           screen_.setCursor(0, 2);
-          screen_.print(ERROR_FLASHER_CLEAR);
-          screen_.setCursor(MAX_COLUMNS - strlen(ERROR_FLASHER_CLEAR), 2);
-          screen_.print(ERROR_FLASHER_CLEAR);
+          screen_.print(FLASH_STRING(ERROR_FLASHER_CLEAR));
+          screen_.setCursor(MAX_COLUMNS - strlen_P(ERROR_FLASHER_CLEAR), 2);
+          screen_.print(FLASH_STRING(ERROR_FLASHER_CLEAR));
           //screen_.setFastBacklight(SCREEN_BACKGROUND_DEFAULT);
         }
         else
@@ -1040,9 +2392,9 @@ void HumidOSH::updateScreen()
 
           // Print the flasher
           screen_.setCursor(0, 2);
-          screen_.print(ERROR_FLASHER_LEFT);
-          screen_.setCursor(MAX_COLUMNS - strlen(ERROR_FLASHER_RIGHT), 2);
-          screen_.print(ERROR_FLASHER_RIGHT);
+          screen_.print(FLASH_STRING(ERROR_FLASHER_LEFT));
+          screen_.setCursor(MAX_COLUMNS - strlen_P(ERROR_FLASHER_RIGHT), 2);
+          screen_.print(FLASH_STRING(ERROR_FLASHER_RIGHT));
           //screen_.setFastBacklight(SCREEN_BACKGROUND_ERROR);
         }
       }
@@ -1070,7 +2422,26 @@ bool HumidOSH::resetScreen()
   return screen_.clear();
 }
 
-bool HumidOSH::clearValueRightAligned(const uint8_t & rightmostColNumber, const uint8_t & rowNumber, const uint8_t & charCount)
+// Clear the screen and draw the static text of the current page. Only the cells that differ
+// from the previous page are sent to the screen on the next flush.
+void HumidOSH::drawScreenPage()
+{
+  resetScreen();
+
+  for (uint8_t i = 0; i < SCREEN_LABEL_COUNT; i++)
+  {
+    ScreenLabel label;
+    memcpy_P(&label, &SCREEN_LABELS[i], sizeof(label));
+
+    if (label.page == screenPage_)
+    {
+      screen_.setCursor(label.col, label.row);
+      screen_.print(FLASH_STRING(label.text));
+    }
+  }
+}
+
+bool HumidOSH::clearValueRightAligned(uint8_t rightmostColNumber, uint8_t rowNumber, uint8_t charCount)
 {
   if (charCount > 0)
   {
@@ -1145,13 +2516,18 @@ bool HumidOSH::printToDisplay(const char stringToPrint[])
   return screen_.print(stringToPrint);
 }
 
+bool HumidOSH::printToDisplay(const __FlashStringHelper *stringToPrint)
+{
+  return screen_.print(stringToPrint);
+}
+
 bool HumidOSH::printToDisplay(double doubleToPrint, uint8_t decimalsToPrint)
 {
   return screen_.print(doubleToPrint, decimalsToPrint);
 }
 
 // Print out values on the screen, right aligned.
-void HumidOSH::printValueRightAligned(const double & value, const uint8_t & decimalsMax, const uint8_t & rightmostColNumber, const uint8_t & rowNumber)
+void HumidOSH::printValueRightAligned(double value, uint8_t decimalsMax, uint8_t rightmostColNumber, uint8_t rowNumber)
 { // First, calculate the number of integers
   uint8_t integerCount = getIntegerCount(value);
   // Move cursor, accounting for integer, decimal point , and decimals.
@@ -1168,50 +2544,92 @@ void HumidOSH::printValueRightAligned(const double & value, const uint8_t & deci
 }
 
 // Print out text on the screen, right aligned.
-void HumidOSH::printValueRightAligned(const char value[], const uint8_t & rightmostColNumber, const uint8_t & rowNumber)
+void HumidOSH::printValueRightAligned(const __FlashStringHelper *value, uint8_t rightmostColNumber, uint8_t rowNumber)
 {
-  screen_.setCursor(rightmostColNumber - strlen(value) + 1, rowNumber);
+  screen_.setCursor(rightmostColNumber - strlen_P(reinterpret_cast<PGM_P>(value)) + 1, rowNumber);
   screen_.print(value);
 }
 
-// Prints symbols to indicate if control is running or not.
-void HumidOSH::printControlIndicators(bool printingLeft)
+// Prints the readings on the readings page. A reading is only printed when it is new, and ERROR or N/A
+// only when the field did not show it already.
+void HumidOSH::printReadingFields()
 {
-  // Print for humidity
-  screen_.setCursor(0, 2);
-  if (humidityControlActive_)
+  if (channel_->humidityOK)
   {
-    if (printingLeft)
-    {
-      screen_.print(CONTROLINDICATOR_RUN_LEFT);
-    }
-    else
+    if (channel_->newHumidityReadingPrint || humidityFieldShown_ != SCREEN_FIELD_VALUE)
     {
-      screen_.print(CONTROLINDICATOR_RUN_RIGHT);
+      printReadingRightAligned(realToDouble(channel_->humidity), INPUT_HUMIDITY_DECIMALS, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_HUMIDITY);
+      channel_->newHumidityReadingPrint = false;
+      humidityFieldShown_ = SCREEN_FIELD_VALUE;
+
+    #ifdef DISPLAY_TEMPERATURE
+      printReadingRightAligned(realToDouble(channel_->temperature), TEMPERATURE_DECIMALS, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_TEMPERATURE);
+    #endif // DISPLAY_TEMPERATURE
     }
   }
-  else
+  else if (humidityFieldShown_ != SCREEN_FIELD_ERROR)
   {
-    screen_.print(CONTROLINDICATOR_IDLE);
+    printTextRightAligned(FLASH_STRING(PRINT_ERROR), MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_HUMIDITY);
+    humidityFieldShown_ = SCREEN_FIELD_ERROR;
   }
 
-  // Print for fan speed
-  screen_.setCursor(0, 3);
-  if (fanSpeedControlActive_)
+  // For fan speed, the tachometer only gives out correct readings when control is active.
+  if (channel_->fanSpeedControlActive)
   {
-    if (printingLeft)
+    if (channel_->fanSpeedOK)
     {
-      screen_.print(CONTROLINDICATOR_RUN_LEFT);
+      if (channel_->newFanSpeedReadingPrint || fanSpeedFieldShown_ != SCREEN_FIELD_VALUE)
+      {
+        printReadingRightAligned(channel_->fanSpeed, INPUT_FANSPEED_DECIMALS, MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_FANSPEED);
+        channel_->newFanSpeedReadingPrint = false;
+        fanSpeedFieldShown_ = SCREEN_FIELD_VALUE;
+      }
     }
-    else
+    else if (fanSpeedFieldShown_ != SCREEN_FIELD_ERROR)
     {
-      screen_.print(CONTROLINDICATOR_RUN_RIGHT);
+      printTextRightAligned(FLASH_STRING(PRINT_ERROR), MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_FANSPEED);
+      fanSpeedFieldShown_ = SCREEN_FIELD_ERROR;
     }
   }
+  else if (fanSpeedFieldShown_ != SCREEN_FIELD_NOREADING)
+  {
+    printNoReading();
+    fanSpeedFieldShown_ = SCREEN_FIELD_NOREADING;
+  }
+}
+
+// Prints symbols to indicate if control is running or not.
+void HumidOSH::printControlIndicators(bool printingLeft)
+{
+  humidityIndicatorShown_ = printControlIndicator(channel_->humidityControlActive, printingLeft, humidityIndicatorShown_, ROW_READING_HUMIDITY);
+  fanSpeedIndicatorShown_ = printControlIndicator(channel_->fanSpeedControlActive, printingLeft, fanSpeedIndicatorShown_, ROW_READING_FANSPEED);
+}
+
+// Prints the indicator of one control at the start of the row, unless it is already shown. Returns what is shown.
+HumidOSH::SCREEN_FIELD HumidOSH::printControlIndicator(bool controlActive, bool printingLeft, SCREEN_FIELD shown, uint8_t row)
+{
+  SCREEN_FIELD indicator = controlActive ? (printingLeft ? SCREEN_FIELD_RUN_LEFT : SCREEN_FIELD_RUN_RIGHT) : SCREEN_FIELD_IDLE;
+
+  if (indicator == shown)
+  {
+    return shown;
+  }
+
+  screen_.setCursor(0, row);
+  if (indicator == SCREEN_FIELD_RUN_LEFT)
+  {
+    screen_.print(FLASH_STRING(CONTROLINDICATOR_RUN_LEFT));
+  }
+  else if (indicator == SCREEN_FIELD_RUN_RIGHT)
+  {
+    screen_.print(FLASH_STRING(CONTROLINDICATOR_RUN_RIGHT));
+  }
   else
   {
-    screen_.print(CONTROLINDICATOR_IDLE);
+    screen_.print(FLASH_STRING(CONTROLINDICATOR_IDLE));
   }
+
+  return indicator;
 }
 
 // Prints out the given reading right-aligned at the given position on screen (rightmostCol and row).
@@ -1238,9 +2656,10 @@ void HumidOSH::printReadingRightAligned(float reading, uint8_t maxDecimals, uint
 
 // Prints out the given reading right-aligned at the given position on screen (rightmostCol and row).
 // Clears out the area (size depends on textCharMaxCount) before printing out the text.
-void HumidOSH::printTextRightAligned(const char text[], uint8_t textCharMaxCount, uint8_t rightmostCol, uint8_t row)
+void HumidOSH::printTextRightAligned(const __FlashStringHelper *text, uint8_t textCharMaxCount, uint8_t rightmostCol, uint8_t row)
 {
-  clearValueRightAligned(rightmostCol - strlen(text), row, textCharMaxCount - strlen(text));
+  uint8_t textCharCount = strlen_P(reinterpret_cast<PGM_P>(text));
+  clearValueRightAligned(rightmostCol - textCharCount, row, textCharMaxCount - textCharCount);
   printValueRightAligned(text, rightmostCol, row);
 }
 
@@ -1248,8 +2667,7 @@ void HumidOSH::printTextRightAligned(const char text[], uint8_t textCharMaxCount
 // Clears out the area before printing out the text.
 void HumidOSH::printNoReading()
 {
-  clearValueRightAligned(COL_READING_RIGHTMOST - strlen(PRINT_NOREADING), ROW_READING_FANSPEED, MAXCHAR_READINGS - strlen(PRINT_NOREADING));
-  printValueRightAligned(PRINT_NOREADING, COL_READING_RIGHTMOST, ROW_READING_FANSPEED);
+  printTextRightAligned(FLASH_STRING(PRINT_NOREADING), MAXCHAR_READINGS, COL_READING_RIGHTMOST, ROW_READING_FANSPEED);
 }
 
 // Print out seconds remaining, rounded towards the lesser integer
@@ -1301,7 +2719,7 @@ void HumidOSH::handleButtonControl(bool humidity, const bool & controlActiveFlag
         }
         else
         {
-          retryFunc(&HumidOSH::toggleFanSpeedControl, true);
+          retryFunc(&channel_->fanRetry, &HumidOSH::toggleFanSpeedControl, true);
         }
       }
       else
@@ -1315,7 +2733,7 @@ void HumidOSH::handleButtonControl(bool humidity, const bool & controlActiveFlag
 }
 
 // Handle number key presses.
-void HumidOSH::handleInputNumber(char inputKey, const uint8_t & charMax, const uint8_t & decimalsMax)
+void HumidOSH::handleInputNumber(char inputKey, uint8_t charMax, uint8_t decimalsMax)
 {
   if (inputCharCount_ + 1 <= charMax)
   { // Still within character limit. Ignore the input if we are already at maximum char limit.
@@ -1344,7 +2762,7 @@ void HumidOSH::handleInputNumber(char inputKey, const uint8_t & charMax, const u
   }
 }
 
-void HumidOSH::handleInputDelete(const uint8_t & charMax)
+void HumidOSH::handleInputDelete(uint8_t charMax)
 {
   if (inputCharCount_ > 0)
   { // Only delete if there are any chars present.
@@ -1398,7 +2816,7 @@ void HumidOSH::handleInputDelete(const uint8_t & charMax)
 }
 
 // Handle the decimal symbol key press
-void HumidOSH::handleInputDot(const uint8_t & charMax, const uint8_t & decimalsMax)
+void HumidOSH::handleInputDot(uint8_t charMax, uint8_t decimalsMax)
 {
   if (decimalsMax > 0 &&            // Only insert the decimal symbol if decimals are allowed
       inputCharCount_ < charMax &&  // Adding a decimal point will not exceed max char limit
@@ -1415,7 +2833,7 @@ void HumidOSH::handleInputDot(const uint8_t & charMax, const uint8_t & decimalsM
 }
 
 // Check user input and display error message if necessary, otherwise save it.
-bool HumidOSH::saveInput(bool humidity, double & targetBuffer, const double & min, const double & max)
+bool HumidOSH::saveInput(bool humidity, double & targetBuffer, double min, double max)
 {
   if (inputValue_ > max)
   { // Warn user if input value exceeds max setting.
@@ -1442,7 +2860,7 @@ bool HumidOSH::saveInput(bool humidity, double & targetBuffer, const double & mi
     // Update tachometer target.
     if (!humidity)
     {
-      retryFunc(&HumidOSH::updateFanSpeedTarget, targetBuffer);
+      retryFunc(&channel_->fanRetry, &HumidOSH::updateFanSpeedTarget, targetBuffer);
     }
     return true;
   }
@@ -1458,10 +2876,20 @@ void HumidOSH::resetInputVars()
   decimalUsed_        = false;
 }
 
-// The SHT3x-DIS sensor needs to be triggered to grab a measurement.
-bool HumidOSH::triggerHumidity()
+// Put the SHT3x-DIS sensor in the periodic mode, where it keeps measuring by itself.
+bool HumidOSH::startHumidityPeriodic()
 {
-  if (this->humiditySensor_.triggerOneMeasurement(false, SHT3x::REP_HIG) == SHT3X_STATUS_OK)
+#ifdef HUMIDOSH_SIMULATION
+  return true;
+#endif // HUMIDOSH_SIMULATION
+
+#ifdef ADAPTIVE_DAQ
+  SHT3x::MeasurementRate rate = channel_->DAQFast ? HUMIDITY_MEASUREMENT_RATE : HUMIDITY_MEASUREMENT_RATE_SLOW;
+#else
+  SHT3x::MeasurementRate rate = HUMIDITY_MEASUREMENT_RATE;
+#endif // ADAPTIVE_DAQ
+
+  if (channel_->humiditySensor.startPeriodicMeasurement(rate, HUMIDITY_REPEATABILITY) == SHT3X_STATUS_OK)
   {
     return true;
   }
@@ -1471,19 +2899,124 @@ bool HumidOSH::triggerHumidity()
   }
 }
 
-// Grab the data saved 
-bool HumidOSH::getHumidity()
+// Put the latest readings from the RH sensor through the filter, and keep the filtered values.
+void HumidOSH::storeHumidity()
+{
+#ifdef HUMIDOSH_SIMULATION
+  channel_->humidityFilter.addSample(channel_->plant.update(millis()), channel_->plant.getTemperature());
+#else
+  channel_->humidityFilter.addSample(realToDouble(channel_->humiditySensor.getRH()), realToDouble(channel_->humiditySensor.getTemperature()));
+#endif // HUMIDOSH_SIMULATION
+
+  channel_->humidity = channel_->humidityFilter.getRH();
+  channel_->temperature = channel_->humidityFilter.getTemperature();
+}
+
+// Save the PID gains of channel_ (e.g. after an autotune), so that they are used again after a reset.
+void HumidOSH::saveHumidityPIDTunings()
+{
+  Config.setPIDGains(channel_ - channels_, channel_->humidityPID.GetKp(), channel_->humidityPID.GetKi(), channel_->humidityPID.GetKd());
+}
+
+// Apply the saved PID gains of channel_, if there are any. Returns false (and keeps the defaults) if nothing was saved.
+bool HumidOSH::loadHumidityPIDTunings()
 {
-  if (this->humiditySensor_.fetchMeasurement() == SHT3X_STATUS_OK)
+  float kp, ki, kd;
+
+  if (!Config.getPIDGains(channel_ - channels_, &kp, &ki, &kd))
   {
-    humidity_ = this->humiditySensor_.getRH();
-    temperature_ = this->humiditySensor_.getTemperature();
+    return false;
+  }
 
-    return true;
+  channel_->humidityPID.SetTunings(kp, ki, kd);
+  return true;
+}
+
+// Whether the last reset calls for a warm boot (see WARM_BOOT).
+bool HumidOSH::isWarmBoot()
+{
+#ifdef WARM_BOOT
+  return (resetFlags & (_BV(WDRF) | _BV(BORF))) && !(resetFlags & _BV(PORF));
+#else
+  return false;
+#endif // WARM_BOOT
+}
+
+// Save the run state of every chamber, if it changed. The integral term and output are only saved with includeOutput.
+void HumidOSH::saveRunStates(bool includeOutput)
+{
+  for (uint8_t i = 0; i < HUMIDOSH_CHANNEL_COUNT; i++)
+  {
+    ChamberChannel *channel = &channels_[i];
+    ChamberRunState state;
+
+    Config.getRunState(i, &state);
+    state.flags = (channel->humidityControlActive ? RUNSTATE_HUMIDITY_ACTIVE : 0)
+                | (channel->fanSpeedControlActive ? RUNSTATE_FANSPEED_ACTIVE : 0)
+                | (channel->humidityControlMode == HUMIDITY_CONTROL_SCHEDULED ? RUNSTATE_SCHEDULED : 0);
+    state.humidityTarget = realToDouble(channel->humidityTarget);
+    state.fanSpeedTarget = channel->fanSpeedTarget;
+
+    // What the autotune drives with is of no use to the PID.
+    if (includeOutput && autotuneChannel_ != i)
+    {
+      state.humidityOutputSum = realToDouble(channel->humidityPID.getOutputSum());
+      state.humidityControlOutput = realToDouble(channel->humidityControlOutput);
+    }
+
+    // Only a change is written.
+    Config.setRunState(i, state);
   }
-  else
+}
+
+// Read the saved run state of channel_. Returns false if nothing was saved.
+bool HumidOSH::loadRunState(ChamberRunState *state)
+{
+  return Config.getRunState(channel_ - channels_, state);
+}
+
+// Put channel_ back in the saved run state, or only set the saved targets with targetsOnly. Unlike toggleHumidityControl(),
+// the PID carries on from the saved integral term, and the pump and valves are driven from the saved output right away
+// instead of after the first readings.
+void HumidOSH::restoreRunState(const ChamberRunState &state, bool targetsOnly)
+{
+  setHumidityTarget(state.humidityTarget);
+  channel_->fanSpeedTarget = constrain(state.fanSpeedTarget, fanSpeedMin_, fanSpeedMax_);
+
+  if (targetsOnly)
   {
-    return false;
+    return;
+  }
+
+  if (state.flags & RUNSTATE_SCHEDULED)
+  {
+    // The RH isn't read yet, so the side is the one the saved output and integral term were on (see
+    // computeScheduledHumidityOutput()); the hysteresis moves it on from the error once the readings are in.
+    changeHumidityControlMode(HUMIDITY_CONTROL_SCHEDULED);
+    setScheduledSide(state.humidityControlOutput >= 0);
+  }
+
+  if (state.flags & RUNSTATE_HUMIDITY_ACTIVE)
+  {
+    digitalWrite(channel_->config.pinLEDRH, HIGH);
+    channel_->humidityControlActive = true;
+    channel_->humidityPID.Reset();
+    channel_->humidityPID.setOutputSum(state.humidityOutputSum);
+    channel_->humidityControlOutput = state.humidityControlOutput;
+
+    if (channel_->humidityControlMode == HUMIDITY_CONTROL_SCHEDULED)
+    {
+      applyScheduledHumidityOutput();
+    }
+    else
+    {
+      applyHumidityOutput();
+    }
+  }
+
+  if (state.flags & RUNSTATE_FANSPEED_ACTIVE)
+  {
+    retryFunc(&channel_->fanRetry, &HumidOSH::toggleFanSpeedControl, true);
   }
 }
 
@@ -1492,15 +3025,25 @@ void HumidOSH::toggleHumidityControl(bool enable)
 {
   if (enable)
   {
-    digitalWrite(pinLEDRH_, HIGH);
-    humidityControlActive_ = true;
-    humidityPID_.Reset();
+    digitalWrite(channel_->config.pinLEDRH, HIGH);
+    channel_->humidityControlActive = true;
+
+    if (channel_->humidityControlMode == HUMIDITY_CONTROL_SCHEDULED)
+    {
+      setScheduledSide(channel_->humidityTarget >= channel_->humidity);
+    }
+    else
+    {
+      channel_->humidityPID.Reset();
+    }
   }
   else
   {
-    digitalWrite(pinLEDRH_, LOW);
-    humidityControlActive_ = false;
-    setPumpDutyCycle(0);
+    cancelAutotune();
+    cancelProgram();
+    digitalWrite(channel_->config.pinLEDRH, LOW);
+    channel_->humidityControlActive = false;
+    setPumpCommand(0);
     toggleValveDry(false);
     toggleValveWet(false);
   }
@@ -1509,22 +3052,72 @@ void HumidOSH::toggleHumidityControl(bool enable)
 // Update RH target, ensuring it's within the limits.
 void HumidOSH::setHumidityTarget(double targetPercent)
 {
-  humidityTarget_ = constrain(targetPercent, humidityMin_, humidityMax_);
+  channel_->humidityTarget = constrain(targetPercent, humidityMin_, humidityMax_);
+}
+
+// Drive the pump of channel_ with command (0 to PUMPDRIVE_COMMAND_MAX), over the full range of the duty cycle.
+void HumidOSH::setPumpCommand(real_t command)
+{
+  channel_->pump.setCommand(command);
+
+#ifdef HUMIDOSH_SIMULATION
+  channel_->plant.setPumpDrive(channel_->pump.getDuty());
+#endif // HUMIDOSH_SIMULATION
 }
 
-// Update the pump duty cycle, ensuring it's within the limits.
-void HumidOSH::setPumpDutyCycle(uint8_t dutyCycle)
+// Program the fan controller. The settings are written together by applyConfig(), which takes a few
+// block transfers instead of a read-modify-write per setting.
+bool HumidOSH::configureFan()
 {
-  pumpDutyCycle_ = dutyCycle;
-  analogWrite(pinPump_, pumpDutyCycle_);
+  selectFanBus();
+
+  if (channel_->fan.beginConfig() != EMC2301_STATUS_OK)
+  {
+    return false;
+  }
+
+  channel_->fan.toggleControlAlgorithm(true);
+  channel_->fan.setFanSpeedMin(fanSpeedAbsMin_);
+  channel_->fan.setSpinUpDrive(30);
+  channel_->fan.setFanSpeedSpinupMin(fanSpeedAbsMin_);
+  channel_->fan.setFanMinDrive(fanMinDrive_);
+
+  if (channel_->fan.applyConfig() != EMC2301_STATUS_OK)
+  {
+    return false;
+  }
+
+#ifdef FAN_ALERT
+  return channel_->fan.toggleAlert(true) == EMC2301_STATUS_OK;
+#else
+  return true;
+#endif // FAN_ALERT
 }
 
 // Get fan speed in RPM.
 bool HumidOSH::getFanSpeed()
 {
-  if (this->fan_.fetchFanSpeed() == EMC2301_STATUS_OK)
+  selectFanBus();
+
+  if (channel_->fan.fetchFanSpeed() == EMC2301_STATUS_OK)
+  {
+    storeFanSpeed();
+    return true;
+  }
+  else
+  {
+    return false;
+  }
+}
+
+// Read the fault bits of the fan controller of channel_.
+bool HumidOSH::getFanStatus()
+{
+  selectFanBus();
+
+  if (channel_->fan.fetchFanStatus() == EMC2301_STATUS_OK)
   {
-    fanSpeed_ = this->fan_.getFanSpeed();
+    channel_->fanStatus = channel_->fan.getFanStatus();
     return true;
   }
   else
@@ -1533,14 +3126,28 @@ bool HumidOSH::getFanSpeed()
   }
 }
 
+// A stalled fan, or one that failed to spin up, has no fan speed to speak of. Full drive below the target still has one.
+bool HumidOSH::hasFanFault()
+{
+  return channel_->fanStatus & (EMC2301::FAN_STATUS_STALL | EMC2301::FAN_STATUS_SPINUP);
+}
+
+// Copy the latest reading from the fan tachometer.
+void HumidOSH::storeFanSpeed()
+{
+  channel_->fanSpeed = channel_->fan.getFanSpeed();
+}
+
 // Update fan speed target, ensuring it's within the limits.
 bool HumidOSH::updateFanSpeedTarget(double targetRPM)
 {
   // Only change fan speed if control is already active.
   // If it's not, the fan speed will be set when toggling the control on.
-  if (fanSpeedControlActive_)
+  if (channel_->fanSpeedControlActive)
   {
-    if (this->fan_.setFanSpeedTarget(fanSpeedTarget_) == EMC2301_STATUS_OK)
+    selectFanBus();
+
+    if (channel_->fan.setFanSpeedTarget(channel_->fanSpeedTarget) == EMC2301_STATUS_OK)
     {
       return true;
     }
@@ -1559,13 +3166,15 @@ bool HumidOSH::updateFanSpeedTarget(double targetRPM)
 // a spin-up routine upon turning on the control.
 bool HumidOSH::toggleFanSpeedControl(bool enable)
 {
+  selectFanBus();
+
   if (enable)
   {
-    if (this->fan_.setFanSpeedTarget(fanSpeedTarget_) == EMC2301_STATUS_OK)
+    if (channel_->fan.setFanSpeedTarget(channel_->fanSpeedTarget) == EMC2301_STATUS_OK)
     {
       toggleFan(true);
-      digitalWrite(pinLEDFan_, HIGH);
-      fanSpeedControlActive_ = true;
+      digitalWrite(channel_->config.pinLEDFan, HIGH);
+      channel_->fanSpeedControlActive = true;
       return true;
     }
     else
@@ -1576,11 +3185,11 @@ bool HumidOSH::toggleFanSpeedControl(bool enable)
   else
   {
     // Set the target to 0 so the EMC2301 stops trying to achieve a target fan speed.
-    if (this->fan_.setFanSpeedTarget(0) == EMC2301_STATUS_OK)
+    if (channel_->fan.setFanSpeedTarget(0) == EMC2301_STATUS_OK)
     {
       toggleFan(false);
-      digitalWrite(pinLEDFan_, LOW);
-      fanSpeedControlActive_ = false;
+      digitalWrite(channel_->config.pinLEDFan, LOW);
+      channel_->fanSpeedControlActive = false;
       return true;
     }
     else
@@ -1598,49 +3207,54 @@ bool HumidOSH::toggleFanSpeedControl(bool enable)
 ***************************************************/
 void HumidOSH::togglePump(bool enable)
 {
-  if (enable)
-  {
-    analogWrite(pinPump_, pumpDutyCycle_);
-  }
-  else
-  {
-    analogWrite(pinPump_, 0);
-  }
+  channel_->pump.enable(enable);
+
+#ifdef HUMIDOSH_SIMULATION
+  channel_->plant.setPumpDrive(enable ? channel_->pump.getDuty() : 0);
+#endif // HUMIDOSH_SIMULATION
 }
 
 void HumidOSH::toggleValveDry(bool enable)
 {
   if (enable)
   {
-    digitalWrite(pinValveDry_, HIGH);
+    digitalWrite(channel_->config.pinValveDry, HIGH);
   }
   else
   {
-    digitalWrite(pinValveDry_, LOW);
+    digitalWrite(channel_->config.pinValveDry, LOW);
   }
+
+#ifdef HUMIDOSH_SIMULATION
+  channel_->plant.setValveDry(enable);
+#endif // HUMIDOSH_SIMULATION
 }
 
 void HumidOSH::toggleValveWet(bool enable)
 {
   if (enable)
   {
-    digitalWrite(pinValveWet_, HIGH);
+    digitalWrite(channel_->config.pinValveWet, HIGH);
   }
   else
   {
-    digitalWrite(pinValveWet_, LOW);
+    digitalWrite(channel_->config.pinValveWet, LOW);
   }
+
+#ifdef HUMIDOSH_SIMULATION
+  channel_->plant.setValveWet(enable);
+#endif // HUMIDOSH_SIMULATION
 }
 
 void HumidOSH::toggleFan(bool enable)
 {
   if (enable)
   {
-    digitalWrite(pinFanPWMDrain_, LOW);
+    digitalWrite(channel_->config.pinFanPWMDrain, LOW);
   }
   else
   {
-    digitalWrite(pinFanPWMDrain_, HIGH);
+    digitalWrite(channel_->config.pinFanPWMDrain, HIGH);
   }
 }
 
@@ -1648,11 +3262,11 @@ void HumidOSH::toggleLEDRH(bool enable)
 {
   if (enable)
   {
-    digitalWrite(pinLEDRH_, HIGH);
+    digitalWrite(channel_->config.pinLEDRH, HIGH);
   }
   else
   {
-    digitalWrite(pinLEDRH_, LOW);
+    digitalWrite(channel_->config.pinLEDRH, LOW);
   }
 }
 
@@ -1660,11 +3274,11 @@ void HumidOSH::toggleLEDFan(bool enable)
 {
   if (enable)
   {
-    digitalWrite(pinLEDFan_, HIGH);
+    digitalWrite(channel_->config.pinLEDFan, HIGH);
   }
   else
   {
-    digitalWrite(pinLEDFan_, LOW);
+    digitalWrite(channel_->config.pinLEDFan, LOW);
   }
 }
 
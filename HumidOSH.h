@@ -58,24 +58,173 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 // will be displayed on the second line of the screen displaying the readings.
 //#define DISPLAY_TEMPERATURE 1
 
+// With KEYPAD_PINCHANGE, the keypad is only scanned after a pin change interrupt on one of its rows, and for as long as a
+// key is down. While no key is pressed, all columns are driven low so that a key press pulls its row low.
+// Comment it out to scan the keypad every PERIOD_TASK_KEYPAD instead.
+#define KEYPAD_PINCHANGE 1
+
+// With FAN_ALERT, the ALERT pins of the EMC2301s (open drain, wired together) go to HUMIDOSH_FAN_ALERT_PIN, and a fan fault
+// (stall or failed spin-up) is picked up by its pin change interrupt. The fan status is then only read while ALERT is low,
+// and the fan speed only every PERIOD_DAQ_FAN_ALERT, since the EMC2301 keeps the RPM by itself.
+// Without it, the fan status is read along with every fan speed reading.
+//#define FAN_ALERT 1
+
+// With RS485, the serial link goes through an RS-485 transceiver for a multi-drop bus (see SERIAL_CMD_UNIT_ADDRESS), and
+// its driver enable (DE and /RE tied together) goes to HUMIDOSH_RS485_DE_PIN, which is high while sending. The RH LED then
+// moves from pin 12 to 13 to free it (see PIN_LED_RH). Without it, the link is point-to-point and no pin is used for it.
+//#define RS485 1
+
+// With ADAPTIVE_DAQ, each chamber is sampled and controlled at a fast rate while its RH is away from the target or moving,
+// and at a slow rate once it has been steady for a while: less traffic on the I2C bus, and less self-heating of the RH sensor.
+// Comment it out to sample at one rate all the time (PERIOD_HUMIDITY_CONTROL and PERIOD_DAQ).
+#define ADAPTIVE_DAQ 1
+
+// With WARM_BOOT, a reset by the brown-out detector or the watchdog skips the splash screen and the waits of a cold start,
+// and puts each chamber back the way it was: targets, control mode, running controls and the PID integral term, as kept
+// in ConfigStore (see ChamberRunState). A power-on or the reset button still starts cold, with only the targets kept.
+#define WARM_BOOT 1
+
+// With WATCHDOG, the watchdog resets the Arduino if run() is stuck for WATCHDOG_TIMEOUT. Needs a bootloader that turns the
+// watchdog off after a reset (Optiboot, the "new bootloader" of the Nano); the old one keeps resetting.
+//#define WATCHDOG 1
+
 #include <SPI.h>
+#include <avr/wdt.h>
 #include "SerialCommunication.h"
 #include "EMC2301.h"
 #include "serLCD_cI2C.h"
 #include "SHT3x.h"
 #include "PID_modified.h"
+#include "PIDAutotune.h"
+#include "FixedPoint.h"
 #include "Keypad.h"
 #include "Key.h"
 #include "I2C.h"
+#include "Scheduler.h"
+#include "Instrumentation.h"
+#include "StepResponse.h"
+#include "HumidityFilter.h"
+#include "RetryPolicy.h"
+#include "PinChange.h"
+#include "TelemetryLog.h"
+#include "ConfigStore.h"
+#include "ChamberPlant.h"
+#include "PumpDrive.h"
+#include "SetpointProgram.h"
+
+// Number of chambers run by this controller. Each chamber has its own RH sensor, fan controller, pump, valves and LEDs
+// (see ChamberConfig); the screen and keypad show one chamber at a time and the 'x' key switches between them.
+// The SHT3x only has two addresses, so at most two chambers can share the bus. The EMC2301 has a fixed address,
+// so with more than one chamber each fan controller must sit behind its own channel of a TCA9548A-type I2C multiplexer.
+#define HUMIDOSH_CHANNEL_COUNT 1
+#define HUMIDOSH_FAN_MUX_ADDRESS 0x70
+#define HUMIDOSH_FAN_ALERT_PIN 10   // See FAN_ALERT. Free with one chamber; the second pump takes it otherwise.
+#define HUMIDOSH_RS485_DE_PIN 12    // See RS485. Not 13, which the bootloader blinks on every reset; pull it down (10 kOhm).
+
+// Casts a string defined with PROGMEM so that Print (and SerLCD) prints it straight from flash, like F().
+#define FLASH_STRING(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+// Hardware of one chamber
+struct ChamberConfig
+{
+  uint8_t pinPump;            // Must be pin 9 or 10 (Timer 1 at 25 kHz, see PumpDrive)
+  uint8_t pinValveDry;
+  uint8_t pinValveWet;
+  uint8_t pinFanPWMDrain;
+  uint8_t pinLEDRH;
+  uint8_t pinLEDFan;
+  bool sensorADDRPinHigh;     // ADDR pin of the SHT3x; the two chambers must differ
+  uint8_t fanMuxChannel;      // Channel of the I2C multiplexer for the EMC2301; unused with one chamber
+};
+
+// How the humidity control output is worked out
+typedef enum
+{
+  HUMIDITY_CONTROL_PID        = 0,  // One PID for both humidifying and drying (the original mode)
+  HUMIDITY_CONTROL_SCHEDULED  = 1   // Separate gains for humidifying and drying, with feed-forward (see HumidOSH::computeScheduledHumidityOutput())
+} HUMIDITY_CONTROL_MODE;
+
+// Settings of HUMIDITY_CONTROL_SCHEDULED. The gains are in the same units as those of the PID.
+struct HumidityGainSchedule
+{
+  double humidifyKp, humidifyKi, humidifyKd;  // Used while humidifying
+  double dryKp, dryKi, dryKd;                 // Used while drying
+  double feedForwardGain;                     // Output per %RH of distance between the target and feedForwardRH
+  double feedForwardRH;                       // RH (%) that the chamber drifts to with the pump off, i.e. that of the room
+};
+
+// Control state of one chamber
+struct ChamberChannel
+{
+  // There is only one TWI peripheral on the ATmega328, so every chamber is on I2c.
+  ChamberChannel() : humiditySensor(&I2c), fan(&I2c), humidityRetry(&I2c, SHT3x::BASE_ADDRESS), fanRetry(&I2c, EMC2301::I2C_ADDRESS) {}
+
+  ChamberConfig config;
+  SHT3x humiditySensor;
+  EMC2301 fan;
+  RetryPolicy humidityRetry;  // For the RH sensor
+  RetryPolicy fanRetry;       // For the fan controller
+  PID humidityPID;
+  StepResponse stepResponse;
+  HumidityFilter humidityFilter;
+  TelemetryLog_Encoder logEncoder;
+#ifdef HUMIDOSH_SIMULATION
+  ChamberPlant plant;       // Stands in for the chamber and its RH sensor
+#endif // HUMIDOSH_SIMULATION
+
+  // Acquiring measurements
+  bool humidityRequested;   // A background read of the RH sensor is waiting to be collected
+  bool fanSpeedRequested;   // A background read of the fan tachometer is waiting to be collected
+  unsigned long DAQTimerStart;
+  unsigned long humidityTimerStart;
+  unsigned long humidityLastReadingTime;
+  unsigned long humidityPublishTime;  // Last time the filtered RH was handed to the control and the screen
+  uint16_t humidityWait;    // Time (ms) after humidityTimerStart to fetch the next RH reading
+#ifdef ADAPTIVE_DAQ
+  bool DAQFast;             // Sampling and control at the fast rate
+  unsigned long DAQSteadyTime;      // Last time the chamber was seen in a transient
+  bool humiditySlopeValid;  // humiditySlopeStart holds a reading; not so before the first one, or after a sensor error
+  bool humiditySlopeHigh;   // The RH moved faster than DAQ_FAST_SLOPE over the last PERIOD_DAQ_SLOPE
+  float humiditySlopeStart; // Filtered RH (%) at humiditySlopeTime
+  unsigned long humiditySlopeTime;
+#endif // ADAPTIVE_DAQ
+
+  // Humidity
+  bool humidityOK;
+  bool humidityErrorHandlingActive;
+  bool humidityControlActive;
+  bool newHumidityReadingPrint;
+  bool newHumidityReadingControl;
+  bool humidityPeriodicStarted;
+  real_t humidity;
+  real_t humidityTarget;
+  real_t humidityControlOutput;
+  PumpDrive pump;
+  HUMIDITY_CONTROL_MODE humidityControlMode;
+  bool humidifying;         // Side of the scheduled control; also the gain set that is in humidityPID
+  double pidKp, pidKi, pidKd; // Gains of HUMIDITY_CONTROL_PID, kept here while humidityPID has the scheduled gains
+
+  // Temperature
+  real_t temperature;
+
+  // Fan speed
+  bool fanSpeedOK;
+  uint8_t fanStatus;        // EMC2301::FAN_STATUS_* of the last fan status read
+  bool fanSpeedControlActive;
+  bool newFanSpeedReadingPrint;
+  double fanSpeed;
+  double fanSpeedTarget;
+};
 
 
 class HumidOSH
 {
 public:
   HumidOSH( SerialCommunication* communicator, I2C* i2cWire, Keypad* keypad, // class ref
-            uint8_t pinPump, uint8_t pinValveDry, uint8_t pinValveWet, uint8_t pinFanPWMDrain, uint8_t pinLEDRH, uint8_t pinLEDFan, // pins
+            const ChamberConfig chamberConfigs[HUMIDOSH_CHANNEL_COUNT], // pins etc. of each chamber
             double humidityMin, double humidityMax, uint8_t pumpDutyCycleMin, uint8_t pumpDutyCycleMax, double fanSpeedMin, double fanSpeedMax, double fanSpeedAbsMin, double fanMinDrive,  // Limits for the controls
             double humidityKp, double humidityKi, double humidityKd, // PID params
+            const HumidityGainSchedule &humidityGainSchedule,       // Gains of HUMIDITY_CONTROL_SCHEDULED
             uint16_t keyHoldDuration
           );
   ~HumidOSH();
@@ -83,27 +232,92 @@ public:
   void run();
   void handleKeyPress(KeypadEvent key);
   void startSendData();
+  void startSendDataBinary();
   void stopSendData();
+  bool sendLatestData();
+  bool setSendPeriod(uint16_t periodMs);
+  bool setHumidityControl(double targetPercent, bool enable);
+  bool setFanSpeedControl(double targetRPM, bool enable);
+  bool setHumidityPIDTunings(double kp, double ki, double kd);
+  bool setHumidityAutotune(bool enable);
+  bool setHumidityControlMode(uint8_t mode);
+  bool setRemoteChannel(uint8_t channelIndex);
+  bool setProgram(const uint8_t *payload, uint8_t length);
+  bool setProgramRun(bool enable);
+  void sendTaskStats();
+  void sendDeviceStats();
+  void sendStepResponse();
+  bool startLogDump();
+  void setLogDecimation(uint16_t decimation);
+  bool clearLog();
 
 private:
   SerialCommunication* communicator_;
   I2C* i2cWire_;
   Keypad* keypad_;
-  SHT3x humiditySensor_;
-  EMC2301 fan_;
   SerLCD screen_;
-  PID humidityPID_;
-
-  // Execute functions with retries
-  const uint8_t RETRIES_MAX = 10; // Maximum number of times to retry a command if it fails.
-  bool retryFunc(bool (HumidOSH::*func)());
-  bool retryFunc(bool (HumidOSH::*func)(bool), bool param);
-  bool retryFunc(bool (HumidOSH::*func)(char), char param);
-  bool retryFunc(bool (HumidOSH::*func)(char[]), char param[]);
-  bool retryFunc(bool (HumidOSH::*func)(uint8_t), uint8_t param);
-  bool retryFunc(bool (HumidOSH::*func)(uint16_t), uint16_t param);
-  bool retryFunc(bool (HumidOSH::*func)(double), double param);
-  bool retryFunc(bool (HumidOSH::*func)(double, uint8_t), double paramDouble, uint8_t paramByte);
+  static const uint8_t I2C_LOSTARB_RETRIES = 2; // Times a transaction is started again after losing arbitration, e.g. to noise on the bus (see I2c.setProfile())
+
+  // Chambers. Most of the functions work on channel_, which is selected by whoever calls them (the task looping over
+  // the chambers, or the screen/keypad for the chamber on display).
+  ChamberChannel channels_[HUMIDOSH_CHANNEL_COUNT];
+  ChamberChannel *channel_;
+  uint8_t displayedChannel_;      // Chamber shown on the screen and adjusted with the keypad
+  uint8_t remoteChannel_;         // Chamber adjusted by the computer
+  uint8_t humidityChannel_;       // Chamber that runHumidityTask() is reading
+  uint8_t fanSpeedChannel_;       // Chamber that runFanSpeedTask() is reading
+  uint8_t fanBusChannel_;         // Multiplexer channel currently selected
+  static const uint8_t FAN_BUS_CHANNEL_UNKNOWN = 0xFF;
+  void selectChannel(uint8_t channelIndex);
+  void selectFanBus();
+  uint8_t getNextDueChannel(bool humidity, uint16_t * waitRemaining);
+
+  // Tasks run by run()
+  Scheduler scheduler_;
+  static const uint16_t PERIOD_TASK_KEYPAD     = 10;   // Period (ms) for scanning the keypad. The keypad library debounces at the same rate.
+  static const uint16_t PERIOD_TASK_SCREEN     = 10;   // Period (ms) for updating the screen. Same as the shortest interval between flushes to the screen.
+  static const uint16_t PERIOD_TASK_I2C_CHECK  = 1;    // Time (ms) before checking if a background I2C read is done. A 6-byte read at 100 kHz takes about 0.8 ms.
+  uint8_t keypadTaskID_;
+#ifdef KEYPAD_PINCHANGE
+  volatile bool keypadWake_;  // Set by the pin change interrupt of the keypad rows
+  bool keypadIdle_;           // No key down at the last scan, so the rows are armed for the interrupt
+  static void keypadPinChangeCallback(void *context);
+#endif // KEYPAD_PINCHANGE
+#ifdef FAN_ALERT
+  volatile bool fanAlert_;    // Set by the pin change interrupt of ALERT
+  static void fanAlertPinChangeCallback(void *context);
+#endif // FAN_ALERT
+  uint8_t humidityTaskID_;
+  uint8_t controlTaskID_;
+  uint8_t fanSpeedTaskID_;
+  uint8_t screenTaskID_;
+  uint8_t sendTaskID_;
+  uint8_t logTaskID_;
+  uint8_t logWriteTaskID_;
+  bool addTasks();
+  void runKeypadTask();
+  void runHumidityTask();
+  void runControlTask();
+  void runFanSpeedTask();
+  void runScreenTask();
+  void runSendTask();
+  void runLogTask();
+  void runLogWriteTask();
+  static void keypadTaskCallback(void *context);
+  static void humidityTaskCallback(void *context);
+  static void controlTaskCallback(void *context);
+  static void fanSpeedTaskCallback(void *context);
+  static void screenTaskCallback(void *context);
+  static void sendTaskCallback(void *context);
+  static void logTaskCallback(void *context);
+  static void logWriteTaskCallback(void *context);
+
+  // Execute functions that talk to a device, keeping track of its failures in the given RetryPolicy (see RetryPolicy.h).
+  // attemptFunc() is for the tasks: one try at most, and none while the device is backing off; the task tries again later.
+  // retryFunc() is for when the result is needed right away (at startup and on user actions), and ignores the backoff.
+  static const uint8_t RETRIES_MAX = 3; // Maximum number of tries in retryFunc(). Each can take up to the I2C timeout.
+  template <typename... Params, typename... Args> bool attemptFunc(RetryPolicy *policy, bool (HumidOSH::*func)(Params...), Args... args);
+  template <typename... Params, typename... Args> bool retryFunc(RetryPolicy *policy, bool (HumidOSH::*func)(Params...), Args... args);
 
   // Screen
   typedef enum
@@ -116,16 +330,42 @@ private:
     SCREEN_PAGE_CAL_RESET   = 6,
     SCREEN_PAGE_HOLD        = 7,
     SCREEN_PAGE_MINVAL      = 8,
-    SCREEN_PAGE_MAXVAL      = 9
+    SCREEN_PAGE_MAXVAL      = 9,
+    SCREEN_PAGE_AUTOTUNE    = 10
   } SCREEN_PAGE;
-  const char CHAR_DECIMAL = '.';
-  const char CHAR_EMPTY   = ' ';
-  const char CHAR_RUN     = '>';
-  const char CHAR_NULL    = '\0';
+
+  // The static text of every page is listed in SCREEN_LABELS (HumidOSH.cpp) and drawn once by drawScreenPage() when the
+  // page is shown; updateScreen() only draws the fields. Everything goes through the framebuffer, so a page change only
+  // sends the cells that differ from the previous page.
+  struct ScreenLabel
+  {
+    uint8_t page;       // SCREEN_PAGE
+    uint8_t col;
+    uint8_t row;
+    const char *text;   // In flash
+  };
+  static const ScreenLabel SCREEN_LABELS[];
+  static const uint8_t SCREEN_LABEL_COUNT;
+
+  // What a field on the screen shows, so that it is only redrawn when that changes (or for a new reading).
+  typedef enum
+  {
+    SCREEN_FIELD_UNKNOWN    = 0,  // Not drawn since the page was shown
+    SCREEN_FIELD_VALUE,
+    SCREEN_FIELD_ERROR,
+    SCREEN_FIELD_NOREADING,
+    SCREEN_FIELD_IDLE,            // Control indicators
+    SCREEN_FIELD_RUN_LEFT,
+    SCREEN_FIELD_RUN_RIGHT
+  } SCREEN_FIELD;
+  static const char CHAR_DECIMAL = '.';
+  static const char CHAR_EMPTY   = ' ';
+  static const char CHAR_RUN     = '>';
+  static const char CHAR_NULL    = '\0';
   const uint16_t keyHoldDuration_;
-  const unsigned long SCREEN_BACKGROUND_DEFAULT = 0x00FFFFFF; // Bright white
-  const unsigned long SCREEN_BACKGROUND_IDLE    = 0x00000000; // Turn off when not in use
-  const unsigned long SCREEN_ACTIVE_DURATION    = 10000;      // The backlight is only left one for certain time, then is turned off until user presses a button
+  static const unsigned long SCREEN_BACKGROUND_DEFAULT = 0x00FFFFFF; // Bright white
+  static const unsigned long SCREEN_BACKGROUND_IDLE    = 0x00000000; // Turn off when not in use
+  static const unsigned long SCREEN_ACTIVE_DURATION    = 10000;      // The backlight is only left one for certain time, then is turned off until user presses a button
   SCREEN_PAGE screenPage_;
   bool backlightOn_;
   bool screenPageChanged_;
@@ -140,51 +380,59 @@ private:
   void changeScreenPage(SCREEN_PAGE newScreenPage);
   void updateScreen();
   bool resetScreen();
-  bool clearValueRightAligned(const uint8_t & rightmostColNumber, const uint8_t & rowNumber, const uint8_t & charCount);
+  void drawScreenPage();
+  bool clearValueRightAligned(uint8_t rightmostColNumber, uint8_t rowNumber, uint8_t charCount);
   bool resetScreenInput(uint8_t charMax, uint8_t charOffset);
   bool idleScreenInput();
   bool printToDisplay(char charToPrint);
   bool printToDisplay(const char stringToPrint[]);
+  bool printToDisplay(const __FlashStringHelper *stringToPrint);
   bool printToDisplay(double doubleToPrint, uint8_t decimalsToPrint);
 
   // Readings screen
   bool controlActiveIndicatorLeft_;
   unsigned long controlIndicatorTimerStart_;
-  const uint8_t MAXCHAR_READINGS            = 7;
-  const uint16_t PERIOD_SCREEN_CONTROLINDICATOR = 500; // Period (ms) between each update of the "running" symbol to indicate control is active.
-  const char CONTROLINDICATOR_RUN_LEFT[5]   = { CHAR_RUN, CHAR_RUN, CHAR_EMPTY, CHAR_EMPTY, CHAR_NULL };
-  const char CONTROLINDICATOR_RUN_RIGHT[5]  = { CHAR_EMPTY, CHAR_EMPTY, CHAR_RUN, CHAR_RUN, CHAR_NULL };
-  const char CONTROLINDICATOR_IDLE[5]       = { 'I', 'D', 'L', 'E', CHAR_NULL };
-  const char PRINT_ERROR[6]                 = { 'E', 'R', 'R', 'O', 'R', CHAR_NULL };
-  const char PRINT_NOREADING[4]             = { 'N', '/', 'A', CHAR_NULL };
-  const uint8_t COL_READING_RIGHTMOST       = 15;
-  const uint8_t ROW_READING_HUMIDITY        = 2;
-  const uint8_t ROW_READING_FANSPEED        = 3;
-  void printValueRightAligned(const double & value, const uint8_t & decimalsMax, const uint8_t & rightmostColNumber, const uint8_t & rowNumber);
-  void printValueRightAligned(const char value[], const uint8_t & rightmostColNumber, const uint8_t & rowNumber);
+  SCREEN_FIELD humidityFieldShown_;
+  SCREEN_FIELD fanSpeedFieldShown_;
+  SCREEN_FIELD humidityIndicatorShown_;
+  SCREEN_FIELD fanSpeedIndicatorShown_;
+  static const uint8_t MAXCHAR_READINGS            = 7;
+  static const uint16_t PERIOD_SCREEN_CONTROLINDICATOR = 500; // Period (ms) between each update of the "running" symbol to indicate control is active.
+  static const char CONTROLINDICATOR_RUN_LEFT[5];  // The screen strings are kept in flash (PROGMEM); see HumidOSH.cpp
+  static const char CONTROLINDICATOR_RUN_RIGHT[5];
+  static const char CONTROLINDICATOR_IDLE[5];
+  static const char PRINT_ERROR[6];
+  static const char PRINT_NOREADING[4];
+  static const uint8_t COL_READING_RIGHTMOST       = 15;
+  static const uint8_t ROW_READING_HUMIDITY        = 2;
+  static const uint8_t ROW_READING_FANSPEED        = 3;
+  void printValueRightAligned(double value, uint8_t decimalsMax, uint8_t rightmostColNumber, uint8_t rowNumber);
+  void printValueRightAligned(const __FlashStringHelper *value, uint8_t rightmostColNumber, uint8_t rowNumber);
+  void printReadingFields();
   void printControlIndicators(bool printingLeft);
+  SCREEN_FIELD printControlIndicator(bool controlActive, bool printingLeft, SCREEN_FIELD shown, uint8_t row);
   void printReadingRightAligned(float reading, uint8_t maxDecimals, uint8_t readingCharMaxCount, uint8_t rightmostCol, uint8_t row);
-  void printTextRightAligned(const char text[], uint8_t textCharMaxCount, uint8_t rightmostCol, uint8_t row);
+  void printTextRightAligned(const __FlashStringHelper *text, uint8_t textCharMaxCount, uint8_t rightmostCol, uint8_t row);
   void printNoReading();
 
   // Hold screen
   void printSecondsRemaining();
 
   // Calibration-related screens
-  const uint8_t MAXCHAR_RHRAW = 5;
-  const uint16_t PERIOD_SCREEN_CALRESET = 2000; // Duration (ms) for the reset calibration screen to be shown before the screen is reverted back to calibration menu.
-  bool calibratingPoint1;
+  static const uint8_t MAXCHAR_RHRAW = 5;
+  static const uint16_t PERIOD_SCREEN_CALRESET = 2000; // Duration (ms) for the reset calibration screen to be shown before the screen is reverted back to calibration menu.
+  uint8_t calibrationPoint_;  // Point on SCREEN_PAGE_CAL_POINT (see SHT3x::findCalibrationPoint()); the point count if it is a new one
   unsigned long calResetSplashTimerStart_; // Keeps track of when the splash screen for confirming calibration reset was shown.
 
   // Min/max error screen
   // const unsigned long SCREEN_BACKGROUND_ERROR = 0x00FF6161; // Light red
-  const char CHAR_FLASHER_LEFT  = '>';
-  const char CHAR_FLASHER_RIGHT = '<';
-  const char ERROR_FLASHER_LEFT[6]  = { CHAR_FLASHER_LEFT, CHAR_FLASHER_LEFT, CHAR_FLASHER_LEFT, CHAR_FLASHER_LEFT, CHAR_FLASHER_LEFT, CHAR_NULL };
-  const char ERROR_FLASHER_RIGHT[6] = { CHAR_FLASHER_RIGHT, CHAR_FLASHER_RIGHT, CHAR_FLASHER_RIGHT, CHAR_FLASHER_RIGHT, CHAR_FLASHER_RIGHT, CHAR_NULL };
-  const char ERROR_FLASHER_CLEAR[6] = { CHAR_EMPTY, CHAR_EMPTY, CHAR_EMPTY, CHAR_EMPTY, CHAR_EMPTY, CHAR_NULL };
-  const uint16_t PERIOD_ERROR_INPUT_FLASH = 700; // Duration between each flash
-  const uint8_t ERROR_INPUT_FLASH_COUNT = 6;       // Number of times to flash. This, multiplied with errorInputTimerFlashDuration_, gives the total duration for the error screen.
+  static const char CHAR_FLASHER_LEFT  = '>';
+  static const char CHAR_FLASHER_RIGHT = '<';
+  static const char ERROR_FLASHER_LEFT[6];
+  static const char ERROR_FLASHER_RIGHT[6];
+  static const char ERROR_FLASHER_CLEAR[6];
+  static const uint16_t PERIOD_ERROR_INPUT_FLASH = 700; // Duration between each flash
+  static const uint8_t ERROR_INPUT_FLASH_COUNT = 6;       // Number of times to flash. This, multiplied with errorInputTimerFlashDuration_, gives the total duration for the error screen.
   bool errorInputFlashOn_;
   uint8_t errorInputTimerFlashCounter_;
   unsigned long errorInputTimerStart_;
@@ -192,81 +440,161 @@ private:
 
 
   // Keypad or button presses
-  const uint8_t INPUT_HUMIDITY_MAXCHAR  = 4; // Max characters for inputting humidity target (100.0 is 5 chars)
-  const uint8_t INPUT_HUMIDITY_DECIMALS = 1; // Number of decimal places allowed for humidity input.
-  const uint8_t INPUT_FANSPEED_MAXCHAR  = 4; // Max characters for inputting fan speed target (9800 is 4 chars)
-  const uint8_t INPUT_FANSPEED_DECIMALS = 0; // Number of decimal places allowed for fan speed input.
+  static const uint8_t INPUT_HUMIDITY_MAXCHAR  = 4; // Max characters for inputting humidity target (100.0 is 5 chars)
+  static const uint8_t INPUT_HUMIDITY_DECIMALS = 1; // Number of decimal places allowed for humidity input.
+  static const uint8_t INPUT_FANSPEED_MAXCHAR  = 4; // Max characters for inputting fan speed target (9800 is 4 chars)
+  static const uint8_t INPUT_FANSPEED_DECIMALS = 0; // Number of decimal places allowed for fan speed input.
   bool decimalUsed_;
   uint8_t inputCharCount_;
   uint8_t inputIntCount_;
   uint8_t inputDecimalCount_;
   double inputValue_;
   void handleButtonControl(bool humidity, const bool & controlActiveFlag, bool & recentlyStoppedFlag);
-  void handleInputNumber(char inputKey, const uint8_t & charMax, const uint8_t & decimalsMax);
-  void handleInputDelete(const uint8_t & charMax);
-  void handleInputDot(const uint8_t & charMax, const uint8_t & decimalsMax);
-  bool saveInput(bool humidity, double & targetBuffer, const double & min, const double & max);
+  void handleInputNumber(char inputKey, uint8_t charMax, uint8_t decimalsMax);
+  void handleInputDelete(uint8_t charMax);
+  void handleInputDot(uint8_t charMax, uint8_t decimalsMax);
+  bool saveInput(bool humidity, double & targetBuffer, double min, double max);
   void resetInputVars();
   
-  // Pins
-  const uint8_t pinPump_;
-  const uint8_t pinValveDry_;
-  const uint8_t pinValveWet_;
-  const uint8_t pinFanPWMDrain_;
-  const uint8_t pinLEDRH_;
-  const uint8_t pinLEDFan_;
-
   // Acquiring measurements
-  unsigned long DAQTimerStart_;
-  const uint16_t PERIOD_DAQ_HUMIDITY_TRIGGER = SHT3x::DURATION_HIGREP + 300; // Wait time (ms) between triggering a measurement and attempting to grab it. Add more to be conservative.
-  const uint16_t PERIOD_DAQ = 1000; // Period (ms) between each data acquisition.
+  // The RH sensor runs in its periodic mode and measures by itself, so each RH reading only needs one read (done in the background).
+  // Every reading goes into the HumidityFilter of the chamber, and the filtered RH is handed to the control and the screen
+  // every PERIOD_HUMIDITY_CONTROL. So the sensor rate and the control rate can be changed independently.
+  // The fan speed is read every PERIOD_DAQ, or every sendPeriod_ if the computer asked for data more often than that.
+  // With FAN_ALERT, it is only telemetry and is read every PERIOD_DAQ_FAN_ALERT instead.
+  // With ADAPTIVE_DAQ, the *_FAST and *_SLOW rates below take the place of the fixed ones (see updateDAQRate()).
+  static const SHT3x::MeasurementRate HUMIDITY_MEASUREMENT_RATE  = SHT3x::MPS_10;
+  static const SHT3x::Repeatability HUMIDITY_REPEATABILITY       = SHT3x::REP_MED; // High repeatability at 10 measurements per second heats up the sensor (datasheet section 4.5)
+  static const uint16_t PERIOD_HUMIDITY_CONTROL    = 1000; // Period (ms) between each run of the humidity control on the filtered RH.
+  static constexpr float HUMIDITY_VARIANCE_MAX         = 0.05; // The control holds its output while the variance (%RH^2) of the filtered RH is above this, e.g. right after a sensor error.
+  static const uint16_t PERIOD_DAQ_HUMIDITY_RETRY  = 20;   // Wait time (ms) before fetching again when the RH sensor had no new measurement. Happens now and then, since the sensor runs on its own clock.
+  static const uint8_t HUMIDITY_MISSED_MAX         = 10;   // Number of measurement periods without a new RH reading before it is treated as an error and the periodic mode is restarted.
+  static const uint16_t PERIOD_DAQ = 1000; // Period (ms) between each data acquisition.
+#ifdef FAN_ALERT
+  static const uint16_t PERIOD_DAQ_FAN_ALERT = 5000; // Period (ms) between each fan speed reading with FAN_ALERT.
+  void checkFanAlert();
+#endif // FAN_ALERT
+#ifdef ADAPTIVE_DAQ
+  static const SHT3x::MeasurementRate HUMIDITY_MEASUREMENT_RATE_SLOW = SHT3x::MPS_1;
+  static const uint16_t PERIOD_HUMIDITY_CONTROL_FAST = 500;
+  static const uint16_t PERIOD_HUMIDITY_CONTROL_SLOW = 2000;
+  static const uint16_t PERIOD_DAQ_FAST         = 500;
+  static const uint16_t PERIOD_DAQ_SLOW         = 5000;
+  static constexpr float DAQ_FAST_ERROR         = 1.0;    // Distance (%RH) from the target beyond which the chamber is in a transient
+  static constexpr float DAQ_FAST_SLOPE         = 1.0;    // Rate of change (%RH/min) of the RH beyond which the chamber is in a transient
+  static const uint16_t PERIOD_DAQ_SLOPE        = 10000;  // Time (ms) over which the rate of change is measured; long enough to average out the noise of the filtered RH
+  static const uint16_t DAQ_STEADY_TIME         = 60000;  // Time (ms) without a transient before going to the slow rate
+  void updateDAQRate();
+#endif // ADAPTIVE_DAQ
+  uint16_t getFanSpeedPeriod(const ChamberChannel *channel);
+  uint16_t getHumidityPeriod();
+  uint16_t getHumidityControlPeriod();
+  void requestHumidityReading();
+  void collectHumidityReading();
+  void handleMissingHumidityReading();
+  void requestFanSpeedReading();
+  void collectFanSpeedReading();
 
   // Humidity
-  bool humidityOK_;
-  bool humidityErrorHandlingActive_;
-  bool humidityControlActive_;
-  bool newHumidityReadingPrint_;
-  bool newHumidityReadingControl_;
-  bool humidityTriggered_;
-  bool humidityTriggeredOK_;
   const double humidityMin_;
   const double humidityMax_;
-  const uint8_t pumpDutyCycleMin_;
-  const uint8_t pumpDutyCycleMax_;
-  double humidity_;
-  double humidityTarget_;
-  double humidityControlOutput_;
-  uint8_t pumpDutyCycle_;
-  bool triggerHumidity();
-  bool getHumidity();
+  const uint8_t pumpDutyCycleMin_;  // Pump command (see PumpDrive) below which the pump is off
+  const uint8_t pumpDutyCycleMax_;  // Pump command at and above which the pump is fully on
+  const HumidityGainSchedule humidityGainSchedule_;
+  static constexpr double VALVE_SWITCH_HYSTERESIS = 1.0; // %RH past the target before the scheduled control switches between humidifying and drying
+  bool startHumidityPeriodic();
+  void storeHumidity();
   void toggleHumidityControl(bool enable);
   void setHumidityTarget(double targetPercent);
-  void setPumpDutyCycle(uint8_t dutyCycle);
+  void setPumpCommand(real_t command);
+  void applyHumidityOutput();
+  void changeHumidityControlMode(HUMIDITY_CONTROL_MODE mode);
+  void setScheduledSide(bool humidifying);
+  void computeScheduledHumidityOutput();
+  void applyScheduledHumidityOutput();
+  void saveHumidityPIDTunings();
+  bool loadHumidityPIDTunings();
+
+  // Warm boot (see WARM_BOOT). The run state of each chamber is kept in ConfigStore. It is checked every second, so a new
+  // target or a control started/stopped is saved within a second or two. The integral term changes all the time, so it
+  // is only saved every PERIOD_RUNSTATE_SAVE. Each save is a whole ConfigStore record, which writes the version byte of its
+  // slot twice and its sequence number and CRC once; with the 2 slots, those bytes take about 17500 writes a year at that
+  // rate (the EEPROM is good for 100000), plus one record per change of target or control. The side of the scheduled
+  // control flips all the time near the target, so it isn't kept: the saved output has the sign of its side.
+  static const unsigned long PERIOD_RUNSTATE_SAVE = 1800000; // Time (ms) between each save of the integral term
+  static const uint8_t RUNSTATE_HUMIDITY_ACTIVE  = 0x01;
+  static const uint8_t RUNSTATE_FANSPEED_ACTIVE  = 0x02;
+  static const uint8_t RUNSTATE_SCHEDULED        = 0x04;  // HUMIDITY_CONTROL_SCHEDULED
+  unsigned long runStateSaveTime_;  // Last save of the integral terms
+  bool isWarmBoot();
+  void saveRunStates(bool includeOutput);
+  bool loadRunState(ChamberRunState *state);
+  void restoreRunState(const ChamberRunState &state, bool targetsOnly);
+#ifdef WATCHDOG
+  static const uint8_t WATCHDOG_TIMEOUT = WDTO_2S; // Longer than the longest blocking call (a retryFunc() with every try timing out)
+#endif // WATCHDOG
+
+  // Autotune of the humidity PID (see PIDAutotune.h)
+  static constexpr double AUTOTUNE_HYSTERESIS      = 0.5;  // %RH on either side of the target before the relay switches
+  static const uint8_t AUTOTUNE_CHANNEL_NONE   = 0xFF;
+  static const uint8_t AUTOTUNE_CYCLE_IDLE     = 0xFE; // Shown on the autotune screen when not running
+  PIDAutotune autotune_;
+  uint8_t autotuneChannel_;       // Chamber being autotuned
+  uint8_t autotuneCycleShown_;    // Cycle count on the autotune screen, so that it is only printed when it changes
+  bool beginAutotune(uint8_t channelIndex);
+  void cancelAutotune();
+  bool isAutotuneChannel();
+  void runAutotune();
+
+  // Setpoint program (see SetpointProgram.h). It sets the targets of one chamber at a time.
+  static const uint8_t PROGRAM_CHANNEL_NONE    = 0xFF;
+  SetpointProgram program_;
+  uint8_t programChannel_;        // Chamber running the program
+  bool isProgramChannel();
+  void cancelProgram();
+  void runProgram();
+  void applyProgramStep();
+  uint8_t getProgramStep(uint8_t channelIndex);
 
-  // Temperature
-  double temperature_;
 #ifdef DISPLAY_TEMPERATURE
   // Temperature
-  const uint8_t ROW_READING_TEMPERATURE = 1;
-  const uint8_t TEMPERATURE_DECIMALS = 1; // Number of decimal places displayed for temperature.
+  static const uint8_t ROW_READING_TEMPERATURE = 1;
+  static const uint8_t TEMPERATURE_DECIMALS = 1; // Number of decimal places displayed for temperature.
 #endif // DISPLAY_TEMPERATURE
 
   // Fan speed
-  bool fanSpeedOK_;
-  bool fanSpeedControlActive_;
-  bool newFanSpeedReadingPrint_;
   const double fanSpeedMin_;
   const double fanSpeedMax_;
   const double fanSpeedAbsMin_;
   const uint8_t fanMinDrive_;
-  double fanSpeed_;
-  double fanSpeedTarget_;
+  bool configureFan();
   bool getFanSpeed();
+  void storeFanSpeed();
+  bool getFanStatus();
+  bool hasFanFault();
   bool updateFanSpeedTarget(double targetRPM);
   bool toggleFanSpeedControl(bool enable);
 
   // Serial communication
   bool sendData_ = false;
+  bool sendDataBinary_ = false; // Send the data as binary frames instead of ASCII strings
+  static const uint16_t PERIOD_SEND_MIN = 50;      // Limits (ms) for the period between each data sent to the computer
+  static const uint16_t PERIOD_SEND_MAX = 60000;
+  uint16_t sendPeriod_;
+  void sendCurrentData(bool binary);
+
+  // Telemetry log (see TelemetryLog.h). A sample of every chamber is logged every getDecimation() seconds.
+  static const uint16_t PERIOD_TASK_LOG        = 1000; // The decimation is counted in runs of the log task
+  static const uint16_t PERIOD_TASK_LOG_WRITE  = 4;  // Time (ms) between each byte written to the EEPROM. A write takes 3.3 ms.
+  static const uint16_t PERIOD_TASK_LOG_DUMP   = 2;  // Time (ms) between each check of the transmit buffer while the log is sent
+  TelemetryLog telemetryLog_;
+  uint16_t logSecondsCount_;  // Seconds since the last sample
+  bool logDumping_;
+  bool logDumpHeaderSent_;
+  uint8_t logDumpCount_;
+  uint8_t logDumpIndex_;      // Next record to send
+  uint8_t getLogStatus(ChamberChannel *channel);
+  void restartLog();
 
   // On/off functions
   void togglePump(bool enable);
@@ -280,6 +608,43 @@ private:
   uint8_t getIntegerCount(double value);
 };
 
+template <typename... Params, typename... Args>
+bool HumidOSH::attemptFunc(RetryPolicy *policy, bool (HumidOSH::*func)(Params...), Args... args)
+{
+  if (!policy->isDue(millis()))
+  {
+    return false;
+  }
 
-#endif
+  if ((this->*func)(args...))
+  {
+    policy->recordSuccess();
+    return true;
+  }
+
+  INSTRUMENT_COUNT(INSTR_COUNTER_RETRY);
+  policy->recordFailure(millis());
+  return false;
+}
 
+template <typename... Params, typename... Args>
+bool HumidOSH::retryFunc(RetryPolicy *policy, bool (HumidOSH::*func)(Params...), Args... args)
+{
+  INSTRUMENT_SCOPE(INSTR_SECTION_RETRYFUNC);
+
+  for (uint8_t tries = 0; tries < RETRIES_MAX; tries++)
+  {
+    if ((this->*func)(args...))
+    {
+      policy->recordSuccess();
+      return true;
+    }
+
+    INSTRUMENT_COUNT(INSTR_COUNTER_RETRY);
+    policy->recordFailure(millis());
+  }
+
+  return false;
+}
+
+#endif
@@ -49,6 +49,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "Keypad.h"
 #include "Key.h"
 #include "I2C.h"
+#include "ConfigStore.h"
+#include "PumpDrive.h"
 #include "HumidOSH.h"
 
 
@@ -71,15 +73,26 @@ uint8_t PIN_KEY_COL[KEY_COLS] = { 4, 2, 6, 11 }; // connect to the column pinout
 uint8_t PIN_KEY_ROW[KEY_ROWS] = { 7, 2, 3, 5 }; // connect to the row pinouts of the keypad
 uint8_t PIN_KEY_COL[KEY_COLS] = { 6, 8, 4, 11 }; // connect to the column pinouts of the keypad
 */
+#ifdef RS485
+const uint8_t PIN_LED_RH        = 13; // Along with the on-board LED; pin 12 is the RS-485 driver enable (HUMIDOSH_RS485_DE_PIN)
+#else
 const uint8_t PIN_LED_RH        = 12;
+#endif // RS485
 const uint8_t PIN_LED_FAN       = A3;
 
+// Hardware of each chamber. With HUMIDOSH_CHANNEL_COUNT above 1, add one line per chamber: the second pump goes on pin 10,
+// the second SHT3x has its ADDR pin high, and each EMC2301 is on its own channel of the I2C multiplexer.
+const ChamberConfig CHAMBERS[HUMIDOSH_CHANNEL_COUNT] = {
+  // Pump      Dry valve      Wet valve      Fan drain         RH LED      Fan LED      ADDR high  Mux channel
+  { PIN_PUMP,  PIN_VALVE_DRY, PIN_VALVE_WET, PIN_FAN_PWMDRAIN, PIN_LED_RH, PIN_LED_FAN, false,     0 }
+};
+
 // Limits for controlling humidity and fan speed. This would depend on the system characteristics.
 // For example, all fans have a maximum speed, and some fans have a minimum RPM, below which the fan just stops working.
 // These limits are important to prevent the user from inadvertently setting a target which is unachievable.
 const double RH_MIN         = 0;    // %
 const double RH_MAX         = 100;  // %
-const uint8_t PUMP_MIN      = 70;   // Duty cycle expressed in byte format: min is 0, max is 255. Convert the duty cycle percentage accordingly.
+const uint8_t PUMP_MIN      = 70;   // Pump command (see PumpDrive): min is 0, max is 255 for a duty cycle of 100 %. Convert the duty cycle percentage accordingly.
 const uint8_t PUMP_MAX      = 255;  // See above. Note that the pump doesn't operate below a certain duty cycle.
 const double FANSPEED_USER_MIN  = 1200;   // The minimum fan speed (RPM) allowed for user input.
 const double FANSPEED_USER_MAX  = 7500;   // The maximum fan speed (RPM) allowed for user input.
@@ -95,8 +108,17 @@ const double PID_RH_KP = 5;
 const double PID_RH_KI = 0.001;
 const double PID_RH_KD = 0;
 
+// Gains for the scheduled humidity control (see SERIAL_CMD_HUMIDITY_MODE). Drying through the desiccant is slower than
+// humidifying through the water, so it gets more gain.
+const HumidityGainSchedule RH_GAIN_SCHEDULE = {
+  4, 0.0008, 0,   // Humidifying: Kp, Ki, Kd
+  6, 0.0012, 0,   // Drying: Kp, Ki, Kd
+  0.3,            // Feed-forward gain (output per %RH). Too much of it overshoots past the hysteresis and starts a limit cycle between the two sides.
+  50              // RH of the room (%)
+};
+
 // Serial communication with computer
-const unsigned long baudRate = 9600;
+const unsigned long baudRate = 9600;  // Used until another baud rate is negotiated with the computer (see SERIAL_CMD_BAUD); the negotiated rate is saved (see ConfigStore).
 SerialCommunication communicator = SerialCommunication();
 
 // Init keypad
@@ -108,28 +130,16 @@ Keypad keypad = Keypad(makeKeymap(keys), PIN_KEY_ROW, PIN_KEY_COL, KEY_ROWS, KEY
 
 // Main class
 HumidOSH chamber = HumidOSH(&communicator, &I2c, &keypad,
-                            PIN_PUMP, PIN_VALVE_DRY, PIN_VALVE_WET, PIN_FAN_PWMDRAIN, PIN_LED_RH, PIN_LED_FAN,
+                            CHAMBERS,
                             RH_MIN, RH_MAX, PUMP_MIN, PUMP_MAX, FANSPEED_USER_MIN, FANSPEED_USER_MAX, FANSPEED_ABS_MIN, FAN_DRIVE_MIN,
                             PID_RH_KP, PID_RH_KI, PID_RH_KD,
+                            RH_GAIN_SCHEDULE,
                             KEY_HOLD_DURATION);
 
 void setup()
 {
-  // Configure Timer 1 for PWM @ 25 kHz to reduce noise from controlling pump with PWM.
-  // This affects both pin 9 and 10
-  // From https://arduino.stackexchange.com/a/25623
-  // My explanation: Due to 16-bit nature of Timer 1, it counts from 0 to 320.
-  // Setting to phase-correct PWM makes it count back down, so a total of 640 ticks.
-  // Since prescaler is 1, the final timer frequency is 16 MHz / 640 / 1 = 25 kHz.
-  TCCR1A = 0;           // undo the configuration done by...
-  TCCR1B = 0;           // ...the Arduino core library
-  TCNT1 = 0;            // reset timer
-  TCCR1A = _BV(COM1A1)  // non-inverted PWM on ch. A
-    | _BV(COM1B1)       // same on ch; B
-    | _BV(WGM11);       // mode 10: ph. correct PWM, TOP = ICR1
-  TCCR1B = _BV(WGM13)   // ditto
-    | _BV(CS10);        // prescaler = 1
-  ICR1 = 320;           // TOP = 320
+  // Timer 1 drives the pumps at 25 kHz (see PumpDrive). This affects both pin 9 and 10.
+  PumpDrive::beginTimer();
 
   // Ensure that the PCA9615 chips have enough time to go through the power-up routine.
   delay(100);
@@ -137,19 +147,23 @@ void setup()
   keypad.setHoldTime(KEY_HOLD_DELAY);
   keypad.addEventListener(keypadEvent); //add an event listener for this keypad
 
+  // Load the saved settings before anything asks for them.
+  Config.begin();
+
   communicator.init(baudRate);
+#ifdef RS485
+  communicator.setDriverEnablePin(HUMIDOSH_RS485_DE_PIN);
+#endif // RS485
 
   chamber.init();
-
-  // TODELETE
-  pinMode(LED_BUILTIN, OUTPUT);
 }
 
 // the loop function runs over and over again until power down or reset
 void loop()
 {
-  keypad.getKey();
-  chamber.run();
+  chamber.run(); // Also scans the keypad
+  communicator.checkBaudRateChange();
+  communicator.checkTransmitDone();
 }
 
 void keypadEvent(KeypadEvent key)
@@ -190,6 +204,386 @@ void serialEvent() {
           communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_DAQ_START, true);
           break;
         }
+        case SerialCommunication::SERIAL_CMD_DAQ_START_BINARY:
+        {
+          /*********************************
+          *        START BINARY DAQ        *
+          * *******************************/
+          /* Same as START DAQ, but the data are sent as binary frames (see SerialCommunication.h for the layout).
+          * Format:
+          * ^b@
+          * where    ^            is SERIAL_CMD_START
+          *          b            is SERIAL_CMD_DAQ_START_BINARY
+          *          @            is SERIAL_CMD_END
+          */
+          chamber.startSendDataBinary();
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_DAQ_START_BINARY, true);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_BAUD:
+        {
+          /*********************************
+          *        CHANGE BAUD RATE        *
+          * *******************************/
+          /* Switch to a new baud rate. The response is sent at the current rate, then the rate is switched.
+          * The computer must send the same command again at the new rate within BAUD_CONFIRM_TIMEOUT,
+          * which saves the new rate. Otherwise, the previous rate is restored and a failed response is sent.
+          * Format:
+          * ^u|[baudRate]@
+          * where    ^            is SERIAL_CMD_START
+          *          u            is SERIAL_CMD_BAUD
+          *          [baudRate]   is one of SerialCommunication::BAUD_RATES
+          *          @            is SERIAL_CMD_END
+          */
+          unsigned long newBaudRate = communicator.getFragmentULong(1);
+
+          if (communicator.isBaudRateChangePending())
+          {
+            communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_BAUD, communicator.confirmBaudRateChange(newBaudRate));
+          }
+          else if (communicator.isBaudRateSupported(newBaudRate))
+          {
+            communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_BAUD, true);
+            communicator.beginBaudRateChange(newBaudRate);
+          }
+          else
+          {
+            communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_BAUD, false);
+          }
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_SEND_PERIOD:
+        {
+          /*********************************
+          *        SET SEND PERIOD         *
+          * *******************************/
+          /* Change how often data are sent during DAQ. Fails if the period is out of range or too short for the current baud rate.
+          * The period is saved, and used again after a reset.
+          * Format:
+          * ^p|[period]@
+          * where    ^            is SERIAL_CMD_START
+          *          p            is SERIAL_CMD_SEND_PERIOD
+          *          [period]     is the period (ms) between each data sent
+          *          @            is SERIAL_CMD_END
+          */
+          unsigned long newPeriod = communicator.getFragmentULong(1);
+          bool success = newPeriod <= 0xFFFF && communicator.canSendEvery(newPeriod / HUMIDOSH_CHANNEL_COUNT) && chamber.setSendPeriod(newPeriod);
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_SEND_PERIOD, success);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_HUMIDITY:
+        {
+          /*********************************
+          *        HUMIDITY CONTROL        *
+          * *******************************/
+          /* Set the RH target and start or stop the humidity control.
+          * Format:
+          * ^h|[target]|[enable]@
+          * where    ^            is SERIAL_CMD_START
+          *          h            is SERIAL_CMD_HUMIDITY
+          *          [target]     is the RH target (%)
+          *          [enable]     is 1 to run the control, 0 to stop it
+          *          @            is SERIAL_CMD_END
+          */
+          bool success = chamber.setHumidityControl(communicator.getFragmentDouble(1), communicator.getFragmentInt(2) != 0);
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_HUMIDITY, success);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_FANSPEED:
+        {
+          /*********************************
+          *       FAN SPEED CONTROL        *
+          * *******************************/
+          /* Set the fan speed target and start or stop the fan speed control.
+          * Format:
+          * ^f|[target]|[enable]@
+          * where    ^            is SERIAL_CMD_START
+          *          f            is SERIAL_CMD_FANSPEED
+          *          [target]     is the fan speed target (RPM)
+          *          [enable]     is 1 to run the control, 0 to stop it
+          *          @            is SERIAL_CMD_END
+          */
+          bool success = chamber.setFanSpeedControl(communicator.getFragmentDouble(1), communicator.getFragmentInt(2) != 0);
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_FANSPEED, success);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_PID:
+        {
+          /*********************************
+          *         HUMIDITY PID           *
+          * *******************************/
+          /* Change the PID parameters of the humidity control. They aren't saved: after a reset, the gains of the last
+          * autotune are used, or the defaults if there was none.
+          * Format:
+          * ^k|[Kp]|[Ki]|[Kd]@
+          * where    ^            is SERIAL_CMD_START
+          *          k            is SERIAL_CMD_PID
+          *          [Kp]         is the proportional gain
+          *          [Ki]         is the integral gain (per ms, like PID_RH_KI)
+          *          [Kd]         is the derivative gain
+          *          @            is SERIAL_CMD_END
+          */
+          bool success = chamber.setHumidityPIDTunings(communicator.getFragmentDouble(1), communicator.getFragmentDouble(2), communicator.getFragmentDouble(3));
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_PID, success);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_TASK_STATS:
+        {
+          /*********************************
+          *        TASK STATISTICS         *
+          * *******************************/
+          /* Send the run time statistics of every task, then reset them.
+          * Format:
+          * ^t@
+          * where    ^            is SERIAL_CMD_START
+          *          t            is SERIAL_CMD_TASK_STATS
+          *          @            is SERIAL_CMD_END
+          * Each task is sent as ^t|[taskID]|[runs]|[total run time (us)]|[max run time (us)]|[overruns]@
+          */
+          chamber.sendTaskStats();
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_TASK_STATS, true);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_DEVICE_STATS:
+        {
+          /*********************************
+          *       DEVICE STATISTICS        *
+          * *******************************/
+          /* Send the failure statistics of the RH sensor and fan controller of every chamber, then reset them.
+          * Format:
+          * ^v@
+          * where    ^            is SERIAL_CMD_START
+          *          v            is SERIAL_CMD_DEVICE_STATS
+          *          @            is SERIAL_CMD_END
+          * Each device is sent as ^v|[chamber]|[device]|[attempts]|[failures]|[failures in a row]|[bus resets]@,
+          * where [device] is 0 for the RH sensor and 1 for the fan controller.
+          */
+          chamber.sendDeviceStats();
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_DEVICE_STATS, true);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_LOG_DUMP:
+        {
+          /*********************************
+          *        DUMP TELEMETRY LOG      *
+          * *******************************/
+          /* Send the telemetry log that is kept in EEPROM (see TelemetryLog.h). Fails if the log is already being sent.
+          * Change to a high baud rate first (SERIAL_CMD_BAUD) to keep the transfer short.
+          * Format:
+          * ^l@
+          * where    ^            is SERIAL_CMD_START
+          *          l            is SERIAL_CMD_LOG_DUMP
+          *          @            is SERIAL_CMD_END
+          * The log follows the response as one binary burst (see SERIAL_SEND_LOG_SYNC). No data are sent until it is done.
+          */
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_LOG_DUMP, chamber.startLogDump());
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_LOG_DECIMATION:
+        {
+          /*********************************
+          *     TELEMETRY LOG DECIMATION   *
+          * *******************************/
+          /* Change how often a sample is logged, and start a new session in the log. The decimation is saved (see ConfigStore).
+          * Format:
+          * ^w|[decimation]@
+          * where    ^            is SERIAL_CMD_START
+          *          w            is SERIAL_CMD_LOG_DECIMATION
+          *          [decimation] is the time (s) between each sample, or 0 to stop logging
+          *          @            is SERIAL_CMD_END
+          */
+          unsigned long decimation = communicator.getFragmentULong(1);
+          bool success = decimation <= 0xFFFF;
+
+          if (success)
+          {
+            chamber.setLogDecimation(decimation);
+          }
+
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_LOG_DECIMATION, success);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_LOG_CLEAR:
+        {
+          /*********************************
+          *       CLEAR TELEMETRY LOG      *
+          * *******************************/
+          /* Delete all records of the telemetry log. Fails while the log is being sent.
+          * Format:
+          * ^e@
+          * where    ^            is SERIAL_CMD_START
+          *          e            is SERIAL_CMD_LOG_CLEAR
+          *          @            is SERIAL_CMD_END
+          */
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_LOG_CLEAR, chamber.clearLog());
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_PROGRAM:
+        {
+          /*********************************
+          *     UPLOAD SETPOINT PROGRAM    *
+          * *******************************/
+          /* Replace the setpoint program (see SetpointProgram.h), which is saved (see ConfigStore). Fails while a program is running.
+          * Format:
+          * ^o|[length]@[payload][CRC]
+          * where    ^            is SERIAL_CMD_START
+          *          o            is SERIAL_CMD_PROGRAM
+          *          [length]     is the number of bytes in [payload]
+          *          @            is SERIAL_CMD_END
+          *          [payload]    is the step count (up to SETPOINTPROGRAM_STEP_MAX), then each step as in SetpointProgram_Step (binary, little-endian)
+          *          [CRC]        is the CRC8 of [payload], same CRC as the SHT3x (polynomial 0x31, init 0xFF)
+          * The response is sent once the whole payload is in.
+          */
+          uint8_t length;
+          const uint8_t *payload = communicator.getPayload(&length);
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_PROGRAM, chamber.setProgram(payload, length));
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_PROGRAM_RUN:
+        {
+          /*********************************
+          *      RUN SETPOINT PROGRAM      *
+          * *******************************/
+          /* Start or stop the setpoint program on the chamber selected with SERIAL_CMD_CHANNEL. The step in progress is in the
+          * binary data frame. Stopping the humidity control also stops the program.
+          * Format:
+          * ^q|[enable]@
+          * where    ^            is SERIAL_CMD_START
+          *          q            is SERIAL_CMD_PROGRAM_RUN
+          *          [enable]     is 1 to start the program from its first step, 0 to stop it
+          *          @            is SERIAL_CMD_END
+          */
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_PROGRAM_RUN, chamber.setProgramRun(communicator.getFragmentInt(1) != 0));
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_UNIT_ADDRESS:
+        {
+          /*********************************
+          *          UNIT ADDRESS          *
+          * *******************************/
+          /* Set the address of this controller on a multi-drop bus (e.g. RS-485), which is saved (see ConfigStore). With an
+          * address, every command must start with it, e.g. ^12|n|0@ (see SerialCommunication::UNIT_ADDRESS_NONE).
+          * The response is sent under the old address.
+          * Format:
+          * ^n|[address]@
+          * where    ^            is SERIAL_CMD_START
+          *          n            is SERIAL_CMD_UNIT_ADDRESS
+          *          [address]    is 1 to UNIT_ADDRESS_MAX, or 0 to go back to point-to-point
+          *          @            is SERIAL_CMD_END
+          */
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_UNIT_ADDRESS, communicator.setUnitAddress(communicator.getFragmentULong(1)));
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_READ_DATA:
+        {
+          /*********************************
+          *        READ LATEST DATA        *
+          * *******************************/
+          /* Send the latest binary data frame of every chamber once, then the response. On a multi-drop bus, poll each unit
+          * with this instead of starting the DAQ; a unit only sends while the computer waits for its reply.
+          * Fails while the telemetry log is being sent.
+          * Format:
+          * ^r@
+          * where    ^            is SERIAL_CMD_START
+          *          r            is SERIAL_CMD_READ_DATA
+          *          @            is SERIAL_CMD_END
+          */
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_READ_DATA, chamber.sendLatestData());
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_INSTRUMENTATION:
+        {
+          /*********************************
+          *        INSTRUMENTATION         *
+          * *******************************/
+          /* Send the timing data (see Instrumentation.h and SerialCommunication::sendInstrumentation()), then reset them.
+          * Fails if the sketch was compiled without INSTRUMENTATION.
+          * Format:
+          * ^i@
+          * where    ^            is SERIAL_CMD_START
+          *          i            is SERIAL_CMD_INSTRUMENTATION
+          *          @            is SERIAL_CMD_END
+          */
+#ifdef INSTRUMENTATION
+          communicator.sendInstrumentation();
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_INSTRUMENTATION, true);
+#else
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_INSTRUMENTATION, false);
+#endif // INSTRUMENTATION
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_CHANNEL:
+        {
+          /*********************************
+          *            CHAMBER             *
+          * *******************************/
+          /* Choose the chamber that the next h, f and k commands apply to. Chambers are numbered from 0.
+          * Format:
+          * ^c|[chamber]@
+          * where    ^            is SERIAL_CMD_START
+          *          c            is SERIAL_CMD_CHANNEL
+          *          |            is SERIAL_CMD_SEPARATOR
+          *          [chamber]    is the chamber number
+          *          @            is SERIAL_CMD_END
+          */
+          unsigned long newChannel = communicator.getFragmentULong(1);
+          bool success = newChannel <= 0xFF && chamber.setRemoteChannel(newChannel);
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_CHANNEL, success);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_HUMIDITY_MODE:
+        {
+          /*********************************
+          *     HUMIDITY CONTROL MODE      *
+          * *******************************/
+          /* Choose how the humidity control output is worked out (see HUMIDITY_CONTROL_MODE in HumidOSH.h).
+          * The mode is saved with the run state of the chamber (see WARM_BOOT in HumidOSH.h): a warm boot carries on in it,
+          * while a cold start goes back to the PID mode.
+          * Format:
+          * ^m|[mode]@
+          * where    ^            is SERIAL_CMD_START
+          *          m            is SERIAL_CMD_HUMIDITY_MODE
+          *          [mode]       is 0 for the PID, 1 for separate humidify/dry gains with feed-forward (RH_GAIN_SCHEDULE)
+          *          @            is SERIAL_CMD_END
+          */
+          bool success = chamber.setHumidityControlMode(communicator.getFragmentInt(1));
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_HUMIDITY_MODE, success);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_AUTOTUNE:
+        {
+          /*********************************
+          *          PID AUTOTUNE          *
+          * *******************************/
+          /* Start or cancel the relay autotune of the humidity PID, around the current RH target (see PIDAutotune.h).
+          * The gains are saved (see ConfigStore) once it finishes, and the result is sent (see SerialCommunication::sendAutotuneResult()).
+          * Format:
+          * ^a|[enable]@
+          * where    ^            is SERIAL_CMD_START
+          *          a            is SERIAL_CMD_AUTOTUNE
+          *          [enable]     is 1 to start, 0 to cancel
+          *          @            is SERIAL_CMD_END
+          */
+          bool success = chamber.setHumidityAutotune(communicator.getFragmentInt(1) != 0);
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_AUTOTUNE, success);
+          break;
+        }
+        case SerialCommunication::SERIAL_CMD_STEP_RESPONSE:
+        {
+          /*********************************
+          *         STEP RESPONSE          *
+          * *******************************/
+          /* Send the settling time and overshoot of the RH control of every chamber (see SerialCommunication::sendStepResponse()).
+          * Format:
+          * ^g@
+          * where    ^            is SERIAL_CMD_START
+          *          g            is SERIAL_CMD_STEP_RESPONSE
+          *          @            is SERIAL_CMD_END
+          */
+          chamber.sendStepResponse();
+          communicator.sendCommandResponse(SerialCommunication::SERIAL_CMD_STEP_RESPONSE, true);
+          break;
+        }
         case SerialCommunication::SERIAL_CMD_DAQ_STOP:
         {
           /*********************************
@@ -0,0 +1,139 @@
+/*********************************************************************************
+Filter for the readings of the RH sensor.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "HumidityFilter.h"
+
+HumidityFilter::HumidityFilter()
+{
+  reset();
+}
+
+// Forget all samples, e.g. after the sensor had an error.
+void HumidityFilter::reset()
+{
+  sampleCount_  = 0;
+  nextSample_   = 0;
+  RH_           = 0;
+  variance_     = VARIANCE_INITIAL;
+  temperature_  = 0;
+}
+
+void HumidityFilter::addSample(float RH, float temperature)
+{
+  RHSamples_[nextSample_] = RH;
+  temperatureSamples_[nextSample_] = temperature;
+  nextSample_ = (nextSample_ + 1) % WINDOW_LENGTH;
+
+  if (sampleCount_ < WINDOW_LENGTH)
+  {
+    sampleCount_++;
+  }
+
+  float RHMedian = getMedian(RHSamples_);
+  temperature_ = getMedian(temperatureSamples_);
+
+  if (sampleCount_ < WINDOW_LENGTH)
+  { // Too few samples to tell a spike apart; just follow the median until the window is full.
+    RH_ = RHMedian;
+    variance_ = VARIANCE_INITIAL;
+    return;
+  }
+
+  if (fabs(RH - RHMedian) > REJECT_BAND)
+  {
+    RH = RHMedian;
+  }
+
+  float measurementNoise = getWindowVariance(RHMedian);
+
+  if (measurementNoise < MEASUREMENT_NOISE_MIN)
+  {
+    measurementNoise = MEASUREMENT_NOISE_MIN;
+  }
+
+  // Predict, then correct with the sample.
+  variance_ += PROCESS_NOISE;
+  float gain = variance_ / (variance_ + measurementNoise);
+  RH_ += gain * (RH - RH_);
+  variance_ *= 1 - gain;
+}
+
+// Whether there has been a sample since the last reset.
+bool HumidityFilter::isReady()
+{
+  return sampleCount_ > 0;
+}
+
+float HumidityFilter::getRH()
+{
+  return RH_;
+}
+
+float HumidityFilter::getTemperature()
+{
+  return temperature_;
+}
+
+// Variance (%RH^2) of the RH estimate
+float HumidityFilter::getVariance()
+{
+  return variance_;
+}
+
+// Median of the samples in the window. Insertion sort on a copy, which is quick enough for a handful of samples.
+float HumidityFilter::getMedian(const float samples[])
+{
+  float sorted[WINDOW_LENGTH];
+
+  for (uint8_t i = 0; i < sampleCount_; i++)
+  {
+    float value = samples[i];
+    uint8_t j = i;
+
+    while (j > 0 && sorted[j - 1] > value)
+    {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+
+    sorted[j] = value;
+  }
+
+  return sorted[sampleCount_ / 2];
+}
+
+// Spread of the RH samples in the window around their median, taken as the measurement noise.
+// Rejected samples are left out, so that a spike doesn't make the filter distrust the samples after it.
+float HumidityFilter::getWindowVariance(float median)
+{
+  float sumSquares = 0;
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < sampleCount_; i++)
+  {
+    float deviation = RHSamples_[i] - median;
+
+    if (fabs(deviation) <= REJECT_BAND)
+    {
+      sumSquares += deviation * deviation;
+      count++;
+    }
+  }
+
+  return sumSquares / count; // The median itself is always counted
+}
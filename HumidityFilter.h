@@ -0,0 +1,74 @@
+/*********************************************************************************
+Filter for the readings of the RH sensor.
+
+The sensor is sampled faster than the control runs, and every sample goes through
+two stages:
+1) Median rejection: the last WINDOW_LENGTH samples are kept in a ring buffer, and
+   a sample farther than REJECT_BAND from their median is replaced by the median.
+   This gets rid of the odd spike without delaying real changes.
+2) A 1-D Kalman filter on the RH, with the RH modelled as a random walk. The
+   measurement noise is estimated from the spread of the samples in the window,
+   so the filter relies more on the incoming samples when the sensor is quiet.
+   The temperature is only median filtered.
+
+getVariance() is the variance of the RH estimate, which is large right after a
+reset and shrinks as samples come in. The process noise is per sample, so the
+filter gets smoother as the sampling rate goes up.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _HUMIDITYFILTER_h
+#define _HUMIDITYFILTER_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+class HumidityFilter
+{
+public:
+  static const uint8_t WINDOW_LENGTH = 5;  // Samples kept for the median; odd so that the median is one of them
+
+  HumidityFilter();
+  void reset();
+  void addSample(float RH, float temperature);
+  bool isReady();
+  float getRH();
+  float getTemperature();
+  float getVariance();
+
+private:
+  static constexpr float REJECT_BAND         = 3.0;    // Max distance (%RH) of a sample from the median before it is rejected
+  static constexpr float PROCESS_NOISE       = 0.001;  // Variance (%RH^2) of the change of the actual RH between two samples
+  static constexpr float MEASUREMENT_NOISE_MIN = 0.0025; // Floor (%RH^2) for the measurement noise, so that a run of identical samples doesn't freeze the filter
+  static constexpr float VARIANCE_INITIAL    = 1.0;    // Variance (%RH^2) of the estimate after the first sample
+
+  float RHSamples_[WINDOW_LENGTH];
+  float temperatureSamples_[WINDOW_LENGTH];
+  uint8_t sampleCount_;   // Samples in the window, up to WINDOW_LENGTH
+  uint8_t nextSample_;    // Where the next sample goes in the ring buffer
+  float RH_;              // Estimate
+  float variance_;        // Variance of the estimate
+  float temperature_;
+
+  float getMedian(const float samples[]);
+  float getWindowVariance(float median);
+};
+
+#endif
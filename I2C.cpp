@@ -56,6 +56,9 @@ Modified by Soon Kiat Lau (2019) for:
 - ping function
 - error codes
 - allow user to enable/disable internal pull-up resistors in begin()
+- interrupt-driven transaction queue
+- bus settings per device
+- bus recovery and quarantine of failing devices
 */
 
 #include "I2C.h"
@@ -68,6 +71,20 @@ uint8_t I2C::totalBytes_ = 0;
 
 I2C::I2C()
 {
+  queueHead_    = 0;
+  queueCount_   = 0;
+  asyncActive_  = false;
+  profileCount_ = 0;
+
+  defaultProfile_.address         = 0;
+  defaultProfile_.bitRate         = I2C_TWBR_100KHZ;
+  defaultProfile_.stretchTimeOut  = 0;
+  defaultProfile_.retries         = 0;
+  defaultProfile_.timeOut         = 0;
+  defaultProfile_.failures        = 0;
+  defaultProfile_.skipped         = false;
+  profile_      = &defaultProfile_;
+  asyncProfile_ = &defaultProfile_;
 }
 
 
@@ -88,8 +105,8 @@ void I2C::begin(bool enableInternalPullUps)
   cbi(TWSR, TWPS0);
   cbi(TWSR, TWPS1);
 
-  // Defaults to 100 kHz
-  TWBR = ((F_CPU / 100000) - 16) / 2;
+  // Defaults to 100 kHz until a transaction applies its profile
+  TWBR = I2C_TWBR_100KHZ;
   // enable twi module and acks
   TWCR = _BV(TWEN) | _BV(TWEA);
 }
@@ -99,26 +116,41 @@ void I2C::end()
   TWCR = 0;
 }
 
+// Timeout (ms) of a whole transaction with a device that has no profile.
 void I2C::setTimeOut(uint16_t timeOut)
 {
-  timeOut_ = timeOut;
+  defaultProfile_.timeOut = timeOut;
 }
 
-// Call setSpeed AFTER begin(), because begin() sets speed to 100 kHz
+// Bus clock for the devices that have no profile: 400 kHz (fast-mode) or 100 kHz (standard mode).
 void I2C::setSpeed(bool useFastMode)
 {
-  useFastMode_ = useFastMode;
+  defaultProfile_.bitRate = useFastMode ? I2C_TWBR_400KHZ : I2C_TWBR_100KHZ;
+}
 
-  if (!useFastMode)
-  {
-    // 100 kHz
-    TWBR = ((F_CPU / 100000) - 16) / 2;
-  }
-  else
+// Give the device at address its own bus settings (see I2C_Profile). Setting the same address again replaces them.
+bool I2C::setProfile(uint8_t address, uint8_t bitRate, uint16_t timeOut, uint8_t stretchTimeOut, uint8_t retries)
+{
+  I2C_Profile *profile = findProfile(address);
+
+  if (profile == &defaultProfile_)
   {
-    // 400 kHz
-    TWBR = ((F_CPU / 400000) - 16) / 2;
+    if (profileCount_ >= I2C_PROFILE_COUNT)
+    {
+      return false;
+    }
+
+    profile = &profiles_[profileCount_++];
   }
+
+  profile->address        = address;
+  profile->bitRate        = bitRate;
+  profile->stretchTimeOut = stretchTimeOut;
+  profile->retries        = retries;
+  profile->timeOut        = timeOut;
+  profile->failures       = 0;
+  profile->skipped        = false;
+  return true;
 }
 
 void I2C::pullup(bool activate)
@@ -155,10 +187,10 @@ void I2C::pullup(bool activate)
 
 void I2C::scan()
 {
-  uint16_t tempTime = timeOut_;
+  uint16_t tempTime = defaultProfile_.timeOut;
   setTimeOut(80);
   uint8_t totalDevicesFound = 0;
-  Serial.println("Scanning for devices...please wait");
+  Serial.println(F("Scanning for devices...please wait"));
   Serial.println();
   for (uint8_t s = 0; s <= 0x7F; s++)
   {
@@ -170,22 +202,22 @@ void I2C::scan()
       if (returnStatus_ != I2C_STATUS_BEGIN_NACK)
       {// Will receive a NACK if a device has the address, but is unable to communicate now. Therefore, that is not a problem with the I2C bus.
         // Other errors indicate there is a problem with the bus.
-        Serial.println("There is a problem with the bus, could not complete scan");
-        timeOut_ = tempTime;
+        Serial.println(F("There is a problem with the bus, could not complete scan"));
+        setTimeOut(tempTime);
         return;
       }
     }
     else
     {
-      Serial.print("Found device at address - ");
-      Serial.print(" 0x");
+      Serial.print(F("Found device at address - "));
+      Serial.print(F(" 0x"));
       Serial.println(s, HEX);
       totalDevicesFound++;
     }
     stop();
   }
-  if (!totalDevicesFound) { Serial.println("No devices found"); }
-  timeOut_ = tempTime;
+  if (!totalDevicesFound) { Serial.println(F("No devices found")); }
+  setTimeOut(tempTime);
 }
 
 
@@ -478,50 +510,47 @@ I2C_STATUS I2C::read(int address, int registerAddress, int numberBytes)
 ///////////////////// Abstractions of some of the private functions to return the appropriate I2C_STATUS /////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-// Send out start bit, the address, and read/write byte (depending on second argument)
+// Send out start bit, the address, and read/write byte (depending on second argument).
+// A new transaction (not a repeated start) uses the profile of the address, and is started again if it loses arbitration.
+// Returns I2C_STATUS_QUARANTINED right away if the device is in quarantine.
 I2C_STATUS I2C::beginTransmission(uint8_t address, bool write, bool repeatedStart)
 {
-  // Start bit
-  TWSRStatus_ = start();
-  if (TWSRStatus_ != TWSR_STATUS_STARTED)
+  if (repeatedStart)
   {
-    if (repeatedStart)
-    {
-      return(I2C_STATUS_REPSTART_TIMEOUT);
-    }
-    else
-    {
-      return(I2C_STATUS_START_TIMEOUT);
-    }
+    return trackStatus(profile_, sendStartAndAddress(address, write, true), false);
   }
 
-  // Address
-  TWSRStatus_ = sendAddress(write ? SLA_W(address) : SLA_R(address));
-  if (TWSRStatus_ != TWSR_STATUS_ACK)
+  // Don't grab the bus while an interrupt-driven transaction is using it.
+  waitAsyncIdle();
+
+  profile_ = findProfile(address);
+  profile_->skipped = isQuarantined(profile_);
+
+  if (profile_->skipped)
   {
-    switch (TWSRStatus_)
-    {
-    case TWSR_STATUS_TIMEOUT:
-      return I2C_STATUS_BEGIN_TIMEOUT;
-      break;
-    case TWSR_STATUS_NACK:
-      return I2C_STATUS_BEGIN_NACK;
-      break;
-    case TWSR_STATUS_LOSTARB:
-      return I2C_STATUS_BEGIN_LOSTARB;
-      break;
-    default:
-      return I2C_STATUS_UNKNOWN;
-      break;
-    }
+    return I2C_STATUS_QUARANTINED;
   }
-  else
+
+  transactionStartTime_ = millis();
+  uint8_t retries = profile_->retries;
+  I2C_STATUS status;
+
+  do
   {
-    return I2C_STATUS_OK;
-  }
+    // Again on every try, since losing arbitration resets the bus.
+    applyBitRate(profile_->bitRate);
+    status = sendStartAndAddress(address, write, false);
+  } while (status == I2C_STATUS_BEGIN_LOSTARB && retries-- > 0);
+
+  return trackStatus(profile_, status, false);
 }
 
 I2C_STATUS I2C::transmit(uint8_t dataByte)
+{
+  return trackStatus(profile_, transmitByte(dataByte), false);
+}
+
+I2C_STATUS I2C::transmitByte(uint8_t dataByte)
 {
   TWSRStatus_ = sendByte(dataByte);
   if (TWSRStatus_ != TWSR_STATUS_ACK)
@@ -546,6 +575,11 @@ I2C_STATUS I2C::transmit(uint8_t dataByte)
 }
 
 I2C_STATUS I2C::receive(bool sendACK)
+{
+  return trackStatus(profile_, receiveAndCheck(sendACK), false);
+}
+
+I2C_STATUS I2C::receiveAndCheck(bool sendACK)
 {
   if (sendACK)
   {
@@ -606,12 +640,164 @@ I2C_STATUS I2C::endTransmission()
   TWSRStatus_ = stop();
   if (TWSRStatus_ != TWSR_STATUS_STOPPED)
   {
-    if (TWSRStatus_ == TWSR_STATUS_TIMEOUT) { return(I2C_STATUS_STOP_TIMEOUT); }
-    else { return(I2C_STATUS_UNKNOWN); }
+    if (TWSRStatus_ == TWSR_STATUS_TIMEOUT) { return trackStatus(profile_, I2C_STATUS_STOP_TIMEOUT, true); }
+    else { return trackStatus(profile_, I2C_STATUS_UNKNOWN, true); }
   }
   else
   {
-    return I2C_STATUS_OK;
+    return trackStatus(profile_, I2C_STATUS_OK, true);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////// Interrupt-driven transactions /////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Queue a transaction to be performed in the background by the TWI interrupt.
+// Returns I2C_STATUS_PENDING if queued; the outcome is placed in transaction->status once transaction->complete is true.
+// Returns I2C_STATUS_QUARANTINED (and queues nothing) if the device is in quarantine.
+I2C_STATUS I2C::submit(I2C_Transaction *transaction)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+
+  if (queueCount_ >= I2C_QUEUE_SIZE)
+  {
+    SREG = oldSREG;
+    return I2C_STATUS_QUEUE_FULL;
+  }
+
+  I2C_Profile *profile = findProfile(transaction->address);
+  profile->skipped = isQuarantined(profile);
+
+  if (profile->skipped)
+  {
+    SREG = oldSREG;
+    return I2C_STATUS_QUARANTINED;
+  }
+
+  transaction->status   = I2C_STATUS_PENDING;
+  transaction->complete = false;
+  queue_[(queueHead_ + queueCount_) % I2C_QUEUE_SIZE] = transaction;
+  queueCount_++;
+
+  // Kick off the transaction right away if the bus is free. Otherwise, the interrupt will start it after the current one.
+  if (!asyncActive_) { startAsync(); }
+
+  SREG = oldSREG;
+  return I2C_STATUS_PENDING;
+}
+
+// True if there are interrupt-driven transactions queued or in progress.
+bool I2C::isBusy()
+{
+  return asyncActive_;
+}
+
+// Aborts the transaction on the bus (and resets the bus) if it has taken longer than the timeout.
+// Without this, a slave holding the bus would stall the queue forever, since no more interrupts will come.
+void I2C::poll()
+{
+  if (!asyncActive_ || !asyncProfile_->timeOut) { return; }
+
+  uint8_t oldSREG = SREG;
+  cli();
+
+  if (asyncActive_ && (millis() - asyncStartTime_) >= asyncProfile_->timeOut)
+  {
+    INSTRUMENT_COUNT(INSTR_COUNTER_I2C_TIMEOUT);
+    resetI2CBus();
+    finishAsync(I2C_STATUS_ASYNC_TIMEOUT, false);
+  }
+
+  SREG = oldSREG;
+}
+
+// State machine for the interrupt-driven transactions. Each TWI interrupt moves the transaction at the head of the queue one step forward.
+void I2C::handleInterrupt()
+{
+  I2C_Transaction *transaction = queue_[queueHead_];
+
+  switch (TWI_STATUS)
+  {
+  case START:
+  case REPEATED_START:
+    // Write first if there are bytes to send (or if there is nothing to read, i.e. a ping); otherwise go straight to reading.
+    if (asyncTxIndex_ < transaction->txLength || transaction->rxLength == 0)
+    {
+      TWDR = SLA_W(transaction->address);
+    }
+    else
+    {
+      TWDR = SLA_R(transaction->address);
+    }
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+    break;
+  case MT_SLA_ACK:
+  case MT_DATA_ACK:
+    if (asyncTxIndex_ < transaction->txLength)
+    { // Send the next byte
+      TWDR = transaction->txBuffer[asyncTxIndex_++];
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+    }
+    else if (transaction->rxLength > 0)
+    { // Done writing; repeated start to begin reading
+      TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+    }
+    else
+    {
+      finishAsync(I2C_STATUS_OK, true);
+    }
+    break;
+  case MT_SLA_NACK:
+  case MR_SLA_NACK:
+    // Some devices do this to indicate they are busy, e.g. the SHT3x while it is still measuring.
+    finishAsync(I2C_STATUS_BEGIN_NACK, true);
+    break;
+  case MT_DATA_NACK:
+    finishAsync(I2C_STATUS_TRS_NACK, true);
+    break;
+  case MR_DATA_ACK:
+    transaction->rxBuffer[asyncRxIndex_++] = TWDR;
+    // Fall through to decide whether the next byte gets an ACK or a NACK
+  case MR_SLA_ACK:
+    if (asyncRxIndex_ + 1 < transaction->rxLength)
+    { // Expecting more bytes after the next one
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+    }
+    else
+    { // The next byte is the last one, answer it with a NACK
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+    }
+    break;
+  case MR_DATA_NACK:
+    transaction->rxBuffer[asyncRxIndex_++] = TWDR;
+    finishAsync(I2C_STATUS_OK, true);
+    break;
+  case LOST_ARBTRTN:
+    if (asyncRetries_ > 0)
+    { // Start over once the bus is free again
+      asyncRetries_--;
+      asyncTxIndex_ = 0;
+      asyncRxIndex_ = 0;
+      TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+      break;
+    }
+
+    // Let go of the bus (no STOP, since we don't own it anymore).
+    if (asyncTxIndex_ == 0 && asyncRxIndex_ == 0)
+    {
+      finishAsync(I2C_STATUS_BEGIN_LOSTARB, false);
+    }
+    else
+    {
+      finishAsync(I2C_STATUS_REC_LOSTARB, false);
+    }
+    break;
+  default:
+    resetI2CBus();
+    finishAsync(I2C_STATUS_UNKNOWN, false);
+    break;
   }
 }
 
@@ -619,15 +805,61 @@ I2C_STATUS I2C::endTransmission()
 /////////////// Private Methods ///////////////////////////////
 ///////////////////////////////////////////////////////////////
 
+I2C_STATUS I2C::sendStartAndAddress(uint8_t address, bool write, bool repeatedStart)
+{
+  // Start bit
+  TWSRStatus_ = start();
+  if (TWSRStatus_ != TWSR_STATUS_STARTED)
+  {
+    if (TWSRStatus_ == TWSR_STATUS_LOSTARB)
+    {
+      return(I2C_STATUS_BEGIN_LOSTARB);
+    }
+    else if (repeatedStart)
+    {
+      return(I2C_STATUS_REPSTART_TIMEOUT);
+    }
+    else
+    {
+      return(I2C_STATUS_START_TIMEOUT);
+    }
+  }
+
+  // Address
+  TWSRStatus_ = sendAddress(write ? SLA_W(address) : SLA_R(address));
+  if (TWSRStatus_ != TWSR_STATUS_ACK)
+  {
+    switch (TWSRStatus_)
+    {
+    case TWSR_STATUS_TIMEOUT:
+      return I2C_STATUS_BEGIN_TIMEOUT;
+      break;
+    case TWSR_STATUS_NACK:
+      return I2C_STATUS_BEGIN_NACK;
+      break;
+    case TWSR_STATUS_LOSTARB:
+      return I2C_STATUS_BEGIN_LOSTARB;
+      break;
+    default:
+      return I2C_STATUS_UNKNOWN;
+      break;
+    }
+  }
+  else
+  {
+    return I2C_STATUS_OK;
+  }
+}
+
 TWSR_STATUS I2C::start()
 {
   unsigned long startingTime = millis();
   TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
   while (!(TWCR & (1 << TWINT)))
   {
-    if (!timeOut_) { continue; }
-    if ((millis() - startingTime) >= timeOut_)
+    if (isTimedOut(startingTime))
     {
+      INSTRUMENT_COUNT(INSTR_COUNTER_I2C_TIMEOUT);
       resetI2CBus();
       return(TWSR_STATUS_TIMEOUT);
     }
@@ -652,10 +884,10 @@ TWSR_STATUS I2C::sendAddress(uint8_t i2cAddress)
   TWCR = (1 << TWINT) | (1 << TWEN);
   while (!(TWCR & (1 << TWINT)))
   {
-    if (!timeOut_) { continue; }
-    if ((millis() - startingTime) >= timeOut_)
+    if (isTimedOut(startingTime))
     {
       // Time out error
+      INSTRUMENT_COUNT(INSTR_COUNTER_I2C_TIMEOUT);
       resetI2CBus();
       return(TWSR_STATUS_TIMEOUT);
     }
@@ -672,6 +904,11 @@ TWSR_STATUS I2C::sendAddress(uint8_t i2cAddress)
     stop();
     return(TWSR_STATUS_NACK);
   }
+  else if (TWI_STATUS == LOST_ARBTRTN)
+  {
+    resetI2CBus();
+    return(TWSR_STATUS_LOSTARB);
+  }
   else
   {
     // Unknown error
@@ -687,9 +924,9 @@ TWSR_STATUS I2C::sendByte(uint8_t i2cData)
   TWCR = (1 << TWINT) | (1 << TWEN);
   while (!(TWCR & (1 << TWINT)))
   {
-    if (!timeOut_) { continue; }
-    if ((millis() - startingTime) >= timeOut_)
+    if (isTimedOut(startingTime))
     {
+      INSTRUMENT_COUNT(INSTR_COUNTER_I2C_TIMEOUT);
       resetI2CBus();
       return(TWSR_STATUS_TIMEOUT);
     }
@@ -725,9 +962,9 @@ TWSR_STATUS I2C::receiveByte(bool sendACK)
   }
   while (!(TWCR & (1 << TWINT)))
   {
-    if (!timeOut_) { continue; }
-    if ((millis() - startingTime) >= timeOut_)
+    if (isTimedOut(startingTime))
     {
+      INSTRUMENT_COUNT(INSTR_COUNTER_I2C_TIMEOUT);
       resetI2CBus();
       return(TWSR_STATUS_TIMEOUT);
     }
@@ -754,9 +991,9 @@ TWSR_STATUS I2C::stop()
   TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
   while ((TWCR & (1 << TWSTO)))
   {
-    if (!timeOut_) { continue; }
-    if ((millis() - startingTime) >= timeOut_)
+    if (isTimedOut(startingTime))
     {
+      INSTRUMENT_COUNT(INSTR_COUNTER_I2C_TIMEOUT);
       resetI2CBus();
       return(TWSR_STATUS_TIMEOUT);
     }
@@ -764,15 +1001,220 @@ TWSR_STATUS I2C::stop()
   return(TWSR_STATUS_STOPPED);
 }
 
+// Start the transaction at the head of the queue by sending a start bit. The rest is done by the TWI interrupt.
+// Must be called with interrupts disabled (or from the TWI interrupt).
+void I2C::startAsync()
+{
+  asyncProfile_   = findProfile(queue_[queueHead_]->address);
+  asyncRetries_   = asyncProfile_->retries;
+  asyncTxIndex_   = 0;
+  asyncRxIndex_   = 0;
+  asyncActive_    = true;
+  asyncStartTime_ = millis();
+  applyBitRate(asyncProfile_->bitRate);
+  TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+}
+
+// Wrap up the transaction at the head of the queue and move on to the next one, if any.
+// Must be called with interrupts disabled (or from the TWI interrupt).
+void I2C::finishAsync(I2C_STATUS status, bool sendStop)
+{
+  I2C_Transaction *transaction = queue_[queueHead_];
+
+  if (sendStop)
+  {
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+
+    // The stop bit only takes a few microseconds; the counter is only there so that a broken bus can't hang the interrupt.
+    uint16_t spins = 1000;
+    while ((TWCR & _BV(TWSTO)) && --spins) {}
+  }
+  else
+  {
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA);
+  }
+
+  trackStatus(asyncProfile_, status, true);
+  queueHead_ = (queueHead_ + 1) % I2C_QUEUE_SIZE;
+  queueCount_--;
+
+  transaction->status   = status;
+  transaction->complete = true;
+  if (transaction->callback) { transaction->callback(transaction); }
+
+  if (queueCount_ > 0)
+  {
+    startAsync();
+  }
+  else
+  {
+    asyncActive_ = false;
+  }
+}
+
+// Block until all the interrupt-driven transactions are done.
+void I2C::waitAsyncIdle()
+{
+  while (asyncActive_)
+  {
+    poll();
+  }
+}
+
 // Resets the I2C bus. This helps to solve a "stuck" I2C bus due to failure of arbitration.
 void I2C::resetI2CBus()
 {
+  INSTRUMENT_COUNT(INSTR_COUNTER_I2C_RESET);
+
   TWCR = 0; //releases SDA and SCL lines to high impedance
 
-  // Re-initialize the I2C bus.
+  // A slave that was cut off in the middle of a byte keeps SDA low, waiting for the rest of its clock pulses.
+  if (!(I2C_PIN & _BV(I2C_BIT_SDA)))
+  {
+    clockOutBus();
+  }
+
+  // Re-initialize the I2C bus. The next transaction sets the bus clock of its device again.
   begin(enableInternalPullUps_);
-  setSpeed(useFastMode_);
+}
+
+// Profile of the device at address, or the defaults if it has none.
+I2C_Profile * I2C::findProfile(uint8_t address)
+{
+  for (uint8_t i = 0; i < profileCount_; i++)
+  {
+    if (profiles_[i].address == address)
+    {
+      return &profiles_[i];
+    }
+  }
+
+  return &defaultProfile_;
+}
+
+// Only call while the bus is idle, i.e. before a start bit.
+void I2C::applyBitRate(uint8_t bitRate)
+{
+  if (TWBR != bitRate)
+  {
+    TWBR = bitRate;
+  }
+}
+
+// Whether the last transaction with the device was skipped for its quarantine. Devices without a profile are never skipped.
+bool I2C::wasSkipped(uint8_t address)
+{
+  return findProfile(address)->skipped;
+}
+
+// Whether the device is in quarantine (see I2C_FAILURES_MAX). Once the time is up, the next transaction goes through as a try.
+bool I2C::isQuarantined(const I2C_Profile *profile)
+{
+  if (profile->failures < I2C_FAILURES_MAX)
+  {
+    return false;
+  }
+
+  uint8_t doublings = min(profile->failures - I2C_FAILURES_MAX, I2C_QUARANTINE_DOUBLINGS_MAX);
+  return (millis() - profile->quarantineStart) < ((unsigned long) I2C_QUARANTINE_TIME << doublings);
+}
+
+// Keep the health of the device up to date with the status of a step of its transaction; done is true for the last step.
+// Only devices with a profile are tracked. Returns status, so that it can wrap the return value.
+I2C_STATUS I2C::trackStatus(I2C_Profile *profile, I2C_STATUS status, bool done)
+{
+  if (profile == &defaultProfile_)
+  {
+    return status;
+  }
+
+  switch (status)
+  {
+  case I2C_STATUS_OK:
+    if (done) { profile->failures = 0; }
+    break;
+  case I2C_STATUS_START_TIMEOUT:
+  case I2C_STATUS_REPSTART_TIMEOUT:
+  case I2C_STATUS_BEGIN_TIMEOUT:
+  case I2C_STATUS_BEGIN_LOSTARB:
+  case I2C_STATUS_TRS_TIMEOUT:
+  case I2C_STATUS_REC_TIMEOUT:
+  case I2C_STATUS_REC_LOSTARB:
+  case I2C_STATUS_STOP_TIMEOUT:
+  case I2C_STATUS_ASYNC_TIMEOUT:
+  case I2C_STATUS_UNKNOWN:
+    if (profile->failures < 0xFF) { profile->failures++; }
+
+    if (profile->failures >= I2C_FAILURES_MAX)
+    {
+      if (profile->failures == I2C_FAILURES_MAX) { INSTRUMENT_COUNT(INSTR_COUNTER_I2C_QUARANTINE); }
+      profile->quarantineStart = millis();
+    }
+    break;
+  default:
+    // A NACK is an answer, and says nothing about the health of the device.
+    break;
+  }
+
+  return status;
+}
+
+// Free a bus that a slave holds by keeping SDA low: clock out the rest of its byte until it lets go of SDA, then send a
+// stop. Done by hand, since the TWI peripheral won't start while the bus is busy.
+void I2C::clockOutBus()
+{
+  for (uint8_t i = 0; i < I2C_CLOCKOUT_PULSES && !(I2C_PIN & _BV(I2C_BIT_SDA)); i++)
+  {
+    driveLineLow(I2C_BIT_SCL);
+    delayMicroseconds(I2C_CLOCKOUT_HALF_PERIOD);
+    releaseLine(I2C_BIT_SCL);
+    delayMicroseconds(I2C_CLOCKOUT_HALF_PERIOD);
+  }
+
+  // Stop: SDA goes high while SCL is high
+  driveLineLow(I2C_BIT_SCL);
+  driveLineLow(I2C_BIT_SDA);
+  delayMicroseconds(I2C_CLOCKOUT_HALF_PERIOD);
+  releaseLine(I2C_BIT_SCL);
+  delayMicroseconds(I2C_CLOCKOUT_HALF_PERIOD);
+  releaseLine(I2C_BIT_SDA);
+  delayMicroseconds(I2C_CLOCKOUT_HALF_PERIOD);
+}
+
+// The bus is open-drain: a line is either pulled low, or left to the pull-ups.
+void I2C::driveLineLow(uint8_t bit)
+{
+  cbi(I2C_PORT, bit);
+  sbi(I2C_DDR, bit);
+}
+
+void I2C::releaseLine(uint8_t bit)
+{
+  cbi(I2C_DDR, bit);
+
+  if (enableInternalPullUps_)
+  {
+    sbi(I2C_PORT, bit);
+  }
+}
+
+// Whether a step of the blocking transaction that began at stepStartTime has taken too long, by the profile of the device.
+bool I2C::isTimedOut(unsigned long stepStartTime)
+{
+  unsigned long now = millis();
+
+  if (profile_->stretchTimeOut && (now - stepStartTime) >= profile_->stretchTimeOut)
+  {
+    return true;
+  }
+
+  return profile_->timeOut && (now - transactionStartTime_) >= profile_->timeOut;
 }
 
 I2C I2c = I2C();
 
+ISR(TWI_vect)
+{
+  I2c.handleInterrupt();
+}
+
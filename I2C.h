@@ -57,6 +57,9 @@ Modified by Soon Kiat Lau (2019):
 - ping function
 - added additional read/write functions to ignore the read/write register
 - allow user to enable/disable internal pull-up resistors in begin()
+- interrupt-driven transaction queue (submit()/poll()) alongside the blocking functions
+- bus settings per device (setProfile()), applied at the start of every transaction
+- a stuck bus is clocked out in resetI2CBus(), and a device that keeps failing is quarantined
 */
 
 #ifndef _I2C_h
@@ -69,6 +72,7 @@ Modified by Soon Kiat Lau (2019):
 #endif
 
 #include <inttypes.h>
+#include "Instrumentation.h"
 
 #ifndef I2C_h
 #define I2C_h
@@ -96,6 +100,36 @@ Modified by Soon Kiat Lau (2019):
 #define sbi(sfr, bit)   (_SFR_BYTE(sfr) |= _BV(bit))
 
 #define MAX_BUFFER_SIZE 32
+#define I2C_QUEUE_SIZE  4   // Max number of interrupt-driven transactions that can be waiting for the bus at once.
+#define I2C_PROFILE_COUNT 6 // Max number of devices with their own bus settings (see setProfile()).
+
+// TWBR values for the bus clock, with the prescaler at 1.
+#define I2C_TWBR_100KHZ (((F_CPU / 100000) - 16) / 2)
+#define I2C_TWBR_400KHZ (((F_CPU / 400000) - 16) / 2)
+
+// A device with a profile that fails I2C_FAILURES_MAX transactions in a row (timeouts, lost arbitration or a stuck bus, but
+// not a NACK) is skipped for I2C_QUARANTINE_TIME (ms). Each failed transaction after that doubles the time, up to
+// I2C_QUARANTINE_DOUBLINGS_MAX times; one that goes through ends the quarantine.
+#define I2C_FAILURES_MAX              3
+#define I2C_QUARANTINE_TIME           2000
+#define I2C_QUARANTINE_DOUBLINGS_MAX  3
+
+// Pins of the TWI peripheral, for clocking out a stuck bus by hand (see resetI2CBus()).
+#define I2C_CLOCKOUT_PULSES     9   // A byte and its ACK bit
+#define I2C_CLOCKOUT_HALF_PERIOD 5  // us, i.e. 100 kHz
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega8__) || defined(__AVR_ATmega328P__)
+  #define I2C_PORT      PORTC
+  #define I2C_DDR       DDRC
+  #define I2C_PIN       PINC
+  #define I2C_BIT_SDA   4
+  #define I2C_BIT_SCL   5
+#else
+  #define I2C_PORT      PORTD
+  #define I2C_DDR       DDRD
+  #define I2C_PIN       PIND
+  #define I2C_BIT_SDA   1
+  #define I2C_BIT_SCL   0
+#endif
 
 // Status of I2C communication.
 typedef enum
@@ -113,6 +147,10 @@ typedef enum
   I2C_STATUS_REC_ACKBUTNACK   = 10, // A NACK bit was received even though we were expecting an ACK bit while receiving data. This could happen when the target device wants to end the communication.
   I2C_STATUS_REC_NACKBUTACK   = 11, // An ACK bit was received even though we were expecting a NACK bit while receiving data. This could happen when we requested too few bytes and the target device still wants to send more data.
   I2C_STATUS_STOP_TIMEOUT     = 12, // I2C timeout while attempting to stop comm on the I2C bus.
+  I2C_STATUS_PENDING          = 13, // The interrupt-driven transaction is queued or still in progress.
+  I2C_STATUS_QUEUE_FULL       = 14, // The interrupt-driven transaction could not be queued because the queue is full.
+  I2C_STATUS_ASYNC_TIMEOUT    = 15, // The interrupt-driven transaction took longer than the timeout and was aborted. The bus was reset.
+  I2C_STATUS_QUARANTINED      = 16, // The device kept failing, so it is skipped for now without using the bus (see I2C_FAILURES_MAX).
   I2C_STATUS_UNKNOWN          = 99  // Unknown or yet to be defined error.
 } I2C_STATUS;
 
@@ -129,6 +167,41 @@ typedef enum
   TWSR_STATUS_UNKNOWN     = 99  // An unknown condition was seen on the TSWR register
 } TWSR_STATUS;
 
+// Descriptor for an interrupt-driven transaction. The bytes in txBuffer are written first, then rxLength bytes are
+// read into rxBuffer using a repeated start (either of the two phases can be skipped by setting its length to 0).
+// The descriptor and both buffers are owned by the caller and must stay untouched until the transaction is complete.
+struct I2C_Transaction;
+typedef void (*I2C_Callback)(I2C_Transaction *transaction);
+
+// Bus settings of one device. The ones of the address are applied at the start of every transaction; addresses without a
+// profile get the defaults from setSpeed() and setTimeOut().
+struct I2C_Profile
+{
+  uint8_t address;
+  uint8_t bitRate;          // TWBR value, e.g. I2C_TWBR_100KHZ or I2C_TWBR_400KHZ
+  uint8_t stretchTimeOut;   // Longest (ms) the device may hold the clock low in one step of a transaction; 0 for no limit
+  uint8_t retries;          // Times a transaction is started again after losing arbitration of the bus
+  uint16_t timeOut;         // Longest (ms) a whole transaction may take; 0 for no limit
+
+  // Health of the device, kept by I2C
+  uint8_t failures;         // Failed transactions in a row
+  unsigned long quarantineStart;
+  bool skipped;             // The last transaction was skipped for the quarantine (I2C_STATUS_QUARANTINED)
+};
+
+struct I2C_Transaction
+{
+  uint8_t address;
+  const uint8_t *txBuffer;
+  uint8_t txLength;
+  uint8_t *rxBuffer;
+  uint8_t rxLength;
+  I2C_Callback callback;        // Optional. Called from the TWI interrupt once the transaction is done, so keep it short.
+  void *context;                // Free for use by the owner of the descriptor, e.g. for the callback.
+  volatile I2C_STATUS status;   // I2C_STATUS_PENDING until the transaction is done.
+  volatile bool complete;       // Poll flag; becomes true once the transaction is done (check status for the outcome).
+};
+
 class I2C
 {
 public:
@@ -137,6 +210,7 @@ public:
   void end();
   void setTimeOut(uint16_t timeOut);
   void setSpeed(bool useFastMode);
+  bool setProfile(uint8_t address, uint8_t bitRate, uint16_t timeOut, uint8_t stretchTimeOut, uint8_t retries); // False if the table is full
   void pullup(bool activate);
   void scan();
 
@@ -147,6 +221,9 @@ public:
   // This function simply sends a write request to the addressed device without any additional bytes. This is sometimes used to trigger a device.
   I2C_STATUS ping(uint8_t address);
 
+  // Whether the last transaction with the device was skipped because it is in quarantine, i.e. it failed without using the bus.
+  bool wasSkipped(uint8_t address);
+
   // The following are the write and read functions. The "registerAddress" is there to follow the expected I2C standard, whereby immediately after a write/read
   // command byte, the master is expected to specify which register should be written on/read from. However, there are many devices that do not follow this
   // standard strictly, and sometimes a "command" is sent instead of the address of the register. Still, the "registerAddress" variable is simply a byte
@@ -185,13 +262,26 @@ public:
   I2C_STATUS receive(bool sendACK);
   I2C_STATUS endTransmission();
 
+  // Interrupt-driven (non-blocking) transactions. submit() queues the transaction and returns I2C_STATUS_PENDING right away
+  // (or I2C_STATUS_QUEUE_FULL). The blocking functions above wait for the queue to drain before using the bus.
+  // poll() should be called regularly from the main loop so that a stuck transaction is aborted after the timeout.
+  I2C_STATUS submit(I2C_Transaction *transaction);
+  bool isBusy();
+  void poll();
+  void handleInterrupt(); // Only meant to be called from the TWI interrupt.
+
+  // Release the bus and start the TWI peripheral again. Done by itself after a timeout; only call it when !isBusy().
+  void resetI2CBus();
+
 private:
+  I2C_STATUS sendStartAndAddress(uint8_t address, bool write, bool repeatedStart);
+  I2C_STATUS transmitByte(uint8_t dataByte);
+  I2C_STATUS receiveAndCheck(bool sendACK);
   TWSR_STATUS start();
   TWSR_STATUS sendAddress(uint8_t address);
   TWSR_STATUS sendByte(uint8_t byte);
   TWSR_STATUS receiveByte(bool sendACK);
   TWSR_STATUS stop();
-  void resetI2CBus();
 
   TWSR_STATUS TWSRStatus_;
   I2C_STATUS returnStatus_;
@@ -201,10 +291,37 @@ private:
   static uint8_t bufferIndex_;
   static uint8_t totalBytes_;
 
-  // Configuration of the I2C bus.
+  // Configuration of the I2C bus. defaultProfile_ is for any address that isn't in profiles_.
   bool enableInternalPullUps_;
-  bool useFastMode_;
-  uint16_t timeOut_;
+  I2C_Profile defaultProfile_;
+  I2C_Profile profiles_[I2C_PROFILE_COUNT];
+  uint8_t profileCount_;
+  I2C_Profile *findProfile(uint8_t address);
+  void applyBitRate(uint8_t bitRate);
+  bool isQuarantined(const I2C_Profile *profile);
+  I2C_STATUS trackStatus(I2C_Profile *profile, I2C_STATUS status, bool done);
+  void clockOutBus();
+  void driveLineLow(uint8_t bit);
+  void releaseLine(uint8_t bit);
+
+  // Profile of the blocking transaction in progress
+  I2C_Profile *profile_;
+  unsigned long transactionStartTime_;
+  bool isTimedOut(unsigned long stepStartTime);
+
+  // Queue of interrupt-driven transactions. The transaction at queueHead_ is the one on the bus.
+  I2C_Transaction *queue_[I2C_QUEUE_SIZE];
+  volatile uint8_t queueHead_;
+  volatile uint8_t queueCount_;
+  volatile bool asyncActive_;
+  volatile uint8_t asyncTxIndex_;
+  volatile uint8_t asyncRxIndex_;
+  volatile unsigned long asyncStartTime_;
+  I2C_Profile * volatile asyncProfile_;
+  volatile uint8_t asyncRetries_;   // Retries left for the transaction on the bus
+  void startAsync();
+  void finishAsync(I2C_STATUS status, bool sendStop);
+  void waitAsyncIdle();
 };
 
 extern I2C I2c;
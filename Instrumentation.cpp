@@ -0,0 +1,73 @@
+/*********************************************************************************
+Optional timing instrumentation.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "Instrumentation.h"
+
+#ifdef INSTRUMENTATION
+
+Instrumentation_SectionStats Instrumentation::sections_[INSTR_SECTION_COUNT];
+unsigned long Instrumentation::counters_[INSTR_COUNTER_COUNT];
+unsigned long Instrumentation::lastLoopTime_ = 0;
+
+void Instrumentation::record(INSTR_SECTION section, unsigned long duration)
+{
+  Instrumentation_SectionStats *stats = &sections_[section];
+  uint16_t clamped = duration > 0xFFFF ? 0xFFFF : duration;
+
+  if (stats->count == 0 || clamped < stats->min) { stats->min = clamped; }
+  if (clamped > stats->max) { stats->max = clamped; }
+  stats->total += duration;
+  stats->count++;
+}
+
+// Call once per loop pass. The first pass after a reset only marks the time.
+void Instrumentation::markLoop()
+{
+  unsigned long now = micros();
+
+  if (lastLoopTime_ != 0)
+  {
+    record(INSTR_SECTION_LOOP, now - lastLoopTime_);
+  }
+
+  lastLoopTime_ = now;
+}
+
+void Instrumentation::increment(INSTR_COUNTER counter)
+{
+  counters_[counter]++;
+}
+
+const Instrumentation_SectionStats & Instrumentation::getSectionStats(INSTR_SECTION section)
+{
+  return sections_[section];
+}
+
+unsigned long Instrumentation::getCounter(INSTR_COUNTER counter)
+{
+  return counters_[counter];
+}
+
+void Instrumentation::reset()
+{
+  memset(sections_, 0, sizeof(sections_));
+  memset(counters_, 0, sizeof(counters_));
+  lastLoopTime_ = 0;
+}
+
+#endif // INSTRUMENTATION
@@ -0,0 +1,111 @@
+/*********************************************************************************
+Optional timing instrumentation.
+
+Uncomment INSTRUMENTATION below to record, for each instrumented section, the
+number of calls and the min/max/mean duration (measured with micros(), so the
+resolution is 4 us on a 16 MHz board), the worst-case time between two loop
+passes, and some event counters (I2C bus resets/timeouts, retryFunc() retries).
+The data are sent to the computer with SERIAL_CMD_INSTRUMENTATION.
+
+When INSTRUMENTATION is not defined, the macros are empty and nothing here is
+compiled in.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _INSTRUMENTATION_h
+#define _INSTRUMENTATION_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+//#define INSTRUMENTATION 1
+
+// Timed sections. The IDs are sent to the computer, so only add new ones at the end.
+typedef enum
+{
+  INSTR_SECTION_LOOP            = 0,  // Time between two calls of HumidOSH::run(), i.e. the loop latency
+  INSTR_SECTION_RETRYFUNC       = 1,
+  INSTR_SECTION_UPDATESCREEN    = 2,
+  INSTR_SECTION_SHT3X_FETCH     = 3,
+  INSTR_SECTION_EMC2301_FETCH   = 4,
+  INSTR_SECTION_COUNT
+} INSTR_SECTION;
+
+// Event counters. Same as above for the IDs.
+typedef enum
+{
+  INSTR_COUNTER_I2C_RESET       = 0,  // Calls to I2C::resetI2CBus()
+  INSTR_COUNTER_I2C_TIMEOUT     = 1,  // Blocking or background I2C transactions that timed out
+  INSTR_COUNTER_RETRY           = 2,  // Failed attempts within retryFunc()
+  INSTR_COUNTER_I2C_QUARANTINE  = 3,  // I2C devices put in quarantine after failing I2C_FAILURES_MAX transactions in a row
+  INSTR_COUNTER_COUNT
+} INSTR_COUNTER;
+
+#ifdef INSTRUMENTATION
+
+struct Instrumentation_SectionStats
+{
+  unsigned long count;
+  unsigned long total;  // us
+  uint16_t min;         // us
+  uint16_t max;         // us
+};
+
+class Instrumentation
+{
+public:
+  static void record(INSTR_SECTION section, unsigned long duration);
+  static void markLoop();
+  static void increment(INSTR_COUNTER counter);
+  static const Instrumentation_SectionStats & getSectionStats(INSTR_SECTION section);
+  static unsigned long getCounter(INSTR_COUNTER counter);
+  static void reset();
+
+private:
+  static Instrumentation_SectionStats sections_[INSTR_SECTION_COUNT];
+  static unsigned long counters_[INSTR_COUNTER_COUNT];
+  static unsigned long lastLoopTime_;
+};
+
+// Records the time until the end of the enclosing block.
+class Instrumentation_Scope
+{
+public:
+  Instrumentation_Scope(INSTR_SECTION section) : section_(section), startTime_(micros()) {}
+  ~Instrumentation_Scope() { Instrumentation::record(section_, micros() - startTime_); }
+
+private:
+  INSTR_SECTION section_;
+  unsigned long startTime_;
+};
+
+#define INSTRUMENT_SCOPE(section)   Instrumentation_Scope instrumentationScope(section)
+#define INSTRUMENT_LOOP()           Instrumentation::markLoop()
+#define INSTRUMENT_COUNT(counter)   Instrumentation::increment(counter)
+
+#else
+
+#define INSTRUMENT_SCOPE(section)
+#define INSTRUMENT_LOOP()
+#define INSTRUMENT_COUNT(counter)
+
+#endif // INSTRUMENTATION
+
+#endif
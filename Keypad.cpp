@@ -86,6 +86,11 @@ void Keypad::scanKeys() {
 		pin_mode(rowPins[r],INPUT_PULLUP);
 	}
 
+	// Release the columns in case armRows() left them driven low.
+	for (byte c=0; c<sizeKpd.columns; c++) {
+		pin_mode(columnPins[c],INPUT);
+	}
+
 	// bitMap stores ALL the keys that are being pressed.
 	for (byte c=0; c<sizeKpd.columns; c++) {
 		pin_mode(columnPins[c],OUTPUT);
@@ -231,6 +236,39 @@ byte Keypad::numKeys() {
 	return sizeof(key)/sizeof(Key);
 }
 
+byte Keypad::getRowCount() {
+	return sizeKpd.rows;
+}
+
+byte Keypad::getRowPin(byte row) {
+	return rowPins[row];
+}
+
+// No key is pressed, held or on its way out of the list.
+bool Keypad::isIdle() {
+	for (byte i=0; i<LIST_MAX; i++) {
+		if (key[i].kchar != NO_KEY && key[i].kstate != IDLE)
+			return false;
+	}
+	return true;
+}
+
+// Drive all columns low so that any key press shows up as a change on its row. Call when isIdle().
+// Returns true if a row is low already, i.e. a key went down before this was called and there will be no change to see.
+bool Keypad::armRows() {
+	bool rowLow = false;
+
+	for (byte c=0; c<sizeKpd.columns; c++) {
+		pin_mode(columnPins[c],OUTPUT);
+		pin_write(columnPins[c],LOW);
+	}
+	for (byte r=0; r<sizeKpd.rows; r++) {
+		if (!pin_read(rowPins[r]))
+			rowLow = true;
+	}
+	return rowLow;
+}
+
 // Minimum debounceTime is 1 mS. Any lower *will* slow down the loop().
 void Keypad::setDebounceTime(uint debounce) {
 	debounce<1 ? debounceTime=1 : debounceTime=debounce;
@@ -99,6 +99,13 @@ public:
 	bool keyStateChanged();
 	byte numKeys();
 
+	// Pin change mode (added for HumidOSH): with all columns driven low, pressing any key pulls its row low, so a pin
+	// change interrupt on the rows can tell when the keypad needs scanning again.
+	byte getRowCount();
+	byte getRowPin(byte row);
+	bool isIdle();
+	bool armRows();
+
 private:
 	unsigned long startTime;
 	char *keymap;
@@ -0,0 +1,142 @@
+/*********************************************************************************
+Relay autotune for the humidity PID.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "PIDAutotune.h"
+
+PIDAutotune::PIDAutotune() : status_(AUTOTUNE_STATUS_IDLE), cycleCount_(0), kp_(0), ki_(0), kd_(0) {}
+
+// Start the experiment around setpoint. The output swings by outputStep on either side of 0.
+void PIDAutotune::start(unsigned long now, double input, double setpoint, double outputStep, double hysteresis)
+{
+  status_         = AUTOTUNE_STATUS_RUNNING;
+  setpoint_       = setpoint;
+  outputStep_     = outputStep;
+  hysteresis_     = hysteresis;
+  outputHigh_     = input < setpoint;
+  cycleStarted_   = false;
+  cycleCount_     = 0;
+  startTime_      = now;
+  cycleStartTime_ = now;
+  peakMax_        = input;
+  peakMin_        = input;
+  amplitudeSum_   = 0;
+  periodSum_      = 0;
+}
+
+void PIDAutotune::stop()
+{
+  status_ = AUTOTUNE_STATUS_IDLE;
+}
+
+// Call with every new reading while running. The output to apply is placed in output.
+AUTOTUNE_STATUS PIDAutotune::update(unsigned long now, double input, double * output)
+{
+  *output = 0;
+
+  if (status_ != AUTOTUNE_STATUS_RUNNING)
+  {
+    return status_;
+  }
+
+  if (now - startTime_ >= TIMEOUT)
+  {
+    status_ = AUTOTUNE_STATUS_FAIL;
+    return status_;
+  }
+
+  if (input > peakMax_) { peakMax_ = input; }
+  if (input < peakMin_) { peakMin_ = input; }
+
+  if (outputHigh_ && input > setpoint_ + hysteresis_)
+  {
+    outputHigh_ = false;
+  }
+  else if (!outputHigh_ && input < setpoint_ - hysteresis_)
+  { // A switch to the high output ends one cycle and starts the next.
+    outputHigh_ = true;
+
+    if (cycleStarted_)
+    {
+      cycleCount_++;
+
+      if (cycleCount_ > CYCLES_DISCARD)
+      {
+        amplitudeSum_ += (peakMax_ - peakMin_) / 2;
+        periodSum_ += now - cycleStartTime_;
+      }
+
+      if (cycleCount_ >= CYCLES_DISCARD + CYCLES_MEASURE)
+      {
+        calcTunings();
+        return status_;
+      }
+    }
+
+    cycleStarted_ = true;
+    cycleStartTime_ = now;
+    peakMax_ = input;
+    peakMin_ = input;
+  }
+
+  *output = outputHigh_ ? outputStep_ : -outputStep_;
+  return status_;
+}
+
+AUTOTUNE_STATUS PIDAutotune::getStatus()
+{
+  return status_;
+}
+
+// Number of complete oscillations so far.
+uint8_t PIDAutotune::getCycleCount()
+{
+  return cycleCount_;
+}
+
+double PIDAutotune::getKp()
+{
+  return kp_;
+}
+
+double PIDAutotune::getKi()
+{
+  return ki_;
+}
+
+double PIDAutotune::getKd()
+{
+  return kd_;
+}
+
+void PIDAutotune::calcTunings()
+{
+  double amplitude = amplitudeSum_ / CYCLES_MEASURE;
+  double period = (double) periodSum_ / CYCLES_MEASURE; // ms
+
+  if (amplitude <= hysteresis_ || period <= 0)
+  { // The oscillation is lost in the hysteresis; can't tell the gain from this.
+    status_ = AUTOTUNE_STATUS_FAIL;
+    return;
+  }
+
+  double ultimateGain = 4 * outputStep_ / (PI * sqrt(amplitude * amplitude - hysteresis_ * hysteresis_));
+  kp_ = 0.45 * ultimateGain;
+  ki_ = kp_ / (period / 1.2);
+  kd_ = 0;
+  status_ = AUTOTUNE_STATUS_DONE;
+}
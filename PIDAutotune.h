@@ -0,0 +1,86 @@
+/*********************************************************************************
+Relay autotune for the humidity PID.
+
+The output is switched between +outputStep and -outputStep whenever the input
+crosses the setpoint (with some hysteresis so that sensor noise doesn't cause
+extra switches). This makes the chamber oscillate around the setpoint. From the
+amplitude a and period Pu of the oscillation, the ultimate gain is
+  Ku = 4 * outputStep / (pi * sqrt(a^2 - hysteresis^2))
+and the Ziegler-Nichols PI rule gives Kp = 0.45 Ku and Ti = Pu / 1.2.
+The derivative gain is left at 0, since the RH readings are too noisy for it.
+
+The gains are in the units of PID::SetTunings(), i.e. Ki is per ms.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _PIDAUTOTUNE_h
+#define _PIDAUTOTUNE_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// Statuses returned by the functions in this class
+typedef enum
+{
+  AUTOTUNE_STATUS_IDLE    = 0,  // Not started, or stopped
+  AUTOTUNE_STATUS_RUNNING = 1,
+  AUTOTUNE_STATUS_DONE    = 2,  // The gains are ready
+  AUTOTUNE_STATUS_FAIL    = 3   // No usable oscillation before the timeout
+} AUTOTUNE_STATUS;
+
+class PIDAutotune
+{
+public:
+  PIDAutotune();
+  void start(unsigned long now, double input, double setpoint, double outputStep, double hysteresis);
+  void stop();
+  AUTOTUNE_STATUS update(unsigned long now, double input, double * output);
+  AUTOTUNE_STATUS getStatus();
+  uint8_t getCycleCount();
+  double getKp();
+  double getKi();
+  double getKd();
+
+private:
+  static const uint8_t CYCLES_DISCARD    = 1;          // The first cycles start from wherever the input was, so they are not used
+  static const uint8_t CYCLES_MEASURE    = 3;          // Cycles averaged for the amplitude and period
+  static const unsigned long TIMEOUT     = 14400000;   // Max duration (ms) of the experiment (4 h)
+
+  AUTOTUNE_STATUS status_;
+  double setpoint_;
+  double outputStep_;
+  double hysteresis_;
+  bool outputHigh_;
+  bool cycleStarted_;             // Saw the first switch to the high output
+  uint8_t cycleCount_;
+  unsigned long startTime_;
+  unsigned long cycleStartTime_;  // When the output last switched to high
+  double peakMax_;
+  double peakMin_;
+  double amplitudeSum_;
+  unsigned long periodSum_;
+  double kp_;
+  double ki_;
+  double kd_;
+
+  void calcTunings();
+};
+
+#endif
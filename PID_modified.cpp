@@ -22,7 +22,7 @@
  ***************************************************************************/
  PID::PID(){}
  
-PID::PID(double* Input, double* Output, double* Setpoint,
+PID::PID(real_t* Input, real_t* Output, real_t* Setpoint,
         double Kp, double Ki, double Kd, unsigned long curTime, int POn, int ControllerDirection)
 {
     myOutput = Output;
@@ -44,7 +44,7 @@ PID::PID(double* Input, double* Output, double* Setpoint,
  *    to use Proportional on Error without explicitly saying so
  ***************************************************************************/
 
-PID::PID(double* Input, double* Output, double* Setpoint,
+PID::PID(real_t* Input, real_t* Output, real_t* Setpoint,
         double Kp, double Ki, double Kd, unsigned long curTime, int ControllerDirection)
     :PID::PID(Input, Output, Setpoint, Kp, Ki, Kd, curTime, P_ON_E, ControllerDirection)
 {
@@ -60,9 +60,14 @@ void PID::Compute(unsigned long curTime)
 {
   // NOTE: timechange is in ms!!!
   timeChange = (curTime - lastTime);
+#ifdef USE_FIXED_POINT
+  // Keep the time terms within the range of the fixed-point type. Only matters if Compute() wasn't called for a long time.
+  if(timeChange > MAX_TIMECHANGE) timeChange = MAX_TIMECHANGE;
+#endif // USE_FIXED_POINT
   error = *mySetpoint - *myInput;
   dInput = (*myInput - lastInput);
-  outputSum+= (ki * timeChange * error);
+  // ki is per second, which keeps it from losing precision in fixed-point
+  outputSum+= (ki * realFromRatio(timeChange, 1000) * error);
 
   /*Add Proportional on Measurement, if P_ON_M is specified*/
   if(!pOnE) outputSum-= kp * dInput;
@@ -77,7 +82,9 @@ void PID::Compute(unsigned long curTime)
   else tempOutput = 0;
 
   /*Compute Rest of PID Output*/
-  tempOutput += outputSum - kd / timeChange * dInput;
+  tempOutput += outputSum;
+  // No derivative term if Compute() is called twice within the same ms; dividing by zero would give NaN.
+  if(timeChange > 0) tempOutput -= kd * dInput / real_t(timeChange);
 
   if(tempOutput > outMax) tempOutput = outMax;
   else if(tempOutput < outMin) tempOutput = outMin;
@@ -103,7 +110,7 @@ void PID::SetTunings(double Kp, double Ki, double Kd, int POn)
    dispKp = Kp; dispKi = Ki; dispKd = Kd;
 
    kp = Kp;
-   ki = Ki; 
+   ki = Ki * 1000;  // Compute() works with the time difference in seconds for the integral term
    kd = Kd;
    
    // EDIT: We insert the contribution from time everytime we call compute so that we are
@@ -135,7 +142,7 @@ void PID::SetTunings(double Kp, double Ki, double Kd){
  *  want to clamp it from 0-125.  who knows.  at any rate, that can all be done
  *  here.
  **************************************************************************/
-void PID::SetOutputLimits(double Min, double Max)
+void PID::SetOutputLimits(real_t Min, real_t Max)
 {
    if(Min >= Max) return;
    outMin = Min;
@@ -213,23 +220,32 @@ void PID::setLastTime(unsigned long newTime)
  * "last input" than one that could have been obtained
  * an extremely long time ago.
  ******************************************************************************/
-void PID::setLastInput(double newLastInput)
+void PID::setLastInput(real_t newLastInput)
 {
   lastInput = newLastInput;
 }
 
-/* setOutputSum(double newOutputSum)*******************************************
+/* setOutputSum(real_t newOutputSum)*******************************************
  * Sets the variable outputSum to newOutputSum
  * Useful if we want to force the control algorithm to a certain state.
  * For example, if we want the control to start at full blast and then slowly
  * reduce until we are at the target setpoint, then we could call setOutputSum
  * to set outputSum to outMax.
  ******************************************************************************/
-void PID::setOutputSum(double newOutputSum)
+void PID::setOutputSum(real_t newOutputSum)
 {
   outputSum = newOutputSum;
 }
 
+/* getOutputSum()**************************************************************
+ * Returns outputSum, e.g. to save it and later carry on from there with
+ * setOutputSum.
+ ******************************************************************************/
+real_t PID::getOutputSum()
+{
+  return outputSum;
+}
+
 /* Reset()*********************************************************************
  * Resets the "memorized" variables e.g. outputSum, lastInput, etc. Used when
  * changing setpoints to avoid delays due to resistance from the "memorized"
@@ -2,6 +2,8 @@
 #define PID_modified_h
 #define LIBRARY_VERSION	1.2.1
 
+#include "FixedPoint.h"
+
 class PID
 {
 
@@ -19,11 +21,11 @@ class PID
   //commonly used functions **************************************************************************
     PID();
     
-    PID(double*, double*, double*,                        // * constructor.  links the PID to the Input, Output, and 
+    PID(real_t*, real_t*, real_t*,                        // * constructor.  links the PID to the Input, Output, and 
         double, double, double, unsigned long, int, int); //   Setpoint.  Initial tuning parameters are also set here.
                                                           //   (overload for specifying proportional mode)
 
-    PID(double*, double*, double*,                        // * constructor.  links the PID to the Input, Output, and 
+    PID(real_t*, real_t*, real_t*,                        // * constructor.  links the PID to the Input, Output, and 
         double, double, double, unsigned long, int);      //   Setpoint.  Initial tuning parameters are also set here
 	
     void SetMode(int Mode);               // * sets PID to either Manual (0) or Auto (non-0)
@@ -34,7 +36,7 @@ class PID
     void Compute(unsigned long curTime);  // * performs the PID calculation.  It should be
                                           //   called every time you want to calculate the new output.
 
-    void SetOutputLimits(double, double); // * clamps the output to a specific range. 0-255 by default, but
+    void SetOutputLimits(real_t, real_t); // * clamps the output to a specific range. 0-255 by default, but
 										                      //   it's likely the user will want to change this depending on
 										                      //   the application
 	
@@ -58,14 +60,15 @@ class PID
                                             // lastTime in the Compute function will become huge if the
                                             // PID is paused for a long time
                                             
-  void setLastInput(double newLastInput);   // Sets the variable lastInput to newLastInput
+  void setLastInput(real_t newLastInput);   // Sets the variable lastInput to newLastInput
                                             // Used when restarting the PID, but from a more current
                                             // "last input" than one that could have been obtained
                                             // an extremely long time ago.
                                             
   // Directly modify the outputSum, which is the bulk of the integral term. Useful if we want to start
   // the control from a certain state and slowly adjust from there.
-  void setOutputSum(double newOutputSum);
+  void setOutputSum(real_t newOutputSum);
+  real_t getOutputSum();
                       
   void Reset(); // Resets the "memorized" variables e.g. outputSum, lastInput, etc. Used when changing
                 // setpoints to avoid delays due to resistance from the "memorized" variables
@@ -86,24 +89,27 @@ class PID
 	double dispKi;				//   format for display purposes
 	double dispKd;				//
     
-	double kp;                  // * (P)roportional Tuning Parameter
-  double ki;                  // * (I)ntegral Tuning Parameter
-  double kd;                  // * (D)erivative Tuning Parameter
+	real_t kp;                  // * (P)roportional Tuning Parameter
+  real_t ki;                  // * (I)ntegral Tuning Parameter, per second (the user enters it per ms)
+  real_t kd;                  // * (D)erivative Tuning Parameter
 
 	int controllerDirection;
 	int pOn;
 
-    double *myInput;              // * Pointers to the Input, Output, and Setpoint variables
-    double *myOutput;             //   This creates a hard link between the variables and the 
-    double *mySetpoint;           //   PID, freeing the user from having to constantly tell us
+    real_t *myInput;              // * Pointers to the Input, Output, and Setpoint variables
+    real_t *myOutput;             //   This creates a hard link between the variables and the 
+    real_t *mySetpoint;           //   PID, freeing the user from having to constantly tell us
                                   //   what these values are.  with pointers we'll just know.
 			  
 	unsigned long lastTime;
   unsigned long timeChange;
-	double dInput, error, lastInput, outputSum, tempOutput;
+	real_t dInput, error, lastInput, outputSum, tempOutput;
 
 	unsigned long SampleTime;
-	double outMin, outMax;
+#ifdef USE_FIXED_POINT
+	static const unsigned long MAX_TIMECHANGE = 30000; // Longest time (ms) between two Compute() that can be handled in fixed-point
+#endif // USE_FIXED_POINT
+	real_t outMin, outMax;
 	bool inAuto, pOnE;
 };
 #endif
@@ -0,0 +1,93 @@
+/*********************************************************************************
+Dispatcher for the pin change interrupts of the ATmega328.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "PinChange.h"
+
+PinChange::Handler PinChange::handlers_[PINCHANGE_HANDLER_MAX];
+uint8_t PinChange::handlerCount_ = 0;
+
+// Call callback(context) from the interrupt whenever the pin (or another attached pin on the same port) changes.
+PINCHANGE_STATUS PinChange::attach(uint8_t pin, PinChange_Callback callback, void *context)
+{
+  if (digitalPinToPCICR(pin) == 0)
+  {
+    return PINCHANGE_STATUS_INVALID_PIN;
+  }
+
+  uint8_t port = digitalPinToPCICRbit(pin);
+  bool registered = false;
+
+  // Several pins on the same port with the same callback (e.g. the rows of a keypad) only need one handler.
+  for (uint8_t i = 0; i < handlerCount_; i++)
+  {
+    if (handlers_[i].port == port && handlers_[i].callback == callback && handlers_[i].context == context)
+    {
+      registered = true;
+    }
+  }
+
+  if (!registered && handlerCount_ >= PINCHANGE_HANDLER_MAX)
+  {
+    return PINCHANGE_STATUS_FULL;
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+
+  if (!registered)
+  {
+    Handler *handler = &handlers_[handlerCount_];
+    handler->port = port;
+    handler->callback = callback;
+    handler->context = context;
+    handlerCount_++;
+  }
+
+  *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+  PCIFR = _BV(port);  // Drop any change from before now
+  *digitalPinToPCICR(pin) |= _BV(port);
+
+  SREG = oldSREG;
+  return PINCHANGE_STATUS_OK;
+}
+
+void PinChange::handleInterrupt(uint8_t port)
+{
+  for (uint8_t i = 0; i < handlerCount_; i++)
+  {
+    if (handlers_[i].port == port)
+    {
+      handlers_[i].callback(handlers_[i].context);
+    }
+  }
+}
+
+ISR(PCINT0_vect)
+{
+  PinChange::handleInterrupt(0);
+}
+
+ISR(PCINT1_vect)
+{
+  PinChange::handleInterrupt(1);
+}
+
+ISR(PCINT2_vect)
+{
+  PinChange::handleInterrupt(2);
+}
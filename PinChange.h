@@ -0,0 +1,65 @@
+/*********************************************************************************
+Dispatcher for the pin change interrupts of the ATmega328.
+
+The pins are grouped into three ports (PCINT0-2), and each port has only one
+interrupt vector that fires on any change of any of its enabled pins. attach()
+enables the interrupt of a pin and registers a callback for it. When a port
+fires, the callbacks of all pins on that port are called, since telling which
+pin changed would need a copy of the previous pin states. The callbacks run in
+the interrupt, so they should do no more than set a flag for the main loop.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _PINCHANGE_h
+#define _PINCHANGE_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#define PINCHANGE_HANDLER_MAX 6
+
+typedef enum
+{
+  PINCHANGE_STATUS_OK           = 0,
+  PINCHANGE_STATUS_FULL         = 1,  // Already PINCHANGE_HANDLER_MAX pins attached
+  PINCHANGE_STATUS_INVALID_PIN  = 2   // The pin has no pin change interrupt
+} PINCHANGE_STATUS;
+
+typedef void (*PinChange_Callback)(void *context);
+
+class PinChange
+{
+public:
+  static PINCHANGE_STATUS attach(uint8_t pin, PinChange_Callback callback, void *context);
+  static void handleInterrupt(uint8_t port); // Only meant to be called from the PCINT interrupts.
+
+private:
+  struct Handler
+  {
+    uint8_t port;     // Bit of the port in PCICR
+    PinChange_Callback callback;
+    void *context;
+  };
+
+  static Handler handlers_[PINCHANGE_HANDLER_MAX];
+  static uint8_t handlerCount_;
+};
+
+#endif
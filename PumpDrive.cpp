@@ -0,0 +1,86 @@
+/*********************************************************************************
+Pump drive on Timer 1 at 25 kHz.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "PumpDrive.h"
+
+static const real_t DUTY_PER_COMMAND = (double) PUMPDRIVE_TOP / PUMPDRIVE_COMMAND_MAX;
+
+// Configure Timer 1 for PWM @ 25 kHz to reduce noise from controlling pump with PWM. This affects both pin 9 and 10.
+// From https://arduino.stackexchange.com/a/25623
+// Due to 16-bit nature of Timer 1, it counts from 0 to PUMPDRIVE_TOP. Setting to phase-correct PWM makes it count back
+// down, so a total of 640 ticks. Since prescaler is 1, the final timer frequency is 16 MHz / 640 / 1 = 25 kHz.
+void PumpDrive::beginTimer()
+{
+  TCCR1A = 0;           // undo the configuration done by...
+  TCCR1B = 0;           // ...the Arduino core library
+  TCNT1 = 0;            // reset timer
+  OCR1A = 0;            // both pumps off
+  OCR1B = 0;
+  TCCR1A = _BV(COM1A1)  // non-inverted PWM on ch. A
+    | _BV(COM1B1)       // same on ch; B
+    | _BV(WGM11);       // mode 10: ph. correct PWM, TOP = ICR1
+  TCCR1B = _BV(WGM13)   // ditto
+    | _BV(CS10);        // prescaler = 1
+  ICR1 = PUMPDRIVE_TOP;
+}
+
+PumpDrive::PumpDrive() : outputCompare_(&OCR1A), command_(0), duty_(0), enabled_(true) {}
+
+void PumpDrive::begin(uint8_t pin)
+{
+  outputCompare_ = pin == 10 ? &OCR1B : &OCR1A;
+  command_ = 0;
+  duty_ = 0;
+  enabled_ = true;
+  writeDuty(0);
+}
+
+// Drive the pump with command (0 to PUMPDRIVE_COMMAND_MAX), rounded to the nearest step of the duty cycle.
+void PumpDrive::setCommand(real_t command)
+{
+  command_ = constrain(command, real_t(0), real_t(PUMPDRIVE_COMMAND_MAX));
+  duty_ = realToLong(command_ * DUTY_PER_COMMAND + real_t(0.5));
+
+  if (enabled_)
+  {
+    writeDuty(duty_);
+  }
+}
+
+real_t PumpDrive::getCommand()
+{
+  return command_;
+}
+
+uint16_t PumpDrive::getDuty()
+{
+  return duty_;
+}
+
+void PumpDrive::enable(bool enable)
+{
+  enabled_ = enable;
+  writeDuty(enabled_ ? duty_ : 0);
+}
+
+// The output compare register is double-buffered and only taken at TOP, so a change never cuts a pulse short.
+// In phase-correct PWM, 0 holds the pin low and PUMPDRIVE_TOP holds it high.
+void PumpDrive::writeDuty(uint16_t duty)
+{
+  *outputCompare_ = duty;
+}
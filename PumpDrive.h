@@ -0,0 +1,64 @@
+/*********************************************************************************
+Pump drive on Timer 1 at 25 kHz, to keep the PWM of the pump out of hearing.
+
+Timer 1 runs in phase-correct PWM with TOP = ICR1 = PUMPDRIVE_TOP, so the duty
+cycle has PUMPDRIVE_TOP + 1 steps, from 0 to fully on. analogWrite() only takes
+0-255, which left the pump at 80 % duty at most; PumpDrive writes OCR1A/OCR1B
+itself instead.
+
+The command is in the units of the humidity PID output: 0 is off and
+PUMPDRIVE_COMMAND_MAX is fully on. The fraction of a command is kept, so the
+pump can be driven finer than a step of the PID output near the deadband.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _PUMPDRIVE_h
+#define _PUMPDRIVE_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#include "FixedPoint.h"
+
+static const uint16_t PUMPDRIVE_TOP         = 320;  // 16 MHz / (2 * 320) / 1 = 25 kHz
+static const uint8_t PUMPDRIVE_COMMAND_MAX  = 255;  // Same range as analogWrite(), which the limits (PUMP_MIN/PUMP_MAX) were set in
+
+class PumpDrive
+{
+public:
+  static void beginTimer();
+
+  PumpDrive();
+  void begin(uint8_t pin);   // Pin 9 (OC1A) or 10 (OC1B)
+  void setCommand(real_t command);
+  real_t getCommand();
+  uint16_t getDuty();        // 0 to PUMPDRIVE_TOP
+  void enable(bool enable);  // Off without losing the command; enable(true) drives it again
+
+private:
+  volatile uint16_t *outputCompare_;  // OCR1A or OCR1B
+  real_t command_;
+  uint16_t duty_;
+  bool enabled_;
+
+  void writeDuty(uint16_t duty);
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*********************************************************************************
+Retry policy and failure statistics of one I2C device.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "RetryPolicy.h"
+
+RetryPolicy::RetryPolicy(I2C * i2cWire, uint8_t address) : i2cWire_(i2cWire), address_(address), busFailures_(0), backoff_(0), nextAttemptTime_(0)
+{
+  memset(&stats_, 0, sizeof(RetryPolicy_Stats));
+}
+
+// Whether the backoff from the last failure is over.
+bool RetryPolicy::isDue(unsigned long now)
+{
+  // Signed difference so that this keeps working when millis() rolls over.
+  return (long) (now - nextAttemptTime_) >= 0;
+}
+
+// Time (ms) until the next attempt is due.
+uint16_t RetryPolicy::getWait(unsigned long now)
+{
+  return isDue(now) ? 0 : nextAttemptTime_ - now;
+}
+
+bool RetryPolicy::isFailing()
+{
+  return stats_.consecutiveFailures >= FAILING_THRESHOLD;
+}
+
+void RetryPolicy::recordSuccess()
+{
+  stats_.attemptCount++;
+  stats_.consecutiveFailures = 0;
+  busFailures_ = 0;
+  backoff_ = 0;
+}
+
+void RetryPolicy::recordFailure(unsigned long now)
+{
+  stats_.attemptCount++;
+  stats_.failureCount++;
+
+  if (stats_.consecutiveFailures < 0xFF)
+  {
+    stats_.consecutiveFailures++;
+  }
+
+  backoff_ = backoff_ == 0 ? BACKOFF_MIN : (backoff_ >= BACKOFF_MAX / 2 ? BACKOFF_MAX : backoff_ * 2);
+  nextAttemptTime_ = now + backoff_;
+
+  // Skipped for the quarantine, without a transaction that could have found the bus stuck.
+  if (i2cWire_->wasSkipped(address_))
+  {
+    return;
+  }
+
+  if (busFailures_ < 0xFF)
+  {
+    busFailures_++;
+  }
+
+  // Not while another device has a transaction going; the reset would cut it off.
+  if (busFailures_ >= BUS_RESET_THRESHOLD && !i2cWire_->isBusy())
+  {
+    i2cWire_->resetI2CBus();
+    stats_.busResetCount++;
+    busFailures_ = 0;
+  }
+}
+
+const RetryPolicy_Stats & RetryPolicy::getStats()
+{
+  return stats_;
+}
+
+// Clear the counts, but not the backoff.
+void RetryPolicy::resetStats()
+{
+  uint8_t consecutiveFailures = stats_.consecutiveFailures;
+
+  memset(&stats_, 0, sizeof(RetryPolicy_Stats));
+  stats_.consecutiveFailures = consecutiveFailures;
+}
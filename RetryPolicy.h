@@ -0,0 +1,76 @@
+/*********************************************************************************
+Retry policy and failure statistics of one I2C device.
+
+HumidOSH keeps one of these for each device. Every attempt to talk to the device
+is recorded with recordSuccess() or recordFailure(). After a failure, the device
+is left alone for a backoff time that doubles with every further failure in a
+row (from BACKOFF_MIN up to BACKOFF_MAX), so that a device that is gone doesn't
+hold up the main loop with one timeout after another. Every BUS_RESET_THRESHOLD
+failures in a row, the I2C bus is reset (unless it is busy with another
+transaction, in which case it is reset on the next failure), in case the device
+is stuck holding it. Attempts that I2C skipped because the device is in
+quarantine (I2C_STATUS_QUARANTINED) didn't use the bus, so they count as
+failures of the device but not towards a bus reset.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _RETRYPOLICY_h
+#define _RETRYPOLICY_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#include "I2C.h"
+
+struct RetryPolicy_Stats
+{
+  uint16_t attemptCount;
+  uint16_t failureCount;
+  uint8_t consecutiveFailures;
+  uint8_t busResetCount;
+};
+
+class RetryPolicy
+{
+public:
+  RetryPolicy(I2C * i2cWire, uint8_t address);
+  bool isDue(unsigned long now);
+  uint16_t getWait(unsigned long now);
+  bool isFailing();
+  void recordSuccess();
+  void recordFailure(unsigned long now);
+  const RetryPolicy_Stats & getStats();
+  void resetStats();
+
+private:
+  static const uint16_t BACKOFF_MIN            = 20;   // Wait (ms) after the first failure
+  static const uint16_t BACKOFF_MAX            = 2000; // Longest wait (ms) between attempts
+  static const uint8_t FAILING_THRESHOLD       = 3;    // Failures in a row before the device is reported as failing
+  static const uint8_t BUS_RESET_THRESHOLD     = 5;    // Failures in a row (that used the bus) between each reset of the I2C bus
+
+  I2C * i2cWire_;
+  uint8_t address_;         // Of the device, to tell the attempts that I2C skipped (see I2C::wasSkipped())
+  RetryPolicy_Stats stats_;
+  uint8_t busFailures_;     // Failures that used the bus since the last success or bus reset
+  uint16_t backoff_;
+  unsigned long nextAttemptTime_;
+};
+
+#endif
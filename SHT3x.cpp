@@ -18,19 +18,19 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "SHT3x.h"
 
+const uint8_t SHT3x::COM_DAQ_FETCH[2] = { 0xE0, 0x00 };
+
 // Initialize with only the custom i2c class
-SHT3x::SHT3x(I2C * i2cWire) : i2cWire_(i2cWire)
+SHT3x::SHT3x(I2C * i2cWire) : i2cWire_(i2cWire), RHSignal_(0), tempSignal_(0), periodicMode_(false), measurementPeriod_(0)
 {
   // Default address to the base address
   changeAddress(false);
-  calcRHAdj();
 }
 
 // Initialize with custom i2c class and set the state of address pin
-SHT3x::SHT3x(I2C * i2cWire, bool ADDRPinHigh) : i2cWire_(i2cWire)
+SHT3x::SHT3x(I2C * i2cWire, bool ADDRPinHigh) : i2cWire_(i2cWire), RHSignal_(0), tempSignal_(0), periodicMode_(false), measurementPeriod_(0)
 {
   changeAddress(ADDRPinHigh);
-  calcRHAdj();
 }
 
 void SHT3x::changeAddress(bool ADDRPinHigh)
@@ -38,11 +38,16 @@ void SHT3x::changeAddress(bool ADDRPinHigh)
   if (ADDRPinHigh)
   {
     i2cAddress_ = BASE_ADDRESS + 1; // 0x45 or 69
+    calibrationSensor_ = 1;
   }
   else
   {
     i2cAddress_ = BASE_ADDRESS; // 0x44 or 68
+    calibrationSensor_ = 0;
   }
+
+  // Each address has its own calibration
+  calibration_ = Config.getCalibration(calibrationSensor_);
 }
 
 // Trigger the sensor to perform a single measurement.
@@ -104,6 +109,7 @@ SHT3X_STATUS SHT3x::triggerOneMeasurement(bool stretchClock, Repeatability repea
 // TODO: clock stretching is not implemented yet.
 SHT3X_STATUS SHT3x::fetchMeasurement()
 {
+  INSTRUMENT_SCOPE(INSTR_SECTION_SHT3X_FETCH);
   I2C_STATUS i2cStatus;
   i2cStatus = i2cWire_->read(i2cAddress_, BYTECOUNT_DAQ_TOTAL);
 
@@ -122,37 +128,7 @@ SHT3X_STATUS SHT3x::fetchMeasurement()
       }
     }
 
-    // Organize the data
-    tempBuffer[0] = dataBuffer[BYTECOUNT_DAQ_TEMP - 2];
-    tempBuffer[1] = dataBuffer[BYTECOUNT_DAQ_TEMP - 1];
-    uint8_t tempCRC = dataBuffer[BYTECOUNT_DAQ_TEMP];
-
-    RHBuffer[0] = dataBuffer[BYTECOUNT_DAQ_TEMP + BYTECOUNT_DAQ_CRC + BYTECOUNT_DAQ_RH - 2];
-    RHBuffer[1] = dataBuffer[BYTECOUNT_DAQ_TEMP + BYTECOUNT_DAQ_CRC + BYTECOUNT_DAQ_RH - 1];
-    uint8_t RHCRC = dataBuffer[BYTECOUNT_DAQ_TEMP + BYTECOUNT_DAQ_CRC + BYTECOUNT_DAQ_RH];
-
-    // Perform CRC check on the RH and temperature bytes
-    if (tempCRC == calcCRC(tempBuffer, BYTECOUNT_DAQ_TEMP) && RHCRC == calcCRC(RHBuffer, BYTECOUNT_DAQ_RH))
-    { // CRC check success; move on to convert signal into actual readings.
-      // Refer to datasheet section 4.13.
-      // Calculate temperature (degC; we're not imperial heathens)
-      uint16_t tempSignal = tempBuffer[BYTECOUNT_DAQ_TEMP-2];
-      tempSignal = tempSignal << 8;
-      tempSignal |= tempBuffer[BYTECOUNT_DAQ_TEMP-1];
-      temperature_ = -45 + tempSignal * 0.0026703; // The multiplier is 175/(2^16 - 1), rounded to account for precision of float in Arduino
-
-      // Calculate relative humidity
-      uint16_t RHSignal = RHBuffer[BYTECOUNT_DAQ_TEMP-2];
-      RHSignal = RHSignal << 8;
-      RHSignal |= RHBuffer[BYTECOUNT_DAQ_TEMP-1];
-      relativeHumidity_ = RHSignal * 0.0015259; // The multiplier is 100/(2^16 - 1), rounded to account for precision of float in Arduino
-
-      return SHT3X_STATUS_OK;
-    }
-    else
-    { // Failed CRC check for one of the readings
-      return SHT3X_STATUS_CORRUPT;
-    }
+    return processMeasurement();
   }
   else if (i2cStatus == I2C_STATUS_BEGIN_NACK)
   {
@@ -165,173 +141,449 @@ SHT3X_STATUS SHT3x::fetchMeasurement()
   }
 }
 
-// Returns the relative humidity to the caller after applying adjustments from the two-point calibration.
-double SHT3x::getRH()
+// Same as fetchMeasurement(), but the read is queued on the I2C bus and done in the background, so this returns right away.
+// Call checkMeasurement() to find out how it went.
+SHT3X_STATUS SHT3x::requestMeasurement()
 {
-  return slopeAdjustment_ * relativeHumidity_ + offset_;
+  fetchTransaction_.address   = i2cAddress_;
+  fetchTransaction_.txBuffer  = NULL;
+  fetchTransaction_.txLength  = 0;
+  fetchTransaction_.rxBuffer  = dataBuffer;
+  fetchTransaction_.rxLength  = BYTECOUNT_DAQ_TOTAL;
+  fetchTransaction_.callback  = NULL;
+  fetchTransaction_.context   = NULL;
+
+  if (i2cWire_->submit(&fetchTransaction_) == I2C_STATUS_PENDING)
+  {
+    return SHT3X_STATUS_PENDING;
+  }
+  else
+  { // Could not queue the read.
+    return SHT3X_STATUS_FAIL;
+  }
 }
 
-// Returns the relative humidity without adjustments from the two-point calibration.
-double SHT3x::getRHRaw()
+// Returns SHT3X_STATUS_PENDING while the read queued by requestMeasurement() is still in progress.
+// Once it is done, the data are processed and this returns the same statuses as fetchMeasurement().
+SHT3X_STATUS SHT3x::checkMeasurement()
 {
-  return relativeHumidity_;
-}
+  if (!fetchTransaction_.complete)
+  {
+    return SHT3X_STATUS_PENDING;
+  }
 
-double SHT3x::getTemperature()
-{
-  return temperature_;
+  switch (fetchTransaction_.status)
+  {
+  case I2C_STATUS_OK:
+    return processMeasurement();
+  case I2C_STATUS_BEGIN_NACK:
+    // Sensor is still performing the measurement.
+    return SHT3X_STATUS_NOTREADY;
+  default:
+    return SHT3X_STATUS_FAIL;
+  }
 }
 
-// Grabs saved calibration data and places it in the given buffers.
-// If no data is available or the data is corrupt, returns false and places
-// default data into the buffers.
-bool SHT3x::getSavedCalibration(bool point1, float * RHOutputRef, float * RHOutputRaw)
+// Put the sensor in the periodic (continuous) mode, where it performs measurements by itself at the given rate.
+// The latest measurement can then be grabbed with only one read using fetchPeriodicMeasurement() or requestPeriodicMeasurement().
+// If the sensor is already in the periodic mode, it is stopped first.
+SHT3X_STATUS SHT3x::startPeriodicMeasurement(MeasurementRate rate, Repeatability repeatability)
 {
-  uint8_t crc;
+  uint8_t rateByte;
+  uint8_t repeatabilityByte;
 
-  if (point1)
+  switch (rate)
   {
-    EEPROM.get(EEPROM_ADDR_POINT1_CRC, crc);
-    EEPROM.get(EEPROM_ADDR_POINT1_RHREF, *RHOutputRef);
-    EEPROM.get(EEPROM_ADDR_POINT1_RHRAW, *RHOutputRaw);
+  case MPS_0_5:
+    rateByte = COM_DAQ_CON_HMPS_MSB;
+    repeatabilityByte = selectRepeatability(repeatability, COM_DAQ_CON_HMPS_LSB_LOWREP, COM_DAQ_CON_HMPS_LSB_MEDREP, COM_DAQ_CON_HMPS_LSB_HIGREP);
+    measurementPeriod_ = 2000;
+    break;
+  case MPS_1:
+    rateByte = COM_DAQ_CON_1MPS_MSB;
+    repeatabilityByte = selectRepeatability(repeatability, COM_DAQ_CON_1MPS_LSB_LOWREP, COM_DAQ_CON_1MPS_LSB_MEDREP, COM_DAQ_CON_1MPS_LSB_HIGREP);
+    measurementPeriod_ = 1000;
+    break;
+  case MPS_2:
+    rateByte = COM_DAQ_CON_2MPS_MSB;
+    repeatabilityByte = selectRepeatability(repeatability, COM_DAQ_CON_2MPS_LSB_LOWREP, COM_DAQ_CON_2MPS_LSB_MEDREP, COM_DAQ_CON_2MPS_LSB_HIGREP);
+    measurementPeriod_ = 500;
+    break;
+  case MPS_4:
+    rateByte = COM_DAQ_CON_4MPS_MSB;
+    repeatabilityByte = selectRepeatability(repeatability, COM_DAQ_CON_4MPS_LSB_LOWREP, COM_DAQ_CON_4MPS_LSB_MEDREP, COM_DAQ_CON_4MPS_LSB_HIGREP);
+    measurementPeriod_ = 250;
+    break;
+  case MPS_10:
+  default:
+    rateByte = COM_DAQ_CON_10MPS_MSB;
+    repeatabilityByte = selectRepeatability(repeatability, COM_DAQ_CON_10MPS_LSB_LOWREP, COM_DAQ_CON_10MPS_LSB_MEDREP, COM_DAQ_CON_10MPS_LSB_HIGREP);
+    measurementPeriod_ = 100;
+    break;
   }
-  else
+
+  // The sensor only listens to a few commands (e.g. break) in the periodic mode
+  if (periodicMode_ && stopPeriodicMeasurement() != SHT3X_STATUS_OK)
   {
-    EEPROM.get(EEPROM_ADDR_POINT2_CRC, crc);
-    EEPROM.get(EEPROM_ADDR_POINT2_RHREF, *RHOutputRef);
-    EEPROM.get(EEPROM_ADDR_POINT2_RHRAW, *RHOutputRaw);
+    return SHT3X_STATUS_FAIL;
   }
 
-  // Assign default values to facilitate subsequent calculations if there are
-  // no stored values or if the saved data are corrupted.
-  if (crc == calcCRCRefAndRaw(*RHOutputRef, *RHOutputRaw))
-  {// Already stored the correct values into the output
-    return true;
+  if (i2cWire_->write(i2cAddress_, rateByte, repeatabilityByte) == I2C_STATUS_OK)
+  {
+    periodicMode_ = true;
+    return SHT3X_STATUS_OK;
+    // The first measurement will be ready after one period (see getMeasurementPeriod())
   }
   else
+  { // Something went wrong.
+    return SHT3X_STATUS_FAIL;
+  }
+}
+
+// Put the sensor in the periodic mode with accelerated response time (ART); measurements are made at 4 Hz.
+// See the datasheet section 4.7.
+SHT3X_STATUS SHT3x::startART()
+{
+  if (periodicMode_ && stopPeriodicMeasurement() != SHT3X_STATUS_OK)
   {
-    if (point1)
-    {
-      *RHOutputRef = RH_POINT1_DEFAULT;
-      *RHOutputRaw = RH_POINT1_DEFAULT;
-    }
-    else
-    {
-      *RHOutputRef = RH_POINT2_DEFAULT;
-      *RHOutputRaw = RH_POINT2_DEFAULT;
-    }
-    return false;
+    return SHT3X_STATUS_FAIL;
+  }
+
+  if (i2cWire_->write(i2cAddress_, COM_DAQ_CON_ART_MSB, COM_DAQ_CON_ART_LSB) == I2C_STATUS_OK)
+  {
+    periodicMode_ = true;
+    measurementPeriod_ = 250;
+    return SHT3X_STATUS_OK;
+  }
+  else
+  { // Something went wrong.
+    return SHT3X_STATUS_FAIL;
   }
 }
 
-// Apply calibration to either point 1 or 2 depending on calPoint1, and
-// saves the calibration data into the EEPROM.
-void SHT3x::saveAndApplyCalibration(bool calPoint1, float RHRef, float RHRaw)
+// Send the break command to stop the periodic mode, returning the sensor to single-shot mode.
+SHT3X_STATUS SHT3x::stopPeriodicMeasurement()
 {
-  uint8_t crc = calcCRCRefAndRaw(RHRef, RHRaw);
+  if (i2cWire_->write(i2cAddress_, COM_BREAK_MSB, COM_BREAK_LSB) == I2C_STATUS_OK)
+  {
+    periodicMode_ = false;
+    delay(DURATION_BREAK);
+    return SHT3X_STATUS_OK;
+  }
+  else
+  { // Something went wrong.
+    return SHT3X_STATUS_FAIL;
+  }
+}
 
-  if (calPoint1)
+// Grab the latest measurement made in the periodic mode. Returns SHT3X_STATUS_NOTREADY if there is no new measurement since the last fetch.
+// Obtained data is stored internally. Must call getRH() or getTemperature() to get the actual measurement values.
+SHT3X_STATUS SHT3x::fetchPeriodicMeasurement()
+{
+  if (i2cWire_->write(i2cAddress_, COM_DAQ_FETCH[0], COM_DAQ_FETCH[1]) == I2C_STATUS_OK)
   {
-    EEPROM.put(EEPROM_ADDR_POINT1_CRC, crc);
-    EEPROM.put(EEPROM_ADDR_POINT1_RHREF, RHRef);
-    EEPROM.put(EEPROM_ADDR_POINT1_RHRAW, RHRaw);
+    return fetchMeasurement();
   }
   else
+  { // Something went wrong.
+    return SHT3X_STATUS_FAIL;
+  }
+}
+
+// Same as fetchPeriodicMeasurement(), but the fetch command and the read are queued on the I2C bus as one transaction
+// (with a repeated start in between) and done in the background. Call checkMeasurement() to find out how it went.
+SHT3X_STATUS SHT3x::requestPeriodicMeasurement()
+{
+  fetchTransaction_.address   = i2cAddress_;
+  fetchTransaction_.txBuffer  = COM_DAQ_FETCH;
+  fetchTransaction_.txLength  = sizeof(COM_DAQ_FETCH);
+  fetchTransaction_.rxBuffer  = dataBuffer;
+  fetchTransaction_.rxLength  = BYTECOUNT_DAQ_TOTAL;
+  fetchTransaction_.callback  = NULL;
+  fetchTransaction_.context   = NULL;
+
+  if (i2cWire_->submit(&fetchTransaction_) == I2C_STATUS_PENDING)
   {
-    EEPROM.put(EEPROM_ADDR_POINT2_CRC, crc);
-    EEPROM.put(EEPROM_ADDR_POINT2_RHREF, RHRef);
-    EEPROM.put(EEPROM_ADDR_POINT2_RHRAW, RHRaw);
+    return SHT3X_STATUS_PENDING;
+  }
+  else
+  { // Could not queue the read.
+    return SHT3X_STATUS_FAIL;
   }
+}
+
+// True if the sensor was put into the periodic mode (or ART).
+bool SHT3x::isPeriodicMode()
+{
+  return periodicMode_;
+}
+
+// Time (ms) between each measurement in the periodic mode.
+uint16_t SHT3x::getMeasurementPeriod()
+{
+  return measurementPeriod_;
+}
+
+// Returns the relative humidity to the caller after applying the calibration.
+real_t SHT3x::getRH()
+{
+  return calibratedRH_;
+}
+
+// Returns the relative humidity without the calibration.
+real_t SHT3x::getRHRaw()
+{
+  return relativeHumidity_;
+}
+
+real_t SHT3x::getTemperature()
+{
+  return temperature_;
+}
+
+// Raw RH signal of the last measurement, before conversion and calibration.
+uint16_t SHT3x::getRHSignal()
+{
+  return RHSignal_;
+}
+
+// Raw temperature signal of the last measurement, before conversion.
+uint16_t SHT3x::getTemperatureSignal()
+{
+  return tempSignal_;
+}
+
+uint8_t SHT3x::getCalibrationPointCount()
+{
+  return calibration_->pointCount;
+}
 
-  calcRHAdj();
+// Point index (in order of raw RH) of the calibration.
+void SHT3x::getCalibrationPoint(uint8_t index, float * RHRef, float * RHRaw)
+{
+  *RHRef = calibration_->ref[index] * 0.0015259;
+  *RHRaw = calibration_->raw[index] * 0.0015259;
 }
 
-// Overwrites all the saved calibration data with zeroes.
+// Index of the point that saving a point at RHRaw would replace, or the point count if it would add one.
+uint8_t SHT3x::findCalibrationPoint(float RHRaw)
+{
+  return findCalibrationPoint(calibration_, RHToSignal(RHRaw));
+}
+
+// Add a point to the calibration, or replace the one it is close to, and save it (see ConfigStore).
+void SHT3x::saveAndApplyCalibration(float RHRef, float RHRaw)
+{
+  ConfigStore_CalTable table = *calibration_;
+  addCalibrationPoint(&table, RHRef, RHRaw);
+  Config.setCalibration(calibrationSensor_, table);
+}
+
+// Deletes all saved calibration points.
 void SHT3x::resetCalibration()
 {
-  EEPROM.write(EEPROM_ADDR_POINT1_CRC, 0);
-  EEPROM.write(EEPROM_ADDR_POINT1_RHREF, 0);
-  EEPROM.write(EEPROM_ADDR_POINT1_RHRAW, 0);
-  EEPROM.write(EEPROM_ADDR_POINT2_CRC, 0);
-  EEPROM.write(EEPROM_ADDR_POINT2_RHREF, 0);
-  EEPROM.write(EEPROM_ADDR_POINT2_RHRAW, 0);
+  ConfigStore_CalTable table;
+  memset(&table, 0, sizeof(table));
+  Config.setCalibration(calibrationSensor_, table);
+}
+
+// Put a point into the table in order of raw RH, replacing the saved point within CAL_POINT_BAND (or the closest one if
+// the table is full), and work out the slopes again. This is the only place with a division, so it is kept out of the
+// measurements.
+void SHT3x::addCalibrationPoint(ConfigStore_CalTable * table, float RHRef, float RHRaw)
+{
+  uint16_t raw = RHToSignal(RHRaw);
+  uint8_t index = findCalibrationPoint(table, raw);
+
+  if (index == table->pointCount)
+  { // New point
+    index = 0;
+
+    while (index < table->pointCount && table->raw[index] < raw)
+    {
+      index++;
+    }
+
+    memmove(&table->raw[index + 1], &table->raw[index], (table->pointCount - index) * sizeof(table->raw[0]));
+    memmove(&table->ref[index + 1], &table->ref[index], (table->pointCount - index) * sizeof(table->ref[0]));
+    table->pointCount++;
+  }
+
+  // The replaced point is the closest one, so the new raw RH doesn't go past its neighbours.
+  table->raw[index] = raw;
+  table->ref[index] = RHToSignal(RHRef);
+  calcCalibrationSlopes(table);
+}
+
+// Checks and converts the raw bytes in dataBuffer into the actual readings.
+SHT3X_STATUS SHT3x::processMeasurement()
+{
+  // Organize the data
+  tempBuffer[0] = dataBuffer[BYTECOUNT_DAQ_TEMP - 2];
+  tempBuffer[1] = dataBuffer[BYTECOUNT_DAQ_TEMP - 1];
+  uint8_t tempCRC = dataBuffer[BYTECOUNT_DAQ_TEMP];
+
+  RHBuffer[0] = dataBuffer[BYTECOUNT_DAQ_TEMP + BYTECOUNT_DAQ_CRC + BYTECOUNT_DAQ_RH - 2];
+  RHBuffer[1] = dataBuffer[BYTECOUNT_DAQ_TEMP + BYTECOUNT_DAQ_CRC + BYTECOUNT_DAQ_RH - 1];
+  uint8_t RHCRC = dataBuffer[BYTECOUNT_DAQ_TEMP + BYTECOUNT_DAQ_CRC + BYTECOUNT_DAQ_RH];
+
+  // Perform CRC check on the RH and temperature bytes
+  if (tempCRC == calcCRC(tempBuffer, BYTECOUNT_DAQ_TEMP) && RHCRC == calcCRC(RHBuffer, BYTECOUNT_DAQ_RH))
+  { // CRC check success; move on to convert signal into actual readings.
+    // Refer to datasheet section 4.13.
+    // Calculate temperature (degC; we're not imperial heathens)
+    uint16_t tempSignal = tempBuffer[BYTECOUNT_DAQ_TEMP-2];
+    tempSignal = tempSignal << 8;
+    tempSignal |= tempBuffer[BYTECOUNT_DAQ_TEMP-1];
+    tempSignal_ = tempSignal;
+#ifdef USE_FIXED_POINT
+    // 175 * signal / (2^16 - 1) in Q15.16 is 175 * signal * 2^16 / (2^16 - 1), which is close enough to 175 * signal * (1 + 2^-16)
+    uint32_t tempScaled = (uint32_t) tempSignal * 175;
+    temperature_ = real_t::fromRaw(-45 * real_t::ONE + (int32_t) (tempScaled + (tempScaled >> 16)));
+#else
+    temperature_ = -45 + tempSignal * 0.0026703; // The multiplier is 175/(2^16 - 1), rounded to account for precision of float in Arduino
+#endif // USE_FIXED_POINT
+
+    // Calculate relative humidity
+    uint16_t RHSignal = RHBuffer[BYTECOUNT_DAQ_TEMP-2];
+    RHSignal = RHSignal << 8;
+    RHSignal |= RHBuffer[BYTECOUNT_DAQ_TEMP-1];
+    RHSignal_ = RHSignal;
+    relativeHumidity_ = signalToRH(RHSignal);
+    calibratedRH_ = signalToRH(calibrateSignal(RHSignal));
 
-  calcRHAdj();
+    return SHT3X_STATUS_OK;
+  }
+  else
+  { // Failed CRC check for one of the readings
+    return SHT3X_STATUS_CORRUPT;
+  }
+}
+
+// Pick the command byte that matches the given repeatability.
+uint8_t SHT3x::selectRepeatability(Repeatability repeatability, uint8_t lowRepByte, uint8_t medRepByte, uint8_t higRepByte)
+{
+  switch (repeatability)
+  {
+  case REP_LOW:
+    return lowRepByte;
+  case REP_MED:
+    return medRepByte;
+  case REP_HIG:
+  default:
+    return higRepByte;
+  }
 }
 
+// CRC-8 of every byte value, polynomial 0x31 (x^8 + x^5 + x^4 + 1), see datasheet section 4.12.
+// A lookup instead of shifting out 8 bits is what makes it cheap enough for the EEPROM records and serial frames too.
+static const uint8_t CRC8_TABLE[256] PROGMEM =
+{
+  0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+  0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4, 0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+  0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11, 0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+  0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+  0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA, 0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+  0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9, 0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+  0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C, 0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+  0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F, 0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+  0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED, 0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+  0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE, 0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+  0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B, 0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+  0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+  0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0, 0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+  0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93, 0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+  0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+  0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15, 0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC
+};
+
 // Calculate the CRC checksum of the data bytes.
-// Adapted from the Arduino SHT library by Sensirion:
+// Same result as the bitwise version in the Arduino SHT library by Sensirion:
 // https://github.com/Sensirion/arduino-sht
-uint8_t SHT3x::calcCRC(const uint8_t *data, uint8_t byteCount)
-{
-  uint8_t crc = 0xFF;
-  for (uint8_t byteCtr = 0; byteCtr < byteCount; ++byteCtr) {
-    crc ^= data[byteCtr];
-    for (uint8_t bit = 8; bit > 0; --bit) {
-      if (crc & 0x80) {
-        crc = (crc << 1) ^ 0x31;
-      }
-      else {
-        crc = (crc << 1);
-      }
-    }
+uint8_t SHT3x::calcCRC(const uint8_t *data, uint8_t byteCount, uint8_t crc)
+{
+  for (uint8_t byteCtr = 0; byteCtr < byteCount; ++byteCtr)
+  {
+    crc = pgm_read_byte(&CRC8_TABLE[crc ^ data[byteCtr]]);
   }
 
   return crc;
 }
 
-// Calculate the CRC value for the given reference and raw relative humidity values.
-uint8_t SHT3x::calcCRCRefAndRaw(float RHRef, float RHRaw)
+// Raw RH signal corrected by the segment of the calibration that it falls in: a search over a handful of points, and one
+// integer multiply-add.
+int32_t SHT3x::calibrateSignal(uint16_t signal)
 {
-  uint8_t * RHRefBytes = (uint8_t *)&RHRef;
-  uint8_t * RHRawBytes = (uint8_t *)&RHRaw;
-  uint8_t combinedBytes[2 * sizeof(float)];
-
-  // Populate first half of entries with ref RH
-  for (uint8_t i = 0; i < sizeof(float); i++)
+  if (calibration_->pointCount == 0)
   {
-    combinedBytes[i] = RHRefBytes[i];
+    return signal;
   }
 
-  // Populate second half of entries with raw RH
-  for (uint8_t i = sizeof(float); i < sizeof(combinedBytes); i++)
+  uint8_t segment = 0;
+
+  while (segment + 2 < calibration_->pointCount && signal >= calibration_->raw[segment + 1])
   {
-    combinedBytes[i] = RHRawBytes[i - sizeof(float)];
+    segment++;
   }
 
-  return calcCRC(combinedBytes, sizeof(combinedBytes));
+  int32_t distance = (int32_t) signal - calibration_->raw[segment];
+  return calibration_->ref[segment] + (((int32_t) calibration_->slope[segment] * distance) >> CONFIGSTORE_CAL_SLOPE_SHIFT);
 }
 
-// Calculate the slope adjustment and offset based on the two-point calibration.
-// Automatically assigns default values if no saved data is available.
-void SHT3x::calcRHAdj()
+// RH (%) of a signal. The calibrated signal may be a little out of the range of the sensor.
+real_t SHT3x::signalToRH(int32_t signal)
 {
-  // Get the saved values for calibration data.
-  float RHPoint1Ref;
-  float RHPoint1Raw;
-  float RHPoint2Ref;
-  float RHPoint2Raw;
+#ifdef USE_FIXED_POINT
+  // Same as the temperature in processMeasurement()
+  int32_t RHScaled = signal * 100;
+  return real_t::fromRaw(RHScaled + (RHScaled >> 16));
+#else
+  return signal * 0.0015259; // The multiplier is 100/(2^16 - 1), rounded to account for precision of float in Arduino
+#endif // USE_FIXED_POINT
+}
 
-  // Get the stored values, if any.
-  bool point1DataValid = getSavedCalibration(true, &RHPoint1Ref, &RHPoint1Raw);
-  bool point2DataValid = getSavedCalibration(false, &RHPoint2Ref, &RHPoint2Raw);
+uint16_t SHT3x::RHToSignal(float RH)
+{
+  return constrain(RH * 655.35 + 0.5, 0, 65535);
+}
+
+// Index of the saved point within CAL_POINT_BAND of raw (or the closest one if the table is full), otherwise the point count.
+uint8_t SHT3x::findCalibrationPoint(const ConfigStore_CalTable * table, uint16_t raw)
+{
+  uint8_t closest = table->pointCount;
+  uint16_t closestDistance = 0xFFFF;
+
+  for (uint8_t i = 0; i < table->pointCount; i++)
+  {
+    uint16_t distance = raw > table->raw[i] ? raw - table->raw[i] : table->raw[i] - raw;
 
-  // Calculate the slope
-  slopeAdjustment_ = (RHPoint2Ref - RHPoint1Ref) / (RHPoint2Raw - RHPoint1Raw);
+    if (distance < closestDistance)
+    {
+      closest = i;
+      closestDistance = distance;
+    }
+  }
 
-  // Since the offset only requires one point, preferentially use a point that is valid rather
-  // than one that was forced to default value. If both points are valid, it doesn't matter
-  // which point is used due to the way the equations work.
-  if (point1DataValid)
+  if (closestDistance <= CAL_POINT_BAND || table->pointCount >= CONFIGSTORE_CAL_POINT_MAX)
   {
-    offset_ = RHPoint1Ref - slopeAdjustment_ * RHPoint1Raw;
+    return closest;
   }
-  else if (point2DataValid)
+
+  return table->pointCount;
+}
+
+// Gain of each segment between two points. With only one point, the calibration is an offset.
+void SHT3x::calcCalibrationSlopes(ConfigStore_CalTable * table)
+{
+  if (table->pointCount == 1)
   {
-    offset_ = RHPoint2Ref - slopeAdjustment_ * RHPoint2Raw;
+    table->slope[0] = 1 << CONFIGSTORE_CAL_SLOPE_SHIFT;
+    return;
   }
-  else
+
+  for (uint8_t i = 0; i + 1 < table->pointCount; i++)
   {
-    offset_ = 0;
+    int32_t slope = ((int32_t) table->ref[i + 1] - table->ref[i]) * (1L << CONFIGSTORE_CAL_SLOPE_SHIFT) / ((int32_t) table->raw[i + 1] - table->raw[i]);
+    table->slope[i] = constrain(slope, (int32_t) INT16_MIN, (int32_t) INT16_MAX);
   }
 }
@@ -25,8 +25,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 	#include "WProgram.h"
 #endif
 
-#include <EEPROM.h>
 #include "I2C.h"
+#include "ConfigStore.h"
+#include "FixedPoint.h"
 
 // Statuses/Errors returned by the functions in this class
 typedef enum
@@ -35,7 +36,8 @@ typedef enum
   SHT3X_STATUS_FAIL       = 1,  // Something went wrong.
   SHT3X_STATUS_NOTREADY   = 2,  // The sensor is not ready to send out data.
   SHT3X_STATUS_CORRUPT    = 3,  // Either the relative humidity or temperature bytes failed the CRC check.
-  SHT3X_STATUS_DATA_LESS  = 4   // Received less data bytes than expected.
+  SHT3X_STATUS_DATA_LESS  = 4,  // Received less data bytes than expected.
+  SHT3X_STATUS_PENDING    = 5   // The background read requested by requestMeasurement() is still in progress.
 } SHT3X_STATUS;
 
 
@@ -51,6 +53,19 @@ public:
     REP_HIG = 2
   } Repeatability;
 
+  // Measurements per second in the periodic mode
+  typedef enum
+  {
+    MPS_0_5 = 0,
+    MPS_1   = 1,
+    MPS_2   = 2,
+    MPS_4   = 3,
+    MPS_10  = 4
+  } MeasurementRate;
+
+  // The sensor has a "base" address that can be modified depending on the state of the ADDR pin (pin 2)
+  static const uint8_t BASE_ADDRESS = 0x44;
+
   // Maximum duration (ms) needed to complete a measurement during the one-shot mode.
   // See datasheet Table 4.
   static const uint8_t DURATION_HIGREP = 15;
@@ -62,29 +77,40 @@ public:
   void changeAddress(bool ADDRPinHigh);
   SHT3X_STATUS triggerOneMeasurement(bool stretchClock, Repeatability repeatability);
   SHT3X_STATUS fetchMeasurement();
-  double getRH();
-  double getRHRaw();
-  double getTemperature();
-  bool getSavedCalibration(bool point1, float * RHOutputRef, float * RHOutputRaw);
-  void saveAndApplyCalibration(bool calPoint1, float RHRef, float RHRaw);
+  SHT3X_STATUS requestMeasurement();
+  SHT3X_STATUS checkMeasurement();
+  SHT3X_STATUS startPeriodicMeasurement(MeasurementRate rate, Repeatability repeatability);
+  SHT3X_STATUS startART();
+  SHT3X_STATUS stopPeriodicMeasurement();
+  SHT3X_STATUS fetchPeriodicMeasurement();
+  SHT3X_STATUS requestPeriodicMeasurement();
+  bool isPeriodicMode();
+  uint16_t getMeasurementPeriod();
+  real_t getRH();
+  real_t getRHRaw();
+  real_t getTemperature();
+  uint16_t getRHSignal();
+  uint16_t getTemperatureSignal();
+
+  // Multi-point RH calibration (see ConfigStore_CalTable). RH values are in %.
+  uint8_t getCalibrationPointCount();
+  void getCalibrationPoint(uint8_t index, float * RHRef, float * RHRaw);
+  uint8_t findCalibrationPoint(float RHRaw);
+  void saveAndApplyCalibration(float RHRef, float RHRaw);
   void resetCalibration();
+  static void addCalibrationPoint(ConfigStore_CalTable * table, float RHRef, float RHRaw);
 
-private:
-  // The sensor has a "base" address that can be modified depending on the state of the ADDR pin (pin 2)
-  const uint8_t BASE_ADDRESS = 0x44;
+  static uint8_t calcCRC(const uint8_t *data, uint8_t len, uint8_t crc = 0xFF); // Pass the CRC of the previous bytes as crc to continue it
 
-  // EEPROM storage locations for two-point calibration data.
-  // Note that float values (ref and raw RH) take up 4 bytes.
-  const uint8_t EEPROM_ADDR_POINT1_CRC    = 10;
-  const uint8_t EEPROM_ADDR_POINT1_RHREF  = 12;
-  const uint8_t EEPROM_ADDR_POINT1_RHRAW  = 16;
-  const uint8_t EEPROM_ADDR_POINT2_CRC    = 20;
-  const uint8_t EEPROM_ADDR_POINT2_RHREF  = 22;
-  const uint8_t EEPROM_ADDR_POINT2_RHRAW  = 26;
+private:
+  // Each address has its own calibration in ConfigStore (0: ADDR pin low, 1: high),
+  // so that two sensors on the same bus can be calibrated separately.
+  uint8_t calibrationSensor_;
 
-  // Default values for two-point calibration
-  const float RH_POINT1_DEFAULT = 1;
-  const float RH_POINT2_DEFAULT = 100;
+  // A point saved within this raw RH signal (2 %RH) of a saved point replaces it rather than adding one, so that the
+  // points are never too close for the slope between them.
+  static const uint16_t CAL_POINT_BAND = 1311;
+  const ConfigStore_CalTable *calibration_;  // The table in ConfigStore, so that it follows every change
 
   // Number of bytes for I2C transmission
   static const uint8_t BYTECOUNT_DAQ_TOTAL  = 6;
@@ -101,60 +127,77 @@ private:
    * DATA ACQUISITION *
    ********************/
   // One shot mode, clock stretching enabled
-  const uint8_t COM_DAQ_ONE_STRETCH_MSB         = 0x2C;
-  const uint8_t COM_DAQ_ONE_STRETCH_LSB_HIGREP  = 0x06;
-  const uint8_t COM_DAQ_ONE_STRETCH_LSB_MEDREP  = 0x0D;
-  const uint8_t COM_DAQ_ONE_STRETCH_LSB_LOWREP  = 0x10;
+  static const uint8_t COM_DAQ_ONE_STRETCH_MSB         = 0x2C;
+  static const uint8_t COM_DAQ_ONE_STRETCH_LSB_HIGREP  = 0x06;
+  static const uint8_t COM_DAQ_ONE_STRETCH_LSB_MEDREP  = 0x0D;
+  static const uint8_t COM_DAQ_ONE_STRETCH_LSB_LOWREP  = 0x10;
 
   // One shot mode, clock stretching disabled
-  const uint8_t COM_DAQ_ONE_NOSTRETCH_MSB         = 0x24;
-  const uint8_t COM_DAQ_ONE_NOSTRETCH_LSB_HIGREP  = 0x00;
-  const uint8_t COM_DAQ_ONE_NOSTRETCH_LSB_MEDREP  = 0x0B;
-  const uint8_t COM_DAQ_ONE_NOSTRETCH_LSB_LOWREP  = 0x16;
+  static const uint8_t COM_DAQ_ONE_NOSTRETCH_MSB         = 0x24;
+  static const uint8_t COM_DAQ_ONE_NOSTRETCH_LSB_HIGREP  = 0x00;
+  static const uint8_t COM_DAQ_ONE_NOSTRETCH_LSB_MEDREP  = 0x0B;
+  static const uint8_t COM_DAQ_ONE_NOSTRETCH_LSB_LOWREP  = 0x16;
 
-  // TODO: Only coding for single-shot mode, for now.....
-  /*
   // Continuous mode, 0.5 measurement per second
-  const uint8_t COM_DAQ_CON_HMPS_MSB = 0x20;
-  const uint8_t COM_DAQ_CON_HMPS_LSB_HIGREP = 0x32;
-  const uint8_t COM_DAQ_CON_HMPS_LSB_MEDREP = 0x24;
-  const uint8_t COM_DAQ_CON_HMPS_LSB_LOWREP = 0x2F;
+  static const uint8_t COM_DAQ_CON_HMPS_MSB = 0x20;
+  static const uint8_t COM_DAQ_CON_HMPS_LSB_HIGREP = 0x32;
+  static const uint8_t COM_DAQ_CON_HMPS_LSB_MEDREP = 0x24;
+  static const uint8_t COM_DAQ_CON_HMPS_LSB_LOWREP = 0x2F;
 
   // Continuous mode, 1 measurement per second
-  const uint8_t COM_DAQ_CON_1MPS_MSB = 0x21;
-  const uint8_t COM_DAQ_CON_1MPS_LSB_HIGREP = 0x30;
-  const uint8_t COM_DAQ_CON_1MPS_LSB_MEDREP = 0x26;
-  const uint8_t COM_DAQ_CON_1MPS_LSB_LOWREP = 0x2D;
+  static const uint8_t COM_DAQ_CON_1MPS_MSB = 0x21;
+  static const uint8_t COM_DAQ_CON_1MPS_LSB_HIGREP = 0x30;
+  static const uint8_t COM_DAQ_CON_1MPS_LSB_MEDREP = 0x26;
+  static const uint8_t COM_DAQ_CON_1MPS_LSB_LOWREP = 0x2D;
 
   // Continuous mode, 2 measurements per second
-  const uint8_t COM_DAQ_CON_2MPS_MSB = 0x22;
-  const uint8_t COM_DAQ_CON_2MPS_LSB_HIGREP = 0x36;
-  const uint8_t COM_DAQ_CON_2MPS_LSB_MEDREP = 0x20;
-  const uint8_t COM_DAQ_CON_2MPS_LSB_LOWREP = 0x2B;
+  static const uint8_t COM_DAQ_CON_2MPS_MSB = 0x22;
+  static const uint8_t COM_DAQ_CON_2MPS_LSB_HIGREP = 0x36;
+  static const uint8_t COM_DAQ_CON_2MPS_LSB_MEDREP = 0x20;
+  static const uint8_t COM_DAQ_CON_2MPS_LSB_LOWREP = 0x2B;
 
   // Continuous mode, 4 measurements per second
-  const uint8_t COM_DAQ_CON_4MPS_MSB = 0x23;
-  const uint8_t COM_DAQ_CON_4MPS_LSB_HIGREP = 0x34;
-  const uint8_t COM_DAQ_CON_4MPS_LSB_MEDREP = 0x22;
-  const uint8_t COM_DAQ_CON_4MPS_LSB_LOWREP = 0x29;
+  static const uint8_t COM_DAQ_CON_4MPS_MSB = 0x23;
+  static const uint8_t COM_DAQ_CON_4MPS_LSB_HIGREP = 0x34;
+  static const uint8_t COM_DAQ_CON_4MPS_LSB_MEDREP = 0x22;
+  static const uint8_t COM_DAQ_CON_4MPS_LSB_LOWREP = 0x29;
 
   // Continuous mode, 10 measurements per second
-  const uint8_t COM_DAQ_CON_10MPS_MSB = 0x27;
-  const uint8_t COM_DAQ_CON_10MPS_LSB_HIGREP = 0x37;
-  const uint8_t COM_DAQ_CON_10MPS_LSB_MEDREP = 0x21;
-  const uint8_t COM_DAQ_CON_10MPS_LSB_LOWREP = 0x2A;
-  */
+  static const uint8_t COM_DAQ_CON_10MPS_MSB = 0x27;
+  static const uint8_t COM_DAQ_CON_10MPS_LSB_HIGREP = 0x37;
+  static const uint8_t COM_DAQ_CON_10MPS_LSB_MEDREP = 0x21;
+  static const uint8_t COM_DAQ_CON_10MPS_LSB_LOWREP = 0x2A;
+
+  // Continuous mode with accelerated response time (ART), 4 measurements per second
+  static const uint8_t COM_DAQ_CON_ART_MSB = 0x2B;
+  static const uint8_t COM_DAQ_CON_ART_LSB = 0x32;
+
+  // Fetch the latest measurement in continuous mode. Kept as an array so that it can be sent by a background transaction.
+  static const uint8_t COM_DAQ_FETCH[2];
+
+  // Break/stop continuous mode and return to single-shot mode
+  static const uint8_t COM_BREAK_MSB = 0x30;
+  static const uint8_t COM_BREAK_LSB = 0x93;
+  static const uint8_t DURATION_BREAK = 1; // Time (ms) for the sensor to abort the measurement and become idle.
 
   I2C *i2cWire_;
   uint8_t i2cAddress_;
-  double relativeHumidity_;
-  double temperature_;
-  float slopeAdjustment_;
-  float offset_;
-
-  uint8_t calcCRC(const uint8_t *data, uint8_t len);
-  uint8_t calcCRCRefAndRaw(float RHRef, float RHRaw);
-  void calcRHAdj();
+  real_t relativeHumidity_;
+  real_t temperature_;
+  uint16_t RHSignal_;       // Raw signals behind relativeHumidity_ and temperature_
+  uint16_t tempSignal_;
+  bool periodicMode_;
+  uint16_t measurementPeriod_;   // Time (ms) between each measurement in the periodic mode
+  real_t calibratedRH_;
+  I2C_Transaction fetchTransaction_;  // Used by requestMeasurement() to read into dataBuffer in the background.
+
+  SHT3X_STATUS processMeasurement();
+  uint8_t selectRepeatability(Repeatability repeatability, uint8_t lowRepByte, uint8_t medRepByte, uint8_t higRepByte);
+  int32_t calibrateSignal(uint16_t signal);
+  static real_t signalToRH(int32_t signal);
+  static uint16_t RHToSignal(float RH);
+  static uint8_t findCalibrationPoint(const ConfigStore_CalTable * table, uint16_t raw);
+  static void calcCalibrationSlopes(ConfigStore_CalTable * table);
 };
 
 
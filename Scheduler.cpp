@@ -0,0 +1,189 @@
+/*********************************************************************************
+Cooperative task scheduler for the main loop.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "Scheduler.h"
+
+Scheduler::Scheduler() : taskCount_(0) {}
+
+// Add a task that runs every periodMs, for the first time firstDelayMs from now.
+SCHEDULER_STATUS Scheduler::addPeriodic(Scheduler_Callback callback, void *context, uint16_t periodMs, uint16_t firstDelayMs, uint8_t *taskID)
+{
+  SCHEDULER_STATUS status = addTask(callback, context, periodMs, taskID);
+
+  if (status == SCHEDULER_STATUS_OK)
+  {
+    tasks_[*taskID].deadline = millis() + firstDelayMs;
+    tasks_[*taskID].pending = true;
+  }
+
+  return status;
+}
+
+// Add a task that only runs after trigger() is called.
+SCHEDULER_STATUS Scheduler::addOneShot(Scheduler_Callback callback, void *context, uint8_t *taskID)
+{
+  return addTask(callback, context, 0, taskID);
+}
+
+// Run the task delayMs from now. For a periodic task, this moves its next run and the period continues from there.
+// Triggering a one-shot task that is already pending only moves its deadline.
+SCHEDULER_STATUS Scheduler::trigger(uint8_t taskID, uint16_t delayMs)
+{
+  if (taskID >= taskCount_)
+  {
+    return SCHEDULER_STATUS_INVALID_TASK;
+  }
+
+  tasks_[taskID].deadline = millis() + delayMs;
+  tasks_[taskID].pending = true;
+  return SCHEDULER_STATUS_OK;
+}
+
+// Stop the task from running until it is triggered again.
+SCHEDULER_STATUS Scheduler::cancel(uint8_t taskID)
+{
+  if (taskID >= taskCount_)
+  {
+    return SCHEDULER_STATUS_INVALID_TASK;
+  }
+
+  tasks_[taskID].pending = false;
+  return SCHEDULER_STATUS_OK;
+}
+
+// Change the period of a task. The next run is not moved; use trigger() for that.
+SCHEDULER_STATUS Scheduler::setPeriod(uint8_t taskID, uint16_t periodMs)
+{
+  if (taskID >= taskCount_)
+  {
+    return SCHEDULER_STATUS_INVALID_TASK;
+  }
+
+  tasks_[taskID].period = periodMs;
+  return SCHEDULER_STATUS_OK;
+}
+
+// Run the tasks that are due, earliest deadline first. Call this in loop().
+void Scheduler::run()
+{
+  bool ran[SCHEDULER_TASK_MAX] = {false};
+
+  for (uint8_t pass = 0; pass < taskCount_; pass++)
+  {
+    unsigned long now = millis();
+    uint8_t earliest = TASK_INVALID;
+
+    for (uint8_t i = 0; i < taskCount_; i++)
+    {
+      // Signed difference so that comparisons keep working when millis() rolls over.
+      if (tasks_[i].pending && !ran[i] && (long) (now - tasks_[i].deadline) >= 0
+          && (earliest == TASK_INVALID || (long) (tasks_[i].deadline - tasks_[earliest].deadline) < 0))
+      {
+        earliest = i;
+      }
+    }
+
+    if (earliest == TASK_INVALID)
+    { // Nothing else is due
+      return;
+    }
+
+    ran[earliest] = true;
+    runTask(earliest, now);
+  }
+}
+
+uint8_t Scheduler::getTaskCount()
+{
+  return taskCount_;
+}
+
+SCHEDULER_STATUS Scheduler::getTaskStats(uint8_t taskID, Scheduler_TaskStats *stats)
+{
+  if (taskID >= taskCount_)
+  {
+    return SCHEDULER_STATUS_INVALID_TASK;
+  }
+
+  *stats = tasks_[taskID].stats;
+  return SCHEDULER_STATUS_OK;
+}
+
+void Scheduler::resetTaskStats()
+{
+  for (uint8_t i = 0; i < taskCount_; i++)
+  {
+    memset(&tasks_[i].stats, 0, sizeof(Scheduler_TaskStats));
+  }
+}
+
+SCHEDULER_STATUS Scheduler::addTask(Scheduler_Callback callback, void *context, uint16_t periodMs, uint8_t *taskID)
+{
+  if (taskCount_ >= SCHEDULER_TASK_MAX)
+  {
+    *taskID = TASK_INVALID;
+    return SCHEDULER_STATUS_FULL;
+  }
+
+  Task *task = &tasks_[taskCount_];
+  task->callback = callback;
+  task->context = context;
+  task->period = periodMs;
+  task->deadline = 0;
+  task->pending = false;
+  memset(&task->stats, 0, sizeof(Scheduler_TaskStats));
+
+  *taskID = taskCount_;
+  taskCount_++;
+  return SCHEDULER_STATUS_OK;
+}
+
+void Scheduler::runTask(uint8_t taskID, unsigned long now)
+{
+  Task *task = &tasks_[taskID];
+
+  // Set up the next run before calling the task, so that the task can still trigger() or cancel() itself.
+  if (task->period > 0)
+  {
+    if (now - task->deadline >= task->period)
+    { // Missed at least one whole period; start counting from now instead of trying to catch up.
+      task->stats.overrunCount++;
+      task->deadline = now + task->period;
+    }
+    else
+    { // Keep to the original schedule so that the period doesn't drift.
+      task->deadline += task->period;
+    }
+  }
+  else
+  {
+    task->pending = false;
+  }
+
+  unsigned long startTime = micros();
+  task->callback(task->context);
+  unsigned long runTime = micros() - startTime;
+
+  task->stats.runCount++;
+  task->stats.runTimeTotal += runTime;
+
+  if (runTime > task->stats.runTimeMax)
+  {
+    task->stats.runTimeMax = runTime > 0xFFFF ? 0xFFFF : runTime;
+  }
+}
@@ -0,0 +1,93 @@
+/*********************************************************************************
+Cooperative task scheduler for the main loop.
+
+Tasks are plain functions with a context pointer, kept in a fixed array. A task
+is either periodic or one-shot; one-shot tasks stay in the table and can be
+triggered again. Every call to run() executes the due tasks, earliest deadline
+first, and each task at most once per call so that a task that is always due can't
+starve the others. Tasks must not block.
+
+The scheduler also keeps track of how many times each task ran, how long it took
+and how often a periodic task missed a whole period (overrun).
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _SCHEDULER_h
+#define _SCHEDULER_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#define SCHEDULER_TASK_MAX 10 // Number of tasks that can be added; HumidOSH uses 8. Each one takes 23 bytes of SRAM.
+
+// Statuses/Errors returned by the functions in this class
+typedef enum
+{
+  SCHEDULER_STATUS_OK           = 0,
+  SCHEDULER_STATUS_FULL         = 1,  // No space left in the task table
+  SCHEDULER_STATUS_INVALID_TASK = 2   // No task with that ID
+} SCHEDULER_STATUS;
+
+typedef void (*Scheduler_Callback)(void *context);
+
+// Run time accounting of a task
+struct Scheduler_TaskStats
+{
+  unsigned long runCount;
+  unsigned long runTimeTotal;   // us
+  uint16_t runTimeMax;          // us
+  uint16_t overrunCount;        // Times a periodic task was late by at least one whole period
+};
+
+class Scheduler
+{
+public:
+  static const uint8_t TASK_INVALID = 0xFF;
+
+  Scheduler();
+  SCHEDULER_STATUS addPeriodic(Scheduler_Callback callback, void *context, uint16_t periodMs, uint16_t firstDelayMs, uint8_t *taskID);
+  SCHEDULER_STATUS addOneShot(Scheduler_Callback callback, void *context, uint8_t *taskID);
+  SCHEDULER_STATUS trigger(uint8_t taskID, uint16_t delayMs);
+  SCHEDULER_STATUS cancel(uint8_t taskID);
+  SCHEDULER_STATUS setPeriod(uint8_t taskID, uint16_t periodMs);
+  void run();
+  uint8_t getTaskCount();
+  SCHEDULER_STATUS getTaskStats(uint8_t taskID, Scheduler_TaskStats *stats);
+  void resetTaskStats();
+
+private:
+  struct Task
+  {
+    Scheduler_Callback callback;
+    void *context;
+    uint16_t period;          // ms; 0 for one-shot tasks
+    unsigned long deadline;   // millis() when the task is due
+    bool pending;             // Waiting for its deadline; periodic tasks are always pending unless cancelled
+    Scheduler_TaskStats stats;
+  };
+
+  Task tasks_[SCHEDULER_TASK_MAX];
+  uint8_t taskCount_;
+
+  SCHEDULER_STATUS addTask(Scheduler_Callback callback, void *context, uint16_t periodMs, uint8_t *taskID);
+  void runTask(uint8_t taskID, unsigned long now);
+};
+
+#endif
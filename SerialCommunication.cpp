@@ -16,12 +16,105 @@ limitations under the License.
 
 #include "SerialCommunication.h"
 
+const unsigned long SerialCommunication::BAUD_RATES[BAUD_RATES_COUNT] = {9600, 115200, 230400, 250000, 500000, 1000000};
+
 SerialCommunication::SerialCommunication() {}
 
-void SerialCommunication::init(unsigned long baudRate)
+// Starts with the saved baud rate (see ConfigStore), if any, otherwise with defaultBaudRate.
+void SerialCommunication::init(unsigned long defaultBaudRate)
 {
-  Serial.begin(baudRate);
+  unsigned long savedBaudRate = Config.getBaudRate();
+
+  if (isBaudRateSupported(savedBaudRate))
+  {
+    baudRate_ = savedBaudRate;
+  }
+  else
+  {
+    baudRate_ = defaultBaudRate;
+  }
+
+  Serial.begin(baudRate_);
   serialActive_ = true;
+
+  uint8_t savedUnitAddress = Config.getUnitAddress();
+  unitAddress_ = savedUnitAddress <= UNIT_ADDRESS_MAX ? savedUnitAddress : UNIT_ADDRESS_NONE;
+}
+
+bool SerialCommunication::isBaudRateSupported(unsigned long baudRate)
+{
+  for (uint8_t i = 0; i < BAUD_RATES_COUNT; i++)
+  {
+    if (BAUD_RATES[i] == baudRate)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Switch to the new baud rate right away (after sending whatever is queued at the current rate).
+// The computer then has BAUD_CONFIRM_TIMEOUT to repeat the command over the new rate, which is when
+// the rate is saved; otherwise checkBaudRateChange() goes back to the previous rate.
+void SerialCommunication::beginBaudRateChange(unsigned long baudRate)
+{
+  if (!baudRateChangePending_)
+  {
+    previousBaudRate_ = baudRate_;
+  }
+
+  switchBaudRate(baudRate);
+  baudRateChangePending_ = true;
+  baudRateChangeTime_ = millis();
+}
+
+// Returns true and saves the baud rate if it matches the pending one.
+bool SerialCommunication::confirmBaudRateChange(unsigned long baudRate)
+{
+  if (!baudRateChangePending_ || baudRate != baudRate_)
+  {
+    return false;
+  }
+
+  baudRateChangePending_ = false;
+  Config.setBaudRate(baudRate_);
+  return true;
+}
+
+bool SerialCommunication::isBaudRateChangePending()
+{
+  return baudRateChangePending_;
+}
+
+// Call this regularly. Falls back to the previous baud rate if the new one wasn't confirmed in time, and tells the computer so.
+void SerialCommunication::checkBaudRateChange()
+{
+  if (baudRateChangePending_ && millis() - baudRateChangeTime_ >= BAUD_CONFIRM_TIMEOUT)
+  {
+    baudRateChangePending_ = false;
+    switchBaudRate(previousBaudRate_);
+    sendCommandResponse(SERIAL_CMD_BAUD, false);
+  }
+}
+
+unsigned long SerialCommunication::getBaudRate()
+{
+  return baudRate_;
+}
+
+// Check if the longest data string can be sent within periodMs at the current baud rate (10 bits per byte).
+bool SerialCommunication::canSendEvery(uint16_t periodMs)
+{
+  return (unsigned long) SERIAL_SEND_DATA_LENGTH_MAX * 10 * 1000 / baudRate_ <= periodMs;
+}
+
+void SerialCommunication::switchBaudRate(unsigned long baudRate)
+{
+  Serial.flush(); // Let the response to the command go out at the current rate
+  Serial.end();
+  Serial.begin(baudRate);
+  baudRate_ = baudRate;
 }
 
 void SerialCommunication::enableSending()
@@ -34,135 +127,369 @@ void SerialCommunication::disableSending()
   serialActive_ = false;
 }
 
+// The driver stays disabled (receiving) until there is something to send.
+void SerialCommunication::setDriverEnablePin(uint8_t pin)
+{
+  driverEnablePin_ = pin;
+  transmitting_ = false;
+  pinMode(driverEnablePin_, OUTPUT);
+  digitalWrite(driverEnablePin_, LOW);
+}
+
+// Takes effect right away (and is saved). The reply to the command that set it still goes out, under the old address.
+bool SerialCommunication::setUnitAddress(unsigned long address)
+{
+  if (address > UNIT_ADDRESS_MAX)
+  {
+    return false;
+  }
+
+  addressed_ = unitAddress_ == UNIT_ADDRESS_NONE || addressed_;
+  unitAddress_ = address;
+  Config.setUnitAddress(unitAddress_);
+  return true;
+}
+
+uint8_t SerialCommunication::getUnitAddress()
+{
+  return unitAddress_;
+}
+
+// Whether this unit may send now (see UNIT_ADDRESS_NONE). If so, the driver is enabled until checkTransmitDone().
+bool SerialCommunication::beginTransmit()
+{
+  if (unitAddress_ != UNIT_ADDRESS_NONE && !addressed_)
+  {
+    return false;
+  }
+
+  if (driverEnablePin_ != PIN_NONE && !transmitting_)
+  {
+    digitalWrite(driverEnablePin_, HIGH);
+    transmitting_ = true;
+  }
+
+  return true;
+}
+
+// Call this regularly. Disables the driver once the last byte is out of the UART, so that the computer can talk.
+// Serial.write() clears TXC0, and the UART sets it once the transmit buffer and the shift register are empty.
+void SerialCommunication::checkTransmitDone()
+{
+  if (transmitting_ && Serial.availableForWrite() >= SERIAL_TX_BUFFER_SIZE - 1 && bit_is_set(UCSR0A, TXC0))
+  {
+    digitalWrite(driverEnablePin_, LOW);
+    transmitting_ = false;
+  }
+}
+
+// A command can be followed by a binary payload (only SERIAL_CMD_PROGRAM is): ^o|[length]@ then [length] bytes
+// and their CRC8 (same CRC as the SHT3x). The payload is taken as it is, so it may hold any byte. Once it is all in,
+// this returns true, and getPayload() has it if the CRC was right.
+// On a multi-drop bus, the unit address comes first (see UNIT_ADDRESS_NONE), and is taken out of the fragments.
 bool SerialCommunication::processIncoming()
 {
-  // All communication must start with SERIAL_CMD_START
-  if (Serial.peek() == SERIAL_CMD_START)
+  while (Serial.available())
   {
-    // Extract this command string
-    memset(serialBuffer, '\0', serialBufferLength);
-    Serial.readBytesUntil(SERIAL_CMD_EOL, serialBuffer, (serialBufferLength - 1));
+    char incoming = Serial.read();
 
-    // Get the pointer to SERIAL_CMD_END 
-    char* endFlag = strchr(serialBuffer, SERIAL_CMD_END);
+    if (payloadRemaining_ > 0 && millis() - payloadStartTime_ > PAYLOAD_TIMEOUT)
+    { // The rest of the payload never came; back to commands.
+      payloadRemaining_ = 0;
+    }
 
-    // All communication must end with SERIAL_CMD_END 
-    // Check if it isn't missing and that there's nothing coming after it
-    if (endFlag && serialBuffer[endFlag - serialBuffer + 1] == '\0')
+    if (payloadRemaining_ > 0)
     {
-      uint8_t endPos = endFlag - serialBuffer;// Index of SERIAL_CMD_END
-
-      // Remove the start and end flags, so we are only left with the inner string
-      // First, clear the processing buffer
-      memset(trimmedSerialBuffer, '\0', serialBufferLength);
-
-      // inputBuffer + 1 to start after SERIAL_CMD_START
-      // endPos - 1 because array is indexed 0, so only minus 1 for one of the start/end flags
-      strncpy(trimmedSerialBuffer, serialBuffer + 1, endPos - 1);
-
-      
-      // Extract first fragment
-      uint8_t fragmentsExtracted = 0;
-      char *tokenPtr = strtok(trimmedSerialBuffer, &SERIAL_CMD_SEPARATOR);
-
-      if (tokenPtr)
-      {// There was at least one command fragment
-        // The first (or maybe only)  is always the command itself. Based on the command,
-        // we can expect the number of parameters that is associated with it
-        uint8_t paramsCount;
-
-        switch (tokenPtr[0])
-        {
-          case SERIAL_CMD_DAQ_START:
-            paramsCount = MAXPARAM_DAQ_START;
-            break;
-          case SERIAL_CMD_DAQ_STOP:
-            paramsCount = MAXPARAM_DAQ_STOP;
-            break;
-          default:
-            // Unknown command, stop processing
-            return(false);
-        }
-
-        do
-        {// Process the extracted fragment. Notice this is a do-while loop.
-          fragmentsExtracted++;
-
-          // Clear the output buffer
-          memset(fragmentBuffer[fragmentsExtracted - 1], '\0', fragmentBufferLength);
-          strcpy(fragmentBuffer[fragmentsExtracted - 1], tokenPtr); // IMPORTANT: Make sure that fragments[fragmentsExtracted - 1] is a char array with at least as many elements as tokenPtr
-          tokenPtr = strtok(NULL, &SERIAL_CMD_SEPARATOR);
-          // Repeat the loop while we haven't exceeded the max number of params for this command and while there are more params available
-        } while (fragmentsExtracted - 1 < paramsCount && tokenPtr);
-
-        // Check if the number of extracted command params are as expected
-        // (because we might exit the while loop above due to tokenPtr being null)
-        // Minus one to account for the command itself being one of the fragments
-        if (fragmentsExtracted - 1 < paramsCount)
-        {
-          // Not enough params were extracted
-          return false;
-        }
-
-        // Check if there are still params remaining
-        // (because we might exit the while loop above due to fragmentsExtracted >= paramsCount)
-        if (tokenPtr)
-        {
-          // Too many params command params were received, though not all were extracted
-          return false;
-        }
-
-        // Extracted command and associated params, all good to go.
+      if (receivePayload(incoming))
+      {
         return true;
       }
-      else
+    }
+    else if (incoming == SERIAL_CMD_START)
+    { // All communication must start with SERIAL_CMD_START. This also drops any command that was cut short.
+      // On a multi-drop bus, this also ends the turn of the unit that was last addressed.
+      commandParsing_ = true;
+      addressed_ = false;
+      commandLength_ = 0;
+      fragmentCount_ = 1;
+      fragmentStart_[0] = 0;
+    }
+    else if (!commandParsing_)
+    { // Not within a command (e.g. the EOL after SERIAL_CMD_END), so assume this is garbage
+    }
+    else if (incoming == SERIAL_CMD_END)
+    { // All communication must end with SERIAL_CMD_END
+      commandParsing_ = false;
+
+      if (!endFragment())
       {
-        // Not a single fragment is available
-        return false;
-      }  
+        continue;
+      }
+
+      bool forUnit = takeUnitAddress();
+
+      if (commandBuffer_[fragmentStart_[0]] == SERIAL_CMD_PROGRAM && fragmentCount_ == MAXPARAM_PROGRAM + 1)
+      { // The payload comes next. It is read even if the command is for another unit, so that none of it is taken for a command.
+        unsigned long length = getFragmentULong(1);
+        payloadStart_ = commandLength_;
+        payloadForUnit_ = forUnit;
+        payloadFits_ = forUnit && length < (unsigned long) (COMMAND_LENGTH_MAX - payloadStart_);
+        payloadLength_ = payloadFits_ ? length : 0;
+        payloadRemaining_ = length + 1;
+        payloadStartTime_ = millis();
+        payloadValid_ = false;
+        continue;
+      }
+
+      if (forUnit && checkParamsCount())
+      { // Extracted command and associated params, all good to go. Anything after this stays in the Serial buffer for the next call.
+        return true;
+      }
+    }
+    else if (incoming == SERIAL_CMD_SEPARATOR)
+    {
+      if (endFragment() && fragmentCount_ < FRAGMENT_COUNT_MAX)
+      {
+        fragmentStart_[fragmentCount_] = commandLength_;
+        fragmentCount_++;
+      }
+      else
+      { // Empty fragment or too many fragments
+        commandParsing_ = false;
+      }
+    }
+    else if (incoming == SERIAL_CMD_EOL || commandLength_ >= COMMAND_LENGTH_MAX - 1)
+    { // SERIAL_CMD_END wasn't seen before the end of the line or the command is too long; assume this is garbage.
+      commandParsing_ = false;
     }
     else
-    {// SERIAL_CMD_END wasn't seen or in wrong location, so assume this is garbage
-      return false;
+    {
+      commandBuffer_[commandLength_] = incoming;
+      commandLength_++;
     }
   }
-  else
-  {// SERIAL_CMD_START wasn't seen, so assume this is garbage
-    // Grab the buffer, but don't store it anywhere. This helps to clear the buffer
-    Serial.read();
+
+  return false;
+}
+
+// Take one byte of the payload. Returns true once the payload (and its CRC) is all in, unless it is for another unit.
+// A payload too long for commandBuffer_ is still read to the end, so that none of it is taken for a command, but it is not valid.
+bool SerialCommunication::receivePayload(uint8_t incoming)
+{
+  if (payloadFits_)
+  {
+    commandBuffer_[commandLength_] = incoming;
+    commandLength_++;
+  }
+
+  payloadRemaining_--;
+
+  if (payloadRemaining_ > 0)
+  {
+    return false;
+  }
+
+  const uint8_t *payload = (const uint8_t *) commandBuffer_ + payloadStart_;
+  payloadValid_ = payloadFits_ && payload[payloadLength_] == SHT3x::calcCRC(payload, payloadLength_);
+  return payloadForUnit_;
+}
+
+// The payload that came with the last command, or NULL if it had none or its CRC was wrong.
+const uint8_t * SerialCommunication::getPayload(uint8_t * length)
+{
+  if (!payloadValid_ || payloadRemaining_ > 0)
+  {
+    *length = 0;
+    return NULL;
+  }
+
+  *length = payloadLength_;
+  return (const uint8_t *) commandBuffer_ + payloadStart_;
+}
+
+// Terminate the last fragment in place. Returns false if it's empty or there is no space left for the terminator.
+bool SerialCommunication::endFragment()
+{
+  uint8_t fragmentIndex = fragmentCount_ - 1;
+  fragmentLength_[fragmentIndex] = commandLength_ - fragmentStart_[fragmentIndex];
+
+  if (fragmentLength_[fragmentIndex] == 0 || commandLength_ >= COMMAND_LENGTH_MAX)
+  {
+    return false;
+  }
+
+  commandBuffer_[commandLength_] = '\0';
+  commandLength_++;
+  return true;
+}
+
+// On a multi-drop bus, drop the unit address in front of the command, so that the command is fragment 0 as in point-to-point.
+// Returns false if the command isn't for this unit; without an address, it is for a controller on its own.
+bool SerialCommunication::takeUnitAddress()
+{
+  if (unitAddress_ == UNIT_ADDRESS_NONE)
+  {
+    return true;
+  }
+
+  if (fragmentCount_ < 2 || !isDigit(commandBuffer_[0]))
+  {
     return false;
   }
+
+  unsigned long address = getFragmentULong(0);
+  fragmentCount_--;
+  memmove(fragmentStart_, fragmentStart_ + 1, fragmentCount_);
+  memmove(fragmentLength_, fragmentLength_ + 1, fragmentCount_);
+
+  // Nobody replies to a broadcast, or all the units would talk at once.
+  addressed_ = address == unitAddress_;
+  return addressed_ || address == UNIT_ADDRESS_BROADCAST;
+}
+
+// The first fragment is always the command itself. Based on the command, we can expect the number of parameters that is associated with it.
+bool SerialCommunication::checkParamsCount()
+{
+  uint8_t paramsCount;
+
+  switch (commandBuffer_[fragmentStart_[0]])
+  {
+    case SERIAL_CMD_DAQ_START:
+      paramsCount = MAXPARAM_DAQ_START;
+      break;
+    case SERIAL_CMD_DAQ_STOP:
+      paramsCount = MAXPARAM_DAQ_STOP;
+      break;
+    case SERIAL_CMD_DAQ_START_BINARY:
+      paramsCount = MAXPARAM_DAQ_START_BINARY;
+      break;
+    case SERIAL_CMD_BAUD:
+      paramsCount = MAXPARAM_BAUD;
+      break;
+    case SERIAL_CMD_SEND_PERIOD:
+      paramsCount = MAXPARAM_SEND_PERIOD;
+      break;
+    case SERIAL_CMD_HUMIDITY:
+      paramsCount = MAXPARAM_HUMIDITY;
+      break;
+    case SERIAL_CMD_FANSPEED:
+      paramsCount = MAXPARAM_FANSPEED;
+      break;
+    case SERIAL_CMD_PID:
+      paramsCount = MAXPARAM_PID;
+      break;
+    case SERIAL_CMD_TASK_STATS:
+      paramsCount = MAXPARAM_TASK_STATS;
+      break;
+    case SERIAL_CMD_INSTRUMENTATION:
+      paramsCount = MAXPARAM_INSTRUMENTATION;
+      break;
+    case SERIAL_CMD_CHANNEL:
+      paramsCount = MAXPARAM_CHANNEL;
+      break;
+    case SERIAL_CMD_STEP_RESPONSE:
+      paramsCount = MAXPARAM_STEP_RESPONSE;
+      break;
+    case SERIAL_CMD_AUTOTUNE:
+      paramsCount = MAXPARAM_AUTOTUNE;
+      break;
+    case SERIAL_CMD_HUMIDITY_MODE:
+      paramsCount = MAXPARAM_HUMIDITY_MODE;
+      break;
+    case SERIAL_CMD_DEVICE_STATS:
+      paramsCount = MAXPARAM_DEVICE_STATS;
+      break;
+    case SERIAL_CMD_LOG_DUMP:
+      paramsCount = MAXPARAM_LOG_DUMP;
+      break;
+    case SERIAL_CMD_LOG_DECIMATION:
+      paramsCount = MAXPARAM_LOG_DECIMATION;
+      break;
+    case SERIAL_CMD_LOG_CLEAR:
+      paramsCount = MAXPARAM_LOG_CLEAR;
+      break;
+    case SERIAL_CMD_PROGRAM:
+      paramsCount = MAXPARAM_PROGRAM;
+      break;
+    case SERIAL_CMD_PROGRAM_RUN:
+      paramsCount = MAXPARAM_PROGRAM_RUN;
+      break;
+    case SERIAL_CMD_UNIT_ADDRESS:
+      paramsCount = MAXPARAM_UNIT_ADDRESS;
+      break;
+    case SERIAL_CMD_READ_DATA:
+      paramsCount = MAXPARAM_READ_DATA;
+      break;
+    default:
+      // Unknown command
+      return false;
+  }
+
+  // Minus one to account for the command itself being one of the fragments
+  return fragmentCount_ - 1 == paramsCount;
+}
+
+uint8_t SerialCommunication::getFragmentCount()
+{
+  return fragmentCount_;
+}
+
+// Points directly into the command buffer; the fragment is null-terminated and length excludes the terminator.
+const char * SerialCommunication::getFragment(uint8_t fragmentIndex, uint8_t * length)
+{
+  if (fragmentIndex >= fragmentCount_)
+  {
+    *length = 0;
+    return "";
+  }
+
+  *length = fragmentLength_[fragmentIndex];
+  return commandBuffer_ + fragmentStart_[fragmentIndex];
 }
 
 int SerialCommunication::getFragmentInt(uint8_t fragmentIndex)
 {
-  return atoi(fragmentBuffer[fragmentIndex]);
+  uint8_t length;
+  return atoi(getFragment(fragmentIndex, &length));
 }
 
 char SerialCommunication::getFragmentChar(uint8_t fragmentIndex)
 {
-  char* fragmentEntry = fragmentBuffer[fragmentIndex];
+  uint8_t length;
 
   // Return only the first character
-  return fragmentEntry[0];
+  return getFragment(fragmentIndex, &length)[0];
 }
 
 double SerialCommunication::getFragmentDouble(uint8_t fragmentIndex)
 {
-  return atof(fragmentBuffer[fragmentIndex]);
+  uint8_t length;
+  return atof(getFragment(fragmentIndex, &length));
 }
 
 unsigned long SerialCommunication::getFragmentULong(uint8_t fragmentIndex)
 {
+  uint8_t length;
+
   // This relies on the fragment not being larger than max of long and not being negative.
-  return (unsigned long) atol(fragmentBuffer[fragmentIndex]);
+  return (unsigned long) atol(getFragment(fragmentIndex, &length));
 }
 
-void SerialCommunication::sendData(bool humidityOK, double humidity, double temperature, bool fanSpeedOK, double fanSpeed, bool humidityControlActive, double humidityTarget, bool fanSpeedControlActive, double fanSpeedTarget)
+void SerialCommunication::sendData(uint8_t channel, bool humidityOK, double humidity, double temperature, bool fanSpeedOK, double fanSpeed, bool humidityControlActive, double humidityTarget, bool fanSpeedControlActive, double fanSpeedTarget)
 {
+  if (!beginTransmit())
+  {
+    return;
+  }
+
   Serial.print(SERIAL_SEND_START);
   Serial.print(SERIAL_SEND_DATA);
   Serial.print(SERIAL_SEND_SEPARATOR);
+  if (channel != SERIAL_SEND_CHANNEL_NONE)
+  {
+    Serial.print(channel);  // Chamber number
+    Serial.print(SERIAL_SEND_SEPARATOR);
+  }
   if (humidityOK)
   {
     Serial.print(humidity, DECIMALS_HUMIDITY);  // Relative humidity (%)
@@ -211,9 +538,248 @@ void SerialCommunication::sendData(bool humidityOK, double humidity, double temp
   Serial.print(SERIAL_SEND_EOL);
 }
 
+// Same data as sendData(), but as a fixed-layout binary frame (see SerialCommunication.h) that is sent with a single write.
+// The raw sensor values are sent as they are, so no float formatting is needed here.
+void SerialCommunication::sendDataBinary(uint8_t channel, bool humidityOK, uint16_t RHSignal, uint16_t temperatureSignal, int16_t humidityCenti, bool fanSpeedOK, uint16_t tachoCount, bool humidityControlActive, int16_t humidityTargetCenti, bool fanSpeedControlActive, uint16_t fanSpeedTarget, uint8_t programStep)
+{
+  if (!beginTransmit())
+  {
+    return;
+  }
+
+  unsigned long timestamp = millis();
+  uint8_t status = channel << SERIAL_SEND_BINARY_STATUS_CHANNEL_SHIFT;
+
+  if (humidityOK)             status |= SERIAL_SEND_BINARY_STATUS_HUMIDITYOK;
+  if (fanSpeedOK)             status |= SERIAL_SEND_BINARY_STATUS_FANSPEEDOK;
+  if (humidityControlActive)  status |= SERIAL_SEND_BINARY_STATUS_HUMIDITYCONTROLACTIVE;
+  if (fanSpeedControlActive)  status |= SERIAL_SEND_BINARY_STATUS_FANSPEEDCONTROLACTIVE;
+
+  binaryFrame_[0] = SERIAL_SEND_BINARY_SYNC;
+  putBinaryUInt16(1, binarySequence_++);
+  putBinaryUInt16(3, (uint16_t) timestamp);
+  putBinaryUInt16(5, (uint16_t) (timestamp >> 16));
+  putBinaryUInt16(7, RHSignal);
+  putBinaryUInt16(9, temperatureSignal);
+  putBinaryUInt16(11, tachoCount);
+  putBinaryUInt16(13, (uint16_t) humidityCenti);
+  putBinaryUInt16(15, (uint16_t) humidityTargetCenti);
+  putBinaryUInt16(17, fanSpeedTarget);
+  binaryFrame_[19] = status;
+  binaryFrame_[20] = programStep;
+  binaryFrame_[21] = SHT3x::calcCRC(binaryFrame_, SERIAL_SEND_BINARY_LENGTH - 1);
+
+  Serial.write(binaryFrame_, SERIAL_SEND_BINARY_LENGTH);
+}
+
+void SerialCommunication::putBinaryUInt16(uint8_t offset, uint16_t value)
+{
+  binaryFrame_[offset]     = value & 0xFF;
+  binaryFrame_[offset + 1] = value >> 8;
+}
+
+// The log is sent a few records at a time, only as fast as the transmit buffer empties, so that the loop isn't held up.
+bool SerialCommunication::canSendBinary(uint8_t length)
+{
+  return Serial.availableForWrite() >= length;
+}
+
+void SerialCommunication::sendLogHeader(uint8_t recordCount, uint8_t recordLength)
+{
+  if (!beginTransmit())
+  {
+    return;
+  }
+
+  uint8_t header[4] = { SERIAL_SEND_LOG_SYNC, recordCount, recordLength, 0 };
+  header[3] = SHT3x::calcCRC(header, sizeof(header) - 1);
+  Serial.write(header, sizeof(header));
+  logCRC_ = 0xFF;
+}
+
+void SerialCommunication::sendLogRecord(const uint8_t *record, uint8_t recordLength)
+{
+  if (!beginTransmit())
+  {
+    return;
+  }
+
+  Serial.write(record, recordLength);
+  logCRC_ = SHT3x::calcCRC(record, recordLength, logCRC_);
+}
+
+void SerialCommunication::sendLogEnd()
+{
+  if (!beginTransmit())
+  {
+    return;
+  }
+
+  Serial.write(logCRC_);
+}
+
+// Run time statistics of one scheduler task
+void SerialCommunication::sendTaskStats(uint8_t taskID, const Scheduler_TaskStats & stats)
+{
+  if (!beginTransmit())
+  {
+    return;
+  }
+
+  Serial.print(SERIAL_SEND_START);
+  Serial.print(SERIAL_SEND_TASK_STATS);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(taskID);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(stats.runCount);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(stats.runTimeTotal);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(stats.runTimeMax);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(stats.overrunCount);
+  Serial.print(SERIAL_SEND_END);
+  Serial.print(SERIAL_SEND_EOL);
+}
+
+// Failure statistics of one device (see RetryPolicy.h):
+// ^v|[chamber]|[device]|[attempts]|[failures]|[failures in a row]|[bus resets]@
+void SerialCommunication::sendDeviceStats(uint8_t channel, uint8_t device, const RetryPolicy_Stats & stats)
+{
+  if (!beginTransmit())
+  {
+    return;
+  }
+
+  Serial.print(SERIAL_SEND_START);
+  Serial.print(SERIAL_SEND_DEVICE_STATS);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(channel);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(device);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(stats.attemptCount);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(stats.failureCount);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(stats.consecutiveFailures);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(stats.busResetCount);
+  Serial.print(SERIAL_SEND_END);
+  Serial.print(SERIAL_SEND_EOL);
+}
+
+// Outcome of the autotune of one chamber, sent when it finishes:
+// ^a|[chamber]|[success]|[Kp]|[Ki]|[Kd]@
+void SerialCommunication::sendAutotuneResult(uint8_t channel, bool success, double kp, double ki, double kd)
+{
+  if (!beginTransmit())
+  {
+    return;
+  }
+
+  Serial.print(SERIAL_SEND_START);
+  Serial.print(SERIAL_SEND_AUTOTUNE);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(channel);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(success);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(kp, DECIMALS_PID);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(ki, DECIMALS_PID);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(kd, DECIMALS_PID);
+  Serial.print(SERIAL_SEND_END);
+  Serial.print(SERIAL_SEND_EOL);
+}
+
+// Step response of the humidity control of one chamber (see StepResponse.h):
+// ^g|[chamber]|[active]|[settled]|[elapsed (ms)]|[settling time (ms)]|[overshoot (%RH)]@
+void SerialCommunication::sendStepResponse(uint8_t channel, bool active, bool settled, unsigned long elapsedTime, unsigned long settlingTime, double overshoot)
+{
+  if (!beginTransmit())
+  {
+    return;
+  }
+
+  Serial.print(SERIAL_SEND_START);
+  Serial.print(SERIAL_SEND_STEP_RESPONSE);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(channel);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(active);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(settled);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(elapsedTime);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(settlingTime);
+  Serial.print(SERIAL_SEND_SEPARATOR);
+  Serial.print(overshoot, DECIMALS_OVERSHOOT);
+  Serial.print(SERIAL_SEND_END);
+  Serial.print(SERIAL_SEND_EOL);
+}
+
+#ifdef INSTRUMENTATION
+// Send all the instrumentation data, then reset them. One string per section, then one per counter:
+// ^i|s|[sectionID]|[count]|[min (us)]|[max (us)]|[mean (us)]@
+// ^i|c|[counterID]|[value]@
+void SerialCommunication::sendInstrumentation()
+{
+  if (!beginTransmit())
+  {
+    return;
+  }
+
+  for (uint8_t section = 0; section < INSTR_SECTION_COUNT; section++)
+  {
+    const Instrumentation_SectionStats & stats = Instrumentation::getSectionStats((INSTR_SECTION) section);
+
+    Serial.print(SERIAL_SEND_START);
+    Serial.print(SERIAL_SEND_INSTRUMENTATION);
+    Serial.print(SERIAL_SEND_SEPARATOR);
+    Serial.print(SERIAL_SEND_INSTRUMENTATION_SECTION);
+    Serial.print(SERIAL_SEND_SEPARATOR);
+    Serial.print(section);
+    Serial.print(SERIAL_SEND_SEPARATOR);
+    Serial.print(stats.count);
+    Serial.print(SERIAL_SEND_SEPARATOR);
+    Serial.print(stats.min);
+    Serial.print(SERIAL_SEND_SEPARATOR);
+    Serial.print(stats.max);
+    Serial.print(SERIAL_SEND_SEPARATOR);
+    Serial.print(stats.count > 0 ? stats.total / stats.count : 0);
+    Serial.print(SERIAL_SEND_END);
+    Serial.print(SERIAL_SEND_EOL);
+  }
+
+  for (uint8_t counter = 0; counter < INSTR_COUNTER_COUNT; counter++)
+  {
+    Serial.print(SERIAL_SEND_START);
+    Serial.print(SERIAL_SEND_INSTRUMENTATION);
+    Serial.print(SERIAL_SEND_SEPARATOR);
+    Serial.print(SERIAL_SEND_INSTRUMENTATION_COUNTER);
+    Serial.print(SERIAL_SEND_SEPARATOR);
+    Serial.print(counter);
+    Serial.print(SERIAL_SEND_SEPARATOR);
+    Serial.print(Instrumentation::getCounter((INSTR_COUNTER) counter));
+    Serial.print(SERIAL_SEND_END);
+    Serial.print(SERIAL_SEND_EOL);
+  }
+
+  Instrumentation::reset();
+}
+#endif // INSTRUMENTATION
+
 // Inform C# program on the status of a command for a specific chamber
 void SerialCommunication::sendCommandResponse(char commandType, bool success)
 {
+  if (!beginTransmit())
+  {
+    return;
+  }
+
   Serial.print(SERIAL_SEND_START);
   Serial.print(SERIAL_SEND_CMDRESPONSE);
   Serial.print(SERIAL_SEND_SEPARATOR);
@@ -23,6 +23,12 @@ limitations under the License.
 	#include "WProgram.h"
 #endif
 
+#include "SHT3x.h"
+#include "ConfigStore.h"
+#include "Scheduler.h"
+#include "RetryPolicy.h"
+#include "Instrumentation.h"
+
 class SerialCommunication
 {
   public:
@@ -30,7 +36,27 @@ class SerialCommunication
     static const char SERIAL_CMD_START            = '^';
     static const char SERIAL_CMD_DAQ_START        = 'd';
     static const char SERIAL_CMD_DAQ_STOP         = 's';
-    const char SERIAL_CMD_SEPARATOR               = '|';
+    static const char SERIAL_CMD_DAQ_START_BINARY = 'b';
+    static const char SERIAL_CMD_BAUD             = 'u';
+    static const char SERIAL_CMD_SEND_PERIOD      = 'p';
+    static const char SERIAL_CMD_HUMIDITY         = 'h';
+    static const char SERIAL_CMD_FANSPEED         = 'f';
+    static const char SERIAL_CMD_PID              = 'k';
+    static const char SERIAL_CMD_TASK_STATS       = 't';
+    static const char SERIAL_CMD_INSTRUMENTATION  = 'i';
+    static const char SERIAL_CMD_CHANNEL          = 'c';
+    static const char SERIAL_CMD_STEP_RESPONSE    = 'g';
+    static const char SERIAL_CMD_AUTOTUNE         = 'a';
+    static const char SERIAL_CMD_HUMIDITY_MODE    = 'm';
+    static const char SERIAL_CMD_DEVICE_STATS     = 'v';
+    static const char SERIAL_CMD_LOG_DUMP         = 'l';
+    static const char SERIAL_CMD_LOG_DECIMATION   = 'w';
+    static const char SERIAL_CMD_LOG_CLEAR        = 'e';
+    static const char SERIAL_CMD_PROGRAM          = 'o';  // Followed by a binary payload, see processIncoming()
+    static const char SERIAL_CMD_PROGRAM_RUN      = 'q';
+    static const char SERIAL_CMD_UNIT_ADDRESS     = 'n';
+    static const char SERIAL_CMD_READ_DATA        = 'r';
+    static const char SERIAL_CMD_SEPARATOR        = '|';
     static const char SERIAL_CMD_END              = '@';
     static const char SERIAL_CMD_EOL              = '\n';
 
@@ -38,6 +64,15 @@ class SerialCommunication
     static const char SERIAL_SEND_DATA                      = 'd';
     static const char SERIAL_SEND_DATA_ERROR                = 'e';
     static const char SERIAL_SEND_DATA_CONTROLINACTIVE      = 'i';
+    static const char SERIAL_SEND_TASK_STATS                = 't';
+    static const char SERIAL_SEND_STEP_RESPONSE             = 'g';
+    static const char SERIAL_SEND_AUTOTUNE                  = 'a';
+    static const char SERIAL_SEND_DEVICE_STATS              = 'v';
+      static const uint8_t SERIAL_SEND_DEVICE_RH_SENSOR     = 0;
+      static const uint8_t SERIAL_SEND_DEVICE_FAN           = 1;
+    static const char SERIAL_SEND_INSTRUMENTATION           = 'i';
+      static const char SERIAL_SEND_INSTRUMENTATION_SECTION = 's';
+      static const char SERIAL_SEND_INSTRUMENTATION_COUNTER = 'c';
     static const char SERIAL_SEND_CMDRESPONSE               = 'r';  // Used to indicate execution status of a received command
       static const char SERIAL_SEND_CMDRESPONSE_SUCC        = 'y';  // Success
       static const char SERIAL_SEND_CMDRESPONSE_FAIL        = 'n';  // Failed
@@ -45,51 +80,192 @@ class SerialCommunication
     static const char SERIAL_SEND_END                     = '@';
     static const char SERIAL_SEND_EOL                     = '\n';
 
+    // Binary data frame, sent instead of the ASCII data string after SERIAL_CMD_DAQ_START_BINARY.
+    // All multi-byte fields are little-endian. Byte offsets:
+    //  0      SERIAL_SEND_BINARY_SYNC
+    //  1-2    Sequence number (wraps around; a gap means a dropped frame)
+    //  3-6    millis() when the frame was sent
+    //  7-8    Raw RH signal from the SHT3x, before calibration. RH (%) = 100 * signal / 65535
+    //  9-10   Raw temperature signal from the SHT3x. T (degC) = -45 + 175 * signal / 65535
+    //  11-12  Tacho count from the EMC2301
+    //  13-14  Calibrated RH, in 0.01 %RH (signed)
+    //  15-16  RH target, in 0.01 %RH (signed)
+    //  17-18  Fan speed target (RPM)
+    //  19     Status bits, see SERIAL_SEND_BINARY_STATUS_*; bits 4-7 are the chamber number
+    //  20     Step of the setpoint program (from 0), with SERIAL_SEND_BINARY_PROGRAM_HOLDING once its ramp is done;
+    //         SERIAL_SEND_BINARY_PROGRAM_NONE if the chamber isn't running a program
+    //  21     CRC8 of bytes 0-20, same CRC as the SHT3x (polynomial 0x31, init 0xFF)
+    static const uint8_t SERIAL_SEND_BINARY_SYNC        = 0xA5;
+    static const uint8_t SERIAL_SEND_BINARY_LENGTH      = 22;
+    static const uint8_t SERIAL_SEND_BINARY_STATUS_HUMIDITYOK             = 0x01;
+    static const uint8_t SERIAL_SEND_BINARY_STATUS_FANSPEEDOK             = 0x02;
+    static const uint8_t SERIAL_SEND_BINARY_STATUS_HUMIDITYCONTROLACTIVE  = 0x04;
+    static const uint8_t SERIAL_SEND_BINARY_STATUS_FANSPEEDCONTROLACTIVE  = 0x08;
+    static const uint8_t SERIAL_SEND_BINARY_STATUS_CHANNEL_SHIFT          = 4;
+    static const uint8_t SERIAL_SEND_BINARY_PROGRAM_HOLDING               = 0x80;
+    static const uint8_t SERIAL_SEND_BINARY_PROGRAM_NONE                  = 0xFF;
+
+    // Telemetry log dump, sent after SERIAL_CMD_LOG_DUMP as one binary burst:
+    //  0      SERIAL_SEND_LOG_SYNC
+    //  1      Number of records
+    //  2      Length of each record
+    //  3      CRC8 of bytes 0-2
+    // followed by the records, oldest first (see TelemetryLog.h), and the CRC8 of all the records.
+    static const uint8_t SERIAL_SEND_LOG_SYNC           = 0x5A;
+
+    // Pass as the channel to sendData() to leave out the chamber field (controllers with only one chamber).
+    static const uint8_t SERIAL_SEND_CHANNEL_NONE = 0xFF;
+
+    // Multi-drop bus (e.g. RS-485, half-duplex), where one computer port talks to many controllers. Once a controller
+    // has a unit address, each command starts with the address of the unit it is for: ^[address]|[command]|[params]@.
+    // Commands for other units are ignored, and UNIT_ADDRESS_BROADCAST is for all of them. A unit only sends after a
+    // command addressed to it (not a broadcast), and stops once the computer starts the next command; so only one
+    // unit talks at a time, and the computer has to wait for the reply before polling the next one.
+    static const uint8_t UNIT_ADDRESS_NONE        = 0;    // Point-to-point: commands have no address, and data is sent any time
+    static const uint8_t UNIT_ADDRESS_BROADCAST   = 0;
+    static const uint8_t UNIT_ADDRESS_MAX         = 247;
+    static const uint8_t PIN_NONE                 = 0xFF;
+
+
+    // Baud rates that can be negotiated with SERIAL_CMD_BAUD
+    static const uint8_t BAUD_RATES_COUNT = 6;
+    static const unsigned long BAUD_RATES[BAUD_RATES_COUNT];
+    static const uint16_t BAUD_CONFIRM_TIMEOUT = 2000; // Time (ms) for the computer to confirm a new baud rate before falling back to the previous one.
 
     SerialCommunication();
-    void init(unsigned long baudRate);
+    void init(unsigned long defaultBaudRate);
+
+    // Changing the baud rate. The new rate is only saved once the computer confirms it over the new rate.
+    bool isBaudRateSupported(unsigned long baudRate);
+    void beginBaudRateChange(unsigned long baudRate);
+    bool confirmBaudRateChange(unsigned long baudRate);
+    bool isBaudRateChangePending();
+    void checkBaudRateChange();
+    unsigned long getBaudRate();
+    bool canSendEvery(uint16_t periodMs);
 
     // Enable/disable sending to computer
     void enableSending();
     void disableSending();
 
-    // Process incoming strings into fragments
+    // Multi-drop bus. The driver enable pin (DE, and /RE if tied to it) of the RS-485 transceiver is high while sending;
+    // PIN_NONE (the default) if there is none.
+    void setDriverEnablePin(uint8_t pin);
+    bool setUnitAddress(unsigned long address);   // Saved; UNIT_ADDRESS_NONE goes back to point-to-point
+    uint8_t getUnitAddress();
+    void checkTransmitDone();
+
+    // Process incoming characters into fragments. Returns true once a complete and valid command is available.
     bool processIncoming();
 
-    // Functions for obtaining the extracted fragments from an incoming string
+    // Functions for obtaining the extracted fragments from an incoming string. Index 0 is the command itself.
+    // The fragments are only valid until the next call to processIncoming().
+    uint8_t       getFragmentCount();
+    const char *  getFragment(uint8_t fragmentIndex, uint8_t * length);
     int           getFragmentInt(uint8_t fragmentIndex);
     char          getFragmentChar(uint8_t fragmentIndex);
     double        getFragmentDouble(uint8_t fragmentIndex);
     unsigned long getFragmentULong(uint8_t fragmentIndex);
+    const uint8_t * getPayload(uint8_t * length);
 
     // Functions for sending strings to computer
-    void sendData(bool humidityOK, double humidity, double temperature, bool fanSpeedOK, double fanSpeed, bool humidityControlActive, double humidityTarget, bool fanSpeedControlActive, double fanSpeedTarget);
+    void sendData(uint8_t channel, bool humidityOK, double humidity, double temperature, bool fanSpeedOK, double fanSpeed, bool humidityControlActive, double humidityTarget, bool fanSpeedControlActive, double fanSpeedTarget);
+    void sendDataBinary(uint8_t channel, bool humidityOK, uint16_t RHSignal, uint16_t temperatureSignal, int16_t humidityCenti, bool fanSpeedOK, uint16_t tachoCount, bool humidityControlActive, int16_t humidityTargetCenti, bool fanSpeedControlActive, uint16_t fanSpeedTarget, uint8_t programStep);
+    void sendTaskStats(uint8_t taskID, const Scheduler_TaskStats & stats);
+    void sendDeviceStats(uint8_t channel, uint8_t device, const RetryPolicy_Stats & stats);
+    void sendAutotuneResult(uint8_t channel, bool success, double kp, double ki, double kd);
+    void sendStepResponse(uint8_t channel, bool active, bool settled, unsigned long elapsedTime, unsigned long settlingTime, double overshoot);
+    bool canSendBinary(uint8_t length);
+    void sendLogHeader(uint8_t recordCount, uint8_t recordLength);
+    void sendLogRecord(const uint8_t *record, uint8_t recordLength);
+    void sendLogEnd();
+#ifdef INSTRUMENTATION
+    void sendInstrumentation();
+#endif // INSTRUMENTATION
     void sendCommandResponse(char commandType, bool success);
 
 
   private:
     // Number of parameters in every command sent by computer
-    const uint8_t MAXPARAM_DAQ_START    = 0;
-    const uint8_t MAXPARAM_DAQ_STOP     = 0;
+    static const uint8_t MAXPARAM_DAQ_START    = 0;
+    static const uint8_t MAXPARAM_DAQ_STOP     = 0;
+    static const uint8_t MAXPARAM_DAQ_START_BINARY = 0;
+    static const uint8_t MAXPARAM_BAUD         = 1;
+    static const uint8_t MAXPARAM_SEND_PERIOD  = 1;
+    static const uint8_t MAXPARAM_HUMIDITY     = 2;
+    static const uint8_t MAXPARAM_FANSPEED     = 2;
+    static const uint8_t MAXPARAM_PID          = 3;
+    static const uint8_t MAXPARAM_TASK_STATS   = 0;
+    static const uint8_t MAXPARAM_INSTRUMENTATION = 0;
+    static const uint8_t MAXPARAM_CHANNEL      = 1;
+    static const uint8_t MAXPARAM_STEP_RESPONSE = 0;
+    static const uint8_t MAXPARAM_AUTOTUNE     = 1;
+    static const uint8_t MAXPARAM_HUMIDITY_MODE = 1;
+    static const uint8_t MAXPARAM_DEVICE_STATS = 0;
+    static const uint8_t MAXPARAM_LOG_DUMP     = 0;
+    static const uint8_t MAXPARAM_LOG_DECIMATION = 1;
+    static const uint8_t MAXPARAM_LOG_CLEAR    = 0;
+    static const uint8_t MAXPARAM_PROGRAM      = 1;
+    static const uint8_t MAXPARAM_PROGRAM_RUN  = 1;
+    static const uint8_t MAXPARAM_UNIT_ADDRESS = 1;
+    static const uint8_t MAXPARAM_READ_DATA    = 0;
+
+    // Longest ASCII data string, used to check if a send period fits in the current baud rate.
+    static const uint8_t SERIAL_SEND_DATA_LENGTH_MAX = 40;
 
     // Decimal places for data sent to computer
-    const uint8_t DECIMALS_HUMIDITY     = 1; // Number of decimal places allowed for humidity.
-    const uint8_t DECIMALS_TEMPERATURE  = 1; // Number of decimal places allowed for temperature.
-    const uint8_t DECIMALS_FANSPEED     = 0; // Number of decimal places allowed for fan speed.
+    static const uint8_t DECIMALS_HUMIDITY     = 1; // Number of decimal places allowed for humidity.
+    static const uint8_t DECIMALS_TEMPERATURE  = 1; // Number of decimal places allowed for temperature.
+    static const uint8_t DECIMALS_FANSPEED     = 0; // Number of decimal places allowed for fan speed.
+    static const uint8_t DECIMALS_OVERSHOOT    = 2; // Number of decimal places for the overshoot of the step response.
+    static const uint8_t DECIMALS_PID          = 7; // Number of decimal places for the PID gains. Ki is per ms, so it is small.
 
     bool serialActive_;
-    // Serial communication and buffers
-    // Must manually define and add fragmentBufferElement to the char pointer array fragmentBuffer, because the arrays points
-    // to char arrays which must be defined.
-    static const uint8_t serialBufferLength   = 128;  // Should be always sufficient for command strings sent by the C# program
-    static const uint8_t fragmentMaxCount     = 1;    // Max possible of fragments in a command sent by computer.
-    static const uint8_t fragmentBufferLength = 20;   // Should be always sufficient for fragments in command strings sent by the C# program
-    char serialBuffer[serialBufferLength];
-    char fragmentBufferElement0[fragmentBufferLength];
-    // This array of char array pointers will be temp storage for fragments extracted from incoming command lines
-    // Only parts of the buffer are used for each command; see the constants defined above for MAXPARAM
-    char* fragmentBuffer[fragmentMaxCount] = {fragmentBufferElement0};
-    char trimmedSerialBuffer[serialBufferLength]; // For holding the unextracted fragments portion of the command string
+    unsigned long baudRate_;
+    unsigned long previousBaudRate_;    // Rate to fall back to if a baud rate change isn't confirmed
+    bool baudRateChangePending_ = false;
+    unsigned long baudRateChangeTime_;
+    void switchBaudRate(unsigned long baudRate);
+    uint16_t binarySequence_ = 0;
+    uint8_t binaryFrame_[SERIAL_SEND_BINARY_LENGTH];
+    void putBinaryUInt16(uint8_t offset, uint16_t value);
+    uint8_t logCRC_;              // CRC of the log records sent so far
+    // Incoming commands are parsed one character at a time as they come out of the Serial receive buffer (filled by the
+    // UART interrupt), so nothing has to wait for a full line. Separators are replaced by '\0' in commandBuffer_,
+    // which makes every fragment a string that can be read in place.
+    // The longest command is SERIAL_CMD_PROGRAM with a full program, to a unit with a 3-digit address: "247|o|73" with its
+    // terminators, then the payload and its CRC. Any other command sent by the C# program is shorter.
+    static const uint8_t PROGRAM_COMMAND_LENGTH_MAX = sizeof("247|o|73");
+    static const uint8_t PROGRAM_PAYLOAD_LENGTH_MAX = 1 + SETPOINTPROGRAM_STEP_MAX * sizeof(SetpointProgram_Step);
+    static const uint8_t COMMAND_LENGTH_MAX   = PROGRAM_COMMAND_LENGTH_MAX + PROGRAM_PAYLOAD_LENGTH_MAX + 1;
+    static const uint8_t FRAGMENT_COUNT_MAX   = 5;    // Max possible of fragments (unit address + command + params) in a command sent by computer.
+    char commandBuffer_[COMMAND_LENGTH_MAX];
+    uint8_t commandLength_ = 0;
+    bool commandParsing_ = false;                     // SERIAL_CMD_START was seen and SERIAL_CMD_END not yet
+    uint8_t fragmentStart_[FRAGMENT_COUNT_MAX];       // Index of each fragment in commandBuffer_
+    uint8_t fragmentLength_[FRAGMENT_COUNT_MAX];
+    uint8_t fragmentCount_ = 0;
+    bool endFragment();
+    bool takeUnitAddress();
+    bool checkParamsCount();
+
+    // Multi-drop bus
+    uint8_t unitAddress_ = UNIT_ADDRESS_NONE;
+    bool addressed_ = false;                          // The last command was for this unit alone, so it may send
+    uint8_t driverEnablePin_ = PIN_NONE;
+    bool transmitting_ = false;                       // The driver is enabled
+    bool beginTransmit();
+
+    // Binary payload after the command, stored in commandBuffer_ after the fragments
+    static const uint16_t PAYLOAD_TIMEOUT     = 1000; // Time (ms) for the whole payload to arrive; after that, it is dropped
+    uint8_t payloadStart_;
+    uint8_t payloadLength_;
+    bool payloadFits_;                                // The payload is short enough for commandBuffer_; it is dropped otherwise
+    bool payloadForUnit_;                             // The command was for this unit; the payload of another is read but dropped
+    unsigned long payloadRemaining_ = 0;              // Bytes (with the CRC) still to come; 0 when not receiving a payload
+    unsigned long payloadStartTime_;
+    bool payloadValid_ = false;
+    bool receivePayload(uint8_t incoming);
 };
 
 #endif
\ No newline at end of file
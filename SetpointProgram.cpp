@@ -0,0 +1,137 @@
+/*********************************************************************************
+Setpoint program: a sequence of RH (and fan speed) targets.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "SetpointProgram.h"
+
+static const unsigned long MS_PER_MINUTE = 60000;
+
+SetpointProgram::SetpointProgram() : table_(NULL), stepIndex_(STEP_NONE), holding_(false), rampStartTarget_(0), humidityTarget_(0), stepStartTime_(0), holdStartTime_(0) {}
+
+// Start the program at its first step, ramping from humidityTarget (%RH). Returns false if the table has no steps.
+bool SetpointProgram::start(const SetpointProgram_Table *table, unsigned long now, float humidityTarget)
+{
+  if (table->stepCount == 0 || table->stepCount > SETPOINTPROGRAM_STEP_MAX)
+  {
+    return false;
+  }
+
+  table_ = table;
+  stepIndex_ = 0;
+  humidityTarget_ = humidityTarget;
+  beginStep(now);
+  return true;
+}
+
+void SetpointProgram::stop()
+{
+  table_ = NULL;
+  stepIndex_ = STEP_NONE;
+}
+
+// Move the target along the ramp, and on to the next step once the hold is over. humidity is the latest RH reading (%).
+SETPOINTPROGRAM_STATUS SetpointProgram::update(unsigned long now, float humidity)
+{
+  if (table_ == NULL)
+  {
+    return SETPOINTPROGRAM_STATUS_IDLE;
+  }
+
+  const SetpointProgram_Step *step = getStep();
+  float target = step->humidityTarget / 100.0;
+
+  if (!holding_)
+  {
+    if (step->rampRate == 0)
+    {
+      humidityTarget_ = target;
+    }
+    else
+    {
+      float ramped = (step->rampRate / 100.0) * (now - stepStartTime_) / MS_PER_MINUTE;
+      humidityTarget_ = rampStartTarget_ < target ? min(rampStartTarget_ + ramped, target) : max(rampStartTarget_ - ramped, target);
+    }
+
+    if (humidityTarget_ != target)
+    {
+      return SETPOINTPROGRAM_STATUS_RUNNING;
+    }
+
+    holding_ = true;
+    holdStartTime_ = now;
+  }
+
+  if (step->stableBand != 0 && fabs(humidity - target) > step->stableBand / 10.0)
+  { // Not settled; the hold starts over.
+    holdStartTime_ = now;
+    return SETPOINTPROGRAM_STATUS_RUNNING;
+  }
+
+  if (now - holdStartTime_ < step->holdTime * MS_PER_MINUTE)
+  {
+    return SETPOINTPROGRAM_STATUS_RUNNING;
+  }
+
+  if (stepIndex_ + 1 >= table_->stepCount)
+  {
+    stop();
+    return SETPOINTPROGRAM_STATUS_DONE;
+  }
+
+  stepIndex_++;
+  beginStep(now);
+  return SETPOINTPROGRAM_STATUS_NEXTSTEP;
+}
+
+bool SetpointProgram::isRunning()
+{
+  return table_ != NULL;
+}
+
+uint8_t SetpointProgram::getStepIndex()
+{
+  return stepIndex_;
+}
+
+// Only valid while running.
+const SetpointProgram_Step *SetpointProgram::getStep()
+{
+  return &table_->steps[stepIndex_];
+}
+
+bool SetpointProgram::isHolding()
+{
+  return table_ != NULL && holding_;
+}
+
+float SetpointProgram::getHumidityTarget()
+{
+  return humidityTarget_;
+}
+
+// The ramp of a step starts from wherever the target is. Without a ramp, the target jumps right away.
+void SetpointProgram::beginStep(unsigned long now)
+{
+  holding_ = false;
+  rampStartTarget_ = humidityTarget_;
+  stepStartTime_ = now;
+
+  if (getStep()->rampRate == 0)
+  {
+    humidityTarget_ = getStep()->humidityTarget / 100.0;
+  }
+}
@@ -0,0 +1,94 @@
+/*********************************************************************************
+Setpoint program: a sequence of RH (and fan speed) targets that a chamber works
+through by itself, e.g. the steps of a sorption isotherm.
+
+Each step ramps the RH target from where the previous step left it to its own
+target at rampRate (or jumps straight to it), then holds it for holdTime. With a
+stableBand, the hold time only counts while the RH stays within the band of the
+target, and starts over whenever it leaves it; so a step can wait for the
+chamber to settle however long that takes. Once the last step is done, the
+chamber stays at its target.
+
+The table is kept in ConfigStore and uploaded from the computer in one binary
+transfer (see SERIAL_CMD_PROGRAM). HumidOSH calls update() with every filtered RH
+reading of the chamber running the program, and takes the target from it.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _SETPOINTPROGRAM_h
+#define _SETPOINTPROGRAM_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#define SETPOINTPROGRAM_STEP_MAX 8
+
+// One step of the program. 9 bytes, little-endian, in the order of the upload.
+struct SetpointProgram_Step
+{
+  int16_t humidityTarget;   // 0.01 %RH
+  uint16_t fanSpeedTarget;  // RPM; 0 leaves the fan as it is
+  uint16_t rampRate;        // 0.01 %RH per minute; 0 jumps straight to the target
+  uint16_t holdTime;        // min
+  uint8_t stableBand;       // 0.1 %RH; 0 for none
+};
+
+struct SetpointProgram_Table
+{
+  uint8_t stepCount;        // 0 if there is no program
+  SetpointProgram_Step steps[SETPOINTPROGRAM_STEP_MAX];
+};
+
+typedef enum
+{
+  SETPOINTPROGRAM_STATUS_IDLE     = 0,  // Not running
+  SETPOINTPROGRAM_STATUS_RUNNING  = 1,
+  SETPOINTPROGRAM_STATUS_NEXTSTEP = 2,  // Moved on to the next step; its fan speed target is to be applied
+  SETPOINTPROGRAM_STATUS_DONE     = 3   // The last step is over
+} SETPOINTPROGRAM_STATUS;
+
+class SetpointProgram
+{
+public:
+  static const uint8_t STEP_NONE = 0xFF;
+
+  SetpointProgram();
+  bool start(const SetpointProgram_Table *table, unsigned long now, float humidityTarget);
+  void stop();
+  SETPOINTPROGRAM_STATUS update(unsigned long now, float humidity);
+  bool isRunning();
+  uint8_t getStepIndex();   // STEP_NONE when not running
+  const SetpointProgram_Step *getStep();
+  bool isHolding();         // The ramp of the step is done
+  float getHumidityTarget();
+
+private:
+  const SetpointProgram_Table *table_;  // NULL when not running. Points at the table in ConfigStore, so it must not change while running.
+  uint8_t stepIndex_;
+  bool holding_;
+  float rampStartTarget_;   // %RH
+  float humidityTarget_;    // %RH
+  unsigned long stepStartTime_;
+  unsigned long holdStartTime_;
+
+  void beginStep(unsigned long now);
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*********************************************************************************
+Step response metrics of the humidity control.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "StepResponse.h"
+
+StepResponse::StepResponse() : active_(false), settled_(false), inBand_(false), rising_(false), target_(0), overshoot_(0), startTime_(0), bandEntryTime_(0) {}
+
+// Call with every new reading while the control is running. A change of target starts a new step.
+void StepResponse::update(unsigned long now, float value, float target)
+{
+  if (!active_ || target != target_)
+  {
+    active_     = true;
+    settled_    = false;
+    inBand_     = false;
+    rising_     = target > value;
+    target_     = target;
+    overshoot_  = 0;
+    startTime_  = now;
+  }
+
+  float error = value - target_;
+  float beyondTarget = rising_ ? error : -error;
+
+  if (beyondTarget > overshoot_)
+  {
+    overshoot_ = beyondTarget;
+  }
+
+  if (fabs(error) <= SETTLING_BAND)
+  {
+    if (!inBand_)
+    {
+      inBand_ = true;
+      bandEntryTime_ = now;
+    }
+    else if (now - bandEntryTime_ >= SETTLING_HOLD)
+    {
+      settled_ = true;
+    }
+  }
+  else
+  { // Left the band; the settling time will be counted from the next entry.
+    inBand_ = false;
+    settled_ = false;
+  }
+}
+
+// The control was turned off; the next update() starts a new step.
+void StepResponse::stop()
+{
+  active_ = false;
+}
+
+bool StepResponse::isActive()
+{
+  return active_;
+}
+
+bool StepResponse::isSettled()
+{
+  return settled_;
+}
+
+// Time (ms) from the start of the step to the last entry into the settling band. Only meaningful once settled.
+unsigned long StepResponse::getSettlingTime()
+{
+  return settled_ ? bandEntryTime_ - startTime_ : 0;
+}
+
+// Time (ms) since the start of the step.
+unsigned long StepResponse::getElapsedTime(unsigned long now)
+{
+  return active_ ? now - startTime_ : 0;
+}
+
+// Largest excursion (%RH) beyond the target so far.
+float StepResponse::getOvershoot()
+{
+  return overshoot_;
+}
@@ -0,0 +1,65 @@
+/*********************************************************************************
+Step response metrics of the humidity control.
+
+Every time the RH target changes (or the control is turned on), a new step starts
+from the current reading. Each reading after that updates the overshoot, i.e. the
+largest excursion beyond the target in the direction of the step, and the settling
+time, i.e. the time from the start of the step until the reading entered the
+settling band for good. A step counts as settled once the reading has stayed in
+the band for SETTLING_HOLD.
+
+This works the same on a real chamber and on the simulated one (see ChamberPlant.h),
+so that tunings can be compared on both.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _STEPRESPONSE_h
+#define _STEPRESPONSE_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+class StepResponse
+{
+public:
+  StepResponse();
+  void update(unsigned long now, float value, float target);
+  void stop();
+  bool isActive();
+  bool isSettled();
+  unsigned long getSettlingTime();
+  unsigned long getElapsedTime(unsigned long now);
+  float getOvershoot();
+
+private:
+  static constexpr float SETTLING_BAND           = 1.0;    // Max distance (%RH) from the target to be settled
+  static const unsigned long SETTLING_HOLD   = 60000;  // Time (ms) the reading must stay in the band to be settled
+
+  bool active_;
+  bool settled_;
+  bool inBand_;
+  bool rising_;             // The target is above the reading at the start of the step
+  float target_;
+  float overshoot_;
+  unsigned long startTime_;
+  unsigned long bandEntryTime_;
+};
+
+#endif
@@ -0,0 +1,305 @@
+/*********************************************************************************
+Telemetry ring log in EEPROM.
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "TelemetryLog.h"
+#include "ConfigStore.h"
+
+// Order in which the bytes of a record are written. The type is marked as erased first and written last,
+// so that a record cut short by a reset is skipped instead of being read as garbage.
+static const uint8_t WRITE_ORDER[] = { 1, 2, 3, 4, 5, 6, 7, 0, 1 };
+
+TelemetryLog::TelemetryLog() : decimation_(0), head_(0), count_(0), sequence_(0), reading_(false),
+  eraseIndex_(LOG_RECORD_COUNT), queueCount_(0), byteIndex_(BYTE_INDEX_DONE) {}
+
+// Load the decimation and find the newest record.
+void TelemetryLog::begin()
+{
+  decimation_ = Config.getLogDecimation();
+
+  if (decimation_ == ConfigStore::CONFIGSTORE_NONE)
+  {
+    decimation_ = LOG_DECIMATION_DEFAULT;
+  }
+
+  head_ = 0;
+  count_ = 0;
+
+  for (uint8_t slot = 0; slot < LOG_RECORD_COUNT; slot++)
+  {
+    if ((EEPROM.read(getSlotAddress(slot) + 1) >> TYPE_SHIFT) == LOG_TYPE_ERASED)
+    {
+      continue;
+    }
+
+    count_++;
+
+    // The newest record is the one that the next slot doesn't continue. The sequence number has more values
+    // than there are slots, so there is always such a record.
+    uint8_t next = (slot + 1) % LOG_RECORD_COUNT;
+    uint8_t sequence = EEPROM.read(getSlotAddress(slot));
+
+    if ((EEPROM.read(getSlotAddress(next) + 1) >> TYPE_SHIFT) == LOG_TYPE_ERASED
+        || EEPROM.read(getSlotAddress(next)) != (uint8_t) (sequence + 1))
+    {
+      head_ = next;
+      sequence_ = sequence + 1;
+    }
+  }
+}
+
+// Start a new session for this chamber: the next record is TARGETS.
+void TelemetryLog::resetEncoder(TelemetryLog_Encoder *encoder)
+{
+  memset(encoder, 0, sizeof(TelemetryLog_Encoder));
+}
+
+uint16_t TelemetryLog::getDecimation()
+{
+  return decimation_;
+}
+
+void TelemetryLog::setDecimation(uint16_t decimation)
+{
+  decimation_ = decimation;
+  Config.setLogDecimation(decimation_);
+}
+
+TELEMETRYLOG_STATUS TelemetryLog::addTargets(TelemetryLog_Encoder *encoder, uint8_t channel, int16_t humidityTarget, uint16_t fanSpeedTarget, uint8_t status)
+{
+  // The half-filled DELTA record belongs before the new targets.
+  TELEMETRYLOG_STATUS result = flush(encoder, channel);
+
+  if (result != TELEMETRYLOG_STATUS_OK)
+  {
+    return result;
+  }
+
+  uint8_t record[LOG_RECORD_LENGTH];
+  newRecord(record, LOG_TYPE_TARGETS, channel, status);
+  putInt16(&record[2], humidityTarget);
+  putInt16(&record[4], fanSpeedTarget);
+  putInt16(&record[6], decimation_);
+  result = queueRecord(record);
+
+  encoder->started = true;
+  encoder->humidityTarget = humidityTarget;
+  encoder->fanSpeedTarget = fanSpeedTarget;
+  encoder->recordsSinceKey = LOG_KEY_INTERVAL;  // The next sample is a KEY record
+  return result;
+}
+
+TELEMETRYLOG_STATUS TelemetryLog::addSample(TelemetryLog_Encoder *encoder, uint8_t channel, const TelemetryLog_Sample &sample)
+{
+  int16_t humidityChange = sample.humidity - encoder->last.humidity;
+  int16_t temperatureChange = sample.temperature - encoder->last.temperature;
+  int16_t fanSpeedChange = ((long) sample.fanSpeed - encoder->last.fanSpeed) / LOG_DELTA_FANSPEED_UNIT;
+
+  if (encoder->recordsSinceKey >= LOG_KEY_INTERVAL
+      || (sample.status & STATUS_MASK) != encoder->last.status
+      || humidityChange <= LOG_DELTA_NONE || humidityChange > 127
+      || temperatureChange < -128 || temperatureChange > 127
+      || fanSpeedChange < -128 || fanSpeedChange > 127)
+  {
+    return addKey(encoder, channel, sample);
+  }
+
+  // Keep track of the values as the host decodes them, so that the rounding of the fan speed doesn't add up.
+  encoder->last.humidity += humidityChange;
+  encoder->last.temperature += temperatureChange;
+  encoder->last.fanSpeed += fanSpeedChange * LOG_DELTA_FANSPEED_UNIT;
+
+  if (!encoder->deltaPending)
+  {
+    encoder->delta[0] = (int8_t) humidityChange;
+    encoder->delta[1] = (int8_t) temperatureChange;
+    encoder->delta[2] = (int8_t) fanSpeedChange;
+    encoder->deltaPending = true;
+    return TELEMETRYLOG_STATUS_OK;
+  }
+
+  uint8_t record[LOG_RECORD_LENGTH];
+  newRecord(record, LOG_TYPE_DELTA, channel, encoder->last.status);
+  memcpy(&record[2], encoder->delta, sizeof(encoder->delta));
+  record[5] = (int8_t) humidityChange;
+  record[6] = (int8_t) temperatureChange;
+  record[7] = (int8_t) fanSpeedChange;
+  encoder->deltaPending = false;
+  encoder->recordsSinceKey++;
+  return queueRecord(record);
+}
+
+// Write the DELTA record that only has its first sample, if any.
+TELEMETRYLOG_STATUS TelemetryLog::flush(TelemetryLog_Encoder *encoder, uint8_t channel)
+{
+  if (!encoder->deltaPending)
+  {
+    return TELEMETRYLOG_STATUS_OK;
+  }
+
+  uint8_t record[LOG_RECORD_LENGTH];
+  newRecord(record, LOG_TYPE_DELTA, channel, encoder->last.status);
+  memcpy(&record[2], encoder->delta, sizeof(encoder->delta));
+  record[5] = (uint8_t) LOG_DELTA_NONE;
+  record[6] = 0;
+  record[7] = 0;
+  encoder->deltaPending = false;
+  encoder->recordsSinceKey++;
+  return queueRecord(record);
+}
+
+bool TelemetryLog::service()
+{
+  if (reading_ || !eeprom_is_ready())
+  {
+    return !isIdle();
+  }
+
+  if (eraseIndex_ < LOG_RECORD_COUNT)
+  {
+    EEPROM.update(getSlotAddress(eraseIndex_) + 1, 0xFF);
+    eraseIndex_++;
+    return !isIdle();
+  }
+
+  if (queueCount_ == 0)
+  {
+    return false;
+  }
+
+  if (byteIndex_ == BYTE_INDEX_DONE)
+  { // Starting a record. When the log is full, this overwrites the oldest one.
+    if (count_ == LOG_RECORD_COUNT)
+    {
+      count_--;
+    }
+
+    EEPROM.update(getSlotAddress(head_) + 1, 0xFF);
+    byteIndex_ = 1;
+    return true;
+  }
+
+  uint8_t offset = WRITE_ORDER[byteIndex_];
+  EEPROM.update(getSlotAddress(head_) + offset, queue_[0][offset]);
+  byteIndex_++;
+
+  if (byteIndex_ < sizeof(WRITE_ORDER))
+  {
+    return true;
+  }
+
+  // Record done
+  byteIndex_ = BYTE_INDEX_DONE;
+  head_ = (head_ + 1) % LOG_RECORD_COUNT;
+  count_++;
+  queueCount_--;
+  memmove(queue_[0], queue_[1], queueCount_ * LOG_RECORD_LENGTH);
+  return !isIdle();
+}
+
+bool TelemetryLog::isIdle()
+{
+  return queueCount_ == 0 && eraseIndex_ >= LOG_RECORD_COUNT;
+}
+
+// Empty the log. The records are marked as erased in the background by service().
+void TelemetryLog::clear()
+{
+  queueCount_ = 0;
+  byteIndex_ = BYTE_INDEX_DONE;
+  head_ = 0;
+  count_ = 0;
+  eraseIndex_ = 0;
+}
+
+// Returns the number of records.
+uint8_t TelemetryLog::beginRead()
+{
+  reading_ = true;
+  return count_;
+}
+
+// index 0 is the oldest record.
+void TelemetryLog::readRecord(uint8_t index, uint8_t *record)
+{
+  uint16_t address = getSlotAddress((head_ + LOG_RECORD_COUNT - count_ + index) % LOG_RECORD_COUNT);
+
+  for (uint8_t i = 0; i < LOG_RECORD_LENGTH; i++)
+  {
+    record[i] = EEPROM.read(address + i);
+  }
+}
+
+void TelemetryLog::endRead()
+{
+  reading_ = false;
+}
+
+TELEMETRYLOG_STATUS TelemetryLog::addKey(TelemetryLog_Encoder *encoder, uint8_t channel, const TelemetryLog_Sample &sample)
+{
+  TELEMETRYLOG_STATUS result = flush(encoder, channel);
+
+  if (result != TELEMETRYLOG_STATUS_OK)
+  {
+    return result;
+  }
+
+  uint8_t record[LOG_RECORD_LENGTH];
+  newRecord(record, LOG_TYPE_KEY, channel, sample.status);
+  putInt16(&record[2], sample.humidity);
+  putInt16(&record[4], sample.temperature);
+  putInt16(&record[6], sample.fanSpeed);
+  encoder->last = sample;
+  encoder->last.status &= STATUS_MASK;
+  encoder->recordsSinceKey = 0;
+  return queueRecord(record);
+}
+
+TELEMETRYLOG_STATUS TelemetryLog::queueRecord(const uint8_t *record)
+{
+  if (eraseIndex_ < LOG_RECORD_COUNT || reading_)
+  {
+    return TELEMETRYLOG_STATUS_BUSY;
+  }
+
+  if (queueCount_ >= QUEUE_LENGTH)
+  {
+    return TELEMETRYLOG_STATUS_QUEUE_FULL;
+  }
+
+  memcpy(queue_[queueCount_], record, LOG_RECORD_LENGTH);
+  queue_[queueCount_][0] = sequence_++;
+  queueCount_++;
+  return TELEMETRYLOG_STATUS_OK;
+}
+
+void TelemetryLog::newRecord(uint8_t *record, uint8_t type, uint8_t channel, uint8_t status)
+{
+  record[0] = 0;  // Sequence number, filled in by queueRecord()
+  record[1] = (type << TYPE_SHIFT) | ((channel & 0x03) << CHANNEL_SHIFT) | (status & STATUS_MASK);
+}
+
+void TelemetryLog::putInt16(uint8_t *buffer, int16_t value)
+{
+  buffer[0] = (uint8_t) value;
+  buffer[1] = (uint8_t) (value >> 8);
+}
+
+uint16_t TelemetryLog::getSlotAddress(uint8_t slot)
+{
+  return LOG_ADDR_START + (uint16_t) slot * LOG_RECORD_LENGTH;
+}
@@ -0,0 +1,147 @@
+/*********************************************************************************
+Telemetry ring log in EEPROM, so that a run is kept when no computer is listening.
+
+The second half of the EEPROM (LOG_ADDR_START onwards) holds LOG_RECORD_COUNT
+fixed-length records. Once full, each new record overwrites the oldest one.
+Every record starts with a sequence number; the newest record is the one that
+is not followed by the next sequence number, so the log picks up where it left
+off after a reset. A record is one of:
+ - TARGETS: RH and fan speed targets, and the decimation. Written at the start of every
+   session (reset or change of decimation) and whenever a target changes.
+ - KEY: one sample with absolute values. Written for the first sample after a TARGETS
+   record, when the status changes, when a change is too large for a DELTA record, and
+   every LOG_KEY_INTERVAL records so that the oldest records can still be decoded after
+   their KEY record was overwritten.
+ - DELTA: two samples as changes from the previous one, halving the space per sample.
+All multi-byte fields are little-endian. Byte offsets:
+  0      Sequence number
+  1      Bits 7-6 type (LOG_TYPE_*), bits 5-4 chamber, bits 3-0 status (same bits as the binary data frame)
+  KEY    2-3 RH (0.1 %RH, signed), 4-5 temperature (0.1 degC, signed), 6-7 fan speed (RPM)
+  TARGETS 2-3 RH target (0.1 %RH, signed), 4-5 fan speed target (RPM), 6-7 decimation (s)
+  DELTA  2-4 and 5-7: change of RH (0.1 %RH), temperature (0.1 degC) and fan speed (LOG_DELTA_FANSPEED_UNIT RPM),
+         each a signed byte. The second sample is left out when its RH change is LOG_DELTA_NONE.
+The samples are the decimation (s) apart. A TARGETS record is written just before
+the sample it applies to. If a record could not be queued, the caller resets the
+encoder, which starts a new session since the time since the last sample is lost.
+
+EEPROM writes take 3.3 ms per byte, so records are queued and written one byte
+at a time by service(), without waiting for the EEPROM.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _TELEMETRYLOG_h
+#define _TELEMETRYLOG_h
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#include <EEPROM.h>
+
+typedef enum
+{
+  TELEMETRYLOG_STATUS_OK        = 0,
+  TELEMETRYLOG_STATUS_QUEUE_FULL,   // The EEPROM writes are falling behind
+  TELEMETRYLOG_STATUS_BUSY          // The log is being cleared or read out
+} TELEMETRYLOG_STATUS;
+
+// One sample, in the units of the records
+struct TelemetryLog_Sample
+{
+  int16_t humidity;       // 0.1 %RH
+  int16_t temperature;    // 0.1 degC
+  uint16_t fanSpeed;      // RPM
+  uint8_t status;         // Lower 4 bits only
+};
+
+// Encoding state of one chamber, kept by the caller
+struct TelemetryLog_Encoder
+{
+  bool started;                   // A TARGETS record was written for this session
+  TelemetryLog_Sample last;       // Last sample as the host will decode it
+  int16_t humidityTarget;         // Targets as last written
+  uint16_t fanSpeedTarget;
+  uint8_t recordsSinceKey;
+  bool deltaPending;              // delta holds the first sample of a DELTA record
+  uint8_t delta[3];
+};
+
+class TelemetryLog
+{
+public:
+  static const uint16_t LOG_ADDR_START    = 512;
+  static const uint8_t LOG_RECORD_LENGTH  = 8;
+  static const uint8_t LOG_RECORD_COUNT   = 64;   // Fills the rest of the 1 KB EEPROM
+  static const uint8_t LOG_KEY_INTERVAL   = 8;    // Most records in a row without a KEY record
+  static const uint8_t LOG_TYPE_DELTA     = 0;
+  static const uint8_t LOG_TYPE_KEY       = 1;
+  static const uint8_t LOG_TYPE_TARGETS   = 2;
+  static const uint8_t LOG_TYPE_ERASED    = 3;    // Also what blank EEPROM reads as
+  static const int8_t LOG_DELTA_NONE      = -128;
+  static const uint8_t LOG_DELTA_FANSPEED_UNIT = 8;
+  static const uint16_t LOG_DECIMATION_DEFAULT = 60; // Seconds between samples, if none was saved. A record every minute wears each EEPROM cell once an hour.
+
+  TelemetryLog();
+  void begin();
+  void resetEncoder(TelemetryLog_Encoder *encoder);
+
+  // Decimation (s) between samples; 0 stops the log. It is saved (see ConfigStore).
+  uint16_t getDecimation();
+  void setDecimation(uint16_t decimation);
+
+  // Encode a record for the chamber. Anything but TELEMETRYLOG_STATUS_OK means that a record was lost; call resetEncoder() then.
+  TELEMETRYLOG_STATUS addTargets(TelemetryLog_Encoder *encoder, uint8_t channel, int16_t humidityTarget, uint16_t fanSpeedTarget, uint8_t status);
+  TELEMETRYLOG_STATUS addSample(TelemetryLog_Encoder *encoder, uint8_t channel, const TelemetryLog_Sample &sample);
+  TELEMETRYLOG_STATUS flush(TelemetryLog_Encoder *encoder, uint8_t channel);
+
+  // Writes at most one byte to the EEPROM. Returns true while there is more to write. Call every few ms until then.
+  bool service();
+  bool isIdle();
+  void clear();
+
+  // Reading out, oldest record first. Nothing is written to the EEPROM between beginRead() and endRead().
+  uint8_t beginRead();
+  void readRecord(uint8_t index, uint8_t *record);
+  void endRead();
+
+private:
+  static const uint8_t QUEUE_LENGTH = 2;                // Records waiting to be written
+  static const uint8_t TYPE_SHIFT     = 6;
+  static const uint8_t CHANNEL_SHIFT  = 4;
+  static const uint8_t STATUS_MASK    = 0x0F;
+  static const uint8_t BYTE_INDEX_DONE = 0xFF;
+
+  uint16_t decimation_;
+  uint8_t head_;          // Slot of the next record
+  uint8_t count_;         // Records in the log
+  uint8_t sequence_;      // Sequence number of the next record
+  bool reading_;
+  uint8_t eraseIndex_;    // Next slot to mark as erased by clear(), or LOG_RECORD_COUNT when not clearing
+  uint8_t queue_[QUEUE_LENGTH][LOG_RECORD_LENGTH];
+  uint8_t queueCount_;
+  uint8_t byteIndex_;     // Progress of writing queue_[0]; BYTE_INDEX_DONE when not started
+
+  TELEMETRYLOG_STATUS addKey(TelemetryLog_Encoder *encoder, uint8_t channel, const TelemetryLog_Sample &sample);
+  TELEMETRYLOG_STATUS queueRecord(const uint8_t *record);
+  void newRecord(uint8_t *record, uint8_t type, uint8_t channel, uint8_t status);
+  void putInt16(uint8_t *buffer, int16_t value);
+  uint16_t getSlotAddress(uint8_t slot);
+};
+
+#endif
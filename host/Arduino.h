@@ -0,0 +1,178 @@
+/*********************************************************************************
+Arduino core for the host build (see HostSim.h).
+
+Only what the sketch uses: the pins are plain state that HostSim can read and
+set, millis()/micros()/delay() run on the virtual clock, and Serial is a pair of
+buffers that the test program writes commands into and reads replies from.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _HOST_ARDUINO_h
+#define _HOST_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+#include "avr/io.h"
+#include "avr/pgmspace.h"
+#include "avr/interrupt.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LED_BUILTIN 13
+
+// Nano pin numbers
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+#define HOST_PIN_COUNT 22
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+#define SERIAL_TX_BUFFER_SIZE 64
+
+#define _BV(bit) (1 << (bit))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+
+// Macros like the AVR core, so that mixed types behave the same (std::min/max would not compile for them).
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+// Pin change interrupts: pins 0-7 are PCINT2 (port D), 8-13 PCINT0 (port B), A0-A5 PCINT1 (port C).
+#define digitalPinToPCICR(p) (((p) >= 0 && (p) <= A5) ? (&PCICR) : ((uint8_t *) 0))
+#define digitalPinToPCICRbit(p) (((p) <= 7) ? 2 : (((p) <= 13) ? 0 : 1))
+#define digitalPinToPCMSK(p) (((p) <= 7) ? (&PCMSK2) : (((p) <= 13) ? (&PCMSK0) : (&PCMSK1)))
+#define digitalPinToPCMSKbit(p) (((p) <= 7) ? (p) : (((p) <= 13) ? ((p) - 8) : ((p) - 14)))
+#define digitalPinToPort(p) (((p) <= 7) ? 4 : (((p) <= 13) ? 2 : 3))
+#define digitalPinToBitMask(p) _BV(digitalPinToPCMSKbit(p))
+#define portInputRegister(port) ((port) == 4 ? &PIND : ((port) == 2 ? &PINB : &PINC))
+
+inline bool isDigit(int c) { return isdigit(c) != 0; }
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) { return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+int analogRead(uint8_t pin);
+void noInterrupts();
+void interrupts();
+
+// Strings in flash are ordinary strings on the host.
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *) str, strlen(str)); }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *) buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const __FlashStringHelper *string);
+  size_t print(const char string[]);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = DEC);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println(const __FlashStringHelper *string);
+  size_t println(const char string[]);
+  size_t println(char c);
+  size_t println(unsigned char value, int base = DEC);
+  size_t println(int value, int base = DEC);
+  size_t println(unsigned int value, int base = DEC);
+  size_t println(long value, int base = DEC);
+  size_t println(unsigned long value, int base = DEC);
+  size_t println(double value, int digits = 2);
+  size_t println();
+
+private:
+  size_t printNumber(unsigned long value, uint8_t base);
+  size_t printFloat(double value, uint8_t digits);
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long timeout) { (void) timeout; }
+};
+
+// The end the sketch sees. HostSim feeds the receive buffer and takes what was sent.
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long baudRate) { baudRate_ = baudRate; }
+  void begin(unsigned long baudRate, uint8_t config) { (void) config; begin(baudRate); }
+  void end() {}
+  int available() override;
+  int peek() override;
+  int read() override;
+  int availableForWrite() override { return SERIAL_TX_BUFFER_SIZE - 1; }
+  void flush() override {}
+  size_t write(uint8_t value) override;
+  using Print::write;
+  operator bool() { return true; }
+
+  unsigned long getBaudRate() { return baudRate_; }
+
+private:
+  unsigned long baudRate_ = 0;
+};
+
+extern HardwareSerial Serial;
+
+#endif
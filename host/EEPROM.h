@@ -0,0 +1,36 @@
+// The 1 KB EEPROM of the ATmega328, blank (0xFF) at the start of each run. HostSim can fill it beforehand.
+#ifndef _HOST_EEPROM_h
+#define _HOST_EEPROM_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define eeprom_is_ready() 1
+
+struct EEPROMClass
+{
+  uint8_t data[1024];
+
+  EEPROMClass() { memset(data, 0xFF, sizeof(data)); }
+  uint8_t read(int index) { return data[index]; }
+  void write(int index, uint8_t value) { data[index] = value; }
+  void update(int index, uint8_t value) { data[index] = value; }
+  uint16_t length() { return sizeof(data); }
+  uint8_t &operator[](int index) { return data[index]; }
+
+  template<typename T> T &get(int index, T &value)
+  {
+    memcpy(&value, &data[index], sizeof(T));
+    return value;
+  }
+
+  template<typename T> const T &put(int index, const T &value)
+  {
+    memcpy(&data[index], &value, sizeof(T));
+    return value;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
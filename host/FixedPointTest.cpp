@@ -0,0 +1,356 @@
+/*********************************************************************************
+Test of the real_t math (see FixedPoint.h) on the host build (see HostSim.h).
+
+The same sweeps are built twice, with real_t as double and as Q15.16 (with
+USE_FIXED_POINT): the SHT3x conversion of every RH and temperature signal, the
+calibration of every RH signal with a few tables, and PID::Compute() over a few
+tunings and input sequences. The double build writes its results to a file,
+which the fixed-point build then reads to compare each of its results with.
+Both check the bounds stated in FixedPoint.h against the exact values.
+
+double is 64 bits on the host but 32 bits on the ATmega328, so the results of
+the double build here show the rounded multipliers of the float path, but not
+the rounding of float itself (about 0.5 LSB of Q15.16 at 100 %RH).
+
+Usage: humidosh_fixedpoint_double <results file>
+       humidosh_fixedpoint_fixed <results file>
+Prints the largest error of each sweep, and fails if one is over its bound.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+// The standard headers go first; the Arduino min() and max() macros would break them.
+#include <math.h>
+#include <stdio.h>
+
+#include "HostSim.h"
+#include "../ConfigStore.h"
+#include "../I2C.h"
+#include "../PID_modified.h"
+#include "../PumpDrive.h"
+#include "../SHT3x.h"
+
+static const double LSB = 1.0 / FixedPoint<16>::ONE;       // Resolution of Q15.16
+static const double SIGNAL_LSB = 100.0 / 65535;            // %RH of one step of the RH signal
+
+// Bounds of FixedPoint.h. The float path has the error of its rounded multipliers on top (see SHT3x.cpp).
+static const double CONVERSION_BOUND = 1.003 * LSB;       // 1 LSB, and 175 / 65536 of one for taking 1 + 2^-16 for 65536 / 65535
+static const double RH_MULTIPLIER_ERROR = 65535 * fabs(0.0015259 - 100.0 / 65535);
+static const double TEMPERATURE_MULTIPLIER_ERROR = 65535 * fabs(0.0026703 - 175.0 / 65535);
+static const double CALIBRATION_BOUND = 1.5;                // Signal LSB, plus slope / 2 and distance / 4096
+static const double PID_BOUND = (double) PUMPDRIVE_COMMAND_MAX / PUMPDRIVE_TOP / 10;  // A tenth of a duty cycle step
+
+static FILE *results;
+static bool passed = true;
+
+// Returns the result of the double build for the same point of the sweep: written by the double build and read back
+// by the fixed-point one.
+static double getFloatResult(double value)
+{
+#ifdef USE_FIXED_POINT
+  if (fread(&value, sizeof(value), 1, results) != 1)
+  {
+    fprintf(stderr, "The results of the double build are too short\n");
+    exit(1);
+  }
+#else
+  fwrite(&value, sizeof(value), 1, results);
+#endif // USE_FIXED_POINT
+
+  return value;
+}
+
+// Largest error of one sweep, against its bound
+struct ErrorMax
+{
+  const char *name;
+  double bound;
+  double error;
+  double at;
+};
+
+static void updateError(ErrorMax *errorMax, double error, double at)
+{
+  error = fabs(error);
+
+  if (error > errorMax->error)
+  {
+    errorMax->error = error;
+    errorMax->at = at;
+  }
+}
+
+// A negative bound only prints the error.
+static void printError(const ErrorMax &errorMax, const char *unit)
+{
+  bool failed = errorMax.bound >= 0 && errorMax.error > errorMax.bound;
+  printf("%-46s %12.3g %-6s (bound %9.3g, at %g)%s\n", errorMax.name, errorMax.error, unit, errorMax.bound, errorMax.at,
+         failed ? " FAILED" : "");
+  passed = passed && !failed;
+}
+
+
+////////////// SHT3x conversion and calibration ////////////////////////////////////////
+
+// Sends the frame of the given signals to every read.
+class SignalSource : public HostI2C_Device
+{
+public:
+  void setSignals(uint16_t temperatureSignal, uint16_t RHSignal)
+  {
+    uint16_t signals[2] = { temperatureSignal, RHSignal };
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+      frame_[3 * i]     = signals[i] >> 8;
+      frame_[3 * i + 1] = signals[i] & 0xFF;
+      frame_[3 * i + 2] = SHT3x::calcCRC(&frame_[3 * i], 2);
+    }
+  }
+
+  bool addressed(bool read) override { index_ = 0; (void) read; return true; }
+  uint8_t requested() override { return index_ < sizeof(frame_) ? frame_[index_++] : 0xFF; }
+
+private:
+  uint8_t frame_[6];
+  uint8_t index_;
+};
+
+static SignalSource source;
+static SHT3x sensor(&I2c);
+
+static void measure(uint16_t temperatureSignal, uint16_t RHSignal)
+{
+  source.setSignals(temperatureSignal, RHSignal);
+
+  if (sensor.fetchMeasurement() != SHT3X_STATUS_OK)
+  {
+    fprintf(stderr, "No measurement from the SHT3x\n");
+    exit(1);
+  }
+}
+
+static void testConversion()
+{
+  ErrorMax RHExact = { "RH conversion, against exact", RH_MULTIPLIER_ERROR + CONVERSION_BOUND, 0, 0 };
+  ErrorMax temperatureExact = { "Temperature conversion, against exact", TEMPERATURE_MULTIPLIER_ERROR + CONVERSION_BOUND, 0, 0 };
+  ErrorMax RHFloat = { "RH conversion, against the double build", RH_MULTIPLIER_ERROR + CONVERSION_BOUND, 0, 0 };
+  ErrorMax temperatureFloat = { "Temperature conversion, against the double build", TEMPERATURE_MULTIPLIER_ERROR + CONVERSION_BOUND, 0, 0 };
+
+#ifdef USE_FIXED_POINT
+  RHExact.bound = CONVERSION_BOUND;
+  temperatureExact.bound = CONVERSION_BOUND;
+#endif // USE_FIXED_POINT
+
+  for (uint32_t signal = 0; signal <= 65535; signal++)
+  {
+    measure(signal, signal);
+    double RH = realToDouble(sensor.getRHRaw());
+    double temperature = realToDouble(sensor.getTemperature());
+
+    updateError(&RHExact, RH - 100.0 * signal / 65535, signal);
+    updateError(&temperatureExact, temperature - (-45 + 175.0 * signal / 65535), signal);
+    updateError(&RHFloat, RH - getFloatResult(RH), signal);
+    updateError(&temperatureFloat, temperature - getFloatResult(temperature), signal);
+  }
+
+  printError(RHExact, "%RH");
+  printError(temperatureExact, "degC");
+  printError(RHFloat, "%RH");
+  printError(temperatureFloat, "degC");
+}
+
+struct CalibrationCase
+{
+  const char *name;
+  uint8_t pointCount;
+  float raw[CONFIGSTORE_CAL_POINT_MAX];   // %RH
+  float ref[CONFIGSTORE_CAL_POINT_MAX];
+};
+
+static const CalibrationCase CALIBRATION_CASES[] =
+{
+  { "Calibration, offset", 1, { 50.0 }, { 52.3 } },
+  { "Calibration, 2 points", 2, { 20.0, 80.0 }, { 22.5, 78.1 } },
+  { "Calibration, 5 points", 5, { 11.3, 33.0, 52.7, 75.5, 90.2 }, { 12.0, 35.2, 51.9, 77.7, 93.1 } },
+  { "Calibration, 8 points", 8, { 5.0, 15.5, 27.1, 40.0, 51.3, 63.8, 77.2, 93.4 },
+                                { 4.1, 16.9, 26.0, 42.7, 50.2, 66.1, 75.9, 96.0 } },
+};
+
+// The exact straight line through the points of the case that the calibration of signal is on, its slope, and the
+// distance (signal LSB) from the point that the segment starts at.
+static double getCalibrationExact(const CalibrationCase &calibration, uint16_t signal, double *slope, double *distance)
+{
+  double raw = signal * SIGNAL_LSB;
+
+  if (calibration.pointCount == 1)
+  {
+    *slope = 1;
+    *distance = fabs(raw - calibration.raw[0]) / SIGNAL_LSB;
+    return raw + calibration.ref[0] - calibration.raw[0];
+  }
+
+  uint8_t segment = 0;
+
+  while (segment + 2 < calibration.pointCount && raw >= calibration.raw[segment + 1])
+  {
+    segment++;
+  }
+
+  *slope = (calibration.ref[segment + 1] - calibration.ref[segment]) / (calibration.raw[segment + 1] - calibration.raw[segment]);
+  *distance = fabs(raw - calibration.raw[segment]) / SIGNAL_LSB;
+  return calibration.ref[segment] + *slope * (raw - calibration.raw[segment]);
+}
+
+static void testCalibration()
+{
+  for (uint8_t i = 0; i < sizeof(CALIBRATION_CASES) / sizeof(CALIBRATION_CASES[0]); i++)
+  {
+    const CalibrationCase &calibration = CALIBRATION_CASES[i];
+    ConfigStore_CalTable table;
+    memset(&table, 0, sizeof(table));
+
+    for (uint8_t j = 0; j < calibration.pointCount; j++)
+    {
+      SHT3x::addCalibrationPoint(&table, calibration.ref[j], calibration.raw[j]);
+    }
+
+    Config.setCalibration(0, table);
+
+    // With the parts of the bound that change along the segment taken out, so that the rest is the same at every signal
+    ErrorMax exact = { calibration.name, CALIBRATION_BOUND + (CONVERSION_BOUND + RH_MULTIPLIER_ERROR) / SIGNAL_LSB, 0, 0 };
+    ErrorMax againstFloat = { "  against the double build", RH_MULTIPLIER_ERROR + CONVERSION_BOUND, 0, 0 };
+
+#ifdef USE_FIXED_POINT
+    exact.bound = CALIBRATION_BOUND + CONVERSION_BOUND / SIGNAL_LSB;
+#endif // USE_FIXED_POINT
+
+    for (uint32_t signal = 0; signal <= 65535; signal++)
+    {
+      measure(0, signal);
+      double RH = realToDouble(sensor.getRH());
+      double slope, distance;
+      double error = fabs(RH - getCalibrationExact(calibration, signal, &slope, &distance)) / SIGNAL_LSB;
+
+      updateError(&exact, max(error - fabs(slope) / 2 - distance / 4096, 0.0), signal);
+      updateError(&againstFloat, RH - getFloatResult(RH), signal);
+    }
+
+    printError(exact, "LSB");
+    printError(againstFloat, "%RH");
+  }
+
+  ConfigStore_CalTable table;
+  memset(&table, 0, sizeof(table));
+  Config.setCalibration(0, table);
+}
+
+
+////////////// PID ////////////////////////////////////////
+
+struct PIDCase
+{
+  double kp, ki, kd;     // ki per ms, as entered
+  int proportionalOn;
+  uint16_t period;       // ms between the runs of Compute()
+};
+
+static const PIDCase PID_CASES[] =
+{
+  { 5,   0.001,   0,    P_ON_E, 100 },   // PID_RH_KP, PID_RH_KI, PID_RH_KD of HumidOSH.ino, at 10 Hz
+  { 5,   0.001,   0,    P_ON_E, 370 },
+  { 5,   0.005,   100,  P_ON_E, 100 },
+  { 1,   0.0001,  0,    P_ON_M, 250 },
+  { 12,  0.003,   1000, P_ON_M, 470 },
+};
+
+static const uint16_t PID_STEPS = 3000;
+
+// RH readings around the target, as a damped swing with some noise. In steps of 2^-8 %RH, so that both builds have
+// the same inputs and only the PID math differs.
+static double getPIDInput(uint16_t step, double target, uint16_t period, uint32_t *random)
+{
+  double time = (double) step * period / 1000;
+  *random = *random * 1664525UL + 1013904223UL;
+  double noise = 0.05 * ((double) (*random >> 8) / (1UL << 24) * 2 - 1);
+  double RH = target - 4 * exp(-time / 120) * cos(time / 40) + noise;
+  return floor(RH * 256 + 0.5) / 256;
+}
+
+static void testPID()
+{
+  for (uint8_t i = 0; i < sizeof(PID_CASES) / sizeof(PID_CASES[0]); i++)
+  {
+    const PIDCase &tuning = PID_CASES[i];
+    real_t input = 0, output = 0, target = 55.5;
+    unsigned long now = 0;
+    PID pid(&input, &output, &target, tuning.kp, tuning.ki, tuning.kd, now, tuning.proportionalOn, DIRECT);
+    pid.SetOutputLimits(-PUMPDRIVE_COMMAND_MAX, PUMPDRIVE_COMMAND_MAX);
+    uint32_t random = i + 1;
+    input = getPIDInput(0, realToDouble(target), tuning.period, &random);
+    pid.SetMode(AUTOMATIC);  // Starts from the input and output above, as in HumidOSH::init()
+
+    char name[64];
+    snprintf(name, sizeof(name), "PID %g/%g/%g%s every %u ms", tuning.kp, tuning.ki, tuning.kd,
+             tuning.proportionalOn == P_ON_M ? " (P on M)" : "", tuning.period);
+    ErrorMax againstFloat = { name, PID_BOUND, 0, 0 };
+
+    for (uint16_t step = 1; step <= PID_STEPS; step++)
+    {
+      now += tuning.period;
+      input = getPIDInput(step, realToDouble(target), tuning.period, &random);
+      pid.Compute(now);
+      updateError(&againstFloat, realToDouble(output) - getFloatResult(realToDouble(output)), step);
+    }
+
+    printError(againstFloat, "");
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s <results file>\n", argv[0]);
+    return 2;
+  }
+
+#ifdef USE_FIXED_POINT
+  results = fopen(argv[1], "rb");
+  printf("real_t is Q15.16; compared with the double build in %s\n", argv[1]);
+#else
+  results = fopen(argv[1], "wb");
+  printf("real_t is double; results written to %s\n", argv[1]);
+#endif // USE_FIXED_POINT
+
+  if (!results)
+  {
+    fprintf(stderr, "Can't open %s\n", argv[1]);
+    return 2;
+  }
+
+  HostSim::attachI2CDevice(SHT3x::BASE_ADDRESS, &source);
+  I2c.begin(false);
+  I2c.setSpeed(true);
+  Config.begin();
+
+  testConversion();
+  testCalibration();
+  testPID();
+
+  fclose(results);
+  return passed ? 0 : 1;
+}
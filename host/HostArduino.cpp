@@ -0,0 +1,396 @@
+/*********************************************************************************
+Arduino core of the host build: virtual clock, pins, registers and Serial (see HostSim.h).
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "HostSim.h"
+#include "EEPROM.h"
+
+volatile uint8_t PORTB, PORTC, PORTD, DDRB, DDRC, DDRD, PINB, PIND;
+volatile uint8_t PINC = _BV(4) | _BV(5);  // SDA and SCL, left high by the pull-ups
+volatile uint8_t TCCR1A, TCCR1B;
+volatile uint16_t TCNT1, ICR1, OCR1A, OCR1B;
+volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2, PCIFR, SREG;
+volatile uint8_t UCSR0A = _BV(TXC0);
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+static uint64_t clock_ = 0;  // ns
+
+// Time (ns) that a call to millis() or micros() takes on the target. A loop that waits for millis() to move on, or for a
+// background transaction while polling for it, gets there because of this.
+static const uint64_t MILLIS_COST = 1500;
+static const uint64_t MICROS_COST = 3500;
+
+static uint8_t pinModes_[HOST_PIN_COUNT];
+static uint8_t pinOutputs_[HOST_PIN_COUNT];
+static uint8_t pinInputs_[HOST_PIN_COUNT];
+static bool pinInputSet_[HOST_PIN_COUNT];
+static int analogWrites_[HOST_PIN_COUNT];
+
+// Far larger than the 64 bytes of the target, so that nothing is lost between two reads by the test program
+static const size_t SERIAL_BUFFER_SIZE = 4096;
+static char serialReceived_[SERIAL_BUFFER_SIZE];
+static size_t serialReceivedHead_ = 0;
+static size_t serialReceivedCount_ = 0;
+static char serialSent_[SERIAL_BUFFER_SIZE];
+static size_t serialSentCount_ = 0;
+
+
+////////////// Virtual clock ////////////////////////////////////////
+
+uint64_t HostSim::now()
+{
+  return clock_;
+}
+
+void HostSim::advance(uint64_t ns)
+{
+  clock_ += ns;
+  advanceI2C();
+}
+
+void HostSim::advanceTo(uint64_t time)
+{
+  if (time > clock_)
+  {
+    advance(time - clock_);
+  }
+}
+
+unsigned long millis()
+{
+  HostSim::advance(MILLIS_COST);
+  return (unsigned long) (clock_ / 1000000);
+}
+
+unsigned long micros()
+{
+  HostSim::advance(MICROS_COST);
+  return (unsigned long) (clock_ / 1000);
+}
+
+void delay(unsigned long ms)
+{
+  HostSim::advance((uint64_t) ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  HostSim::advance((uint64_t) us * 1000);
+}
+
+void noInterrupts()
+{
+}
+
+void interrupts()
+{
+}
+
+
+////////////// Pins ////////////////////////////////////////
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin < HOST_PIN_COUNT)
+  {
+    pinModes_[pin] = mode;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin < HOST_PIN_COUNT)
+  {
+    pinOutputs_[pin] = value ? HIGH : LOW;
+    analogWrites_[pin] = value ? 255 : 0;
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  if (pin >= HOST_PIN_COUNT)
+  {
+    return LOW;
+  }
+
+  if (pinModes_[pin] == OUTPUT)
+  {
+    return pinOutputs_[pin];
+  }
+
+  if (pinInputSet_[pin])
+  {
+    return pinInputs_[pin];
+  }
+
+  // Nothing connected, e.g. no key down
+  return pinModes_[pin] == INPUT_PULLUP ? HIGH : LOW;
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+  if (pin < HOST_PIN_COUNT)
+  {
+    analogWrites_[pin] = value;
+    pinOutputs_[pin] = value > 0 ? HIGH : LOW;
+  }
+}
+
+int analogRead(uint8_t pin)
+{
+  (void) pin;
+  return 0;
+}
+
+uint8_t HostSim::getPinMode(uint8_t pin)
+{
+  return pin < HOST_PIN_COUNT ? pinModes_[pin] : INPUT;
+}
+
+uint8_t HostSim::getPinOutput(uint8_t pin)
+{
+  return pin < HOST_PIN_COUNT ? pinOutputs_[pin] : LOW;
+}
+
+void HostSim::setPinInput(uint8_t pin, uint8_t value)
+{
+  if (pin < HOST_PIN_COUNT)
+  {
+    pinInputs_[pin] = value;
+    pinInputSet_[pin] = true;
+  }
+}
+
+int HostSim::getAnalogWrite(uint8_t pin)
+{
+  return pin < HOST_PIN_COUNT ? analogWrites_[pin] : 0;
+}
+
+
+////////////// Serial ////////////////////////////////////////
+
+int HardwareSerial::available()
+{
+  return (int) serialReceivedCount_;
+}
+
+int HardwareSerial::peek()
+{
+  return serialReceivedCount_ ? (uint8_t) serialReceived_[serialReceivedHead_] : -1;
+}
+
+int HardwareSerial::read()
+{
+  if (!serialReceivedCount_)
+  {
+    return -1;
+  }
+
+  uint8_t value = serialReceived_[serialReceivedHead_];
+  serialReceivedHead_ = (serialReceivedHead_ + 1) % SERIAL_BUFFER_SIZE;
+  serialReceivedCount_--;
+  return value;
+}
+
+size_t HardwareSerial::write(uint8_t value)
+{
+  if (serialSentCount_ >= SERIAL_BUFFER_SIZE)
+  { // The test program isn't reading; drop the oldest half.
+    memmove(serialSent_, serialSent_ + SERIAL_BUFFER_SIZE / 2, SERIAL_BUFFER_SIZE / 2);
+    serialSentCount_ = SERIAL_BUFFER_SIZE / 2;
+  }
+
+  serialSent_[serialSentCount_++] = value;
+  return 1;
+}
+
+void HostSim::serialReceive(const char *text)
+{
+  for (; *text != '\0' && serialReceivedCount_ < SERIAL_BUFFER_SIZE; text++)
+  {
+    serialReceived_[(serialReceivedHead_ + serialReceivedCount_) % SERIAL_BUFFER_SIZE] = *text;
+    serialReceivedCount_++;
+  }
+}
+
+size_t HostSim::serialTakeSent(char *buffer, size_t length)
+{
+  size_t count = serialSentCount_ < length ? serialSentCount_ : length;
+  memcpy(buffer, serialSent_, count);
+  memmove(serialSent_, serialSent_ + count, serialSentCount_ - count);
+  serialSentCount_ -= count;
+  return count;
+}
+
+void HostSim::serialClearSent()
+{
+  serialSentCount_ = 0;
+}
+
+
+////////////// Print ////////////////////////////////////////
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+
+  while (size--)
+  {
+    n += write(*buffer++);
+  }
+
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *string)
+{
+  return write(reinterpret_cast<const char *>(string));
+}
+
+size_t Print::print(const char string[])
+{
+  return write(string);
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t) c);
+}
+
+size_t Print::print(unsigned char value, int base)
+{
+  return print((unsigned long) value, base);
+}
+
+size_t Print::print(int value, int base)
+{
+  return print((long) value, base);
+}
+
+size_t Print::print(unsigned int value, int base)
+{
+  return print((unsigned long) value, base);
+}
+
+size_t Print::print(long value, int base)
+{
+  if (base == 0)
+  {
+    return write((uint8_t) value);
+  }
+
+  if (base == DEC && value < 0)
+  {
+    return print('-') + printNumber((unsigned long) -value, DEC);
+  }
+
+  return printNumber((unsigned long) value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  return base == 0 ? write((uint8_t) value) : printNumber(value, base);
+}
+
+size_t Print::print(double value, int digits)
+{
+  return printFloat(value, digits);
+}
+
+size_t Print::println(const __FlashStringHelper *string) { return print(string) + println(); }
+size_t Print::println(const char string[]) { return print(string) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char value, int base) { return print(value, base) + println(); }
+size_t Print::println(int value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned int value, int base) { return print(value, base) + println(); }
+size_t Print::println(long value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned long value, int base) { return print(value, base) + println(); }
+size_t Print::println(double value, int digits) { return print(value, digits) + println(); }
+
+size_t Print::println()
+{
+  return write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long value, uint8_t base)
+{
+  char buffer[8 * sizeof(long) + 1];
+  char *str = &buffer[sizeof(buffer) - 1];
+  *str = '\0';
+
+  if (base < 2)
+  {
+    base = 10;
+  }
+
+  do
+  {
+    char c = value % base;
+    value /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (value);
+
+  return write(str);
+}
+
+// Same rounding and limits as the AVR core, so that the sketch sends the same strings.
+size_t Print::printFloat(double value, uint8_t digits)
+{
+  if (isnan(value)) { return print("nan"); }
+  if (isinf(value)) { return print("inf"); }
+  if (value > 4294967040.0) { return print("ovf"); }
+  if (value < -4294967040.0) { return print("ovf"); }
+
+  size_t n = 0;
+
+  if (value < 0.0)
+  {
+    n += print('-');
+    value = -value;
+  }
+
+  double rounding = 0.5;
+
+  for (uint8_t i = 0; i < digits; i++)
+  {
+    rounding /= 10.0;
+  }
+
+  value += rounding;
+
+  unsigned long integer = (unsigned long) value;
+  double remainder = value - (double) integer;
+  n += print(integer);
+
+  if (digits > 0)
+  {
+    n += print('.');
+  }
+
+  while (digits-- > 0)
+  {
+    remainder *= 10.0;
+    unsigned int digit = (unsigned int) remainder;
+    n += print(digit);
+    remainder -= digit;
+  }
+
+  return n;
+}
@@ -0,0 +1,242 @@
+/*********************************************************************************
+Models of the I2C devices of HumidOSH for the host build (see HostDevices.h).
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "HostDevices.h"
+#include "../SHT3x.h"
+
+static const uint64_t NS_PER_MS = 1000000;
+
+
+////////////// SHT3x ////////////////////////////////////////
+
+HostSHT3x::HostSHT3x(ChamberPlant *plant) : plant_(plant), noise_(0), noiseState_(1), commandLength_(0), frameIndex_(0),
+  periodic_(false), periodStart_(0), period_(0), fetchedIndex_(0), fetchPending_(false), singleShotPending_(false),
+  singleShotReady_(0)
+{
+  memset(frame_, 0xFF, sizeof(frame_));
+}
+
+void HostSHT3x::setNoise(float amplitude, uint32_t seed)
+{
+  noise_ = amplitude;
+  noiseState_ = seed ? seed : 1;
+}
+
+bool HostSHT3x::addressed(bool read)
+{
+  if (!read)
+  {
+    commandLength_ = 0;
+    return true;
+  }
+
+  frameIndex_ = 0;
+
+  if (singleShotPending_)
+  {
+    if (HostSim::now() < singleShotReady_)
+    {
+      return false;
+    }
+
+    singleShotPending_ = false;
+    measure();
+    return true;
+  }
+
+  if (periodic_ && fetchPending_)
+  { // The data are gone after one read, and the fetch must be sent again.
+    fetchPending_ = false;
+    uint64_t index = (HostSim::now() - periodStart_) / period_;
+
+    if (index > fetchedIndex_)
+    {
+      fetchedIndex_ = index;
+      measure();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool HostSHT3x::received(uint8_t value)
+{
+  if (commandLength_ < sizeof(command_))
+  {
+    command_[commandLength_++] = value;
+
+    if (commandLength_ == sizeof(command_))
+    {
+      runCommand(((uint16_t) command_[0] << 8) | command_[1]);
+    }
+  }
+
+  return true;
+}
+
+uint8_t HostSHT3x::requested()
+{
+  return frameIndex_ < sizeof(frame_) ? frame_[frameIndex_++] : 0xFF;
+}
+
+// The commands of the datasheet (section 4) that SHT3x.cpp uses
+void HostSHT3x::runCommand(uint16_t command)
+{
+  uint8_t msb = command >> 8;
+  uint8_t lsb = command & 0xFF;
+
+  if (command == 0x3093)
+  { // Break
+    periodic_ = false;
+    fetchPending_ = false;
+    return;
+  }
+
+  if (command == 0xE000)
+  {
+    fetchPending_ = true;
+    return;
+  }
+
+  if (periodic_)
+  { // Nothing else is heard in the periodic mode
+    return;
+  }
+
+  if (msb == 0x24 || msb == 0x2C)
+  { // Single shot; clock stretching isn't modelled, so the read is NACKed until the measurement is done
+    uint8_t duration = (lsb == 0x00 || lsb == 0x06) ? 15 : ((lsb == 0x0B || lsb == 0x0D) ? 6 : 4);
+    singleShotPending_ = true;
+    singleShotReady_ = HostSim::now() + duration * NS_PER_MS;
+    return;
+  }
+
+  uint16_t periodMs = 0;
+
+  switch (msb)
+  {
+  case 0x20: periodMs = 2000; break;
+  case 0x21: periodMs = 1000; break;
+  case 0x22: periodMs = 500;  break;
+  case 0x23: periodMs = 250;  break;
+  case 0x27: periodMs = 100;  break;
+  case 0x2B: periodMs = lsb == 0x32 ? 250 : 0; break; // ART
+  default: break;
+  }
+
+  if (periodMs)
+  {
+    periodic_ = true;
+    periodStart_ = HostSim::now();
+    period_ = periodMs * NS_PER_MS;
+    fetchedIndex_ = 0;
+    fetchPending_ = false;
+  }
+}
+
+// Fill the frame with the RH and temperature of the plant: signal, CRC, signal, CRC (temperature first).
+void HostSHT3x::measure()
+{
+  float RH = plant_->getRH();
+
+  if (noise_ > 0)
+  {
+    noiseState_ = noiseState_ * 1664525UL + 1013904223UL;
+    RH += noise_ * ((float) (noiseState_ >> 8) / (1UL << 24) * 2 - 1);
+  }
+
+  float temperatureSignal = (plant_->getTemperature() + 45) / 175 * 65535 + 0.5;
+  float RHSignal = RH / 100 * 65535 + 0.5;
+  uint16_t signals[2] = { (uint16_t) constrain(temperatureSignal, 0, 65535), (uint16_t) constrain(RHSignal, 0, 65535) };
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    frame_[3 * i]     = signals[i] >> 8;
+    frame_[3 * i + 1] = signals[i] & 0xFF;
+    frame_[3 * i + 2] = SHT3x::calcCRC(&frame_[3 * i], 2);
+  }
+}
+
+
+////////////// EMC2301 ////////////////////////////////////////
+
+HostEMC2301::HostEMC2301() : pointer_(0), pointerNext_(false), speed_(0), updateTime_(0)
+{
+  memset(registers_, 0, sizeof(registers_));
+  registers_[REG_TACHTARGETLSB] = 0xF8;   // Fan off
+  registers_[REG_TACHTARGETMSB] = 0xFF;
+  registers_[0xFD] = 0x37;  // Product ID
+  registers_[0xFE] = 0x5D;  // Manufacturer ID
+  registers_[0xFF] = 0x80;  // Revision
+}
+
+uint16_t HostEMC2301::getTachCount()
+{
+  update();
+  return speed_ > 1.0 / TACH_STOPPED ? (uint16_t) (1 / speed_ + 0.5) : TACH_STOPPED;
+}
+
+bool HostEMC2301::addressed(bool read)
+{
+  pointerNext_ = !read;
+  return true;
+}
+
+bool HostEMC2301::received(uint8_t value)
+{
+  if (pointerNext_)
+  {
+    pointer_ = value;
+    pointerNext_ = false;
+    return true;
+  }
+
+  if (pointer_ == REG_TACHTARGETLSB || pointer_ == REG_TACHTARGETMSB)
+  { // The fan runs towards the old target until now
+    update();
+  }
+
+  registers_[pointer_++] = value;
+  return true;
+}
+
+uint8_t HostEMC2301::requested()
+{
+  if (pointer_ == REG_TACHREADMSB)
+  { // The LSB is latched along with the MSB (p37 of the datasheet)
+    uint16_t count = getTachCount();
+    registers_[REG_TACHREADMSB] = count >> 5;
+    registers_[REG_TACHREADLSB] = (count << 3) & 0xF8;
+  }
+
+  return registers_[pointer_++];
+}
+
+// Move the speed to now, towards the target.
+void HostEMC2301::update()
+{
+  uint64_t now = HostSim::now();
+  float elapsed = (now - updateTime_) / 1e9;
+  updateTime_ = now;
+
+  uint16_t targetCount = ((uint16_t) registers_[REG_TACHTARGETMSB] << 5) | (registers_[REG_TACHTARGETLSB] >> 3);
+  float targetSpeed = targetCount >= TACH_STOPPED || targetCount == 0 ? 0 : 1.0 / targetCount;
+  speed_ += (targetSpeed - speed_) * (1 - expf(-elapsed / SPEED_TIME_CONSTANT));
+}
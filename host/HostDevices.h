@@ -0,0 +1,95 @@
+/*********************************************************************************
+Models of the I2C devices of HumidOSH for the host build (see HostSim.h).
+
+HostSHT3x answers the commands that SHT3x.cpp sends, with the RH of a
+ChamberPlant: single shot measurements are ready after their duration, and the
+periodic mode (or ART) makes one measurement per period, which a fetch reads
+once. Without a new measurement the read is NACKed, as by the sensor.
+
+HostEMC2301 is a register file with an auto-incremented pointer. The target
+tach count (TACHTARGET) sets the speed that the fan runs up or down to, with a
+lag of SPEED_TIME_CONSTANT, and TACHREAD follows the speed. The tach counts are
+kept as they are, so the model doesn't need the fan poles or the range.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _HOSTDEVICES_h
+#define _HOSTDEVICES_h
+
+#include "HostSim.h"
+#include "../ChamberPlant.h"
+
+class HostSHT3x : public HostI2C_Device
+{
+public:
+  explicit HostSHT3x(ChamberPlant *plant);
+  void setNoise(float amplitude, uint32_t seed);  // Adds uniform noise of +/- amplitude (%RH) to each measurement
+
+  bool addressed(bool read) override;
+  bool received(uint8_t value) override;
+  uint8_t requested() override;
+
+private:
+  ChamberPlant *plant_;
+  float noise_;
+  uint32_t noiseState_;
+
+  uint8_t command_[2];
+  uint8_t commandLength_;
+  uint8_t frame_[6];
+  uint8_t frameIndex_;
+
+  bool periodic_;
+  uint64_t periodStart_;    // ns
+  uint64_t period_;         // ns
+  uint64_t fetchedIndex_;   // Measurements of the periodic mode are numbered from 1
+  bool fetchPending_;
+  bool singleShotPending_;
+  uint64_t singleShotReady_;
+
+  void runCommand(uint16_t command);
+  void measure();
+};
+
+class HostEMC2301 : public HostI2C_Device
+{
+public:
+  HostEMC2301();
+  uint16_t getTachCount();  // 13 bits, as in TACHREAD
+
+  bool addressed(bool read) override;
+  bool received(uint8_t value) override;
+  uint8_t requested() override;
+
+private:
+  static const uint8_t REG_TACHTARGETLSB = 0x3C;
+  static const uint8_t REG_TACHTARGETMSB = 0x3D;
+  static const uint8_t REG_TACHREADMSB   = 0x3E;
+  static const uint8_t REG_TACHREADLSB   = 0x3F;
+  static const uint16_t TACH_STOPPED     = 0x1FFF;
+  static constexpr float SPEED_TIME_CONSTANT = 1.0;  // s
+
+  uint8_t registers_[256];
+  uint8_t pointer_;
+  bool pointerNext_;        // The next byte written is the register pointer
+  float speed_;             // 1 / tach count; 0 when stopped
+  uint64_t updateTime_;
+
+  void update();
+};
+
+#endif
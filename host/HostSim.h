@@ -0,0 +1,80 @@
+/*********************************************************************************
+Host build of HumidOSH: the sketch compiled for the PC, on a virtual clock.
+
+The sketch and its libraries are compiled as they are, I2C.cpp included. What
+the Arduino core and the hardware would provide is replaced by the files in
+this folder:
+  Arduino.h, avr/*      millis()/micros()/delay() read and advance the virtual
+                        clock, the pins and registers are plain variables, and
+                        Serial is a pair of buffers.
+  HostTWI.cpp           The TWI peripheral behind TWCR: each step that I2C.cpp
+                        starts takes the bus time it would take at the bit rate
+                        in TWBR, and goes to the HostI2C_Device at the address.
+                        With TWIE set, the step finishes (and the TWI interrupt
+                        runs) once the clock has passed its end.
+  HostDevices.*         Models of the SHT3x and the EMC2301.
+
+The clock only moves when the sketch waits (delay(), a blocking transaction, a
+call to millis()) or when the test program moves it on between two passes of
+loop(), so a run takes as long as the code takes on the PC, not the time it
+simulates.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef _HOSTSIM_h
+#define _HOSTSIM_h
+
+#include "Arduino.h"
+
+// A device on the I2C bus. The functions are called as the bytes go over the bus; return false to NACK.
+class HostI2C_Device
+{
+public:
+  virtual ~HostI2C_Device() {}
+  virtual bool addressed(bool read) { (void) read; return true; } // After the address byte (start or repeated start)
+  virtual bool received(uint8_t value) { (void) value; return true; }
+  virtual uint8_t requested() { return 0xFF; }
+  virtual void stopped() {}
+};
+
+namespace HostSim
+{
+  // Virtual clock (ns since the start)
+  uint64_t now();
+  void advance(uint64_t ns);
+  void advanceTo(uint64_t time);
+
+  // Pins and PWM, as driven by the sketch
+  uint8_t getPinMode(uint8_t pin);
+  uint8_t getPinOutput(uint8_t pin);
+  void setPinInput(uint8_t pin, uint8_t value); // Level read by digitalRead() for a pin that isn't an output
+  int getAnalogWrite(uint8_t pin);
+
+  // Serial link to the computer
+  void serialReceive(const char *text);   // Bytes for the sketch to read
+  size_t serialTakeSent(char *buffer, size_t length);  // Moves what the sketch sent into buffer; returns the length
+  void serialClearSent();
+
+  // I2C bus
+  void attachI2CDevice(uint8_t address, HostI2C_Device *device);
+  uint64_t getI2CBusyTime(uint8_t address);   // Total bus time (ns) of the transactions with the address, start to stop
+  uint32_t getI2CTransactionCount(uint8_t address);
+  void resetI2CStats();
+  void advanceI2C();  // Finishes the step of the TWI that is over by now(); called by advance()
+}
+
+#endif
@@ -0,0 +1,267 @@
+/*********************************************************************************
+TWI peripheral of the host build (see HostSim.h).
+
+Writing TWCR with TWINT set starts one step on the bus, as on the ATmega328: a
+start (TWSTA), a stop (TWSTO), or the byte in TWDR (sent, or received into it).
+The step goes to the HostI2C_Device at the address of the transaction and takes
+the bus time of its bits at the bit rate in TWBR, from when the previous step
+ended. Without TWIE the clock is moved to the end of the step right away, so
+the busy-wait in I2C.cpp sees TWINT straight after; with TWIE the step ends,
+and the TWI interrupt runs, once the clock gets there.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "HostSim.h"
+
+// TWSR status codes (same as in I2C.h)
+static const uint8_t TW_START         = 0x08;
+static const uint8_t TW_REP_START     = 0x10;
+static const uint8_t TW_MT_SLA_ACK    = 0x18;
+static const uint8_t TW_MT_SLA_NACK   = 0x20;
+static const uint8_t TW_MT_DATA_ACK   = 0x28;
+static const uint8_t TW_MT_DATA_NACK  = 0x30;
+static const uint8_t TW_MR_SLA_ACK    = 0x40;
+static const uint8_t TW_MR_SLA_NACK   = 0x48;
+static const uint8_t TW_MR_DATA_ACK   = 0x50;
+static const uint8_t TW_MR_DATA_NACK  = 0x58;
+static const uint8_t TW_NO_INFO       = 0xF8;
+
+// Bits on the bus for each step
+static const uint8_t BITS_START = 1;
+static const uint8_t BITS_STOP  = 1;
+static const uint8_t BITS_BYTE  = 9;  // 8 data bits and the ACK
+
+extern "C" void TWI_vect(void);
+
+HostTWI_Control TWCR;
+volatile uint8_t TWSR = TW_NO_INFO, TWBR, TWDR, TWAR;
+
+typedef enum
+{
+  BUS_IDLE,
+  BUS_ADDRESS,    // After a start; TWDR holds the address
+  BUS_TRANSMIT,
+  BUS_RECEIVE,
+  BUS_NACKED      // The address or a byte was not acknowledged; the master should stop
+} BUS_STATE;
+
+static HostI2C_Device *devices_[128];
+static uint64_t busyTime_[128];
+static uint32_t transactionCount_[128];
+
+static BUS_STATE state_ = BUS_IDLE;
+static HostI2C_Device *device_ = NULL;
+static uint8_t address_ = 0;
+static uint64_t transactionStart_ = 0;
+static uint64_t busTime_ = 0;         // End of the last step
+
+// The step that ends with an interrupt
+static bool stepPending_ = false;
+static uint64_t stepEnd_;
+static uint8_t stepStatus_;
+static uint8_t stepData_;
+static bool stepReceived_;
+static bool inInterrupt_ = false;
+
+// Time (ns) of one bit on the bus: SCL = F_CPU / (16 + 2 * TWBR * prescaler)
+static uint64_t getBitTime()
+{
+  static const uint8_t PRESCALERS[4] = { 1, 4, 16, 64 };
+  return (16 + 2 * (uint64_t) TWBR * PRESCALERS[TWSR & 0x03]) * 1000000000ULL / F_CPU;
+}
+
+// Start a step of the given number of bits. In the interrupt, the clock may already be past the end of the previous
+// step; the next one follows straight on from it, as the interrupt would have run at its end.
+static uint64_t beginStep(uint8_t bits)
+{
+  uint64_t start = inInterrupt_ || busTime_ > HostSim::now() ? busTime_ : HostSim::now();
+  busTime_ = start + bits * getBitTime();
+  return start;
+}
+
+struct HostTWI
+{
+  static void setInterruptFlag() { TWCR.value_ |= _BV(TWINT); }
+};
+
+static void endTransaction()
+{
+  if (state_ != BUS_IDLE)
+  {
+    busyTime_[address_] += busTime_ - transactionStart_;
+    transactionCount_[address_]++;
+
+    if (device_)
+    {
+      device_->stopped();
+    }
+  }
+
+  state_ = BUS_IDLE;
+  device_ = NULL;
+}
+
+HostTWI_Control &HostTWI_Control::operator=(uint8_t value)
+{
+  if (!(value & _BV(TWEN)))
+  { // The peripheral is off and lets go of the bus, e.g. to reset it.
+    endTransaction();
+    stepPending_ = false;
+    value_ = value;
+    return *this;
+  }
+
+  if (!(value & _BV(TWINT)))
+  { // Only the settings changed
+    value_ = (value_ & _BV(TWINT)) | value;
+    return *this;
+  }
+
+  // Writing a one to TWINT clears it and starts the step.
+  value_ = value & ~_BV(TWINT);
+  uint8_t status;
+  bool received = false;
+  uint8_t data = 0;
+
+  if (value & _BV(TWSTO))
+  { // A stop doesn't set TWINT; TWSTO clears once it is sent.
+    beginStep(BITS_STOP);
+    endTransaction();
+    value_ &= ~_BV(TWSTO);
+
+    if (!inInterrupt_)
+    {
+      HostSim::advanceTo(busTime_);
+    }
+
+    return *this;
+  }
+  else if (value & _BV(TWSTA))
+  {
+    uint64_t start = beginStep(BITS_START);
+
+    if (state_ == BUS_IDLE)
+    {
+      transactionStart_ = start;
+      status = TW_START;
+    }
+    else
+    {
+      status = TW_REP_START;
+    }
+
+    state_ = BUS_ADDRESS;
+  }
+  else
+  {
+    switch (state_)
+    {
+    case BUS_ADDRESS:
+    {
+      bool read = TWDR & 0x01;
+      address_ = TWDR >> 1;
+      device_ = devices_[address_];
+      beginStep(BITS_BYTE);
+      bool ack = device_ && device_->addressed(read);
+      status = read ? (ack ? TW_MR_SLA_ACK : TW_MR_SLA_NACK) : (ack ? TW_MT_SLA_ACK : TW_MT_SLA_NACK);
+      state_ = ack ? (read ? BUS_RECEIVE : BUS_TRANSMIT) : BUS_NACKED;
+      break;
+    }
+    case BUS_TRANSMIT:
+    {
+      beginStep(BITS_BYTE);
+      bool ack = device_->received(TWDR);
+      status = ack ? TW_MT_DATA_ACK : TW_MT_DATA_NACK;
+      state_ = ack ? BUS_TRANSMIT : BUS_NACKED;
+      break;
+    }
+    case BUS_RECEIVE:
+      beginStep(BITS_BYTE);
+      data = device_->requested();
+      received = true;
+      status = (value & _BV(TWEA)) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+      break;
+    default:
+      // Nothing to do on the bus, e.g. the ACK setting after letting go of it
+      value_ |= _BV(TWINT);
+      return *this;
+    }
+  }
+
+  stepStatus_ = status;
+  stepData_ = data;
+  stepReceived_ = received;
+
+  if (value & _BV(TWIE))
+  {
+    stepPending_ = true;
+    stepEnd_ = busTime_;
+  }
+  else
+  {
+    TWSR = (TWSR & 0x03) | stepStatus_;
+    if (stepReceived_) { TWDR = stepData_; }
+    value_ |= _BV(TWINT);
+
+    if (!inInterrupt_)
+    {
+      HostSim::advanceTo(busTime_);
+    }
+  }
+
+  return *this;
+}
+
+void HostSim::advanceI2C()
+{
+  if (inInterrupt_)
+  {
+    return;
+  }
+
+  while (stepPending_ && stepEnd_ <= now())
+  {
+    stepPending_ = false;
+    TWSR = (TWSR & 0x03) | stepStatus_;
+    if (stepReceived_) { TWDR = stepData_; }
+    HostTWI::setInterruptFlag();
+    inInterrupt_ = true;
+    TWI_vect();
+    inInterrupt_ = false;
+  }
+}
+
+void HostSim::attachI2CDevice(uint8_t address, HostI2C_Device *device)
+{
+  devices_[address & 0x7F] = device;
+}
+
+uint64_t HostSim::getI2CBusyTime(uint8_t address)
+{
+  return busyTime_[address & 0x7F];
+}
+
+uint32_t HostSim::getI2CTransactionCount(uint8_t address)
+{
+  return transactionCount_[address & 0x7F];
+}
+
+void HostSim::resetI2CStats()
+{
+  memset(busyTime_, 0, sizeof(busyTime_));
+  memset(transactionCount_, 0, sizeof(transactionCount_));
+}
@@ -0,0 +1,29 @@
+// Nothing is on the SPI bus; the sketch only includes it for the libraries.
+#ifndef _HOST_SPI_h
+#define _HOST_SPI_h
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+class SPISettings
+{
+public:
+  SPISettings() {}
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) { (void) clock; (void) bitOrder; (void) dataMode; }
+};
+
+class SPIClass
+{
+public:
+  void begin() {}
+  void end() {}
+  void beginTransaction(SPISettings settings) { (void) settings; }
+  void endTransaction() {}
+  uint8_t transfer(uint8_t data) { (void) data; return 0xFF; }
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,2 @@
+// serLCD_cI2C.cpp includes its header as "SerLCD_cI2C.h"; the file system here is case sensitive.
+#include "../serLCD_cI2C.h"
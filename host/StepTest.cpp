@@ -0,0 +1,337 @@
+/*********************************************************************************
+Step test of the humidity control on the host build (see HostSim.h).
+
+Runs the whole sketch against a ChamberPlant, and drives it over the serial link
+like the computer would: the fan is started, then the RH target is changed to a
+new random value once the step response (SERIAL_CMD_STEP_RESPONSE) says that the
+previous step settled, or after STEP_TIMEOUT. At the end it prints the settling
+time and overshoot of the steps, the loop cost (host time per pass of loop(),
+and the run time of each task on the virtual clock, as sent for
+SERIAL_CMD_TASK_STATS) and the share of the time that the I2C bus was busy with
+each device.
+
+Usage: humidosh_steps [steps] [seed]
+Fails if a step didn't settle, or if a device reported a failure.
+
+Copyright (C) 2019 Soon Kiat Lau
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+// The standard headers go first; the Arduino min() and max() macros would break them.
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "HostSim.h"
+#include "HostDevices.h"
+#include "../Keypad.h"
+
+// Prototypes that the Arduino IDE would generate for the sketch
+void keypadEvent(KeypadEvent key);
+void serialEvent();
+
+#include "../HumidOSH.ino"
+
+static const uint64_t NS_PER_MS = 1000000;
+static const uint64_t NS_PER_S = 1000 * NS_PER_MS;
+
+static const uint16_t STEP_COUNT_DEFAULT = 20;
+static const uint64_t STEP_TIMEOUT = 30 * 60 * NS_PER_S;  // A step that hasn't settled by then counts as not settled
+static const uint64_t STEP_POLL_PERIOD = 5 * NS_PER_S;    // How often the step response is asked for
+static const uint64_t REPLY_TIMEOUT = 2 * NS_PER_S;
+static const float TARGET_MIN = 20;        // %RH
+static const float TARGET_MAX = 80;
+static const float TARGET_STEP_MIN = 5;    // Smallest change of target
+static const uint16_t FAN_SPEED = 3000;    // RPM
+
+static ChamberPlant plant;
+static HostSHT3x sensor(&plant);
+static HostEMC2301 fan;
+static HostI2C_Device screen;   // Takes everything
+static HostI2C_Device fanMux;
+
+static std::string received;    // What the sketch sent that wasn't read yet
+static unsigned long passCount = 0;
+
+static uint16_t pumpDrive = 0;
+static bool valveDryOpen = false;
+static bool valveWetOpen = false;
+static uint64_t plantUpdateTime = 0;
+
+// One pass of loop(), then serialEvent() as in the Arduino core. The sketch only acts on deadlines in ms, so instead
+// of spinning, the clock goes on to the next ms.
+static void runPass()
+{
+  loop();
+
+  if (Serial.available())
+  {
+    serialEvent();
+  }
+
+  HostSim::advanceTo((HostSim::now() / NS_PER_MS + 1) * NS_PER_MS);
+  passCount++;
+
+  // The plant follows the pump and valves as they were since its last update. It is only moved when they change, or
+  // once per measurement: in steps of 1 ms, the slow leak would be lost to the rounding of the RH (a float).
+  uint16_t pumpDriveNow = OCR1A;
+  bool valveDryOpenNow = HostSim::getPinOutput(PIN_VALVE_DRY) == HIGH;
+  bool valveWetOpenNow = HostSim::getPinOutput(PIN_VALVE_WET) == HIGH;
+
+  if (pumpDriveNow != pumpDrive || valveDryOpenNow != valveDryOpen || valveWetOpenNow != valveWetOpen ||
+      HostSim::now() - plantUpdateTime >= ChamberPlant::MEASUREMENT_PERIOD * NS_PER_MS)
+  {
+    plantUpdateTime = HostSim::now();
+    plant.update(plantUpdateTime / NS_PER_MS);
+    plant.setPumpDrive(pumpDrive = pumpDriveNow);
+    plant.setValveDry(valveDryOpen = valveDryOpenNow);
+    plant.setValveWet(valveWetOpen = valveWetOpenNow);
+  }
+
+  char buffer[256];
+  size_t length;
+
+  while ((length = HostSim::serialTakeSent(buffer, sizeof(buffer))) > 0)
+  {
+    received.append(buffer, length);
+  }
+}
+
+static void runFor(uint64_t duration)
+{
+  uint64_t end = HostSim::now() + duration;
+
+  while (HostSim::now() < end)
+  {
+    runPass();
+  }
+}
+
+// Send a command and wait for the line of the reply that starts with prefix. Returns false if it didn't come.
+static bool sendCommand(const char *command, const char *prefix, std::string *reply)
+{
+  received.clear();
+  HostSim::serialReceive(command);
+  uint64_t end = HostSim::now() + REPLY_TIMEOUT;
+
+  while (HostSim::now() < end)
+  {
+    runPass();
+    size_t start = received.find(prefix);
+
+    if (start != std::string::npos)
+    {
+      size_t stop = received.find('\n', start);
+
+      if (stop != std::string::npos)
+      {
+        if (reply)
+        {
+          *reply = received.substr(start, stop - start);
+        }
+
+        return true;
+      }
+    }
+  }
+
+  fprintf(stderr, "No reply to %s\n", command);
+  return false;
+}
+
+// Fields of a reply such as ^g|0|1|0|1000|0|1.25@, from index 1 (after the command character)
+static double getField(const std::string &reply, uint8_t index)
+{
+  size_t position = 0;
+
+  for (uint8_t i = 0; i < index; i++)
+  {
+    position = reply.find('|', position);
+
+    if (position == std::string::npos)
+    {
+      return 0;
+    }
+
+    position++;
+  }
+
+  return atof(reply.c_str() + position);
+}
+
+static uint32_t random_ = 1;
+
+static float randomTarget(float previous)
+{
+  float target;
+
+  do
+  {
+    random_ = random_ * 1664525UL + 1013904223UL;
+    target = TARGET_MIN + (TARGET_MAX - TARGET_MIN) * ((random_ >> 8) / (float) (1UL << 24));
+    target = (int) (target * 10) / 10.0;  // As typed in
+  } while (fabs(target - previous) < TARGET_STEP_MIN);
+
+  return target;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned long stepCount = argc > 1 ? strtoul(argv[1], NULL, 10) : STEP_COUNT_DEFAULT;
+  random_ = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+  HostSim::attachI2CDevice(SHT3x::BASE_ADDRESS, &sensor);
+  HostSim::attachI2CDevice(EMC2301::I2C_ADDRESS, &fan);
+  HostSim::attachI2CDevice(DISPLAY_ADDRESS1, &screen);
+  HostSim::attachI2CDevice(HUMIDOSH_FAN_MUX_ADDRESS, &fanMux);
+  sensor.setNoise(0.05, random_);
+
+  setup();
+  runFor(NS_PER_S);
+
+  char command[64];
+  snprintf(command, sizeof(command), "^f|%u|1@", FAN_SPEED);
+
+  if (!sendCommand(command, "^r|f|", NULL))
+  {
+    return 1;
+  }
+
+  // Counted from here on
+  HostSim::resetI2CStats();
+  sendCommand("^t@", "^r|t|", NULL);
+  sendCommand("^v@", "^r|v|", NULL);
+  uint64_t startTime = HostSim::now();
+  unsigned long startPassCount = passCount;
+  std::chrono::steady_clock::time_point hostStartTime = std::chrono::steady_clock::now();
+
+  unsigned long settledCount = 0;
+  double settlingTimeTotal = 0;
+  double settlingTimeMax = 0;
+  double overshootTotal = 0;
+  double overshootMax = 0;
+  float target = plant.getRH();
+
+  for (unsigned long step = 0; step < stepCount; step++)
+  {
+    target = randomTarget(target);
+    snprintf(command, sizeof(command), "^h|%.1f|1@", target);
+
+    if (!sendCommand(command, "^r|h|", NULL))
+    {
+      return 1;
+    }
+
+    uint64_t stepStart = HostSim::now();
+    std::string reply;
+    bool settled = false;
+
+    while (!settled && HostSim::now() - stepStart < STEP_TIMEOUT)
+    {
+      runFor(STEP_POLL_PERIOD);
+
+      if (!sendCommand("^g@", "^g|", &reply))
+      {
+        return 1;
+      }
+
+      settled = getField(reply, 3) != 0;
+    }
+
+    double settlingTime = getField(reply, 5) / 1000;  // s
+    double overshoot = getField(reply, 6);
+
+    if (settled)
+    {
+      settledCount++;
+      settlingTimeTotal += settlingTime;
+      settlingTimeMax = max(settlingTimeMax, settlingTime);
+    }
+    else
+    {
+      printf("Step %lu to %.1f %%RH didn't settle in %llu s\n", step + 1, target, (unsigned long long) (STEP_TIMEOUT / NS_PER_S));
+    }
+
+    overshootTotal += overshoot;
+    overshootMax = max(overshootMax, overshoot);
+  }
+
+  double hostTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStartTime).count();
+  uint64_t simulatedTime = HostSim::now() - startTime;
+  unsigned long passes = passCount - startPassCount;
+
+  printf("Steps: %lu, settled: %lu (%.1f %%)\n", stepCount, settledCount, stepCount ? 100.0 * settledCount / stepCount : 0);
+
+  if (settledCount)
+  {
+    printf("Settling time (s): mean %.1f, max %.1f\n", settlingTimeTotal / settledCount, settlingTimeMax);
+  }
+
+  if (stepCount)
+  {
+    printf("Overshoot (%%RH): mean %.2f, max %.2f\n", overshootTotal / stepCount, overshootMax);
+  }
+
+  printf("Simulated %.1f h in %.1f s of host time (%.0fx real time)\n", simulatedTime / 3600.0 / NS_PER_S, hostTime,
+         simulatedTime / (hostTime * NS_PER_S));
+  printf("Loop: %lu passes, %.0f ns of host time per pass\n", passes, passes ? hostTime * 1e9 / passes : 0);
+
+  // Run time of each task on the virtual clock, i.e. mostly the time spent waiting for the bus or in delay()
+  std::string tasks;
+  received.clear();
+  HostSim::serialReceive("^t@");
+  runFor(100 * NS_PER_MS);
+  tasks = received;
+  printf("Tasks (virtual time):   runs   mean (us)   max (us)   overruns   load (%%)\n");
+
+  for (size_t start = tasks.find("^t|"); start != std::string::npos; start = tasks.find("^t|", start + 1))
+  {
+    std::string line = tasks.substr(start, tasks.find('\n', start) - start);
+    double runs = getField(line, 2);
+    double total = getField(line, 3);
+    printf("  task %-2.0f %18.0f %11.1f %10.0f %10.0f %10.3f\n", getField(line, 1), runs, runs ? total / runs : 0,
+           getField(line, 4), getField(line, 5), 100 * total * 1000 / simulatedTime);
+  }
+
+  printf("I2C bus (busy time / simulated time):\n");
+  const uint8_t addresses[] = { SHT3x::BASE_ADDRESS, EMC2301::I2C_ADDRESS, DISPLAY_ADDRESS1, HUMIDOSH_FAN_MUX_ADDRESS };
+  const char *names[] = { "SHT3x", "EMC2301", "Screen", "Fan mux" };
+  double busyTotal = 0;
+
+  for (uint8_t i = 0; i < sizeof(addresses); i++)
+  {
+    double busy = HostSim::getI2CBusyTime(addresses[i]);
+    busyTotal += busy;
+    printf("  %-8s 0x%02X %10lu transactions %8.3f %%\n", names[i], addresses[i],
+           (unsigned long) HostSim::getI2CTransactionCount(addresses[i]), 100 * busy / simulatedTime);
+  }
+
+  printf("  Total              %26.3f %%\n", 100 * busyTotal / simulatedTime);
+
+  // Device failures since the start of the steps: ^v|[chamber]|[device]|[attempts]|[failures]|...
+  unsigned long failures = 0;
+  received.clear();
+  HostSim::serialReceive("^v@");
+  runFor(100 * NS_PER_MS);
+
+  for (size_t start = received.find("^v|"); start != std::string::npos; start = received.find("^v|", start + 1))
+  {
+    failures += getField(received.substr(start, received.find('\n', start) - start), 4);
+  }
+
+  printf("Device failures: %lu\n", failures);
+  return settledCount == stepCount && failures == 0 ? 0 : 1;
+}
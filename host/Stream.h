@@ -0,0 +1,2 @@
+// Stream is part of the core (see Arduino.h).
+#include "Arduino.h"
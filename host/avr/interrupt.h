@@ -0,0 +1,9 @@
+// There are no interrupts on the host; an ISR is an ordinary function that is never called.
+#ifndef _HOST_AVR_INTERRUPT_h
+#define _HOST_AVR_INTERRUPT_h
+
+#define ISR(vector) extern "C" void vector(void)
+#define cli()
+#define sei()
+
+#endif
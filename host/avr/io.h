@@ -0,0 +1,59 @@
+// Registers of the ATmega328P that the sketch touches, as plain variables (see HostArduino.cpp), apart from TWCR:
+// writing it drives the TWI peripheral (see HostTWI.cpp).
+#ifndef _HOST_AVR_IO_h
+#define _HOST_AVR_IO_h
+
+#include <stdint.h>
+
+#define __AVR_ATmega328P__ 1
+
+#define _SFR_BYTE(sfr) (sfr)
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
+#define bit_is_set(sfr, bit) (_SFR_BYTE(sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!(_SFR_BYTE(sfr) & _BV(bit)))
+
+class HostTWI_Control
+{
+public:
+  HostTWI_Control &operator=(uint8_t value);
+  operator uint8_t() const { return value_; }
+
+private:
+  friend struct HostTWI;
+  volatile uint8_t value_ = 0;
+};
+
+extern HostTWI_Control TWCR;
+extern volatile uint8_t TWSR, TWBR, TWDR, TWAR;
+extern volatile uint8_t PORTB, PORTC, PORTD, DDRB, DDRC, DDRD, PINB, PINC, PIND;
+extern volatile uint8_t TCCR1A, TCCR1B;
+extern volatile uint16_t TCNT1, ICR1, OCR1A, OCR1B;
+extern volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2, PCIFR, SREG;
+extern volatile uint8_t UCSR0A;   // TXC0 always set: the UART sends instantly
+
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC 3
+#define TWEN 2
+#define TWIE 0
+#define TWPS0 0
+#define TWPS1 1
+#define COM1A1 7
+#define COM1B1 5
+#define WGM11 1
+#define WGM13 4
+#define CS10 0
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define TXC0 6
+
+#endif
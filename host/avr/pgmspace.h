@@ -0,0 +1,22 @@
+// Flash and RAM are one address space on the host.
+#ifndef _HOST_AVR_PGMSPACE_h
+#define _HOST_AVR_PGMSPACE_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+#define pgm_read_word(address) (*(const uint16_t *) (address))
+#define pgm_read_dword(address) (*(const uint32_t *) (address))
+#define pgm_read_float(address) (*(const float *) (address))
+#define pgm_read_ptr(address) (*(void * const *) (address))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define memcpy_P memcpy
+
+#endif
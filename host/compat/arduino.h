@@ -0,0 +1,3 @@
+// The sketch includes the core as "arduino.h" as well as "Arduino.h". This one only matters on a case sensitive file
+// system, and is kept apart from Arduino.h so that the two don't collide on the others.
+#include "../Arduino.h"
@@ -326,6 +326,19 @@ bool SerLCD::specialCommand(byte command, byte count) {
  * of the display.
  */
 bool SerLCD::clear() {
+  if (_framebufferEnabled)
+  {
+    _cursorCol = 0;
+    _cursorRow = 0;
+    for (byte i = 0; i < MAX_ROWS * MAX_COLUMNS; i++) {
+      putFrameChar(' ');
+    }
+    _cursorCol = 0;
+    _cursorRow = 0;
+    _cursorDirty = true;
+    return true;
+  }
+
   if (command(CLEAR_COMMAND))
   {
     delay(10);  // a little extra delay after clear
@@ -340,6 +353,14 @@ bool SerLCD::clear() {
  * the display.
  */
 bool SerLCD::home() {
+  if (_framebufferEnabled)
+  {
+    _cursorCol = 0;
+    _cursorRow = 0;
+    _cursorDirty = true;
+    return true;
+  }
+
   return specialCommand(LCD_RETURNHOME);
 }
 
@@ -352,14 +373,20 @@ bool SerLCD::home() {
  * returns: boolean true if cursor set.
  */
 bool SerLCD::setCursor(byte col, byte row) {
-  int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-
   //kepp variables in bounds
   row = max(0, row);      //row cannot be less than 0
   row = min(row, MAX_ROWS-1); //row cannot be greater than max rows
 
+  if (_framebufferEnabled)
+  {
+    _cursorCol = min(col, MAX_COLUMNS-1);
+    _cursorRow = row;
+    _cursorDirty = true;
+    return true;
+  }
+
   //send the command
-  return specialCommand(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+  return specialCommand(LCD_SETDDRAMADDR | getDDRAMAddress(col, row));
 } // setCursor
 
 /*
@@ -409,6 +436,12 @@ bool SerLCD::writeChar(byte location) {
  * Required for Print.
  */
 size_t SerLCD::write(uint8_t b) {
+  if (_framebufferEnabled)
+  {
+    putFrameChar(b);
+    return 1;
+  }
+
   if (beginTransmission() && // transmit to device
       transmit(b) &&
       endTransmission()) //Stop transmission
@@ -428,6 +461,14 @@ size_t SerLCD::write(uint8_t b) {
  */
 size_t SerLCD::write(const uint8_t *buffer, size_t size) {
   size_t n = 0;
+  if (_framebufferEnabled)
+  {
+    for (n = 0; n < size; n++) {
+      putFrameChar(buffer[n]);
+    }
+    return n;
+  }
+
   if (beginTransmission())
   {
     // transmit to device
@@ -467,12 +508,57 @@ size_t SerLCD::write(const uint8_t *buffer, size_t size) {
    return write((const uint8_t *)str, strlen(str));
 }
 
+/*
+ * Print a string kept in flash (PROGMEM).
+ * Print::print() would write it one byte at a time, i.e. one I2C transmission per character
+ * when the framebuffer is off, so send it in one transmission like write(buffer, size).
+ */
+size_t SerLCD::print(const __FlashStringHelper *str) {
+  PGM_P p = reinterpret_cast<PGM_P>(str);
+  size_t n = 0;
+  byte c;
+
+  if (p == NULL) return false;
+
+  if (_framebufferEnabled)
+  {
+    while ((c = pgm_read_byte(p++)) != 0) {
+      putFrameChar(c);
+      n++;
+    }
+    return n;
+  }
+
+  if (beginTransmission())
+  {
+    while ((c = pgm_read_byte(p++)) != 0)
+    {
+      if (transmit(c))
+      {
+        n++;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    if (endTransmission())
+    {
+      delay(10);
+      return n;
+    }
+    else { return false; }
+  }
+  else { return false; }
+} //print
+
  /*
   * Turn the display off quickly.
   */
  bool SerLCD::noDisplay(){
   _displayControl &= ~LCD_DISPLAYON;
-  return specialCommand(LCD_DISPLAYCONTROL | _displayControl);
+  return sendDisplayControl();
  } // noDisplay
 
 /*
@@ -480,7 +566,7 @@ size_t SerLCD::write(const uint8_t *buffer, size_t size) {
  */
  bool SerLCD::display() {
   _displayControl |= LCD_DISPLAYON;
-  return specialCommand(LCD_DISPLAYCONTROL | _displayControl);
+  return sendDisplayControl();
  } // display
  
  /*
@@ -488,7 +574,7 @@ size_t SerLCD::write(const uint8_t *buffer, size_t size) {
   */
  bool SerLCD::noCursor(){
   _displayControl &= ~LCD_CURSORON;
-  return specialCommand(LCD_DISPLAYCONTROL | _displayControl);
+  return sendDisplayControl();
  } // noCursor
 
 /*
@@ -496,7 +582,7 @@ size_t SerLCD::write(const uint8_t *buffer, size_t size) {
  */
  bool SerLCD::cursor() {
   _displayControl |= LCD_CURSORON;
-  return specialCommand(LCD_DISPLAYCONTROL | _displayControl);
+  return sendDisplayControl();
  } // cursor
 
  /*
@@ -504,7 +590,7 @@ size_t SerLCD::write(const uint8_t *buffer, size_t size) {
   */
  bool SerLCD::noBlink(){
   _displayControl &= ~LCD_BLINKON;
-  return specialCommand(LCD_DISPLAYCONTROL | _displayControl);
+  return sendDisplayControl();
  } // noBlink
 
 /*
@@ -512,7 +598,7 @@ size_t SerLCD::write(const uint8_t *buffer, size_t size) {
  */
  bool SerLCD::blink() {
   _displayControl |= LCD_BLINKON;
-  return specialCommand(LCD_DISPLAYCONTROL | _displayControl);
+  return sendDisplayControl();
  } // blink
 
 /*
@@ -748,4 +834,198 @@ bool SerLCD::setAddress(byte new_addr) {
     return true;
   }
   else { return false; }
-} //setContrast
\ No newline at end of file
+} //setContrast
+
+/*
+ * Switch over to the shadow framebuffer. The display is cleared so that
+ * it matches the (blank) framebuffer.
+ */
+bool SerLCD::enableFramebuffer() {
+  _framebufferEnabled = false;
+  if (!clear()) { return false; }
+
+  for (byte row = 0; row < MAX_ROWS; row++) {
+    for (byte col = 0; col < MAX_COLUMNS; col++) {
+      _frame[row][col] = ' ';
+    }
+    _dirtyStart[row] = MAX_COLUMNS;
+    _dirtyEnd[row] = 0;
+  }
+
+  _cursorCol = 0;
+  _cursorRow = 0;
+  _cursorDirty = false;
+  _displayControlDirty = false;
+  _flushTransaction.status = I2C_STATUS_OK;
+  _flushTransaction.complete = true;
+  _lastFlush = millis();
+  _flushInterval = FLUSH_INTERVAL_DEFAULT;
+  _framebufferEnabled = true;
+  return true;
+} // enableFramebuffer
+
+/*
+ * Send the cells that changed since the last flush to the display, together with
+ * any pending display control and cursor position, as a single transaction.
+ * Does nothing if the previous flush is still in progress or was sent less than
+ * the minimum interval ago; just call this regularly. With I2C, the transaction
+ * is done in the background. Anything that doesn't fit in one transaction is
+ * left for the next flush.
+ *
+ * returns: boolean false if the transaction could not be sent.
+ */
+bool SerLCD::flushFrame() {
+  if (!_framebufferEnabled) { return true; }
+
+  //Pace the flushes instead of sleeping after each one
+  if (!_flushTransaction.complete || millis() - _lastFlush < _flushInterval) { return true; }
+
+  //Whatever was in the previous flush may not have made it to the display; redraw everything
+  if (_flushTransaction.status != I2C_STATUS_OK) {
+    _flushTransaction.status = I2C_STATUS_OK;
+    markAllDirty();
+  }
+
+  byte n = 0;
+  bool sentCommand = false;
+
+  for (byte row = 0; row < MAX_ROWS && n + 3 <= FLUSH_BUFFER_SIZE; row++) {
+    if (_dirtyStart[row] >= _dirtyEnd[row]) { continue; }
+
+    //Move to the first changed cell of the row, then send everything up to the last changed cell
+    _flushBuffer[n++] = SPECIAL_COMMAND;
+    _flushBuffer[n++] = LCD_SETDDRAMADDR | getDDRAMAddress(_dirtyStart[row], row);
+    while (_dirtyStart[row] < _dirtyEnd[row] && n < FLUSH_BUFFER_SIZE) {
+      _flushBuffer[n++] = _frame[row][_dirtyStart[row]++];
+    }
+
+    if (_dirtyStart[row] >= _dirtyEnd[row]) {
+      _dirtyStart[row] = MAX_COLUMNS;
+      _dirtyEnd[row] = 0;
+    }
+    _cursorDirty = true;
+  }
+
+  if (_displayControlDirty && n + 2 <= FLUSH_BUFFER_SIZE) {
+    _flushBuffer[n++] = SPECIAL_COMMAND;
+    _flushBuffer[n++] = LCD_DISPLAYCONTROL | _displayControl;
+    _displayControlDirty = false;
+    sentCommand = true;
+  }
+
+  //Writing the cells moved the display's cursor; only matters if the cursor is visible
+  if (_cursorDirty && (_displayControl & (LCD_CURSORON | LCD_BLINKON)) && n + 2 <= FLUSH_BUFFER_SIZE) {
+    _flushBuffer[n++] = SPECIAL_COMMAND;
+    _flushBuffer[n++] = LCD_SETDDRAMADDR | getDDRAMAddress(_cursorCol, _cursorRow);
+    _cursorDirty = false;
+  }
+
+  if (n == 0) { return true; }
+
+  _lastFlush = millis();
+  _flushInterval = sentCommand ? FLUSH_INTERVAL_COMMAND : FLUSH_INTERVAL_DEFAULT;
+
+  if (_i2cPort) {
+    _flushTransaction.address = _i2cAddr;
+    _flushTransaction.txBuffer = _flushBuffer;
+    _flushTransaction.txLength = n;
+    _flushTransaction.rxBuffer = NULL;
+    _flushTransaction.rxLength = 0;
+    _flushTransaction.callback = NULL;
+    _flushTransaction.context = NULL;
+
+    if (_i2cPort->submit(&_flushTransaction) == I2C_STATUS_PENDING) { return true; }
+    else {
+      markAllDirty();
+      return false;
+    }
+  }
+
+  //Serial and SPI are sent right away
+  if (beginTransmission()) {
+    for (byte i = 0; i < n; i++) {
+      if (!transmit(_flushBuffer[i])) { break; }
+    }
+    if (endTransmission()) { return true; }
+  }
+  markAllDirty();
+  return false;
+} // flushFrame
+
+/*
+ * Keep flushing until the whole framebuffer is on the display.
+ * Blocks for a while; only meant for setup code such as splash screens.
+ */
+void SerLCD::flushFrameAll() {
+  while (isDirty()) {
+    if (_i2cPort) { _i2cPort->poll(); }
+    flushFrame();
+  }
+} // flushFrameAll
+
+/*
+ * returns: boolean true if the display does not match the framebuffer yet.
+ */
+bool SerLCD::isDirty() {
+  if (!_framebufferEnabled) { return false; }
+  if (!_flushTransaction.complete || _displayControlDirty) { return true; }
+  if (_cursorDirty && (_displayControl & (LCD_CURSORON | LCD_BLINKON))) { return true; }
+
+  for (byte row = 0; row < MAX_ROWS; row++) {
+    if (_dirtyStart[row] < _dirtyEnd[row]) { return true; }
+  }
+  return false;
+} // isDirty
+
+/*
+ * Place a character at the framebuffer cursor and advance the cursor,
+ * wrapping to the next row like OpenLCD does.
+ */
+void SerLCD::putFrameChar(byte c) {
+  if (_cursorCol >= MAX_COLUMNS) {
+    _cursorCol = 0;
+    _cursorRow = (_cursorRow + 1) % MAX_ROWS;
+  }
+
+  if (_frame[_cursorRow][_cursorCol] != (char) c) {
+    _frame[_cursorRow][_cursorCol] = c;
+    if (_cursorCol < _dirtyStart[_cursorRow]) { _dirtyStart[_cursorRow] = _cursorCol; }
+    if (_cursorCol >= _dirtyEnd[_cursorRow]) { _dirtyEnd[_cursorRow] = _cursorCol + 1; }
+  }
+
+  _cursorCol++;
+  _cursorDirty = true;
+} // putFrameChar
+
+/*
+ * Force the whole framebuffer (and the display control) to be sent again.
+ */
+void SerLCD::markAllDirty() {
+  for (byte row = 0; row < MAX_ROWS; row++) {
+    _dirtyStart[row] = 0;
+    _dirtyEnd[row] = MAX_COLUMNS;
+  }
+  _displayControlDirty = true;
+  _cursorDirty = true;
+} // markAllDirty
+
+/*
+ * Send _displayControl now, or with the next flush if the framebuffer is in use.
+ */
+bool SerLCD::sendDisplayControl() {
+  if (_framebufferEnabled) {
+    _displayControlDirty = true;
+    return true;
+  }
+
+  return specialCommand(LCD_DISPLAYCONTROL | _displayControl);
+} // sendDisplayControl
+
+/*
+ * Convert a column and row into the display's DDRAM address.
+ */
+byte SerLCD::getDDRAMAddress(byte col, byte row) {
+  const byte row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+
+  return col + row_offsets[row];
+} // getDDRAMAddress
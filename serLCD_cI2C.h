@@ -10,6 +10,11 @@
 #define MAX_ROWS      	  4
 #define MAX_COLUMNS  	 20
 
+// Framebuffer flushing
+#define FLUSH_BUFFER_SIZE         32  //OpenLCD receives I2C through the Wire library, which can only hold 32 bytes per transaction
+#define FLUSH_INTERVAL_DEFAULT    10  //Minimum time (ms) between flushes, to let OpenLCD process the previous one
+#define FLUSH_INTERVAL_COMMAND    50  //Minimum time (ms) after a flush that included a special command
+
 //OpenLCD command characters
 #define SPECIAL_COMMAND  254  //Magic number for sending a special command
 #define SETTING_COMMAND  0x7C //124, |, the pipe character: The command to change settings: baud, lines, width, backlight, splash, etc
@@ -70,6 +75,9 @@ public:
 	virtual size_t write(uint8_t);
 	virtual size_t write(const uint8_t *buffer, size_t size);
     virtual size_t write(const char *str);
+  //Print a string kept in flash, e.g. print(F("text")), without copying it to RAM first.
+  using Print::print;
+  size_t print(const __FlashStringHelper *str);
 	bool noDisplay();
   bool display();
   bool noCursor();
@@ -97,6 +105,13 @@ public:
 	bool command(byte command);
 	bool specialCommand(byte command);
     bool specialCommand(byte command, byte count);
+
+  //Shadow framebuffer. Once enabled, printing, setCursor(), clear(), home() and the cursor/blink/display toggles only
+  //change the framebuffer; flushFrame() then sends the changed cells to the display in the background.
+  bool enableFramebuffer();
+  bool flushFrame();
+  void flushFrameAll();
+  bool isDirty();
 private:
     I2C *_i2cPort = NULL; //The generic connection to user's chosen I2C hardware
     Stream   *_serialPort = NULL; //The generic connection to user's chosen serial hardware
@@ -111,6 +126,25 @@ private:
 	byte _i2cAddr = DISPLAY_ADDRESS1;
 	byte _displayControl = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
     byte _displayMode    = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+    //Shadow framebuffer and the rows/columns that changed since the last flush.
+    //A row is clean when _dirtyStart[row] >= _dirtyEnd[row].
+    bool _framebufferEnabled = false;
+    char _frame[MAX_ROWS][MAX_COLUMNS];
+    byte _dirtyStart[MAX_ROWS];
+    byte _dirtyEnd[MAX_ROWS];
+    byte _cursorCol = 0;
+    byte _cursorRow = 0;
+    bool _cursorDirty = false;          //The display's cursor needs to be moved back to (_cursorCol, _cursorRow), e.g. for blinking
+    bool _displayControlDirty = false;  //_displayControl has to be sent with the next flush
+    unsigned long _lastFlush = 0;
+    uint16_t _flushInterval = FLUSH_INTERVAL_DEFAULT;
+    I2C_Transaction _flushTransaction;
+    byte _flushBuffer[FLUSH_BUFFER_SIZE];
+    void putFrameChar(byte c);
+    void markAllDirty();
+    bool sendDisplayControl();
+    byte getDDRAMAddress(byte col, byte row);
+
     bool init();
     bool beginTransmission();
     bool transmit(byte data);